@@ -386,4 +386,43 @@ void Dx12RenderDevice::ReadPixels(void* data)
 
 }
 
+bool Dx12RenderDevice::LoadPipelineCache(const char* path)
+{
+	return false;
+}
+
+bool Dx12RenderDevice::SavePipelineCache(const char* path)
+{
+	return false;
+}
+
+void Dx12RenderDevice::GetPipelineCacheStats(HalPipelineCacheStats& stats)
+{
+	stats = HalPipelineCacheStats();
+}
+
+void Dx12RenderDevice::GetMemoryUsage(HalMemoryUsage& usage)
+{
+	usage = HalMemoryUsage();
+}
+
+void Dx12RenderDevice::GetMemoryAllocations(std::vector<HalMemoryAllocation>& allocations)
+{
+	allocations.clear();
+}
+
+void Dx12RenderDevice::GetUploadStats(HalUploadStats& stats)
+{
+	stats = HalUploadStats();
+}
+
+void Dx12RenderDevice::SetUploadPolicy(HalUploadPolicy)
+{
+}
+
+uint32_t Dx12RenderDevice::DefragmentMemory(uint64_t)
+{
+	return 0;
+}
+
 }
@@ -603,6 +603,68 @@ public:
     */
     void ReadPixels(void* data) override;
 
+    /**
+    * @brief Seed the device pipeline cache with data saved by a previous run.
+    *
+    * @param[in] path	Path to the cache file
+    *
+    * @return true if the cache data was used
+    */
+    bool LoadPipelineCache(const char* path) override;
+
+    /**
+    * @brief Write the device pipeline cache
+    *
+    * @param[in] path	Path to the cache file
+    *
+    * @return true if successful
+    */
+    bool SavePipelineCache(const char* path) override;
+
+    /**
+    * @brief Query pipeline cache statistics
+    *
+    * @param[out] stats	Receives the statistics
+    */
+    void GetPipelineCacheStats(HalPipelineCacheStats& stats) override;
+
+    /**
+    * @brief Query device memory usage per memory heap and memory type
+    *
+    * @param[out] usage	Receives the usage
+    */
+    void GetMemoryUsage(HalMemoryUsage& usage) override;
+
+    /**
+    * @brief Query all used and free ranges of the memory blocks
+    *
+    * @param[out] allocations	Receives the ranges in block and address order
+    */
+    void GetMemoryAllocations(std::vector<HalMemoryAllocation>& allocations) override;
+
+    /**
+    * @brief Query upload batching statistics
+    *
+    * @param[out] stats	Receives the statistics
+    */
+    void GetUploadStats(HalUploadStats& stats) override;
+
+    /**
+    * @brief Set how device local resources are filled. Applies to resources bound afterwards
+    *
+    * @param[in] policy	Upload policy
+    */
+    void SetUploadPolicy(HalUploadPolicy policy) override;
+
+    /**
+    * @brief Move resources out of the least used device memory block so it can be freed
+    *
+    * @param[in] maxBytes	Upper limit of bytes to move
+    *
+    * @return number of resources moved
+    */
+    uint32_t DefragmentMemory(uint64_t maxBytes) override;
+
 private:
     D3dInstance* _d3dInstance;
     IDXGIAdapter4* _d3dAdapter; ///< D3D physical device
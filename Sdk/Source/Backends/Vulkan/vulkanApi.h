@@ -51,6 +51,7 @@ typedef VkResult(VKAPI_PTR* vkCreateDevicePtr) (VkPhysicalDevice physicalDevice,
 typedef PFN_vkVoidFunction(VKAPI_PTR* vkGetDeviceProcAddrPtr) (VkDevice device, const char* pName);
 typedef VkResult(VKAPI_PTR* vkEnumerateDeviceExtensionPropertiesPtr) (VkPhysicalDevice physicalDevice, const char* pLayerName, uint32_t* pPropertyCount, VkExtensionProperties* pProperties);
 typedef void		(VKAPI_PTR* vkGetPhysicalDeviceMemoryPropertiesPtr) (VkPhysicalDevice physicalDevice, VkPhysicalDeviceMemoryProperties* pMemoryProperties);
+typedef void		(VKAPI_PTR* vkGetPhysicalDeviceMemoryProperties2Ptr) (VkPhysicalDevice physicalDevice, VkPhysicalDeviceMemoryProperties2* pMemoryProperties);
 typedef void		(VKAPI_PTR* vkGetDeviceQueuePtr) (VkDevice device, uint32_t queueFamilyIndex, uint32_t queueIndex, VkQueue* pQueue);
 typedef void		(VKAPI_PTR* vkDestroyDevicePtr) (VkDevice device, const VkAllocationCallbacks* pAllocator);
 typedef VkResult(VKAPI_PTR* vkDeviceWaitIdlePtr) (VkDevice device);
@@ -90,11 +91,13 @@ typedef VkResult    (VKAPI_PTR* vkBindImageMemoryPtr)(VkDevice device, VkImage i
 typedef VkResult    (VKAPI_PTR* vkMapMemoryPtr)(VkDevice device, VkDeviceMemory memory, VkDeviceSize offset, VkDeviceSize size, VkMemoryMapFlags flags, void** ppData);
 typedef void		(VKAPI_PTR* vkUnmapMemoryPtr)(VkDevice device, VkDeviceMemory memory);
 typedef VkResult    (VKAPI_PTR* vkFlushMappedMemoryRangesPtr)(VkDevice device, uint32_t memoryRangeCount, const VkMappedMemoryRange* pMemoryRanges);
+typedef VkResult    (VKAPI_PTR* vkInvalidateMappedMemoryRangesPtr)(VkDevice device, uint32_t memoryRangeCount, const VkMappedMemoryRange* pMemoryRanges);
 typedef VkResult    (VKAPI_PTR* vkQueueSubmitPtr) (VkQueue queue, uint32_t submitCount, const VkSubmitInfo* pSubmits, VkFence fence);
 typedef VkResult    (VKAPI_PTR* vkQueueWaitIdlePtr)(VkQueue queue);
 typedef void		(VKAPI_PTR* vkGetBufferMemoryRequirementsPtr)(VkDevice device, VkBuffer buffer, VkMemoryRequirements* pMemoryRequirements);
 typedef void		(VKAPI_PTR* vkGetBufferMemoryRequirements2Ptr)(VkDevice device, const VkBufferMemoryRequirementsInfo2* pInfo, VkMemoryRequirements2* pMemoryRequirements);
 typedef void		(VKAPI_PTR* vkGetImageMemoryRequirementsPtr)(VkDevice device, VkImage image, VkMemoryRequirements* pMemoryRequirements);
+typedef void		(VKAPI_PTR* vkGetImageMemoryRequirements2Ptr)(VkDevice device, const VkImageMemoryRequirementsInfo2* pInfo, VkMemoryRequirements2* pMemoryRequirements);
 typedef VkResult    (VKAPI_PTR* vkCreateCommandPoolPtr) (VkDevice device, const VkCommandPoolCreateInfo* pCreateInfo, const VkAllocationCallbacks* pAllocator, VkCommandPool* pCommandPool);
 typedef VkResult    (VKAPI_PTR* vkAllocateCommandBuffersPtr) (VkDevice device, const VkCommandBufferAllocateInfo* pAllocateInfo, VkCommandBuffer* pCommandBuffers);
 typedef void		(VKAPI_PTR* vkDestroyCommandPoolPtr) (VkDevice device, VkCommandPool commandPool, const VkAllocationCallbacks* pAllocator);
@@ -134,6 +137,10 @@ typedef void		(VKAPI_PTR* vkUpdateDescriptorSetsPtr)(VkDevice device, uint32_t d
 typedef VkResult    (VKAPI_PTR* vkCreateGraphicsPipelinesPtr) (VkDevice device, VkPipelineCache pipelineCache, uint32_t createInfoCount, const VkGraphicsPipelineCreateInfo* pCreateInfos, const VkAllocationCallbacks* pAllocator, VkPipeline* pPipelines);
 typedef VkResult    (VKAPI_PTR* vkCreateComputePipelinesPtr) (VkDevice device, VkPipelineCache pipelineCache, uint32_t createInfoCount, const VkComputePipelineCreateInfo* pCreateInfos, const VkAllocationCallbacks* pAllocator, VkPipeline* pPipelines);
 typedef void		(VKAPI_PTR* vkDestroyPipelinePtr) (VkDevice device, VkPipeline pipeline, const VkAllocationCallbacks* pAllocator);
+typedef VkResult    (VKAPI_PTR* vkCreatePipelineCachePtr) (VkDevice device, const VkPipelineCacheCreateInfo* pCreateInfo, const VkAllocationCallbacks* pAllocator, VkPipelineCache* pPipelineCache);
+typedef void		(VKAPI_PTR* vkDestroyPipelineCachePtr) (VkDevice device, VkPipelineCache pipelineCache, const VkAllocationCallbacks* pAllocator);
+typedef VkResult    (VKAPI_PTR* vkGetPipelineCacheDataPtr) (VkDevice device, VkPipelineCache pipelineCache, size_t* pDataSize, void* pData);
+typedef VkResult    (VKAPI_PTR* vkMergePipelineCachesPtr) (VkDevice device, VkPipelineCache dstCache, uint32_t srcCacheCount, const VkPipelineCache* pSrcCaches);
 typedef void		(VKAPI_PTR* vkCmdBindPipelinePtr) (VkCommandBuffer commandBuffer, VkPipelineBindPoint pipelineBindPoint, VkPipeline pipeline);
 typedef void		(VKAPI_PTR* vkCmdBindDescriptorSetsPtr)(VkCommandBuffer commandBuffer, VkPipelineBindPoint pipelineBindPoint, VkPipelineLayout layout, uint32_t firstSet, uint32_t descriptorSetCount, const VkDescriptorSet* pDescriptorSets, uint32_t dynamicOffsetCount, const uint32_t* pDynamicOffsets);
 typedef void		(VKAPI_PTR* vkCmdBindIndexBufferPtr)(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize offset, VkIndexType indexType);
@@ -319,6 +326,8 @@ public:
             retValue &= LoadInstanceFunction(pInstance, "vkGetDeviceQueue", vkGetDeviceQueue);
             retValue &= LoadInstanceFunction(pInstance, "vkDestroyDevice", vkDestroyDevice);
             retValue &= LoadInstanceFunction(pInstance, "vkDeviceWaitIdle", vkDeviceWaitIdle);
+            // needs a 1.1 instance -> don't error out if not available
+            LoadInstanceFunction(pInstance, "vkGetPhysicalDeviceMemoryProperties2", vkGetPhysicalDeviceMemoryProperties2);
 
             retValue &= LoadInstanceFunction(pInstance, "vkDestroySurfaceKHR", vkDestroySurfaceKHR);
             retValue &= LoadInstanceFunction(pInstance, "vkGetPhysicalDeviceSurfaceSupportKHR", vkGetPhysicalDeviceSurfaceSupportKHR);
@@ -387,6 +396,7 @@ public:
             retValue &= LoadDeviceFunction(pDevice, "vkMapMemory", vkMapMemory);
             retValue &= LoadDeviceFunction(pDevice, "vkUnmapMemory", vkUnmapMemory);
             retValue &= LoadDeviceFunction(pDevice, "vkFlushMappedMemoryRanges", vkFlushMappedMemoryRanges);
+            retValue &= LoadDeviceFunction(pDevice, "vkInvalidateMappedMemoryRanges", vkInvalidateMappedMemoryRanges);
             retValue &= LoadDeviceFunction(pDevice, "vkQueueSubmit", vkQueueSubmit);
             retValue &= LoadDeviceFunction(pDevice, "vkQueueWaitIdle", vkQueueWaitIdle);
             retValue &= LoadDeviceFunction(pDevice, "vkGetBufferMemoryRequirements", vkGetBufferMemoryRequirements);
@@ -426,6 +436,10 @@ public:
             retValue &= LoadDeviceFunction(pDevice, "vkCreateGraphicsPipelines", vkCreateGraphicsPipelines);
             retValue &= LoadDeviceFunction(pDevice, "vkCreateComputePipelines", vkCreateComputePipelines);
             retValue &= LoadDeviceFunction(pDevice, "vkDestroyPipeline", vkDestroyPipeline);
+            retValue &= LoadDeviceFunction(pDevice, "vkCreatePipelineCache", vkCreatePipelineCache);
+            retValue &= LoadDeviceFunction(pDevice, "vkDestroyPipelineCache", vkDestroyPipelineCache);
+            retValue &= LoadDeviceFunction(pDevice, "vkGetPipelineCacheData", vkGetPipelineCacheData);
+            retValue &= LoadDeviceFunction(pDevice, "vkMergePipelineCaches", vkMergePipelineCaches);
             retValue &= LoadDeviceFunction(pDevice, "vkCmdBindPipeline", vkCmdBindPipeline);
             retValue &= LoadDeviceFunction(pDevice, "vkCmdBindDescriptorSets", vkCmdBindDescriptorSets);
             retValue &= LoadDeviceFunction(pDevice, "vkCmdBindIndexBuffer", vkCmdBindIndexBuffer);
@@ -451,12 +465,30 @@ public:
             if (apiVersion >= VK_MAKE_VERSION(1, 1, 0))
             {
                 retValue &= LoadDeviceFunction(pDevice, "vkGetBufferMemoryRequirements2", vkGetBufferMemoryRequirements2);
+                retValue &= LoadDeviceFunction(pDevice, "vkGetImageMemoryRequirements2", vkGetImageMemoryRequirements2);
             }
         }
 
         return retValue;
     }
 
+    /**
+    * @brief Load the VK_KHR_get_memory_requirements2 functions of a Vulkan 1.0 device
+    *		 into the core function pointers
+    *
+    * @param[in] pDevice	Pointer to vulkan device
+    *
+    * @return true if loading succeeded
+    */
+    bool LoadMemoryRequirements2Functions(VkDevice* pDevice)
+    {
+        bool retValue = true;
+        retValue &= LoadDeviceFunction(pDevice, "vkGetBufferMemoryRequirements2KHR", vkGetBufferMemoryRequirements2);
+        retValue &= LoadDeviceFunction(pDevice, "vkGetImageMemoryRequirements2KHR", vkGetImageMemoryRequirements2);
+
+        return retValue;
+    }
+
 private:
     osLibraryHandle _hVulkan;	///< Vulkan library handle
 
@@ -499,6 +531,7 @@ public:
     vkGetDeviceProcAddrPtr						vkGetDeviceProcAddr;
     vkEnumerateDeviceExtensionPropertiesPtr		vkEnumerateDeviceExtensionProperties;
     vkGetPhysicalDeviceMemoryPropertiesPtr		vkGetPhysicalDeviceMemoryProperties;
+    vkGetPhysicalDeviceMemoryProperties2Ptr		vkGetPhysicalDeviceMemoryProperties2;
     vkGetDeviceQueuePtr							vkGetDeviceQueue;
     vkDestroyDevicePtr							vkDestroyDevice;
     vkDeviceWaitIdlePtr							vkDeviceWaitIdle;
@@ -545,11 +578,13 @@ public:
     vkMapMemoryPtr								vkMapMemory;
     vkUnmapMemoryPtr							vkUnmapMemory;
     vkFlushMappedMemoryRangesPtr				vkFlushMappedMemoryRanges;
+    vkInvalidateMappedMemoryRangesPtr			vkInvalidateMappedMemoryRanges;
     vkQueueSubmitPtr							vkQueueSubmit;
     vkQueueWaitIdlePtr							vkQueueWaitIdle;
     vkGetBufferMemoryRequirementsPtr			vkGetBufferMemoryRequirements;
     vkGetBufferMemoryRequirements2Ptr			vkGetBufferMemoryRequirements2;
     vkGetImageMemoryRequirementsPtr				vkGetImageMemoryRequirements;
+    vkGetImageMemoryRequirements2Ptr			vkGetImageMemoryRequirements2;
     vkCreateCommandPoolPtr						vkCreateCommandPool;
     vkAllocateCommandBuffersPtr					vkAllocateCommandBuffers;
     vkDestroyCommandPoolPtr						vkDestroyCommandPool;
@@ -585,6 +620,10 @@ public:
     vkCreateGraphicsPipelinesPtr				vkCreateGraphicsPipelines;
     vkCreateComputePipelinesPtr					vkCreateComputePipelines;
     vkDestroyPipelinePtr						vkDestroyPipeline;
+    vkCreatePipelineCachePtr					vkCreatePipelineCache;
+    vkDestroyPipelineCachePtr					vkDestroyPipelineCache;
+    vkGetPipelineCacheDataPtr					vkGetPipelineCacheData;
+    vkMergePipelineCachesPtr					vkMergePipelineCaches;
     vkCmdBindPipelinePtr						vkCmdBindPipeline;
     vkCmdBindDescriptorSetsPtr					vkCmdBindDescriptorSets;
     vkCmdBindIndexBufferPtr						vkCmdBindIndexBuffer;
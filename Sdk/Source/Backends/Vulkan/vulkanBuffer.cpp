@@ -33,12 +33,18 @@ VulkanBuffer::VulkanBuffer(VulkanRenderDevice* device, HalBufferInfo& bufferInfo
 	, _vkBuffer(VK_NULL_HANDLE)
 	, _familyIndicesArray(nullptr)
 	, _vkMemProperties(0)
+	, _mapOffset(0)
+	, _mapSize(0)
+	, _uploaded(false)
+	, _descriptorReference(false)
+	, _relocatedBuffer(VK_NULL_HANDLE)
 {
 	_vkCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
 	_vkCreateInfo.pNext = nullptr;
 	_vkCreateInfo.flags = VulkanTypeConversion::ConvertBufferCreateFlagsToVulkan(bufferInfo._create);
 	_vkCreateInfo.size = bufferInfo._size;
-	_vkCreateInfo.usage = VulkanTypeConversion::ConvertBufferUsageFlagsToVulkan(bufferInfo._usage);
+	// the defragmenter copies buffers to new memory
+	_vkCreateInfo.usage = VulkanTypeConversion::ConvertBufferUsageFlagsToVulkan(bufferInfo._usage) | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
 	_vkCreateInfo.sharingMode = VulkanTypeConversion::ConvertSharedModeFlagsToVulkan(bufferInfo._shareMode);
 	_vkCreateInfo.queueFamilyIndexCount = bufferInfo._queueFamilyIndexCount;
 
@@ -95,6 +101,64 @@ void VulkanBuffer::Bind()
 	// bind Memory to buffer object
 	if (VulkanApi::GetApi()->vkBindBufferMemory(_pDevice->GetDeviceHandle(), _vkBuffer, _deviceMemory._vkDeviceMemory, _deviceMemory._offset) != VK_SUCCESS)
 		throw BackendException("Error failed to bind device memory");
+
+	memManager->SetMemoryOwner(_deviceMemory, this);
+}
+
+bool VulkanBuffer::Relocate(VkCommandBuffer commandBuffer, VulkanMemoryBlock* sourceBlock)
+{
+	// descriptor sets would keep using the old handle
+	if (!CanRelocate())
+		return false;
+
+	VulkanMemoryManager* memManager = _pDevice->GetMemoryManager();
+
+	VkBuffer newBuffer = VK_NULL_HANDLE;
+	if (VulkanApi::GetApi()->vkCreateBuffer(_pDevice->GetDeviceHandle(), &_vkCreateInfo, nullptr, &newBuffer) != VK_SUCCESS)
+		return false;
+
+	VkMemoryRequirements memRequirements;
+	VulkanApi::GetApi()->vkGetBufferMemoryRequirements(_pDevice->GetDeviceHandle(), newBuffer, &memRequirements);
+
+	VulkanDeviceMemory newMemory;
+	if (!memManager->AllocateRelocation(memRequirements, AllocatorTlsfKind::Linear, sourceBlock, newMemory))
+	{
+		VulkanApi::GetApi()->vkDestroyBuffer(_pDevice->GetDeviceHandle(), newBuffer, nullptr);
+		return false;
+	}
+
+	if (VulkanApi::GetApi()->vkBindBufferMemory(_pDevice->GetDeviceHandle(), newBuffer, newMemory._vkDeviceMemory, newMemory._offset) != VK_SUCCESS)
+	{
+		memManager->ReleaseBufferMemory(newMemory);
+		VulkanApi::GetApi()->vkDestroyBuffer(_pDevice->GetDeviceHandle(), newBuffer, nullptr);
+		return false;
+	}
+
+	VkBufferCopy region = {};
+	region.size = _vkCreateInfo.size;
+	VulkanApi::GetApi()->vkCmdCopyBuffer(commandBuffer, _vkBuffer, newBuffer, 1, &region);
+
+	// the old buffer is the copy source until the copy finished
+	_relocatedBuffer = _vkBuffer;
+	_relocatedMemory = _deviceMemory;
+	_vkBuffer = newBuffer;
+	_deviceMemory = newMemory;
+	// written by the graphics queue
+	_uploaded = true;
+	memManager->SetMemoryOwner(_deviceMemory, this);
+
+	return true;
+}
+
+void VulkanBuffer::FinishRelocation()
+{
+	if (_relocatedBuffer != VK_NULL_HANDLE)
+	{
+		VulkanApi::GetApi()->vkDestroyBuffer(_pDevice->GetDeviceHandle(), _relocatedBuffer, nullptr);
+		_relocatedBuffer = VK_NULL_HANDLE;
+	}
+
+	_pDevice->GetMemoryManager()->ReleaseBufferMemory(_relocatedMemory);
 }
 
 void VulkanBuffer::Update(uint64_t offset, uint64_t size, const void* pData)
@@ -104,21 +168,49 @@ void VulkanBuffer::Update(uint64_t offset, uint64_t size, const void* pData)
 
 	VulkanMemoryManager* memManager = _pDevice->GetMemoryManager();
 
-	VulkanStagingBufferInfo stagingBufferInfo;
-	memManager->GetStagingBuffer(size, stagingBufferInfo);
-
-	if (stagingBufferInfo.GetMappedAddress() == nullptr)
+	// Buffers created host visible are always written in place, the caller keeps the GPU off the range.
+	// Device local buffers the upload policy placed in host visible memory are written in place only
+	// the first time, when no submitted work reads them yet. Later updates use copies which are ordered
+	// with the frames still in flight.
+	bool hostVisible = (_vkMemProperties & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0;
+	if (_deviceMemory._mappedAddress && (hostVisible || !_uploaded))
+	{
+		std::memcpy(static_cast<uint8_t*>(_deviceMemory._mappedAddress) + offset, pData, (size_t)size);
+		memManager->FlushMappedMemory(_deviceMemory, offset, size);
+		memManager->AddDirectWrite(size);
+		_uploaded = true;
 		return;
+	}
+
+	const uint8_t* pSrc = static_cast<const uint8_t*>(pData);
+
+	// large updates are streamed in staging sized pieces
+	for (uint64_t done = 0; done < size;)
+	{
+		uint64_t chunkSize = size - done;
+		if (chunkSize > VulkanMemoryManager::StagingChunkSize)
+			chunkSize = VulkanMemoryManager::StagingChunkSize;
 
-	// copy data to staging buffer
-	std::memcpy(stagingBufferInfo.GetMappedAddress(), pData, (size_t)size);
+		VulkanStagingBufferInfo stagingBufferInfo;
+		memManager->GetStagingBuffer(chunkSize, stagingBufferInfo);
 
-	// Flush memory if needed
-	if (stagingBufferInfo.NeedsFlush())
-		memManager->FlushStagingMemory(stagingBufferInfo._statgingMemory);
+		if (stagingBufferInfo.GetMappedAddress() == nullptr)
+			return;
 
-	// copy buffer
-	memManager->CopyBuffer(stagingBufferInfo._stagingBuffer, _vkBuffer, stagingBufferInfo.GetOffset(), offset, size);
+		// copy data to staging buffer
+		std::memcpy(stagingBufferInfo.GetMappedAddress(), pSrc + done, (size_t)chunkSize);
+
+		// Flush memory if needed
+		if (stagingBufferInfo.NeedsFlush())
+			memManager->FlushStagingMemory(stagingBufferInfo._statgingMemory);
+
+		// copy buffer
+		memManager->CopyBuffer(stagingBufferInfo._stagingBuffer, _vkBuffer, stagingBufferInfo.GetOffset(), offset + done, chunkSize, _uploaded);
+
+		done += chunkSize;
+	}
+
+	_uploaded = true;
 }
 
 void VulkanBuffer::Map(uint64_t offset, uint64_t size, void** ppData)
@@ -131,12 +223,23 @@ void VulkanBuffer::Map(uint64_t offset, uint64_t size, void** ppData)
 	if ((size > _vkCreateInfo.size) || (offset + size > _vkCreateInfo.size))
 		return;
 
-	VulkanApi::GetApi()->vkMapMemory(_pDevice->GetDeviceHandle(), _deviceMemory._vkDeviceMemory, _deviceMemory._offset + offset, size, 0, ppData);
+	// the memory block is mapped persistently
+	if (!_deviceMemory._mappedAddress)
+		return;
+
+	_mapOffset = offset;
+	_mapSize = size;
+	_pDevice->GetMemoryManager()->InvalidateMappedMemory(_deviceMemory, offset, size);
+	*ppData = static_cast<uint8_t*>(_deviceMemory._mappedAddress) + offset;
 }
 
 void VulkanBuffer::Unmap()
 {
-	VulkanApi::GetApi()->vkUnmapMemory(_pDevice->GetDeviceHandle(), _deviceMemory._vkDeviceMemory);
+	if (!_deviceMemory._mappedAddress)
+		return;
+
+	_pDevice->GetMemoryManager()->FlushMappedMemory(_deviceMemory, _mapOffset, _mapSize);
+	_mapSize = 0;
 }
 
 size_t VulkanBuffer::GetDataAlignment()
@@ -35,7 +35,7 @@ class VulkanRenderDevice;
 /**
 * @brief Vulkan device buffer
 */
-class VulkanBuffer : public HalBuffer
+class VulkanBuffer : public HalBuffer, public VulkanMemoryOwner
 {
 public:
 	/**
@@ -56,7 +56,10 @@ public:
 	void Bind() override;
 
 	/**
-	* @brief Copy data to buffer
+	* @brief Copy data to buffer.
+	* Buffers created host visible are written directly, the caller must make sure the GPU does not use the range.
+	* Device local buffers in host visible memory are written directly on the first update only,
+	* later updates go through staging copies. Other buffers are updated through staging copies.
 	*
 	* @param[in] offset		Start offset from where to copy data
 	* @param[in] size		The size of the memory range to copy
@@ -66,7 +69,8 @@ public:
 	virtual void Update(uint64_t offset, uint64_t size, const void* pData) override;
 
 	/**
-	* @brief Map buffer to virtual memory address
+	* @brief Map buffer to virtual memory address.
+	* Host visible memory is mapped persistently, this only returns a pointer into the mapping.
 	*
 	* @param[in] offset		Start offset from memory start
 	* @param[in] size		The size of the memory range to map from offset
@@ -76,7 +80,7 @@ public:
 	void Map(uint64_t offset, uint64_t size, void** ppData) override;
 
 	/**
-	* @brief Unmap previously mapped buffer
+	* @brief Unmap previously mapped buffer. Flushes the mapped range if the memory is not host coherent
 	*
 	*/
 	void Unmap() override;
@@ -94,6 +98,36 @@ public:
 	*/
 	VkBuffer GetBuffer() { return _vkBuffer; }
 
+	/**
+	* @brief Remember that a descriptor set holds the buffer handle.
+	* The buffer is not moved by the defragmenter afterwards.
+	*
+	*/
+	void SetDescriptorReference() { _descriptorReference = true; }
+
+	/**
+	* @brief Check if the buffer can be moved
+	*
+	* @return false if a descriptor set holds the buffer
+	*/
+	bool CanRelocate() const override { return !_descriptorReference; }
+
+	/**
+	* @brief Move the buffer to new memory. The buffer gets a new handle
+	*
+	* @param[in] commandBuffer	Command buffer the copy is recorded to
+	* @param[in] sourceBlock	Block the buffer is moved out of
+	*
+	* @return false if no memory was available or a descriptor set holds the buffer
+	*/
+	bool Relocate(VkCommandBuffer commandBuffer, VulkanMemoryBlock* sourceBlock) override;
+
+	/**
+	* @brief Release the old buffer handle and memory
+	*
+	*/
+	void FinishRelocation() override;
+
 private:
 	VulkanRenderDevice* _pDevice;	///< Pointer to device object
 	VkBuffer _vkBuffer;	///< Low level vulkan handle
@@ -101,6 +135,12 @@ private:
 	VkMemoryPropertyFlags _vkMemProperties;	///< Vulkan memory properties
 	VkBufferCreateInfo _vkCreateInfo;	///< Vulkan buffer creation info
 	VulkanDeviceMemory _deviceMemory;	///< Allocate device memory info
+	uint64_t _mapOffset;	///< Offset of the mapped range
+	uint64_t _mapSize;	///< Size of the mapped range (0 if not mapped)
+	bool _uploaded;	///< Content was copied to the buffer, the graphics queue owns it
+	bool _descriptorReference;	///< Handle was written to a descriptor set, it must not change
+	VkBuffer _relocatedBuffer;	///< Old handle until the relocation copy finished
+	VulkanDeviceMemory _relocatedMemory;	///< Old memory until the relocation copy finished
 };
 
 }
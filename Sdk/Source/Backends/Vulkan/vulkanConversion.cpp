@@ -363,12 +363,39 @@ VulkanTypeConversion::GetImageSizeInfo(VkFormat imageFormat)
         imageSizeInfo._compressed = true;
         imageSizeInfo._elementSize = 1;
         break;
+    case VK_FORMAT_BC2_UNORM_BLOCK:
+    case VK_FORMAT_BC2_SRGB_BLOCK:
+    case VK_FORMAT_BC3_SRGB_BLOCK:
     case VK_FORMAT_BC7_UNORM_BLOCK:
+    case VK_FORMAT_BC7_SRGB_BLOCK:
         imageSizeInfo._blockSize = 16;
         imageSizeInfo._blockDimension = 4;
         imageSizeInfo._compressed = true;
         imageSizeInfo._elementSize = 1;
         break;
+    case VK_FORMAT_R8G8B8A8_UNORM:
+    case VK_FORMAT_R8G8B8A8_SNORM:
+    case VK_FORMAT_R8G8B8A8_SRGB:
+    case VK_FORMAT_B8G8R8A8_UNORM:
+    case VK_FORMAT_B8G8R8A8_SRGB:
+    case VK_FORMAT_R32_SFLOAT:
+    case VK_FORMAT_D32_SFLOAT:
+        imageSizeInfo._blockDimension = 1;
+        imageSizeInfo._elementSize = 4;
+        break;
+    case VK_FORMAT_R16G16B16A16_SFLOAT:
+    case VK_FORMAT_R32G32_SFLOAT:
+        imageSizeInfo._blockDimension = 1;
+        imageSizeInfo._elementSize = 8;
+        break;
+    case VK_FORMAT_R32G32B32_SFLOAT:
+        imageSizeInfo._blockDimension = 1;
+        imageSizeInfo._elementSize = 12;
+        break;
+    case VK_FORMAT_R32G32B32A32_SFLOAT:
+        imageSizeInfo._blockDimension = 1;
+        imageSizeInfo._elementSize = 16;
+        break;
     default:
         assert(false);
         break;
@@ -177,8 +177,8 @@ bool VulkanGraphicsPipeline::CompilePipeline()
 	if (_vkPipeline != VK_NULL_HANDLE)
 		return true;
 
-	// create
-	VkResult result = VulkanApi::GetApi()->vkCreateGraphicsPipelines(_pDevice->GetDeviceHandle(), VK_NULL_HANDLE, 1, &_vkGraphicsPipelineInfo, nullptr, &_vkPipeline);
+	// create through the device pipeline cache
+	VkResult result = _pDevice->CreateGraphicsPipeline(_vkGraphicsPipelineInfo, &_vkPipeline);
 	assert(_vkPipeline != VK_NULL_HANDLE);
 
 	return (result == VK_SUCCESS);
@@ -16,6 +16,7 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SO
 ///       Vulkan device image
 
 #include "vulkanImage.h"
+#include "vulkanImageView.h"
 #include "vulkanRenderDevice.h"
 #include "vulkanConversion.h"
 
@@ -23,6 +24,7 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SO
 
 #include<limits>
 #include<cstring>
+#include<algorithm>
 
 namespace cave
 {
@@ -33,6 +35,9 @@ VulkanImage::VulkanImage(VulkanRenderDevice* device, HalImageInfo& imageInfo)
     , _vkImage(VK_NULL_HANDLE)
     , _familyIndicesArray(nullptr)
     , _vkMemProperties(0)
+    , _preinitialized(false)
+    , _uploaded(false)
+    , _relocatedImage(VK_NULL_HANDLE)
 {
 
     _vkCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -53,6 +58,20 @@ VulkanImage::VulkanImage(VulkanRenderDevice* device, HalImageInfo& imageInfo)
     _vkCreateInfo.queueFamilyIndexCount = imageInfo._queueFamilyIndexCount;
     _vkCreateInfo.pQueueFamilyIndices = imageInfo._queueFamilyIndices;
 
+    // small textures in host visible device memory are written in place
+    if (_pDevice->GetMemoryManager()->CanWriteImageDirect(_vkCreateInfo))
+    {
+        _vkCreateInfo.tiling = VK_IMAGE_TILING_LINEAR;
+        _vkCreateInfo.initialLayout = VK_IMAGE_LAYOUT_PREINITIALIZED;
+        _preinitialized = true;
+    }
+    else if ((_vkCreateInfo.usage & VK_IMAGE_USAGE_SAMPLED_BIT) && !(_vkCreateInfo.usage & (VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT
+        | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT | VK_IMAGE_USAGE_STORAGE_BIT)))
+    {
+        // textures only the GPU reads may be copied to new memory by the defragmenter
+        _vkCreateInfo.usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    }
+
     VkResult result = VulkanApi::GetApi()->vkCreateImage(_pDevice->GetDeviceHandle(), &_vkCreateInfo, nullptr, &_vkImage);
     if (result != VK_SUCCESS)
         throw BackendException("Error failed to create vulkan image");
@@ -61,6 +80,9 @@ VulkanImage::VulkanImage(VulkanRenderDevice* device, HalImageInfo& imageInfo)
 
 VulkanImage::~VulkanImage()
 {
+    for (VulkanImageView* view : _views)
+        view->DetachImage();
+
     if (_vkImage != VK_NULL_HANDLE)
         VulkanApi::GetApi()->vkDestroyImage(_pDevice->GetDeviceHandle(), _vkImage, nullptr);
 
@@ -78,56 +100,206 @@ void VulkanImage::Bind()
 
     VulkanMemoryManager* memManager = _pDevice->GetMemoryManager();
 
-    VkMemoryRequirements memRequirements;
-    VulkanApi::GetApi()->vkGetImageMemoryRequirements(_pDevice->GetDeviceHandle(), _vkImage, &memRequirements);
-
     // allcoate memory
-    memManager->AllocateImageMemory(memRequirements, _vkMemProperties, _deviceMemory);
+    memManager->AllocateImageMemory(_vkImage, _vkMemProperties, _vkCreateInfo.tiling, _deviceMemory);
 
     // bind Memory to image object
-    if (VulkanApi::GetApi()->vkBindImageMemory(_pDevice->GetDeviceHandle(), _vkImage, _deviceMemory._vkDeviceMemory, 0) != VK_SUCCESS)
+    if (VulkanApi::GetApi()->vkBindImageMemory(_pDevice->GetDeviceHandle(), _vkImage, _deviceMemory._vkDeviceMemory, _deviceMemory._offset) != VK_SUCCESS)
         throw BackendException("Error failed to bind device memory");
+
+    if (_vkCreateInfo.tiling == VK_IMAGE_TILING_OPTIMAL && (_vkCreateInfo.usage & VK_IMAGE_USAGE_TRANSFER_SRC_BIT))
+        memManager->SetMemoryOwner(_deviceMemory, this);
 }
 
-void VulkanImage::Update(const void* data)
+void VulkanImage::AddView(VulkanImageView* view)
 {
-    if (_deviceMemory._vkDeviceMemory == VK_NULL_HANDLE)
-        return;
+    _views.push_back(view);
+}
 
-    // compute buffers size required for upload
-    VulkanImageSizeInfo imageSizeInfo = VulkanTypeConversion::GetImageSizeInfo(_vkCreateInfo.format);
-    uint64_t size = 0;
+void VulkanImage::RemoveView(VulkanImageView* view)
+{
+    _views.erase(std::remove(_views.begin(), _views.end(), view), _views.end());
+}
+
+bool VulkanImage::Relocate(VkCommandBuffer commandBuffer, VulkanMemoryBlock* sourceBlock)
+{
+    // without an upload the layout is unknown, views of the old handle
+    // may be in descriptor sets and framebuffers
+    if (!CanRelocate())
+        return false;
+
+    VulkanMemoryManager* memManager = _pDevice->GetMemoryManager();
+
+    VkImage newImage = VK_NULL_HANDLE;
+    if (VulkanApi::GetApi()->vkCreateImage(_pDevice->GetDeviceHandle(), &_vkCreateInfo, nullptr, &newImage) != VK_SUCCESS)
+        return false;
+
+    VkMemoryRequirements memRequirements;
+    VulkanApi::GetApi()->vkGetImageMemoryRequirements(_pDevice->GetDeviceHandle(), newImage, &memRequirements);
+
+    VulkanDeviceMemory newMemory;
+    if (!memManager->AllocateRelocation(memRequirements, AllocatorTlsfKind::Optimal, sourceBlock, newMemory))
+    {
+        VulkanApi::GetApi()->vkDestroyImage(_pDevice->GetDeviceHandle(), newImage, nullptr);
+        return false;
+    }
+
+    if (VulkanApi::GetApi()->vkBindImageMemory(_pDevice->GetDeviceHandle(), newImage, newMemory._vkDeviceMemory, newMemory._offset) != VK_SUCCESS)
+    {
+        memManager->ReleaseImageMemory(newMemory);
+        VulkanApi::GetApi()->vkDestroyImage(_pDevice->GetDeviceHandle(), newImage, nullptr);
+        return false;
+    }
+
+    VkImageSubresourceRange range = { VK_IMAGE_ASPECT_COLOR_BIT, 0, _vkCreateInfo.mipLevels, 0, _vkCreateInfo.arrayLayers };
+
+    // the old content is kept, the new image starts undefined
+    VkImageMemoryBarrier barriers[2] = {};
+    barriers[0].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barriers[0].srcAccessMask = 0;
+    barriers[0].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    barriers[0].oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barriers[0].newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    barriers[0].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barriers[0].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barriers[0].image = _vkImage;
+    barriers[0].subresourceRange = range;
+    barriers[1] = barriers[0];
+    barriers[1].dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barriers[1].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barriers[1].newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barriers[1].image = newImage;
+
+    VulkanApi::GetApi()->vkCmdPipelineBarrier(commandBuffer,
+        VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+        0,
+        0, nullptr, // no memory barriers
+        0, nullptr, // no buffer barriers
+        2, barriers);
+
+    caveVector<VkImageCopy> regions(_pDevice->GetEngineAllocator());
     for (uint32_t i = 0; i < _vkCreateInfo.mipLevels; i++)
     {
         uint32_t width = _vkCreateInfo.extent.width >> i;
         uint32_t height = _vkCreateInfo.extent.height >> i;
-        // clamp size
-        width = (width > 0) ? width : 1;
-        height = (height > 0) ? height : 1;
+        uint32_t depth = _vkCreateInfo.extent.depth >> i;
 
-        uint32_t mipSize = width * height * imageSizeInfo._elementSize;
-        if (imageSizeInfo._compressed && mipSize < imageSizeInfo._blockSize)
-            mipSize = imageSizeInfo._blockSize;
+        VkImageCopy region = {};
+        region.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, i, 0, _vkCreateInfo.arrayLayers };
+        region.dstSubresource = region.srcSubresource;
+        region.extent = { (width > 0) ? width : 1, (height > 0) ? height : 1, (depth > 0) ? depth : 1 };
+        regions.Push(region);
+    }
+
+    VulkanApi::GetApi()->vkCmdCopyImage(commandBuffer, _vkImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        newImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(regions.Size()), regions.Data());
+
+    barriers[1].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barriers[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    barriers[1].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barriers[1].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    VulkanApi::GetApi()->vkCmdPipelineBarrier(commandBuffer,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+        0,
+        0, nullptr, // no memory barriers
+        0, nullptr, // no buffer barriers
+        1, &barriers[1]);
+
+    // the old image is the copy source until the copy finished
+    _relocatedImage = _vkImage;
+    _relocatedMemory = _deviceMemory;
+    _vkImage = newImage;
+    _deviceMemory = newMemory;
+    memManager->SetMemoryOwner(_deviceMemory, this);
+
+    return true;
+}
 
-        size += mipSize;
+void VulkanImage::FinishRelocation()
+{
+    if (_relocatedImage != VK_NULL_HANDLE)
+    {
+        VulkanApi::GetApi()->vkDestroyImage(_pDevice->GetDeviceHandle(), _relocatedImage, nullptr);
+        _relocatedImage = VK_NULL_HANDLE;
     }
 
+    _pDevice->GetMemoryManager()->ReleaseImageMemory(_relocatedMemory);
+}
+
+void VulkanImage::Update(const void* data)
+{
+    UpdateStaging([data](void* pDst, uint64_t offset, uint64_t size)
+    {
+        std::memcpy(pDst, static_cast<const uint8_t*>(data) + offset, (size_t)size);
+        return true;
+    });
+}
+
+bool VulkanImage::UpdateStaging(const HalImageWriteFunction& writeFunc)
+{
+    if (_deviceMemory._vkDeviceMemory == VK_NULL_HANDLE)
+        return false;
+
+    // Only the first upload writes in place. Later ones use copies, the host must not
+    // write an image in shader read layout. Staging copies also cover linear images
+    // which did not get host visible memory.
+    if (_preinitialized)
+    {
+        _preinitialized = false;
+        if (_deviceMemory._mappedAddress)
+        {
+            _uploaded = UpdateDirect(writeFunc);
+            return _uploaded;
+        }
+    }
+
+    VulkanImageSizeInfo imageSizeInfo = VulkanTypeConversion::GetImageSizeInfo(_vkCreateInfo.format);
+    uint32_t rowHeight = (imageSizeInfo._compressed) ? imageSizeInfo._blockDimension : 1;
+
     VulkanMemoryManager* memManager = _pDevice->GetMemoryManager();
 
-    VulkanStagingBufferInfo stagingBufferInfo;
-    memManager->GetStagingBuffer(size, stagingBufferInfo);
+    // The mip chain is uploaded in staging sized chunks. Small levels are packed
+    // into one chunk, levels larger than a chunk are split into rows of texel blocks.
+    // Every chunk is one contiguous byte range of the mip chain.
+    caveVector<VkBufferImageCopy> imageCopyArray(_pDevice->GetEngineAllocator());
+    uint64_t chainOffset = 0;	// start of the next region in the mip chain
+    uint64_t chunkOffset = 0;	// start of the current chunk in the mip chain
+    bool firstCopy = true;
 
-    if (stagingBufferInfo.GetMappedAddress() == nullptr)
-        return;
+    auto uploadChunk = [&](bool lastCopy) -> bool
+    {
+        if (imageCopyArray.Empty())
+            return true;
 
-    // copy data to staging buffer
-    std::memcpy(stagingBufferInfo.GetMappedAddress(), data, (size_t)size);
+        uint64_t chunkSize = chainOffset - chunkOffset;
 
-    // upload level by level to hardware
-    caveVector<VkBufferImageCopy> imageCopyArray(_pDevice->GetEngineAllocator(), _vkCreateInfo.mipLevels);
-    uint32_t bufferOffset = 0;
+        VulkanStagingBufferInfo stagingBufferInfo;
+        memManager->GetStagingBuffer(chunkSize, stagingBufferInfo);
+
+        if (stagingBufferInfo.GetMappedAddress() == nullptr)
+            return false;
+
+        // let the caller fill the staging buffer
+        if (!writeFunc(stagingBufferInfo.GetMappedAddress(), chunkOffset, chunkSize))
+            return false;
+
+        // Flush memory if needed
+        if (stagingBufferInfo.NeedsFlush())
+            memManager->FlushStagingMemory(stagingBufferInfo._statgingMemory);
+
+        for (size_t i = 0; i < imageCopyArray.Size(); i++)
+            imageCopyArray[i].bufferOffset += stagingBufferInfo.GetOffset();
+
+        // copy buffer
+        memManager->CopyBufferToImage(stagingBufferInfo._stagingBuffer, _vkImage, imageCopyArray, _vkCreateInfo.mipLevels, chunkSize, firstCopy, lastCopy, _uploaded);
+
+        imageCopyArray.Clear();
+        chunkOffset = chainOffset;
+        firstCopy = false;
+
+        return true;
+    };
 
-    // setup copy regions
     for (uint32_t i = 0; i < _vkCreateInfo.mipLevels; i++)
     {
         uint32_t width = _vkCreateInfo.extent.width >> i;
@@ -136,27 +308,93 @@ void VulkanImage::Update(const void* data)
         width = (width > 0) ? width : 1;
         height = (height > 0) ? height : 1;
 
-        uint32_t mipSize = width * height * imageSizeInfo._elementSize;
+        uint64_t mipSize = width * height * imageSizeInfo._elementSize;
         if (imageSizeInfo._compressed && mipSize < imageSizeInfo._blockSize)
             mipSize = imageSizeInfo._blockSize;
 
-        imageCopyArray[i].bufferOffset = bufferOffset + stagingBufferInfo.GetOffset();
-        imageCopyArray[i].bufferRowLength = 0;
-        imageCopyArray[i].bufferImageHeight = 0;
+        // rows of texel blocks per region
+        uint64_t rowSize = static_cast<uint64_t>(width) * rowHeight * imageSizeInfo._elementSize;
+        uint32_t rowsPerRegion = static_cast<uint32_t>(VulkanMemoryManager::StagingChunkSize / rowSize);
+        rowsPerRegion = (rowsPerRegion > 0) ? rowsPerRegion : 1;
+
+        uint64_t levelOffset = 0;
+        for (uint32_t y = 0; y < height;)
+        {
+            uint32_t regionHeight = height - y;
+            uint64_t regionSize = mipSize - levelOffset;
+            if (regionSize > VulkanMemoryManager::StagingChunkSize && regionHeight > rowsPerRegion * rowHeight)
+            {
+                regionHeight = rowsPerRegion * rowHeight;
+                regionSize = rowsPerRegion * rowSize;
+            }
+
+            // start a new chunk if the region doesn't fit anymore
+            if (chainOffset > chunkOffset && chainOffset - chunkOffset + regionSize > VulkanMemoryManager::StagingChunkSize)
+            {
+                if (!uploadChunk(false))
+                    return false;
+            }
+
+            VkBufferImageCopy region = {};
+            region.bufferOffset = chainOffset - chunkOffset;
+            region.bufferRowLength = 0;
+            region.bufferImageHeight = 0;
+
+            region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            region.imageSubresource.baseArrayLayer = 0;
+            region.imageSubresource.layerCount = 1;
+            region.imageSubresource.mipLevel = i;
+
+            region.imageOffset = { 0, static_cast<int32_t>(y), 0 };
+            region.imageExtent = { width, regionHeight, 1 };
+            imageCopyArray.Push(region);
+
+            chainOffset += regionSize;
+            levelOffset += regionSize;
+            y += regionHeight;
+        }
+    }
 
-        imageCopyArray[i].imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        imageCopyArray[i].imageSubresource.baseArrayLayer = 0;
-        imageCopyArray[i].imageSubresource.layerCount = 1;
-        imageCopyArray[i].imageSubresource.mipLevel = i;
+    if (!uploadChunk(true))
+        return false;
 
-        imageCopyArray[i].imageOffset = { 0, 0, 0 };
-        imageCopyArray[i].imageExtent = { width, height, 1 };
+    _uploaded = true;
+    return true;
+}
 
-        bufferOffset += mipSize;
+bool VulkanImage::UpdateDirect(const HalImageWriteFunction& writeFunc)
+{
+    VulkanMemoryManager* memManager = _pDevice->GetMemoryManager();
+    VulkanImageSizeInfo imageSizeInfo = VulkanTypeConversion::GetImageSizeInfo(_vkCreateInfo.format);
+
+    VkImageSubresource subresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0 };
+    VkSubresourceLayout layout;
+    VulkanApi::GetApi()->vkGetImageSubresourceLayout(_pDevice->GetDeviceHandle(), _vkImage, &subresource, &layout);
+
+    uint64_t rowSize = static_cast<uint64_t>(_vkCreateInfo.extent.width) * imageSizeInfo._elementSize;
+    uint64_t size = rowSize * _vkCreateInfo.extent.height;
+    uint8_t* pDst = static_cast<uint8_t*>(_deviceMemory._mappedAddress) + layout.offset;
+
+    // rows are padded to the driver row pitch
+    if (layout.rowPitch == rowSize)
+    {
+        if (!writeFunc(pDst, 0, size))
+            return false;
+    }
+    else
+    {
+        for (uint32_t y = 0; y < _vkCreateInfo.extent.height; y++)
+        {
+            if (!writeFunc(pDst + y * layout.rowPitch, y * rowSize, rowSize))
+                return false;
+        }
     }
 
-    // copy buffer
-    memManager->CopyBufferToImage(stagingBufferInfo._stagingBuffer, _vkImage, imageCopyArray);
+    memManager->FlushMappedMemory(_deviceMemory, layout.offset, layout.size);
+    memManager->TransitionHostWrittenImage(_vkImage, VK_IMAGE_ASPECT_COLOR_BIT);
+    memManager->AddDirectWrite(size);
+
+    return true;
 }
 
 }
@@ -21,6 +21,8 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SO
 
 #include "vulkan.h"
 
+#include <vector>
+
 /** \addtogroup backend
 *  @{
 *
@@ -31,11 +33,12 @@ namespace cave
 
 ///< forwards
 class VulkanRenderDevice;
+class VulkanImageView;
 
 /**
 * @brief Vulkan device image
 */
-class VulkanImage : public HalImage
+class VulkanImage : public HalImage, public VulkanMemoryOwner
 {
 public:
 	/**
@@ -63,6 +66,15 @@ public:
 	*/
 	virtual void Update(const void* pData) override;
 
+	/**
+	* @brief Let the caller write the data straight into staging memory
+	*
+	* @param[in] writeFunc	Called for every staging chunk of the mip chain
+	*
+	* @return false if no staging memory was available or writeFunc failed
+	*/
+	virtual bool UpdateStaging(const HalImageWriteFunction& writeFunc) override;
+
 	/**
 	* @brief Get pipeline layout object
 	*
@@ -70,13 +82,64 @@ public:
 	*/
 	VkImage GetImage() { return _vkImage; }
 
+	/**
+	* @brief Register a view which is recreated when the image moves
+	*
+	* @param[in] view	Image view
+	*/
+	void AddView(VulkanImageView* view);
+
+	/**
+	* @brief Unregister a view
+	*
+	* @param[in] view	Image view
+	*/
+	void RemoveView(VulkanImageView* view);
+
+	/**
+	* @brief Check if the image can be moved
+	*
+	* @return false if the image has no content yet or has views
+	*/
+	bool CanRelocate() const override { return _uploaded && _views.empty(); }
+
+	/**
+	* @brief Move the image to new memory. The image gets a new handle
+	*
+	* @param[in] commandBuffer	Command buffer the copy is recorded to
+	* @param[in] sourceBlock	Block the image is moved out of
+	*
+	* @return false if the image has no content yet, has views or no memory was available
+	*/
+	bool Relocate(VkCommandBuffer commandBuffer, VulkanMemoryBlock* sourceBlock) override;
+
+	/**
+	* @brief Release the old image handle and memory
+	*
+	*/
+	void FinishRelocation() override;
+
 private:
+	/**
+	* @brief Let the caller write the data straight into the host visible image memory
+	*
+	* @param[in] writeFunc	Called for the whole image or for every row if rows are padded
+	*
+	* @return false if writeFunc failed
+	*/
+	bool UpdateDirect(const HalImageWriteFunction& writeFunc);
+
 	VulkanRenderDevice * _pDevice;	///< Pointer to device object
 	VkImage _vkImage;	///< Low level vulkan handle
 	uint32_t* _familyIndicesArray;		///< Familiy indices array. Only required for images in non-exclusive mode
 	VkMemoryPropertyFlags _vkMemProperties;	///< Vulkan memory properties
 	VkImageCreateInfo _vkCreateInfo;	///< Vulkan image creation info
 	VulkanDeviceMemory _deviceMemory;	///< Allocate device memory info
+	bool _preinitialized;	///< Linear image waiting for its first host write
+	bool _uploaded;	///< Image content was uploaded and is in shader read layout
+	VkImage _relocatedImage;	///< Old handle until the relocation copy finished
+	VulkanDeviceMemory _relocatedMemory;	///< Old memory until the relocation copy finished
+	std::vector<VulkanImageView*> _views;	///< Views of this image
 };
 
 }
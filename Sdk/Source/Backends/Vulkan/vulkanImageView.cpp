@@ -31,9 +31,10 @@ namespace cave
 VulkanImageView::VulkanImageView(VulkanRenderDevice* device, HalImage* image, HalImageViewInfo& viewInfo)
     : HalImageView(device, image, viewInfo)
     , _pDevice(device)
+    , _pImage(static_cast<VulkanImage*>(image))
     , _vkImageView(VK_NULL_HANDLE)
 {
-    VulkanImage* vkImage = static_cast<VulkanImage*>(image);
+    VulkanImage* vkImage = _pImage;
 
     _vkImageViewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
     _vkImageViewCreateInfo.pNext = nullptr;
@@ -52,10 +53,14 @@ VulkanImageView::VulkanImageView(VulkanRenderDevice* device, HalImage* image, Ha
     if (result != VK_SUCCESS)
         throw BackendException("Error failed to create vulkan image view");
 
+    vkImage->AddView(this);
 }
 
 VulkanImageView::~VulkanImageView()
 {
+    if (_pImage)
+        _pImage->RemoveView(this);
+
     if (_vkImageView)
         VulkanApi::GetApi()->vkDestroyImageView(_pDevice->GetDeviceHandle(), _vkImageView, nullptr);
 }
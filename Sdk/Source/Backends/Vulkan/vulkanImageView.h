@@ -31,6 +31,7 @@ namespace cave
 
 ///< forwards
 class VulkanRenderDevice;
+class VulkanImage;
 
 /**
 * @brief Vulkan device image
@@ -57,8 +58,15 @@ public:
     */
     VkImageView GetImageView() { return _vkImageView; }
 
+    /**
+    * @brief Forget the image, it is destroyed before the view
+    *
+    */
+    void DetachImage() { _pImage = nullptr; }
+
 private:
     VulkanRenderDevice* _pDevice;	///< Pointer to device object
+    VulkanImage* _pImage;	///< Image the view is registered with (nullptr if destroyed)
     VkImageView _vkImageView; ///< Low level vulkan handle
     VkImageViewCreateInfo _vkImageViewCreateInfo;	///< Vulkan image view creation info
 };
@@ -19,6 +19,7 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SO
 #include "vulkanInstance.h"
 #include "vulkanRenderDevice.h"
 #include "vulkanPhysicalDevice.h"
+#include "vulkanConversion.h"
 
 #include "vulkanApi.h"
 
@@ -35,313 +36,1092 @@ VulkanMemoryManager::VulkanMemoryManager(VulkanInstance* instance, VulkanPhysica
 	, _pPhysicalDevice(physicalDevice)
 	, _pRenderDevice(renderDevice)
 	, _nonCoherentAlignment(0)
+	, _bufferImageGranularity(1)
+	, _stagingAlignment(16)
+	, _graphicsFamilyIndex(renderDevice->GetGraphicsFamilyIndex())
+	, _transferFamilyIndex(renderDevice->GetTransferFamilyIndex())
 	, _vkCommandPool(VK_NULL_HANDLE)
-	, _vkTransferCommandBuffer(VK_NULL_HANDLE)
-	, _vkImageTransferCommandBuffer(VK_NULL_HANDLE)
-	, _bufferMemoryPages(renderDevice->GetEngineAllocator())
-	, _vkCopyFence(VK_NULL_HANDLE)
-    , _vkCopyImageFence(VK_NULL_HANDLE)
-	, _stagingMemoryPages(renderDevice->GetEngineAllocator())
-	, _copyCount(0)
-	, _copyWaitCount(0)
-    , _copyImageCount(0)
-    , _copyImageWaitCount(0)
+	, _vkAcquireCommandPool(VK_NULL_HANDLE)
+	, _fallbackCount(0)
+	, _relocationCount(0)
+	, _relocatedSize(0)
+	, _pStagingRing(nullptr)
+	, _pCopySubmission(nullptr)
+	, _recordedStagingSize(0)
+	, _uploadPolicy(HalUploadPolicy::Auto)
+	, _directMemoryTypeIndex(~0u)
+	, _directHeapSize(0)
+	, _directHeapFull(false)
 {
 	// store some physical device properties
 	VkPhysicalDeviceProperties deviceProperties = physicalDevice->GetPhysicalDeviceProperties();
 	_nonCoherentAlignment = deviceProperties.limits.nonCoherentAtomSize;
+	_bufferImageGranularity = deviceProperties.limits.bufferImageGranularity;
+	// image copies need texel block aligned offsets, flushes need atom aligned ones
+	if (_nonCoherentAlignment > _stagingAlignment)
+		_stagingAlignment = _nonCoherentAlignment;
+
+	for (uint32_t i = 0; i < VK_MAX_MEMORY_HEAPS; i++)
+	{
+		_dedicatedCount[i] = 0;
+		_dedicatedSize[i] = 0;
+		_blockSize[i] = 0;
+		_heapBudget[i] = 0;
+		_heapUsage[i] = 0;
+		_budgetAllocated[i] = 0;
+	}
+
+	// Without driver budgets leave room for other processes and driver internal allocations
+	const VkPhysicalDeviceMemoryProperties& deviceMemProperties = physicalDevice->GetPhysicalDeviceMemoryProperties();
+	for (uint32_t i = 0; i < deviceMemProperties.memoryHeapCount; i++)
+		_heapBudget[i] = deviceMemProperties.memoryHeaps[i].size / 10 * 8;
+	UpdateBudget();
+
+	// Device local memory the host can write to. If its heap is the largest device local heap
+	// it is UMA or resizable BAR memory, otherwise only the small BAR window
+	VkMemoryRequirements anyType = {};
+	anyType.memoryTypeBits = ~0u;
+	_directMemoryTypeIndex = ChooseMemoryType(anyType, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	if (_directMemoryTypeIndex == ~0u)
+		_directMemoryTypeIndex = ChooseMemoryType(anyType, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+
+	if (_directMemoryTypeIndex != ~0u)
+	{
+		uint64_t largestDeviceLocalHeap = 0;
+		for (uint32_t i = 0; i < deviceMemProperties.memoryHeapCount; i++)
+		{
+			if ((deviceMemProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) && deviceMemProperties.memoryHeaps[i].size > largestDeviceLocalHeap)
+				largestDeviceLocalHeap = deviceMemProperties.memoryHeaps[i].size;
+		}
+
+		_directHeapSize = deviceMemProperties.memoryHeaps[deviceMemProperties.memoryTypes[_directMemoryTypeIndex].heapIndex].size;
+		_directHeapFull = (_directHeapSize >= largestDeviceLocalHeap);
+	}
 
 	// for some operations we need a command pool
 	VkCommandPoolCreateInfo vkPoolCreateInfo;
 	vkPoolCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
 	vkPoolCreateInfo.pNext = nullptr;
 	vkPoolCreateInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
-	vkPoolCreateInfo.queueFamilyIndex = _pRenderDevice->GetGraphicsFamilyIndex();
+	vkPoolCreateInfo.queueFamilyIndex = _transferFamilyIndex;
 
 	if (VulkanApi::GetApi()->vkCreateCommandPool(_pRenderDevice->GetDeviceHandle(), &vkPoolCreateInfo, nullptr, &_vkCommandPool) != VK_SUCCESS)
 		throw BackendException("Error failed to create GPU device memory manager");
 
-	// allocate command buffer used for buffer transfers
-	VkCommandBufferAllocateInfo allocInfo = {};
-	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-	allocInfo.commandPool = _vkCommandPool;
-	allocInfo.commandBufferCount = 1;
-
-	if (VulkanApi::GetApi()->vkAllocateCommandBuffers(_pRenderDevice->GetDeviceHandle(), &allocInfo, &_vkTransferCommandBuffer) != VK_SUCCESS)
-		throw BackendException("Error failed to GPU device memory manager");
+	// the graphics queue takes over ownership of uploaded resources
+	if (_transferFamilyIndex != _graphicsFamilyIndex)
+	{
+		vkPoolCreateInfo.queueFamilyIndex = _graphicsFamilyIndex;
+		if (VulkanApi::GetApi()->vkCreateCommandPool(_pRenderDevice->GetDeviceHandle(), &vkPoolCreateInfo, nullptr, &_vkAcquireCommandPool) != VK_SUCCESS)
+			throw BackendException("Error failed to create GPU device memory manager");
+	}
 
-	// same for image transfer
-	if (VulkanApi::GetApi()->vkAllocateCommandBuffers(_pRenderDevice->GetDeviceHandle(), &allocInfo, &_vkImageTransferCommandBuffer) != VK_SUCCESS)
+	// Allocate the staging ring at start
+	if (!CreateStagingRing(StagingBufferSize))
 		throw BackendException("Error failed to create GPU device memory manager");
-
-	// create buffer transfer sync fence
-	VkFenceCreateInfo fenceInfo;
-	fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-	fenceInfo.pNext = nullptr;
-	fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-	if (VulkanApi::GetApi()->vkCreateFence(_pRenderDevice->GetDeviceHandle(), &fenceInfo, nullptr, &_vkCopyFence) != VK_SUCCESS)
-		throw BackendException("Error failed to create GPU device memory manager");
-
-	VulkanApi::GetApi()->vkResetFences(_pRenderDevice->GetDeviceHandle(), 1, &_vkCopyFence);
-
-    // create image transfer sync fence
-    fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-    if (VulkanApi::GetApi()->vkCreateFence(_pRenderDevice->GetDeviceHandle(), &fenceInfo, nullptr, &_vkCopyImageFence) != VK_SUCCESS)
-        throw BackendException("Error failed to create GPU device memory manager");
-
-    VulkanApi::GetApi()->vkResetFences(_pRenderDevice->GetDeviceHandle(), 1, &_vkCopyImageFence);
-
-	// Allocate a page at start
-	AllocateStagingPage(StagingBufferSize);
+	UpdateStagingStats();
 }
 
 VulkanMemoryManager::~VulkanMemoryManager()
 {
 	// Wait until the device is idle before deleting
-	VulkanApi::GetApi()->vkQueueWaitIdle(_pRenderDevice->GetGraphicsQueue());
+	VulkanApi::GetApi()->vkDeviceWaitIdle(_pRenderDevice->GetDeviceHandle());
 
-	if (_vkTransferCommandBuffer != VK_NULL_HANDLE)
-		VulkanApi::GetApi()->vkFreeCommandBuffers(_pRenderDevice->GetDeviceHandle(), _vkCommandPool, 1, &_vkTransferCommandBuffer);
+	// Release copy submissions. Command buffers go away with the pool
+	if (_pCopySubmission)
+		_freeCopySubmissions.push_back(_pCopySubmission);
+	_freeCopySubmissions.insert(_freeCopySubmissions.end(), _pendingCopySubmissions.begin(), _pendingCopySubmissions.end());
+	for (VulkanCopySubmission* submission : _freeCopySubmissions)
+	{
+		if (submission->_vkFence != VK_NULL_HANDLE)
+			VulkanApi::GetApi()->vkDestroyFence(_pRenderDevice->GetDeviceHandle(), submission->_vkFence, nullptr);
+		if (submission->_vkSemaphore != VK_NULL_HANDLE)
+			VulkanApi::GetApi()->vkDestroySemaphore(_pRenderDevice->GetDeviceHandle(), submission->_vkSemaphore, nullptr);
 
-	if (_vkImageTransferCommandBuffer != VK_NULL_HANDLE)
-		VulkanApi::GetApi()->vkFreeCommandBuffers(_pRenderDevice->GetDeviceHandle(), _vkCommandPool, 1, &_vkImageTransferCommandBuffer);
+		DeallocateDelete(*_pRenderDevice->GetEngineAllocator(), *submission);
+	}
 
 	if (_vkCommandPool != VK_NULL_HANDLE)
 		VulkanApi::GetApi()->vkDestroyCommandPool(_pRenderDevice->GetDeviceHandle(), _vkCommandPool, nullptr);
 
-    if (_vkCopyFence != VK_NULL_HANDLE)
-        VulkanApi::GetApi()->vkDestroyFence(_pRenderDevice->GetDeviceHandle(), _vkCopyFence, nullptr);
+	if (_vkAcquireCommandPool != VK_NULL_HANDLE)
+		VulkanApi::GetApi()->vkDestroyCommandPool(_pRenderDevice->GetDeviceHandle(), _vkAcquireCommandPool, nullptr);
 
-    if (_vkCopyImageFence != VK_NULL_HANDLE)
-        VulkanApi::GetApi()->vkDestroyFence(_pRenderDevice->GetDeviceHandle(), _vkCopyImageFence, nullptr);
+    // Release staging rings
+    for (VulkanStagingRing* ring : _retiredStagingRings)
+        ReleaseStagingRing(ring);
+    if (_pStagingRing)
+        ReleaseStagingRing(_pStagingRing);
 
-    // Release staging memory pages
-    CaveList<VulkanDeviceMemoryPageEntry>::Iterator pageIter = _stagingMemoryPages.begin();
-    for (; pageIter != _stagingMemoryPages.end(); pageIter++)
-    {
-        ReleaseStagingMemory(pageIter->_deviceMemory);
-        if (pageIter->_vkBuffer != VK_NULL_HANDLE)
-            VulkanApi::GetApi()->vkDestroyBuffer(_pRenderDevice->GetDeviceHandle(), pageIter->_vkBuffer, nullptr);
-    }
-
-    // Release buffer memory pages
-	CaveList<VulkanDeviceMemoryPageEntry>::Iterator pageBufferIter = _bufferMemoryPages.begin();
-	for (; pageBufferIter != _bufferMemoryPages.end(); pageBufferIter++)
+    // Release memory blocks
+	for (uint32_t i = 0; i < VK_MAX_MEMORY_TYPES; i++)
 	{
-		if (pageBufferIter->_deviceMemory._vkDeviceMemory != VK_NULL_HANDLE)
-			VulkanApi::GetApi()->vkFreeMemory(_pRenderDevice->GetDeviceHandle(), pageBufferIter->_deviceMemory._vkDeviceMemory, nullptr);
+		while (!_memoryBlocks[i].empty())
+			ReleaseBlock(_memoryBlocks[i].back());
 	}
 }
 
 void VulkanMemoryManager::AllocateBufferMemory(VkMemoryRequirements& memRequirements, VkMemoryPropertyFlags properties, VulkanDeviceMemory& deviceMemory)
 {
+	// device local buffers the host can write to skip the staging copies
+	if ((properties & (VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)) == VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+		&& UseDirectMemory() && (memRequirements.memoryTypeBits & (1u << _directMemoryTypeIndex)))
+	{
+		if (SubAllocate(_directMemoryTypeIndex, memRequirements, AllocatorTlsfKind::Linear, deviceMemory, true))
+			return;
+		// heap is full (e.g. small BAR window), use regular device memory
+	}
+
 	uint32_t memoryTypeIndex = ChooseMemoryType(memRequirements, properties);
 	if (memoryTypeIndex != ~0u)
 	{
-		// Search for a place in a memory page
-		CaveList<VulkanDeviceMemoryPageEntry>::Iterator pageBufferIter = _bufferMemoryPages.begin();
-		for (; pageBufferIter != _bufferMemoryPages.end(); pageBufferIter++)
+		if (SubAllocate(memoryTypeIndex, memRequirements, AllocatorTlsfKind::Linear, deviceMemory, true))
+			return;
+
+		// device heap over budget. Host memory is slower but does not make the driver page out device memory
+		uint32_t fallbackTypeIndex = ChooseFallbackMemoryType(memRequirements, properties);
+		if (fallbackTypeIndex != ~0u && SubAllocate(fallbackTypeIndex, memRequirements, AllocatorTlsfKind::Linear, deviceMemory, false))
 		{
-			size_t currentOffset = align_to(memRequirements.alignment, pageBufferIter->_deviceMemory._offset);
-			if ((currentOffset + memRequirements.size) < pageBufferIter->_deviceMemory._size && 
-				memoryTypeIndex == pageBufferIter->_deviceMemory._memoryTypeIndex)
-			{
-				// Found a match. Fill in values
-				deviceMemory._offset = currentOffset;
-				deviceMemory._size = memRequirements.size;
-				deviceMemory._vkDeviceMemory = pageBufferIter->_deviceMemory._vkDeviceMemory;
+			std::lock_guard<std::mutex> lock(_blockMutex);
+			_fallbackCount++;
+			return;
+		}
 
-				// update page entries
-				pageBufferIter->_allocationCount++;
-				pageBufferIter->_deviceMemory._offset = currentOffset + memRequirements.size;
+		// nowhere else to go, exceed the budget
+		if (!SubAllocate(memoryTypeIndex, memRequirements, AllocatorTlsfKind::Linear, deviceMemory, false))
+			throw BackendException("Error failed to allocate device memory");
+	}
+}
 
-				return;
-			}
-		}
+void VulkanMemoryManager::ReleaseBufferMemory(VulkanDeviceMemory& deviceMemory)
+{
+	if (deviceMemory._vkDeviceMemory)
+		SubRelease(deviceMemory);
+}
+
+uint64_t VulkanMemoryManager::GetBlockSize(uint32_t memoryTypeIndex)
+{
+	const VkPhysicalDeviceMemoryProperties& deviceMemProperties = _pPhysicalDevice->GetPhysicalDeviceMemoryProperties();
+	uint64_t heapSize = deviceMemProperties.memoryHeaps[deviceMemProperties.memoryTypes[memoryTypeIndex].heapIndex].size;
 
-		// Allocate new memory page
-		// new page
-		_bufferMemoryPages.PushBack(VulkanDeviceMemoryPageEntry());
-		CaveList<VulkanDeviceMemoryPageEntry>::Iterator last = _bufferMemoryPages.tail();
+	// small heaps (e.g. the host visible part of device memory) must not be taken by a few blocks
+	uint64_t blockSize = MemoryBlockSize;
+	if (heapSize / 8 < blockSize)
+		blockSize = (heapSize / 8 > StagingBufferSize) ? heapSize / 8 : StagingBufferSize;
+
+	return blockSize;
+}
+
+bool VulkanMemoryManager::SubAllocate(uint32_t memoryTypeIndex, VkMemoryRequirements& memRequirements, AllocatorTlsfKind kind, VulkanDeviceMemory& deviceMemory, bool checkBudget)
+{
+	std::lock_guard<std::mutex> lock(_blockMutex);
+
+	// Non coherent allocations are padded to whole atoms, so flushing and invalidating
+	// the aligned range of one allocation never touches the data of another one
+	const VkPhysicalDeviceMemoryProperties& deviceMemProperties = _pPhysicalDevice->GetPhysicalDeviceMemoryProperties();
+	VkMemoryPropertyFlags typeFlags = deviceMemProperties.memoryTypes[memoryTypeIndex].propertyFlags;
+	bool hostVisible = (typeFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0;
+	bool needsFlush = hostVisible && !(typeFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	VkMemoryRequirements requirements = memRequirements;
+	if (needsFlush)
+	{
+		requirements.size = align_to(_nonCoherentAlignment, requirements.size);
+		if (requirements.alignment < _nonCoherentAlignment)
+			requirements.alignment = _nonCoherentAlignment;
+	}
+
+	// newest blocks have the most space left
+	std::vector<VulkanMemoryBlock*>& blocks = _memoryBlocks[memoryTypeIndex];
+	VulkanMemoryBlock* block = nullptr;
+	uint32_t handle = AllocatorTlsf::InvalidHandle;
+	uint64_t offset = 0;
+	for (size_t i = blocks.size(); i > 0 && handle == AllocatorTlsf::InvalidHandle; i--)
+	{
+		block = blocks[i - 1];
+		handle = block->_allocator.Allocate(requirements.size, requirements.alignment, kind, offset);
+	}
+
+	if (handle == AllocatorTlsf::InvalidHandle)
+	{
+		// new block. Allocations larger than half a block get their own one
+		uint64_t blockSize = GetBlockSize(memoryTypeIndex);
+		if (requirements.size > blockSize / 2)
+			blockSize = requirements.size;
+
+		uint32_t heapIndex = deviceMemProperties.memoryTypes[memoryTypeIndex].heapIndex;
+		if (checkBudget && !IsWithinBudget(heapIndex, blockSize))
+			return false;
+
+		block = AllocateObject<VulkanMemoryBlock>(*_pRenderDevice->GetEngineAllocator(), blockSize, _bufferImageGranularity);
+		if (!block)
+			return false;
 
-		uint64_t allocSize = (memRequirements.size < StagingBufferSize) ? StagingBufferSize : memRequirements.size;
 		VkMemoryAllocateInfo allocInfo = {};
 		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-		allocInfo.allocationSize = allocSize;
+		allocInfo.allocationSize = blockSize;
 		allocInfo.memoryTypeIndex = memoryTypeIndex;
-		if (VulkanApi::GetApi()->vkAllocateMemory(_pRenderDevice->GetDeviceHandle(), &allocInfo, nullptr, &last->_deviceMemory._vkDeviceMemory) != VK_SUCCESS)
+		if (VulkanApi::GetApi()->vkAllocateMemory(_pRenderDevice->GetDeviceHandle(), &allocInfo, nullptr, &block->_vkDeviceMemory) != VK_SUCCESS)
 		{
-			throw BackendException("Error failed to allocate device memory");
+			DeallocateDelete(*_pRenderDevice->GetEngineAllocator(), *block);
+			return false;
 		}
-		last->_allocationCount++;
-		last->_deviceMemory._memoryTypeIndex = memoryTypeIndex;
-		last->_deviceMemory._size = allocSize;
-		last->_deviceMemory._offset = memRequirements.size;
 
-		deviceMemory._offset = 0;
-		deviceMemory._size = memRequirements.size;
-		deviceMemory._vkDeviceMemory = last->_deviceMemory._vkDeviceMemory;
+		// map once, allocations get pointers into the mapping
+		if (hostVisible && VulkanApi::GetApi()->vkMapMemory(_pRenderDevice->GetDeviceHandle(), block->_vkDeviceMemory, 0, VK_WHOLE_SIZE, 0, &block->_mappedAddress) != VK_SUCCESS)
+		{
+			VulkanApi::GetApi()->vkFreeMemory(_pRenderDevice->GetDeviceHandle(), block->_vkDeviceMemory, nullptr);
+			DeallocateDelete(*_pRenderDevice->GetEngineAllocator(), *block);
+			return false;
+		}
+
+		block->_memoryTypeIndex = memoryTypeIndex;
+		block->_index = static_cast<uint32_t>(blocks.size());
+		block->_needsFlush = needsFlush;
+		blocks.push_back(block);
+		_blockSize[heapIndex] += blockSize;
+
+		handle = block->_allocator.Allocate(requirements.size, requirements.alignment, kind, offset);
+		if (handle == AllocatorTlsf::InvalidHandle)
+			return false;
 	}
+
+	SetSubAllocation(block, handle, offset, requirements.size, deviceMemory);
+
+	return true;
 }
 
-void VulkanMemoryManager::ReleaseBufferMemory(VulkanDeviceMemory& deviceMemory)
+void VulkanMemoryManager::SetSubAllocation(VulkanMemoryBlock* block, uint32_t handle, uint64_t offset, uint64_t size, VulkanDeviceMemory& deviceMemory)
 {
-    if (deviceMemory._vkDeviceMemory)
-    {
-        // Search for a place in a memory page
-        CaveList<VulkanDeviceMemoryPageEntry>::Iterator pageBufferIter = _bufferMemoryPages.begin();
-        for (; pageBufferIter != _bufferMemoryPages.end(); pageBufferIter++)
-        {
-            if (pageBufferIter->_deviceMemory._vkDeviceMemory == deviceMemory._vkDeviceMemory)
-            {
-                // found page
-                pageBufferIter->_allocationCount--;
-                break;
-            }
-        }
-
-        if (pageBufferIter != _bufferMemoryPages.end())
-        {
-            // Last allocation release page
-            if (pageBufferIter->_allocationCount == 0)
-            {
-                VulkanApi::GetApi()->vkFreeMemory(_pRenderDevice->GetDeviceHandle(), pageBufferIter->_deviceMemory._vkDeviceMemory, nullptr);
-                _bufferMemoryPages.Erase(pageBufferIter);
-            }
-            else
-            {
-                // Check if it was the last allcoation done on this page
-                // If this is the case we can rollback the offset
-                if (deviceMemory._offset + deviceMemory._size == pageBufferIter->_deviceMemory._offset)
-                    pageBufferIter->_deviceMemory._offset = deviceMemory._offset;
-            }
-        }
-
-        deviceMemory._offset = 0;
-        deviceMemory._size = 0;
-        deviceMemory._vkDeviceMemory = nullptr;
-    }
-}
-
-void VulkanMemoryManager::AllocateImageMemory(VkMemoryRequirements& memRequirements, VkMemoryPropertyFlags properties, VulkanDeviceMemory& deviceMemory)
+	deviceMemory._offset = offset;
+	deviceMemory._size = size;
+	deviceMemory._memoryTypeIndex = block->_memoryTypeIndex;
+	deviceMemory._vkDeviceMemory = block->_vkDeviceMemory;
+	deviceMemory._pBlock = block;
+	deviceMemory._allocationHandle = handle;
+	deviceMemory._needsFlush = block->_needsFlush;
+	deviceMemory._mappedAddress = (block->_mappedAddress) ? static_cast<uint8_t*>(block->_mappedAddress) + offset : nullptr;
+}
+
+void VulkanMemoryManager::SubRelease(VulkanDeviceMemory& deviceMemory)
+{
+	VulkanMemoryBlock* block = deviceMemory._pBlock;
+	if (block)
+	{
+		std::lock_guard<std::mutex> lock(_blockMutex);
+		block->_allocator.Free(deviceMemory._allocationHandle);
+		block->_owners.erase(deviceMemory._allocationHandle);
+
+		// keep one empty block per memory type so alternating create/destroy does not hit the driver
+		if (block->_allocator.IsEmpty() && _memoryBlocks[block->_memoryTypeIndex].size() > 1)
+			ReleaseBlock(block);
+	}
+
+	deviceMemory._offset = 0;
+	deviceMemory._size = 0;
+	deviceMemory._vkDeviceMemory = nullptr;
+	deviceMemory._pBlock = nullptr;
+	deviceMemory._allocationHandle = AllocatorTlsf::InvalidHandle;
+	deviceMemory._needsFlush = false;
+	deviceMemory._mappedAddress = nullptr;
+}
+
+void VulkanMemoryManager::ReleaseBlock(VulkanMemoryBlock* block)
+{
+	// swap with the last entry of the list
+	std::vector<VulkanMemoryBlock*>& blocks = _memoryBlocks[block->_memoryTypeIndex];
+	blocks[block->_index] = blocks.back();
+	blocks[block->_index]->_index = block->_index;
+	blocks.pop_back();
+
+	const VkPhysicalDeviceMemoryProperties& deviceMemProperties = _pPhysicalDevice->GetPhysicalDeviceMemoryProperties();
+	_blockSize[deviceMemProperties.memoryTypes[block->_memoryTypeIndex].heapIndex] -= block->_allocator.GetSize();
+
+	if (block->_mappedAddress)
+		VulkanApi::GetApi()->vkUnmapMemory(_pRenderDevice->GetDeviceHandle(), block->_vkDeviceMemory);
+
+	if (block->_vkDeviceMemory != VK_NULL_HANDLE)
+		VulkanApi::GetApi()->vkFreeMemory(_pRenderDevice->GetDeviceHandle(), block->_vkDeviceMemory, nullptr);
+
+	DeallocateDelete(*_pRenderDevice->GetEngineAllocator(), *block);
+}
+
+void VulkanMemoryManager::AllocateImageMemory(VkImage image, VkMemoryPropertyFlags properties, VkImageTiling tiling, VulkanDeviceMemory& deviceMemory)
 {
+	AllocatorTlsfKind kind = (tiling == VK_IMAGE_TILING_LINEAR) ? AllocatorTlsfKind::Linear : AllocatorTlsfKind::Optimal;
+
+	VkMemoryRequirements memRequirements;
+	bool dedicated = false;
+	if (_pRenderDevice->GetDeviceExtensions().caps.bits.bDedicatedAllocation)
+	{
+		// ask the driver if the image wants its own allocation (e.g. large render targets)
+		VkImageMemoryRequirementsInfo2 requirementsInfo = {};
+		requirementsInfo.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_REQUIREMENTS_INFO_2;
+		requirementsInfo.image = image;
+
+		VkMemoryDedicatedRequirements dedicatedRequirements = {};
+		dedicatedRequirements.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS;
+
+		VkMemoryRequirements2 memRequirements2 = {};
+		memRequirements2.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+		memRequirements2.pNext = &dedicatedRequirements;
+
+		VulkanApi::GetApi()->vkGetImageMemoryRequirements2(_pRenderDevice->GetDeviceHandle(), &requirementsInfo, &memRequirements2);
+		memRequirements = memRequirements2.memoryRequirements;
+		dedicated = dedicatedRequirements.prefersDedicatedAllocation || dedicatedRequirements.requiresDedicatedAllocation;
+	}
+	else
+	{
+		VulkanApi::GetApi()->vkGetImageMemoryRequirements(_pRenderDevice->GetDeviceHandle(), image, &memRequirements);
+	}
+
+	// linear images are written by the host
+	if (kind == AllocatorTlsfKind::Linear && !(properties & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+		&& UseDirectMemory() && (memRequirements.memoryTypeBits & (1u << _directMemoryTypeIndex)))
+	{
+		if (SubAllocate(_directMemoryTypeIndex, memRequirements, kind, deviceMemory, true))
+			return;
+	}
+
 	uint32_t memoryTypeIndex = ChooseMemoryType(memRequirements, properties);
-	if (memoryTypeIndex != ~0u)
+	if (memoryTypeIndex == ~0u)
+		throw BackendException("Error failed to allocate device memory");
+
+	const VkPhysicalDeviceMemoryProperties& deviceMemProperties = _pPhysicalDevice->GetPhysicalDeviceMemoryProperties();
+	uint32_t heapIndex = deviceMemProperties.memoryTypes[memoryTypeIndex].heapIndex;
+	bool withinBudget = true;
+	if (dedicated)
 	{
-		// Allocate memory
-		VkMemoryAllocateInfo allocInfo = {};
-		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-		allocInfo.allocationSize = memRequirements.size;
-		allocInfo.memoryTypeIndex = memoryTypeIndex;
-		if (VulkanApi::GetApi()->vkAllocateMemory(_pRenderDevice->GetDeviceHandle(), &allocInfo, nullptr, &deviceMemory._vkDeviceMemory) != VK_SUCCESS)
+		std::lock_guard<std::mutex> lock(_blockMutex);
+		withinBudget = IsWithinBudget(heapIndex, memRequirements.size);
+	}
+
+	if (!dedicated || !withinBudget)
+	{
+		if (withinBudget && SubAllocate(memoryTypeIndex, memRequirements, kind, deviceMemory, true))
+			return;
+
+		// device heap over budget, host memory is slower but does not make the driver page out device memory
+		uint32_t fallbackTypeIndex = ChooseFallbackMemoryType(memRequirements, properties);
+		if (fallbackTypeIndex != ~0u && SubAllocate(fallbackTypeIndex, memRequirements, kind, deviceMemory, false))
 		{
-			throw BackendException("Error failed to allocate device memory");
+			std::lock_guard<std::mutex> lock(_blockMutex);
+			_fallbackCount++;
+			return;
 		}
 
-		deviceMemory._offset = 0;
-		deviceMemory._size = memRequirements.size;
+		// nowhere else to go, exceed the budget
+		if (!dedicated)
+		{
+			if (!SubAllocate(memoryTypeIndex, memRequirements, kind, deviceMemory, false))
+				throw BackendException("Error failed to allocate device memory");
+
+			return;
+		}
 	}
+
+	VkMemoryDedicatedAllocateInfo dedicatedInfo = {};
+	dedicatedInfo.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO;
+	dedicatedInfo.image = image;
+
+	VkMemoryAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.pNext = &dedicatedInfo;
+	allocInfo.allocationSize = memRequirements.size;
+	allocInfo.memoryTypeIndex = memoryTypeIndex;
+	if (VulkanApi::GetApi()->vkAllocateMemory(_pRenderDevice->GetDeviceHandle(), &allocInfo, nullptr, &deviceMemory._vkDeviceMemory) != VK_SUCCESS)
+	{
+		throw BackendException("Error failed to allocate device memory");
+	}
+
+	deviceMemory._offset = 0;
+	deviceMemory._size = memRequirements.size;
+	deviceMemory._memoryTypeIndex = memoryTypeIndex;
+	deviceMemory._pBlock = nullptr;
+
+	std::lock_guard<std::mutex> lock(_blockMutex);
+	_dedicatedCount[heapIndex]++;
+	_dedicatedSize[heapIndex] += memRequirements.size;
 }
 
 void VulkanMemoryManager::ReleaseImageMemory(VulkanDeviceMemory& deviceMemory)
 {
-	if (deviceMemory._size && deviceMemory._vkDeviceMemory)
+	if (deviceMemory._pBlock)
+	{
+		SubRelease(deviceMemory);
+	}
+	else if (deviceMemory._size && deviceMemory._vkDeviceMemory)
 	{
 		VulkanApi::GetApi()->vkFreeMemory(_pRenderDevice->GetDeviceHandle(), deviceMemory._vkDeviceMemory, nullptr);
+
+		const VkPhysicalDeviceMemoryProperties& deviceMemProperties = _pPhysicalDevice->GetPhysicalDeviceMemoryProperties();
+		uint32_t heapIndex = deviceMemProperties.memoryTypes[deviceMemory._memoryTypeIndex].heapIndex;
+		{
+			std::lock_guard<std::mutex> lock(_blockMutex);
+			_dedicatedCount[heapIndex]--;
+			_dedicatedSize[heapIndex] -= deviceMemory._size;
+		}
+
 		deviceMemory._offset = 0;
 		deviceMemory._size = 0;
 		deviceMemory._vkDeviceMemory = nullptr;
 	}
 }
 
-void VulkanMemoryManager::SubmitCopies()
+void VulkanMemoryManager::GetMemoryUsage(HalMemoryUsage& usage)
 {
-    if (_copyCount > 0)
-    {
-        VulkanApi::GetApi()->vkEndCommandBuffer(_vkTransferCommandBuffer);
+	const VkPhysicalDeviceMemoryProperties& deviceMemProperties = _pPhysicalDevice->GetPhysicalDeviceMemoryProperties();
 
-        // submit job
-        VkSubmitInfo submitInfo = {};
-        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-        submitInfo.commandBufferCount = 1;
-        submitInfo.pCommandBuffers = &_vkTransferCommandBuffer;
+	usage._heapCount = (deviceMemProperties.memoryHeapCount < HAL_MAX_MEMORY_HEAPS) ? deviceMemProperties.memoryHeapCount : HAL_MAX_MEMORY_HEAPS;
+	for (uint32_t i = 0; i < usage._heapCount; i++)
+	{
+		usage._heaps[i] = HalMemoryHeapUsage();
+		usage._heaps[i]._heapSize = deviceMemProperties.memoryHeaps[i].size;
+		usage._heaps[i]._deviceLocal = (deviceMemProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+	}
 
-        VulkanApi::GetApi()->vkQueueSubmit(_pRenderDevice->GetGraphicsQueue(), 1, &submitInfo, _vkCopyFence);
+	std::lock_guard<std::mutex> lock(_blockMutex);
+	for (uint32_t i = 0; i < usage._heapCount; i++)
+	{
+		usage._heaps[i]._dedicatedCount = _dedicatedCount[i];
+		usage._heaps[i]._dedicatedSize = _dedicatedSize[i];
+		usage._heaps[i]._budget = _heapBudget[i];
+		usage._heaps[i]._usage = GetHeapUsage(i);
+	}
+	usage._driverBudget = _pRenderDevice->GetDeviceExtensions().caps.bits.bMemoryBudget;
+	usage._fallbackCount = _fallbackCount;
+	usage._relocationCount = _relocationCount;
+	usage._relocatedSize = _relocatedSize;
 
-        _copyCount = 0;
-    }
-    if (_copyImageCount > 0)
-    {
-        VulkanApi::GetApi()->vkEndCommandBuffer(_vkImageTransferCommandBuffer);
+	for (uint32_t type = 0; type < deviceMemProperties.memoryTypeCount; type++)
+	{
+		uint32_t heapIndex = deviceMemProperties.memoryTypes[type].heapIndex;
+		if (heapIndex >= usage._heapCount)
+			continue;
 
-        // submit job
-        VkSubmitInfo submitInfo = {};
-        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-        submitInfo.commandBufferCount = 1;
-        submitInfo.pCommandBuffers = &_vkImageTransferCommandBuffer;
+		HalMemoryHeapUsage& heap = usage._heaps[heapIndex];
+		for (VulkanMemoryBlock* block : _memoryBlocks[type])
+		{
+			heap._blockCount++;
+			heap._blockSize += block->_allocator.GetSize();
+			heap._usedSize += block->_allocator.GetUsedSize();
+			heap._allocationCount += block->_allocator.GetAllocationCount();
+		}
+	}
 
-        VulkanApi::GetApi()->vkQueueSubmit(_pRenderDevice->GetGraphicsQueue(), 1, &submitInfo, _vkCopyImageFence);
+	usage._typeCount = (deviceMemProperties.memoryTypeCount < HAL_MAX_MEMORY_TYPES) ? deviceMemProperties.memoryTypeCount : HAL_MAX_MEMORY_TYPES;
+	for (uint32_t type = 0; type < usage._typeCount; type++)
+	{
+		VkMemoryPropertyFlags typeFlags = deviceMemProperties.memoryTypes[type].propertyFlags;
+		HalMemoryTypeUsage& typeUsage = usage._types[type];
+		typeUsage = HalMemoryTypeUsage();
+		typeUsage._heapIndex = deviceMemProperties.memoryTypes[type].heapIndex;
+		typeUsage._deviceLocal = (typeFlags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) != 0;
+		typeUsage._hostVisible = (typeFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0;
+		typeUsage._hostCoherent = (typeFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+
+		// free space a block can't hand out in one piece counts as fragmented
+		uint64_t freeSize = 0;
+		uint64_t fragmentedSize = 0;
+		for (VulkanMemoryBlock* block : _memoryBlocks[type])
+		{
+			uint64_t blockFree = block->_allocator.GetSize() - block->_allocator.GetUsedSize();
+			uint64_t largestFree = block->_allocator.GetLargestFreeRange();
+			typeUsage._blockCount++;
+			typeUsage._blockSize += block->_allocator.GetSize();
+			typeUsage._usedSize += block->_allocator.GetUsedSize();
+			typeUsage._allocationCount += block->_allocator.GetAllocationCount();
+			typeUsage._freeRangeCount += block->_allocator.GetFreeRangeCount();
+			if (largestFree > typeUsage._largestFreeRange)
+				typeUsage._largestFreeRange = largestFree;
+
+			freeSize += blockFree;
+			fragmentedSize += (blockFree > largestFree) ? blockFree - largestFree : 0;
+		}
 
-        _copyImageCount = 0;
-    }
+		typeUsage._fragmentation = (freeSize) ? float(fragmentedSize) / float(freeSize) : 0.0f;
+	}
 }
 
-void VulkanMemoryManager::WaitForCopies()
+void VulkanMemoryManager::GetMemoryAllocations(std::vector<HalMemoryAllocation>& allocations)
 {
-	SubmitCopies(); // just in case it did not happen already
+	std::vector<AllocatorTlsfRange> ranges;
+
+	std::lock_guard<std::mutex> lock(_blockMutex);
+	for (uint32_t type = 0; type < VK_MAX_MEMORY_TYPES; type++)
+	{
+		for (size_t i = 0; i < _memoryBlocks[type].size(); i++)
+		{
+			VulkanMemoryBlock* block = _memoryBlocks[type][i];
+			block->_allocator.GetRanges(ranges);
+			for (const AllocatorTlsfRange& range : ranges)
+			{
+				HalMemoryAllocation allocation;
+				allocation._memoryType = type;
+				allocation._block = static_cast<uint32_t>(i);
+				allocation._offset = range._offset;
+				allocation._size = range._size;
+				allocation._free = (range._handle == AllocatorTlsf::InvalidHandle);
+				allocation._image = !allocation._free && range._kind == AllocatorTlsfKind::Optimal;
+				allocation._movable = !allocation._free && block->_owners.count(range._handle) != 0;
+				allocations.push_back(allocation);
+			}
+		}
+	}
+}
+
+void VulkanMemoryManager::GetUploadStats(HalUploadStats& stats)
+{
+	{
+		std::lock_guard<std::mutex> lock(_statsMutex);
+		stats = _uploadStats;
+	}
+	stats._directMemorySize = (UseDirectMemory()) ? _directHeapSize : 0;
+}
+
+void VulkanMemoryManager::SetUploadPolicy(HalUploadPolicy policy)
+{
+	_uploadPolicy = policy;
+}
 
-    if (_copyWaitCount > 0)
-    {
-        VkResult result = VulkanApi::GetApi()->vkGetFenceStatus(_pRenderDevice->GetDeviceHandle(), _vkCopyFence);
-        if (result == VK_NOT_READY)
-        {
-            // Wait for fence
-            VulkanApi::GetApi()->vkWaitForFences(_pRenderDevice->GetDeviceHandle(), 1, &_vkCopyFence, VK_TRUE, (std::numeric_limits<uint64_t>::max)());
-        }
+void VulkanMemoryManager::UpdateBudget()
+{
+	if (!_pRenderDevice->GetDeviceExtensions().caps.bits.bMemoryBudget)
+		return;
 
-        _copyWaitCount = 0;
+	VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties = {};
+	budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
 
-        // Reset fence for re-use
-        VulkanApi::GetApi()->vkResetFences(_pRenderDevice->GetDeviceHandle(), 1, &_vkCopyFence);
+	VkPhysicalDeviceMemoryProperties2 memProperties2 = {};
+	memProperties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+	memProperties2.pNext = &budgetProperties;
+	VulkanApi::GetApi()->vkGetPhysicalDeviceMemoryProperties2(_pPhysicalDevice->GetPhysicalDeviceHandle(), &memProperties2);
 
-        // we re-use the command buffer which is safe after we waited for the fence
-        VulkanApi::GetApi()->vkResetCommandBuffer(_vkTransferCommandBuffer, 0);
-    }
+	// own allocations made after this point are added to the reported usage
+	std::lock_guard<std::mutex> lock(_blockMutex);
+	for (uint32_t i = 0; i < memProperties2.memoryProperties.memoryHeapCount; i++)
+	{
+		_heapBudget[i] = budgetProperties.heapBudget[i];
+		_heapUsage[i] = budgetProperties.heapUsage[i];
+		_budgetAllocated[i] = _blockSize[i] + _dedicatedSize[i];
+	}
+}
+
+uint64_t VulkanMemoryManager::GetHeapUsage(uint32_t heapIndex)
+{
+	// driver usage at the last update plus what we allocated or freed since then
+	uint64_t usage = _heapUsage[heapIndex] + _blockSize[heapIndex] + _dedicatedSize[heapIndex];
+	return (usage > _budgetAllocated[heapIndex]) ? usage - _budgetAllocated[heapIndex] : 0;
+}
+
+bool VulkanMemoryManager::IsWithinBudget(uint32_t heapIndex, uint64_t size)
+{
+	// host memory is paged by the OS, only device heaps are limited
+	const VkPhysicalDeviceMemoryProperties& deviceMemProperties = _pPhysicalDevice->GetPhysicalDeviceMemoryProperties();
+	if (!(deviceMemProperties.memoryHeaps[heapIndex].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT))
+		return true;
+
+	return GetHeapUsage(heapIndex) + size <= _heapBudget[heapIndex];
+}
+
+uint32_t VulkanMemoryManager::ChooseFallbackMemoryType(VkMemoryRequirements& memRequirements, VkMemoryPropertyFlags properties)
+{
+	if (!(properties & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT))
+		return ~0u;
+
+	const VkPhysicalDeviceMemoryProperties& deviceMemProperties = _pPhysicalDevice->GetPhysicalDeviceMemoryProperties();
+	properties &= ~VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+
+	// any type outside of device local heaps with the remaining properties (UMA devices have none)
+	for (uint32_t i = 0; i < deviceMemProperties.memoryTypeCount; i++)
+	{
+		const VkMemoryType& memoryType = deviceMemProperties.memoryTypes[i];
+		if ((memRequirements.memoryTypeBits & (1u << i)) && (memoryType.propertyFlags & properties) == properties
+			&& !(memoryType.propertyFlags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)
+			&& !(deviceMemProperties.memoryHeaps[memoryType.heapIndex].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT))
+		{
+			return i;
+		}
+	}
 
-    if (_copyImageWaitCount > 0)
-    {
-        VkResult result = VulkanApi::GetApi()->vkGetFenceStatus(_pRenderDevice->GetDeviceHandle(), _vkCopyImageFence);
-        if (result == VK_NOT_READY)
-        {
-            // Wait for fence
-            VulkanApi::GetApi()->vkWaitForFences(_pRenderDevice->GetDeviceHandle(), 1, &_vkCopyImageFence, VK_TRUE, (std::numeric_limits<uint64_t>::max)());
-        }
+	return ~0u;
+}
 
-        _copyImageWaitCount = 0;
+void VulkanMemoryManager::SetMemoryOwner(const VulkanDeviceMemory& deviceMemory, VulkanMemoryOwner* owner)
+{
+	// dedicated allocations are not moved
+	if (!deviceMemory._pBlock)
+		return;
 
-        // Reset fence for re-use
-        VulkanApi::GetApi()->vkResetFences(_pRenderDevice->GetDeviceHandle(), 1, &_vkCopyImageFence);
+	std::lock_guard<std::mutex> lock(_blockMutex);
+	if (owner)
+		deviceMemory._pBlock->_owners[deviceMemory._allocationHandle] = std::make_pair(owner, deviceMemory._size);
+	else
+		deviceMemory._pBlock->_owners.erase(deviceMemory._allocationHandle);
+}
 
-        // we re-use the command buffer which is safe after we waited for the fence
-        VulkanApi::GetApi()->vkResetCommandBuffer(_vkImageTransferCommandBuffer, 0);
-    }
+bool VulkanMemoryManager::AllocateRelocation(VkMemoryRequirements& memRequirements, AllocatorTlsfKind kind, VulkanMemoryBlock* sourceBlock, VulkanDeviceMemory& deviceMemory)
+{
+	std::lock_guard<std::mutex> lock(_blockMutex);
 
-	// Make staging buffers available again
-	// Reset first page remove others
-	CaveList<VulkanDeviceMemoryPageEntry>::Iterator begin = _stagingMemoryPages.begin();
-	begin->_deviceMemory._offset = 0;
-	begin++;
-	
-	CaveList<VulkanDeviceMemoryPageEntry>::Iterator pageIter = begin;
-	for (; pageIter != _stagingMemoryPages.end(); pageIter++)
+	// any other block of the type, the source block is emptied
+	std::vector<VulkanMemoryBlock*>& blocks = _memoryBlocks[sourceBlock->_memoryTypeIndex];
+	for (size_t i = 0; i < blocks.size(); i++)
 	{
-		ReleaseStagingMemory(pageIter->_deviceMemory);
-		if (pageIter->_vkBuffer != VK_NULL_HANDLE)
-			VulkanApi::GetApi()->vkDestroyBuffer(_pRenderDevice->GetDeviceHandle(), pageIter->_vkBuffer, nullptr);
+		VulkanMemoryBlock* block = blocks[i];
+		if (block == sourceBlock)
+			continue;
 
-		_stagingMemoryPages.Erase(pageIter);
+		uint64_t offset = 0;
+		uint32_t handle = block->_allocator.Allocate(memRequirements.size, memRequirements.alignment, kind, offset);
+		if (handle != AllocatorTlsf::InvalidHandle)
+		{
+			SetSubAllocation(block, handle, offset, memRequirements.size, deviceMemory);
+			return true;
+		}
 	}
+
+	return false;
+}
+
+uint32_t VulkanMemoryManager::Defragment(uint64_t maxBytes)
+{
+	// nothing may use the resources while they are copied
+	WaitForCopies();
+	VulkanApi::GetApi()->vkDeviceWaitIdle(_pRenderDevice->GetDeviceHandle());
+
+	const VkPhysicalDeviceMemoryProperties& deviceMemProperties = _pPhysicalDevice->GetPhysicalDeviceMemoryProperties();
+	std::vector<std::pair<VulkanMemoryOwner*, uint64_t>> owners;
+	VulkanMemoryBlock* sourceBlock = nullptr;
+	{
+		std::lock_guard<std::mutex> lock(_blockMutex);
+
+		// The least used block of a device local type is emptied. Host visible blocks are mapped
+		// and may be written by the host at any time, they stay where they are.
+		for (uint32_t type = 0; type < deviceMemProperties.memoryTypeCount; type++)
+		{
+			VkMemoryPropertyFlags typeFlags = deviceMemProperties.memoryTypes[type].propertyFlags;
+			std::vector<VulkanMemoryBlock*>& blocks = _memoryBlocks[type];
+			if (!(typeFlags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) || (typeFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) || blocks.size() < 2)
+				continue;
+
+			uint64_t freeSize = 0;
+			for (VulkanMemoryBlock* block : blocks)
+				freeSize += block->_allocator.GetSize() - block->_allocator.GetUsedSize();
+
+			for (VulkanMemoryBlock* block : blocks)
+			{
+				uint64_t usedSize = block->_allocator.GetUsedSize();
+				uint64_t otherFreeSize = freeSize - (block->_allocator.GetSize() - usedSize);
+				// every allocation must be movable and the other blocks must have room for them
+				if (usedSize == 0 || usedSize > otherFreeSize || block->_owners.size() != block->_allocator.GetAllocationCount())
+					continue;
+
+				bool movable = true;
+				for (auto& entry : block->_owners)
+					movable = movable && entry.second.first->CanRelocate();
+				if (!movable)
+					continue;
+
+				if (!sourceBlock || usedSize < sourceBlock->_allocator.GetUsedSize())
+					sourceBlock = block;
+			}
+		}
+
+		if (!sourceBlock)
+			return 0;
+
+		for (auto& entry : sourceBlock->_owners)
+			owners.push_back(entry.second);
+	}
+
+	// copies run on the graphics queue, the resources are owned by it
+	VkCommandPool commandPool = (_vkAcquireCommandPool != VK_NULL_HANDLE) ? _vkAcquireCommandPool : _vkCommandPool;
+	VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+	VkFence fence = VK_NULL_HANDLE;
+
+	VkCommandBufferAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	allocInfo.commandPool = commandPool;
+	allocInfo.commandBufferCount = 1;
+
+	VkFenceCreateInfo fenceInfo = {};
+	fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+	if (VulkanApi::GetApi()->vkAllocateCommandBuffers(_pRenderDevice->GetDeviceHandle(), &allocInfo, &commandBuffer) != VK_SUCCESS)
+		return 0;
+
+	if (VulkanApi::GetApi()->vkCreateFence(_pRenderDevice->GetDeviceHandle(), &fenceInfo, nullptr, &fence) != VK_SUCCESS)
+	{
+		VulkanApi::GetApi()->vkFreeCommandBuffers(_pRenderDevice->GetDeviceHandle(), commandPool, 1, &commandBuffer);
+		return 0;
+	}
+
+	VkCommandBufferBeginInfo beginInfo = {};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	VulkanApi::GetApi()->vkBeginCommandBuffer(commandBuffer, &beginInfo);
+
+	VkMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+	VulkanApi::GetApi()->vkCmdPipelineBarrier(commandBuffer,
+		VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+		0,
+		1, &barrier,
+		0, nullptr, // no buffer barriers
+		0, nullptr); // no image barriers
+
+	// owners refusing to move (e.g. no room left in other blocks) are skipped
+	// the source block stays alive until FinishRelocation released the old memory
+	std::vector<VulkanMemoryOwner*> movedOwners;
+	uint64_t movedSize = 0;
+	for (auto& owner : owners)
+	{
+		if (movedSize >= maxBytes && !movedOwners.empty())
+			break;
+
+		if (!owner.first->Relocate(commandBuffer, sourceBlock))
+			continue;
+
+		movedSize += owner.second;
+		movedOwners.push_back(owner.first);
+	}
+
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+	VulkanApi::GetApi()->vkCmdPipelineBarrier(commandBuffer,
+		VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+		0,
+		1, &barrier,
+		0, nullptr, // no buffer barriers
+		0, nullptr); // no image barriers
+	VulkanApi::GetApi()->vkEndCommandBuffer(commandBuffer);
+
+	if (!movedOwners.empty())
+	{
+		VkSubmitInfo submitInfo = {};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &commandBuffer;
+
+		VulkanApi::GetApi()->vkQueueSubmit(_pRenderDevice->GetGraphicsQueue(), 1, &submitInfo, fence);
+		VulkanApi::GetApi()->vkWaitForFences(_pRenderDevice->GetDeviceHandle(), 1, &fence, VK_TRUE, (std::numeric_limits<uint64_t>::max)());
+
+		// old handles and memory go away, an emptied block with them
+		for (VulkanMemoryOwner* owner : movedOwners)
+			owner->FinishRelocation();
+	}
+
+	VulkanApi::GetApi()->vkDestroyFence(_pRenderDevice->GetDeviceHandle(), fence, nullptr);
+	VulkanApi::GetApi()->vkFreeCommandBuffers(_pRenderDevice->GetDeviceHandle(), commandPool, 1, &commandBuffer);
+
+	std::lock_guard<std::mutex> lock(_blockMutex);
+	_relocationCount += movedOwners.size();
+	_relocatedSize += movedSize;
+
+	return static_cast<uint32_t>(movedOwners.size());
+}
+
+bool VulkanMemoryManager::UseDirectMemory() const
+{
+	if (_directMemoryTypeIndex == ~0u)
+		return false;
+
+	return (_uploadPolicy == HalUploadPolicy::Direct) || (_uploadPolicy == HalUploadPolicy::Auto && _directHeapFull);
+}
+
+bool VulkanMemoryManager::CanWriteImageDirect(const VkImageCreateInfo& createInfo)
+{
+	if (!UseDirectMemory())
+		return false;
+
+	if (createInfo.imageType != VK_IMAGE_TYPE_2D || createInfo.mipLevels != 1 || createInfo.arrayLayers != 1
+		|| createInfo.extent.depth != 1 || createInfo.samples != VK_SAMPLE_COUNT_1_BIT)
+		return false;
+
+	// only images shaders read from
+	if (createInfo.usage & ~(VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT))
+		return false;
+
+	VulkanImageSizeInfo imageSizeInfo = VulkanTypeConversion::GetImageSizeInfo(createInfo.format);
+	// unknown formats have no element size to write rows with
+	if (imageSizeInfo._compressed || imageSizeInfo._elementSize == 0)
+		return false;
+
+	uint64_t size = static_cast<uint64_t>(createInfo.extent.width) * createInfo.extent.height * imageSizeInfo._elementSize;
+	if (size > DirectImageMaxSize)
+		return false;
+
+	VkFormatProperties formatProperties;
+	VulkanApi::GetApi()->vkGetPhysicalDeviceFormatProperties(_pPhysicalDevice->GetPhysicalDeviceHandle(), createInfo.format, &formatProperties);
+
+	return (formatProperties.linearTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) != 0;
+}
+
+void VulkanMemoryManager::AddDirectWrite(uint64_t size)
+{
+	std::lock_guard<std::mutex> lock(_statsMutex);
+	_uploadStats._directWriteCount++;
+	_uploadStats._directByteCount += size;
+}
+
+void VulkanMemoryManager::TransitionHostWrittenImage(VkImage image, VkImageAspectFlags aspectMask)
+{
+	VulkanCopySubmission* submission = BeginCopies();
+	if (!submission)
+		return;
+
+	// the submission makes the host writes available, no access to wait for
+	VkImageMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.srcAccessMask = 0;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_PREINITIALIZED;
+	barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = image;
+	barrier.subresourceRange = VkImageSubresourceRange{ aspectMask, 0, 1, 0, 1 };
+	submission->_hostWriteBarriers.push_back(barrier);
+}
+
+void VulkanMemoryManager::SubmitCopies()
+{
+	VulkanCopySubmission* submission = _pCopySubmission;
+	if (!submission)
+		return;
+
+	// record the collected copies. Image releases are returned for the acquire
+	VulkanUploadBatcher& batcher = submission->_batcher;
+	VulkanUploadBatcher& graphicsBatcher = submission->_graphicsBatcher;
+
+	// the copies may overwrite content earlier graphics work still reads
+	if (_transferFamilyIndex == _graphicsFamilyIndex)
+		RecordWriteAfterReadBarrier(submission->_vkCommandBuffer);
+
+	uint32_t commandCount = batcher.Record(submission->_vkCommandBuffer, _transferFamilyIndex, _graphicsFamilyIndex, submission->_imageBarriers);
+
+	{
+		std::lock_guard<std::mutex> lock(_statsMutex);
+		_uploadStats._submitCount++;
+		_uploadStats._copyCount += batcher.GetCopyCount() + graphicsBatcher.GetCopyCount();
+		_uploadStats._commandCount += commandCount;
+		_uploadStats._byteCount += batcher.GetByteCount() + graphicsBatcher.GetByteCount();
+		_uploadStats._lastSubmitSize = batcher.GetByteCount() + graphicsBatcher.GetByteCount();
+	}
+
+	if (_transferFamilyIndex == _graphicsFamilyIndex)
+	{
+		std::vector<VkImageMemoryBarrier>& hostWriteBarriers = submission->_hostWriteBarriers;
+		if (!hostWriteBarriers.empty())
+		{
+			VulkanApi::GetApi()->vkCmdPipelineBarrier(submission->_vkCommandBuffer,
+				VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+				0,
+				0, nullptr, // no memory barriers
+				0, nullptr, // no buffer barriers
+				static_cast<uint32_t>(hostWriteBarriers.size()), hostWriteBarriers.data());
+		}
+
+		// make the copies visible to everything submitted after them
+		VkMemoryBarrier barrier = {};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+		VulkanApi::GetApi()->vkCmdPipelineBarrier(submission->_vkCommandBuffer,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+			0,
+			1, &barrier,
+			0, nullptr, // no buffer barriers
+			0, nullptr); // no image barriers
+
+		VulkanApi::GetApi()->vkEndCommandBuffer(submission->_vkCommandBuffer);
+
+		// submit job
+		VkSubmitInfo submitInfo = {};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &submission->_vkCommandBuffer;
+
+		VulkanApi::GetApi()->vkQueueSubmit(_pRenderDevice->GetGraphicsQueue(), 1, &submitInfo, submission->_vkFence);
+	}
+	else
+	{
+		// release the written buffer ranges to the graphics queue. Images were released by the batcher
+		std::vector<VkBufferMemoryBarrier>& bufferBarriers = submission->_bufferBarriers;
+		if (!bufferBarriers.empty())
+		{
+			VulkanApi::GetApi()->vkCmdPipelineBarrier(submission->_vkCommandBuffer,
+				VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+				0,
+				0, nullptr, // no memory barriers
+				static_cast<uint32_t>(bufferBarriers.size()), bufferBarriers.data(),
+				0, nullptr); // no image barriers
+		}
+
+		VulkanApi::GetApi()->vkEndCommandBuffer(submission->_vkCommandBuffer);
+
+		VkSubmitInfo submitInfo = {};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &submission->_vkCommandBuffer;
+		submitInfo.signalSemaphoreCount = 1;
+		submitInfo.pSignalSemaphores = &submission->_vkSemaphore;
+
+		VulkanApi::GetApi()->vkQueueSubmit(_pRenderDevice->GetTransferQueue(), 1, &submitInfo, VK_NULL_HANDLE);
+
+		// acquire on the graphics queue. Only graphics work submitted from now on waits for the copies
+		for (VkBufferMemoryBarrier& barrier : bufferBarriers)
+		{
+			barrier.srcAccessMask = 0;
+			barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+		}
+		for (VkImageMemoryBarrier& barrier : submission->_imageBarriers)
+		{
+			barrier.srcAccessMask = 0;
+			barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		}
+
+		// host written images never belonged to the transfer queue, the graphics queue moves them out of preinitialized layout
+		submission->_imageBarriers.insert(submission->_imageBarriers.end(), submission->_hostWriteBarriers.begin(), submission->_hostWriteBarriers.end());
+
+		VkCommandBufferBeginInfo beginInfo = {};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+		VulkanApi::GetApi()->vkBeginCommandBuffer(submission->_vkAcquireCommandBuffer, &beginInfo);
+		VulkanApi::GetApi()->vkCmdPipelineBarrier(submission->_vkAcquireCommandBuffer,
+			VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+			0,
+			0, nullptr, // no memory barriers
+			static_cast<uint32_t>(bufferBarriers.size()), bufferBarriers.data(),
+			static_cast<uint32_t>(submission->_imageBarriers.size()), submission->_imageBarriers.data());
+
+		// re-uploads stay on the graphics queue, which owns these resources and orders them after earlier reads
+		if (graphicsBatcher.GetCopyCount() > 0)
+		{
+			std::vector<VkImageMemoryBarrier> noReleaseBarriers;
+			RecordWriteAfterReadBarrier(submission->_vkAcquireCommandBuffer);
+			uint32_t graphicsCommandCount = graphicsBatcher.Record(submission->_vkAcquireCommandBuffer, _graphicsFamilyIndex, _graphicsFamilyIndex, noReleaseBarriers);
+			{
+				std::lock_guard<std::mutex> lock(_statsMutex);
+				_uploadStats._commandCount += graphicsCommandCount;
+			}
+
+			VkMemoryBarrier barrier = {};
+			barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+			VulkanApi::GetApi()->vkCmdPipelineBarrier(submission->_vkAcquireCommandBuffer,
+				VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+				0,
+				1, &barrier,
+				0, nullptr, // no buffer barriers
+				0, nullptr); // no image barriers
+		}
+		VulkanApi::GetApi()->vkEndCommandBuffer(submission->_vkAcquireCommandBuffer);
+
+		VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+		VkSubmitInfo acquireInfo = {};
+		acquireInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		acquireInfo.waitSemaphoreCount = 1;
+		acquireInfo.pWaitSemaphores = &submission->_vkSemaphore;
+		acquireInfo.pWaitDstStageMask = &waitStage;
+		acquireInfo.commandBufferCount = 1;
+		acquireInfo.pCommandBuffers = &submission->_vkAcquireCommandBuffer;
+
+		// the fence covers both submissions, the acquire finishes last
+		VulkanApi::GetApi()->vkQueueSubmit(_pRenderDevice->GetGraphicsQueue(), 1, &acquireInfo, submission->_vkFence);
+	}
+
+	// staging space up to the current head is in use until the fence signals
+	submission->_pRing = _pStagingRing;
+	submission->_ringHead = _pStagingRing->_head;
+	_pStagingRing->_pendingCount++;
+
+	_pendingCopySubmissions.push_back(submission);
+	_pCopySubmission = nullptr;
+	_recordedStagingSize = 0;
+}
+
+void VulkanMemoryManager::ReclaimStaging()
+{
+	// submissions finish in order, stop at the first one still running
+	while (!_pendingCopySubmissions.empty())
+	{
+		VulkanCopySubmission* submission = _pendingCopySubmissions.front();
+		if (VulkanApi::GetApi()->vkGetFenceStatus(_pRenderDevice->GetDeviceHandle(), submission->_vkFence) != VK_SUCCESS)
+			break;
+
+		_pendingCopySubmissions.pop_front();
+
+		VulkanStagingRing* ring = submission->_pRing;
+		ring->_tail = submission->_ringHead;
+		ring->_pendingCount--;
+
+		// Reset fence and command buffer for re-use
+		VulkanApi::GetApi()->vkResetFences(_pRenderDevice->GetDeviceHandle(), 1, &submission->_vkFence);
+		VulkanApi::GetApi()->vkResetCommandBuffer(submission->_vkCommandBuffer, 0);
+		if (submission->_vkAcquireCommandBuffer != VK_NULL_HANDLE)
+			VulkanApi::GetApi()->vkResetCommandBuffer(submission->_vkAcquireCommandBuffer, 0);
+		submission->_bufferBarriers.clear();
+		submission->_imageBarriers.clear();
+		submission->_hostWriteBarriers.clear();
+		submission->_batcher.Clear();
+		submission->_graphicsBatcher.Clear();
+		submission->_pRing = nullptr;
+		_freeCopySubmissions.push_back(submission);
+	}
+
+	// outgrown rings go away once nothing uses them anymore
+	for (size_t i = 0; i < _retiredStagingRings.size();)
+	{
+		if (_retiredStagingRings[i]->_pendingCount == 0)
+		{
+			ReleaseStagingRing(_retiredStagingRings[i]);
+			_retiredStagingRings[i] = _retiredStagingRings.back();
+			_retiredStagingRings.pop_back();
+		}
+		else
+		{
+			i++;
+		}
+	}
+
+	if (_pStagingRing)
+		UpdateStagingStats();
+}
+
+void VulkanMemoryManager::UpdateStagingStats()
+{
+	uint64_t usedSize = _pStagingRing->_head - _pStagingRing->_tail;
+
+	std::lock_guard<std::mutex> lock(_statsMutex);
+	_uploadStats._stagingSize = _pStagingRing->_size;
+	_uploadStats._stagingUsedSize = usedSize;
+	if (usedSize > _uploadStats._stagingHighWater)
+		_uploadStats._stagingHighWater = usedSize;
+}
+
+void VulkanMemoryManager::WaitForCopies()
+{
+	SubmitCopies(); // just in case it did not happen already
+
+	if (!_pendingCopySubmissions.empty())
+	{
+		{
+			std::lock_guard<std::mutex> lock(_statsMutex);
+			_uploadStats._copyWaitCount++;
+		}
+
+		// the last submission finishes last
+		VkFence fence = _pendingCopySubmissions.back()->_vkFence;
+		VulkanApi::GetApi()->vkWaitForFences(_pRenderDevice->GetDeviceHandle(), 1, &fence, VK_TRUE, (std::numeric_limits<uint64_t>::max)());
+	}
+
+	ReclaimStaging();
 }
 
 void VulkanMemoryManager::AllocateStagingMemory(VkMemoryRequirements& memRequirements, VulkanDeviceMemory& deviceMemory)
@@ -380,12 +1160,72 @@ void VulkanMemoryManager::AllocateStagingMemory(VkMemoryRequirements& memRequire
 
 void VulkanMemoryManager::GetStagingBuffer(uint64_t size, VulkanStagingBufferInfo& stagingBufferInfo)
 {
-	// Get available stating buffer
-	VkBuffer stagingBuffer = FindStagingBuffer(size, stagingBufferInfo._statgingMemory);
-	if (stagingBuffer != VK_NULL_HANDLE)
+	// streamed uploads: let the GPU work on the copies recorded so far while the caller fills the next piece
+	if (_recordedStagingSize >= StagingSubmitSize)
+		SubmitCopies();
+
+	ReclaimStaging();
+
+	uint64_t offset = 0;
+	while (!_pStagingRing->Allocate(size, _stagingAlignment, offset))
+	{
+		// Ring is full. Copies recorded so far are submitted first so they keep the ring alive
+		SubmitCopies();
+
+		uint64_t ringSize = _pStagingRing->_size * 2;
+		while (ringSize < size + _stagingAlignment)
+			ringSize *= 2;
+
+		if (ringSize > MaxStagingRingSize && size + _stagingAlignment <= _pStagingRing->_size && !_pendingCopySubmissions.empty())
+		{
+			// the ring reached its limit, wait for the oldest copies instead of growing
+			{
+				std::lock_guard<std::mutex> lock(_statsMutex);
+				_uploadStats._stagingWaitCount++;
+			}
+			VkFence fence = _pendingCopySubmissions.front()->_vkFence;
+			VulkanApi::GetApi()->vkWaitForFences(_pRenderDevice->GetDeviceHandle(), 1, &fence, VK_TRUE, (std::numeric_limits<uint64_t>::max)());
+			ReclaimStaging();
+			continue;
+		}
+
+		// grow instead of waiting for the GPU
+		if (!CreateStagingRing(ringSize) || !_pStagingRing->Allocate(size, _stagingAlignment, offset))
+			return;
+	}
+
+	_recordedStagingSize += size;
+	UpdateStagingStats();
+
+	stagingBufferInfo._stagingBuffer = _pStagingRing->_vkBuffer;
+	stagingBufferInfo._statgingMemory._offset = offset;
+	stagingBufferInfo._statgingMemory._size = size;
+	stagingBufferInfo._statgingMemory._memoryTypeIndex = _pStagingRing->_deviceMemory._memoryTypeIndex;
+	stagingBufferInfo._statgingMemory._vkDeviceMemory = _pStagingRing->_deviceMemory._vkDeviceMemory;
+	stagingBufferInfo._statgingMemory._needsFlush = _pStagingRing->_deviceMemory._needsFlush;
+	stagingBufferInfo._statgingMemory._mappedAddress = static_cast<uint8_t*>(_pStagingRing->_deviceMemory._mappedAddress) + offset;
+}
+
+bool VulkanStagingRing::Allocate(uint64_t size, uint64_t alignment, uint64_t& offset)
+{
+	uint64_t position = _head % _size;
+	uint64_t alignedPosition = align_to(alignment, position);
+	uint64_t newHead = _head + (alignedPosition - position) + size;
+	if (alignedPosition + size > _size)
 	{
-		stagingBufferInfo._stagingBuffer = stagingBuffer;
+		// wrap around, the rest of the ring is skipped
+		alignedPosition = 0;
+		newHead = _head + (_size - position) + size;
 	}
+
+	// would overwrite space still in use
+	if (newHead - _tail > _size)
+		return false;
+
+	offset = alignedPosition;
+	_head = newHead;
+
+	return true;
 }
 
 void VulkanMemoryManager::ReleaseStagingMemory(VulkanDeviceMemory& deviceMemory)
@@ -414,6 +1254,41 @@ void VulkanMemoryManager::FlushStagingMemory(VulkanDeviceMemory& deviceMemory)
 	VulkanApi::GetApi()->vkFlushMappedMemoryRanges(_pRenderDevice->GetDeviceHandle(), 1, &stagingRange);
 }
 
+void VulkanMemoryManager::GetMappedRange(const VulkanDeviceMemory& deviceMemory, uint64_t offset, uint64_t size, VkMappedMemoryRange& range)
+{
+	uint64_t start = deviceMemory._offset + offset;
+	uint64_t end = start + size;
+	uint64_t alignedStart = start - (start % _nonCoherentAlignment);
+	uint64_t alignedEnd = align_to(_nonCoherentAlignment, end);
+
+	range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+	range.pNext = nullptr;
+	range.memory = deviceMemory._vkDeviceMemory;
+	range.offset = alignedStart;
+	// the end of the block might not be a multiple of the atom size
+	range.size = (deviceMemory._pBlock && alignedEnd > deviceMemory._pBlock->_allocator.GetSize()) ? VK_WHOLE_SIZE : alignedEnd - alignedStart;
+}
+
+void VulkanMemoryManager::FlushMappedMemory(const VulkanDeviceMemory& deviceMemory, uint64_t offset, uint64_t size)
+{
+	if (!deviceMemory._needsFlush || size == 0)
+		return;
+
+	VkMappedMemoryRange range;
+	GetMappedRange(deviceMemory, offset, size, range);
+	VulkanApi::GetApi()->vkFlushMappedMemoryRanges(_pRenderDevice->GetDeviceHandle(), 1, &range);
+}
+
+void VulkanMemoryManager::InvalidateMappedMemory(const VulkanDeviceMemory& deviceMemory, uint64_t offset, uint64_t size)
+{
+	if (!deviceMemory._needsFlush || size == 0)
+		return;
+
+	VkMappedMemoryRange range;
+	GetMappedRange(deviceMemory, offset, size, range);
+	VulkanApi::GetApi()->vkInvalidateMappedMemoryRanges(_pRenderDevice->GetDeviceHandle(), 1, &range);
+}
+
 uint32_t VulkanMemoryManager::ChooseMemoryType(VkMemoryRequirements& memRequirements, VkMemoryPropertyFlags properties)
 {
 	const VkPhysicalDeviceMemoryProperties& deviceMemProperties = _pPhysicalDevice->GetPhysicalDeviceMemoryProperties();
@@ -430,179 +1305,190 @@ uint32_t VulkanMemoryManager::ChooseMemoryType(VkMemoryRequirements& memRequirem
 	return memoryTypeIndex;
 }
 
-VkBuffer VulkanMemoryManager::FindStagingBuffer(uint64_t size, VulkanDeviceMemory& memoryInfo)
-{
-	// iterate over the pages and find a spot
-	CaveList<VulkanDeviceMemoryPageEntry>::Iterator pageIter = _stagingMemoryPages.begin();
-	for (; pageIter != _stagingMemoryPages.end(); pageIter++)
-	{
-		VkMemoryRequirements reqs;
-		VulkanApi::GetApi()->vkGetBufferMemoryRequirements(_pRenderDevice->GetDeviceHandle(), pageIter->_vkBuffer, &reqs);
-		size_t currentOffset = align_to(reqs.alignment, pageIter->_deviceMemory._offset);
-		if ((currentOffset + size) < pageIter->_deviceMemory._size)
-		{
-			// found a space
-			// Fill in data
-			memoryInfo._offset = currentOffset;
-			memoryInfo._size = size;
-			memoryInfo._vkDeviceMemory = pageIter->_deviceMemory._vkDeviceMemory;
-			memoryInfo._mappedAddress = static_cast<uint8_t*>(pageIter->_deviceMemory._mappedAddress) + currentOffset;
-			// update entries
-			pageIter->_deviceMemory._offset = currentOffset + size;
-
-			return pageIter->_vkBuffer;
-		}
-	}
-
-	// alocate new page
-	if (pageIter == _stagingMemoryPages.end())
-	{
-		uint64_t allocSize = (size < StagingBufferSize) ? StagingBufferSize : size;
-		AllocateStagingPage(allocSize);
-		CaveList<VulkanDeviceMemoryPageEntry>::Iterator last = _stagingMemoryPages.tail();
-		VkMemoryRequirements reqs;
-		VulkanApi::GetApi()->vkGetBufferMemoryRequirements(_pRenderDevice->GetDeviceHandle(), last->_vkBuffer, &reqs);
-		size_t currentOffset = align_to(reqs.alignment, last->_deviceMemory._offset);
-		if ((currentOffset + size) < last->_deviceMemory._size)
-		{
-			// found a space
-			// Fill in data
-			memoryInfo._offset = currentOffset;
-			memoryInfo._size = size;
-			memoryInfo._vkDeviceMemory = last->_deviceMemory._vkDeviceMemory;
-			memoryInfo._mappedAddress = static_cast<uint8_t*>(last->_deviceMemory._mappedAddress) + currentOffset;
-			// update entries
-			last->_deviceMemory._offset = currentOffset + size;
-
-			return last->_vkBuffer;
-		}
-	}
-
-	// no success 
-	return VK_NULL_HANDLE;
-}
-
-void VulkanMemoryManager::AllocateStagingPage(uint64_t pageSize)
+bool VulkanMemoryManager::CreateStagingRing(uint64_t size)
 {
-	// new entry
-	_stagingMemoryPages.PushBack(VulkanDeviceMemoryPageEntry());
-	CaveList<VulkanDeviceMemoryPageEntry>::Iterator last = _stagingMemoryPages.tail();
+	VulkanStagingRing* ring = AllocateObject<VulkanStagingRing>(*_pRenderDevice->GetEngineAllocator());
+	if (!ring)
+		return false;
 
 	// create staging buffer
 	VkBufferCreateInfo stagingCreateInfo = {};
 	stagingCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-	stagingCreateInfo.size = pageSize;
+	stagingCreateInfo.size = size;
 	stagingCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
 	stagingCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
-	if (VulkanApi::GetApi()->vkCreateBuffer(_pRenderDevice->GetDeviceHandle(), &stagingCreateInfo, NULL, &last->_vkBuffer) != VK_SUCCESS)
-		return;
+	if (VulkanApi::GetApi()->vkCreateBuffer(_pRenderDevice->GetDeviceHandle(), &stagingCreateInfo, NULL, &ring->_vkBuffer) != VK_SUCCESS)
+	{
+		ReleaseStagingRing(ring);
+		return false;
+	}
 
-	VulkanDeviceMemory deviceMemory;
 	VkMemoryRequirements memRequirements;
-	VulkanApi::GetApi()->vkGetBufferMemoryRequirements(_pRenderDevice->GetDeviceHandle(), last->_vkBuffer, &memRequirements);
-	AllocateStagingMemory(memRequirements, last->_deviceMemory);
+	VulkanApi::GetApi()->vkGetBufferMemoryRequirements(_pRenderDevice->GetDeviceHandle(), ring->_vkBuffer, &memRequirements);
+	AllocateStagingMemory(memRequirements, ring->_deviceMemory);
+	if (ring->_deviceMemory._mappedAddress == nullptr)
+	{
+		ReleaseStagingRing(ring);
+		return false;
+	}
+
+	VulkanApi::GetApi()->vkBindBufferMemory(_pRenderDevice->GetDeviceHandle(), ring->_vkBuffer, ring->_deviceMemory._vkDeviceMemory, 0);
+	ring->_size = size;
+
+	// the old ring lives on until its copies finished
+	if (_pStagingRing)
+	{
+		if (_pStagingRing->_pendingCount > 0)
+			_retiredStagingRings.push_back(_pStagingRing);
+		else
+			ReleaseStagingRing(_pStagingRing);
+	}
+	_pStagingRing = ring;
 
-	VulkanApi::GetApi()->vkBindBufferMemory(_pRenderDevice->GetDeviceHandle(), last->_vkBuffer, last->_deviceMemory._vkDeviceMemory, 0);
+	return true;
 }
 
-void VulkanMemoryManager::CopyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, uint64_t srcOffset, uint64_t dstOffset, uint64_t size)
+void VulkanMemoryManager::ReleaseStagingRing(VulkanStagingRing* ring)
 {
-	if (_vkCommandPool == VK_NULL_HANDLE || _vkTransferCommandBuffer == VK_NULL_HANDLE)
-		return;
+	ReleaseStagingMemory(ring->_deviceMemory);
+	if (ring->_vkBuffer != VK_NULL_HANDLE)
+		VulkanApi::GetApi()->vkDestroyBuffer(_pRenderDevice->GetDeviceHandle(), ring->_vkBuffer, nullptr);
+
+	DeallocateDelete(*_pRenderDevice->GetEngineAllocator(), *ring);
+}
 
-	if (_copyCount == 0)
+VulkanCopySubmission* VulkanMemoryManager::BeginCopies()
+{
+	if (_pCopySubmission)
+		return _pCopySubmission;
+
+	if (_vkCommandPool == VK_NULL_HANDLE)
+		return nullptr;
+
+	VulkanCopySubmission* submission = nullptr;
+	if (!_freeCopySubmissions.empty())
 	{
-		// If we already submited some copies we need to wait before restart
-		if (_copyWaitCount > 0)
-			WaitForCopies();
+		submission = _freeCopySubmissions.back();
+		_freeCopySubmissions.pop_back();
+	}
+	else
+	{
+		// all submissions in flight, add one. We never wait for the GPU here
+		submission = AllocateObject<VulkanCopySubmission>(*_pRenderDevice->GetEngineAllocator());
+		if (!submission)
+			return nullptr;
 
-		VkCommandBufferBeginInfo beginInfo = {};
-		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		VkCommandBufferAllocateInfo allocInfo = {};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		allocInfo.commandPool = _vkCommandPool;
+		allocInfo.commandBufferCount = 1;
+
+		VkFenceCreateInfo fenceInfo = {};
+		fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+		bool success = VulkanApi::GetApi()->vkAllocateCommandBuffers(_pRenderDevice->GetDeviceHandle(), &allocInfo, &submission->_vkCommandBuffer) == VK_SUCCESS
+			&& VulkanApi::GetApi()->vkCreateFence(_pRenderDevice->GetDeviceHandle(), &fenceInfo, nullptr, &submission->_vkFence) == VK_SUCCESS;
 
-		VulkanApi::GetApi()->vkBeginCommandBuffer(_vkTransferCommandBuffer, &beginInfo);
+		if (success && _vkAcquireCommandPool != VK_NULL_HANDLE)
+		{
+			allocInfo.commandPool = _vkAcquireCommandPool;
+			VkSemaphoreCreateInfo semaphoreInfo = {};
+			semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+			success = VulkanApi::GetApi()->vkAllocateCommandBuffers(_pRenderDevice->GetDeviceHandle(), &allocInfo, &submission->_vkAcquireCommandBuffer) == VK_SUCCESS
+				&& VulkanApi::GetApi()->vkCreateSemaphore(_pRenderDevice->GetDeviceHandle(), &semaphoreInfo, nullptr, &submission->_vkSemaphore) == VK_SUCCESS;
+		}
+
+		if (!success)
+		{
+			if (submission->_vkCommandBuffer != VK_NULL_HANDLE)
+				VulkanApi::GetApi()->vkFreeCommandBuffers(_pRenderDevice->GetDeviceHandle(), _vkCommandPool, 1, &submission->_vkCommandBuffer);
+			if (submission->_vkAcquireCommandBuffer != VK_NULL_HANDLE)
+				VulkanApi::GetApi()->vkFreeCommandBuffers(_pRenderDevice->GetDeviceHandle(), _vkAcquireCommandPool, 1, &submission->_vkAcquireCommandBuffer);
+			if (submission->_vkFence != VK_NULL_HANDLE)
+				VulkanApi::GetApi()->vkDestroyFence(_pRenderDevice->GetDeviceHandle(), submission->_vkFence, nullptr);
+			DeallocateDelete(*_pRenderDevice->GetEngineAllocator(), *submission);
+			return nullptr;
+		}
 	}
 
+	VkCommandBufferBeginInfo beginInfo = {};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+	VulkanApi::GetApi()->vkBeginCommandBuffer(submission->_vkCommandBuffer, &beginInfo);
+	_pCopySubmission = submission;
+
+	return submission;
+}
+
+void VulkanMemoryManager::RecordWriteAfterReadBarrier(VkCommandBuffer commandBuffer)
+{
+	// the copies wait for all earlier work of the queue, no memory barrier needed for reads
+	VulkanApi::GetApi()->vkCmdPipelineBarrier(commandBuffer,
+		VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+		0,
+		0, nullptr, // no memory barriers
+		0, nullptr, // no buffer barriers
+		0, nullptr); // no image barriers
+}
+
+void VulkanMemoryManager::CopyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, uint64_t srcOffset, uint64_t dstOffset, uint64_t size, bool graphicsOwned)
+{
+	VulkanCopySubmission* submission = BeginCopies();
+	if (!submission)
+		return;
+
 	VkBufferCopy copyRegion = {};
 	copyRegion.srcOffset = srcOffset;
 	copyRegion.dstOffset = dstOffset;
 	copyRegion.size = size;
-	VulkanApi::GetApi()->vkCmdCopyBuffer(_vkTransferCommandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
 
-	_copyCount++;
-	_copyWaitCount++;
+	// the transfer queue never owned the buffer and doesn't know when the graphics queue stops reading it
+	if (graphicsOwned && _transferFamilyIndex != _graphicsFamilyIndex)
+	{
+		submission->_graphicsBatcher.AddBufferCopy(srcBuffer, dstBuffer, copyRegion);
+		return;
+	}
+
+	submission->_batcher.AddBufferCopy(srcBuffer, dstBuffer, copyRegion);
+
+	// written range changes queue ownership at submission. Pieces of one update are merged
+	if (_transferFamilyIndex != _graphicsFamilyIndex)
+	{
+		std::vector<VkBufferMemoryBarrier>& bufferBarriers = submission->_bufferBarriers;
+		if (!bufferBarriers.empty() && bufferBarriers.back().buffer == dstBuffer
+			&& bufferBarriers.back().offset + bufferBarriers.back().size == dstOffset)
+		{
+			bufferBarriers.back().size += size;
+		}
+		else
+		{
+			VkBufferMemoryBarrier barrier = {};
+			barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.dstAccessMask = 0;
+			barrier.srcQueueFamilyIndex = _transferFamilyIndex;
+			barrier.dstQueueFamilyIndex = _graphicsFamilyIndex;
+			barrier.buffer = dstBuffer;
+			barrier.offset = dstOffset;
+			barrier.size = size;
+			bufferBarriers.push_back(barrier);
+		}
+	}
 }
 
-void VulkanMemoryManager::CopyBufferToImage(VkBuffer srcBuffer, VkImage dstImage, caveVector<VkBufferImageCopy>& regions)
+void VulkanMemoryManager::CopyBufferToImage(VkBuffer srcBuffer, VkImage dstImage, caveVector<VkBufferImageCopy>& regions, uint32_t levelCount, uint64_t size, bool firstCopy, bool lastCopy, bool graphicsOwned)
 {
-    if (_vkCommandPool == VK_NULL_HANDLE || _vkImageTransferCommandBuffer == VK_NULL_HANDLE)
+    VulkanCopySubmission* submission = BeginCopies();
+    if (!submission)
         return;
 
-    // First copy in frame
-    if (_copyImageCount == 0)
-    {
-        // If we already submited some copies we need to wait before restart
-        if (_copyImageWaitCount > 0)
-            WaitForCopies();
-
-        VkCommandBufferBeginInfo beginInfo = {};
-        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-
-        VulkanApi::GetApi()->vkBeginCommandBuffer(_vkImageTransferCommandBuffer, &beginInfo);
-    }
-
-    // transition for copy
-    VkImageMemoryBarrier barrier = {};
-    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-    barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    barrier.image = dstImage;
-    barrier.subresourceRange.aspectMask = regions[0].imageSubresource.aspectMask;   // the same for all
-    barrier.subresourceRange.baseMipLevel = 0;
-    barrier.subresourceRange.levelCount = static_cast<uint32_t>(regions.Size());
-    barrier.subresourceRange.baseArrayLayer = 0;
-    barrier.subresourceRange.layerCount = 1;
-    barrier.srcAccessMask = 0;
-    barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT; // We are going to write to the texture
-
-    VulkanApi::GetApi()->vkCmdPipelineBarrier(_vkImageTransferCommandBuffer,
-        VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
-        0,
-        0, nullptr, // no memory barriers
-        0, nullptr, // no buffer barriers
-        1, &barrier);
-
-    VulkanApi::GetApi()->vkCmdCopyBufferToImage(_vkImageTransferCommandBuffer, srcBuffer, dstImage,
-        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(regions.Size()), regions.Data());
-
-    // transition for shader usage
-    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-    barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    barrier.image = dstImage;
-    barrier.subresourceRange.aspectMask = regions[0].imageSubresource.aspectMask;   // the same for all
-    barrier.subresourceRange.baseMipLevel = 0;
-    barrier.subresourceRange.levelCount = static_cast<uint32_t>(regions.Size());
-    barrier.subresourceRange.baseArrayLayer = 0;
-    barrier.subresourceRange.layerCount = 1;
-    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT; // Next access is shader reads
-
-    VulkanApi::GetApi()->vkCmdPipelineBarrier(_vkImageTransferCommandBuffer,
-        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
-        0,
-        0, nullptr, // no memory barriers
-        0, nullptr, // no buffer barriers
-        1, &barrier);
-
-    _copyImageCount++;
-    _copyImageWaitCount++;
+    // re-uploads stay on the graphics queue, see CopyBuffer
+    VulkanUploadBatcher& batcher = (graphicsOwned && _transferFamilyIndex != _graphicsFamilyIndex) ? submission->_graphicsBatcher : submission->_batcher;
+    batcher.AddImageCopy(srcBuffer, dstImage, regions.Data(), static_cast<uint32_t>(regions.Size()), levelCount, size, firstCopy, lastCopy);
 }
 
 }
@@ -18,11 +18,17 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SO
 
 #include "halTypes.h"
 #include "osPlatformLib.h"
-#include "Common/caveList.h"
 #include "Common/caveVector.h"
+#include "Memory/allocatorTlsf.h"
+#include "vulkanUploadBatcher.h"
 
 #include "vulkan.h"
 
+#include <deque>
+#include <map>
+#include <mutex>
+#include <vector>
+
 /** \addtogroup backend
 *  @{
 *
@@ -35,6 +41,43 @@ namespace cave
 class VulkanInstance;
 class VulkanPhysicalDevice;
 class VulkanRenderDevice;
+struct VulkanMemoryBlock;
+
+/**
+* Resource bound to sub-allocated device memory which the defragmenter may move.
+* The resource creates a new handle in new memory and keeps the old one until the copy finished.
+*/
+class VulkanMemoryOwner
+{
+public:
+    /** @brief Destructor */
+    virtual ~VulkanMemoryOwner() {}
+
+    /**
+    * @brief Check if the resource may get a new handle.
+    * Handles held by descriptor sets or views must not change.
+    *
+    * @return true if the resource can be moved
+    */
+    virtual bool CanRelocate() const = 0;
+
+    /**
+    * @brief Move the resource out of a block. Creates the new handle, allocates and
+    * binds new memory and records the copy. The old handle and memory stay valid.
+    *
+    * @param[in] commandBuffer	Graphics queue command buffer the copy is recorded to
+    * @param[in] sourceBlock	Block the resource is moved out of
+    *
+    * @return false if the resource can't be moved now
+    */
+    virtual bool Relocate(VkCommandBuffer commandBuffer, VulkanMemoryBlock* sourceBlock) = 0;
+
+    /**
+    * @brief Release the old handle and memory once the copy finished
+    *
+    */
+    virtual void FinishRelocation() = 0;
+};
 
 
 /**
@@ -49,6 +92,8 @@ struct VulkanDeviceMemory
         _memoryTypeIndex = 0;
         _needsFlush = false;
         _mappedAddress = nullptr;
+        _pBlock = nullptr;
+        _allocationHandle = AllocatorTlsf::InvalidHandle;
     }
 
     uint64_t _offset;	///< Memory offset
@@ -57,24 +102,107 @@ struct VulkanDeviceMemory
     VkDeviceMemory _vkDeviceMemory;		///< Vulkan device memory handle
     bool _needsFlush;		///< does this memory need a flush before usage
     void* _mappedAddress;	///< Pointer to virtual memory if mapped
+    VulkanMemoryBlock* _pBlock;	///< Block we are sub-allocated from (nullptr if not sub-allocated)
+    uint32_t _allocationHandle;	///< Allocation handle inside the block
 };
 
 /**
-* Vulkan device memory page allocation
-* This represents a page entry from where
-* we do sub-allocations
+* Vulkan device memory block.
+* Buffers and images are sub-allocated from blocks of the same memory type.
+* Host visible blocks stay mapped for their whole lifetime
 */
-struct VulkanDeviceMemoryPageEntry
+struct VulkanMemoryBlock
 {
-    VulkanDeviceMemoryPageEntry()
+    /**
+    * @brief Constructor
+    *
+    * @param[in] size			Block size in bytes
+    * @param[in] granularity	Device bufferImageGranularity
+    *
+    */
+    VulkanMemoryBlock(uint64_t size, uint64_t granularity)
+        : _vkDeviceMemory(VK_NULL_HANDLE)
+        , _memoryTypeIndex(0)
+        , _index(0)
+        , _mappedAddress(nullptr)
+        , _needsFlush(false)
+        , _allocator(size, granularity)
+    {
+    }
+
+    VkDeviceMemory _vkDeviceMemory;	///< Vulkan device memory handle
+    uint32_t _memoryTypeIndex;	///< type of memory
+    uint32_t _index;	///< Position in the block list of the memory type
+    void* _mappedAddress;	///< Persistent mapping of the block (nullptr if not host visible)
+    bool _needsFlush;	///< Memory is not host coherent
+    AllocatorTlsf _allocator;	///< Sub-allocator for the block range
+    std::map<uint32_t, std::pair<VulkanMemoryOwner*, uint64_t>> _owners;	///< Movable resources and their sizes by allocation handle
+};
+
+/**
+* Host visible staging ring buffer.
+* Space is handed out by bumping the head and given back
+* when the copy submission that used it finished on the GPU
+*/
+struct VulkanStagingRing
+{
+    VulkanStagingRing()
     {
-        _allocationCount = 0;
         _vkBuffer = VK_NULL_HANDLE;
+        _size = 0;
+        _head = _tail = 0;
+        _pendingCount = 0;
     }
 
-    uint64_t _allocationCount;
-    VulkanDeviceMemory _deviceMemory;
-    VkBuffer _vkBuffer;	///< buffer for this page
+    /**
+    * @brief Take space from the head of the ring
+    *
+    * @param[in] size		Requested size in bytes
+    * @param[in] alignment	Required offset alignment (power of two)
+    * @param[out] offset	Offset of the space inside the ring buffer
+    *
+    * @return false if the ring has not enough free space
+    */
+    bool Allocate(uint64_t size, uint64_t alignment, uint64_t& offset);
+
+    VkBuffer _vkBuffer;	///< Ring buffer handle
+    VulkanDeviceMemory _deviceMemory;	///< Mapped memory of the ring
+    uint64_t _size;	///< Ring size in bytes
+    uint64_t _head;	///< Bytes handed out so far (next allocation position modulo the size)
+    uint64_t _tail;	///< Bytes given back so far (everything between tail and head may be in use)
+    uint32_t _pendingCount;	///< Submitted copy batches using the ring
+};
+
+/**
+* Command buffers and sync objects of one batch of copies.
+* With a dedicated transfer queue the copies run there and release the
+* resources to the graphics queue, which acquires them in a second command buffer.
+* Re-uploads of resources the graphics queue already owns are recorded to that
+* second command buffer, so they are ordered after the graphics work using the old content.
+*/
+struct VulkanCopySubmission
+{
+    VulkanCopySubmission()
+    {
+        _vkCommandBuffer = VK_NULL_HANDLE;
+        _vkAcquireCommandBuffer = VK_NULL_HANDLE;
+        _vkSemaphore = VK_NULL_HANDLE;
+        _vkFence = VK_NULL_HANDLE;
+        _pRing = nullptr;
+        _ringHead = 0;
+    }
+
+    VkCommandBuffer _vkCommandBuffer;	///< Vulkan command buffer the copies are recorded to
+    VkCommandBuffer _vkAcquireCommandBuffer;	///< Graphics queue command buffer acquiring the copied resources (transfer queue only)
+    VkSemaphore _vkSemaphore;	///< Signaled by the transfer queue, waited for by the acquire (transfer queue only)
+    VkFence _vkFence;	///< Signaled when the copies (and the acquire) finished
+    std::vector<VkBufferMemoryBarrier> _bufferBarriers;	///< Buffer ranges to hand over to the graphics queue
+    std::vector<VkImageMemoryBarrier> _imageBarriers;	///< Images to hand over to the graphics queue
+    std::vector<VkImageMemoryBarrier> _hostWriteBarriers;	///< Images written by the host, leaving preinitialized layout
+    VulkanUploadBatcher _batcher;	///< Copies collected until submission
+    VulkanUploadBatcher _graphicsBatcher;	///< Re-uploads executed on the graphics queue (transfer queue only)
+    VulkanStagingRing* _pRing;	///< Ring the staging data was taken from
+    uint64_t _ringHead;	///< Ring head at submission time. Reclaimed up to here once the fence signaled
 };
 
 /**
@@ -145,10 +273,16 @@ public:
     /** @brief Destructor */
     virtual ~VulkanMemoryManager();
 
-    static constexpr uint64_t StagingBufferSize = 8388608;	///< 8 MB
+    static constexpr uint64_t StagingBufferSize = 8388608;	///< 8 MB (initial staging ring size)
+    static constexpr uint64_t MaxStagingRingSize = 67108864;	///< 64 MB (the ring grows up to this size, then staging requests wait for finished copies)
+    static constexpr uint64_t StagingChunkSize = 2097152;	///< 2 MB (large uploads are split into pieces of this size)
+    static constexpr uint64_t StagingSubmitSize = 4194304;	///< 4 MB (recorded copies are submitted once they used this much staging space)
+    static constexpr uint64_t MemoryBlockSize = 67108864;	///< 64 MB (heaps smaller than 512 MB use an eighth of the heap)
+    static constexpr uint64_t DirectImageMaxSize = 262144;	///< 256 KB (larger images keep optimal tiling)
 
     /**
-    * @brief Allocate device memory for any buffer usage
+    * @brief Allocate device memory for any buffer usage.
+    * Device local buffers go to host visible device local memory if the upload policy allows it.
     *
     * @param[in] memRequirements	VkMemoryRequirements struct
     * @param[in] properties			VkMemoryPropertyFlags required memory properties
@@ -166,25 +300,131 @@ public:
     void ReleaseBufferMemory(VulkanDeviceMemory& deviceMemory);
 
     /**
-    * @brief Allocate device memory for any image usage
+    * @brief Allocate device memory for an optimal tiled image.
+    * The memory is sub-allocated from a block unless the driver
+    * prefers or requires a dedicated allocation for the image.
+    * Linear images take host visible device local memory if the upload policy allows it.
     *
-    * @param[in] memRequirements	VkMemoryRequirements struct
+    * @param[in] image				VkImage the memory is for
     * @param[in] properties			VkMemoryPropertyFlags required memory properties
+    * @param[in] tiling				Image tiling
     * @param[out] deviceMemory		Filled in VulkanDeviceMemory struct on success
     *
     */
-    void AllocateImageMemory(VkMemoryRequirements& memRequirements, VkMemoryPropertyFlags properties, VulkanDeviceMemory& deviceMemory);
+    void AllocateImageMemory(VkImage image, VkMemoryPropertyFlags properties, VkImageTiling tiling, VulkanDeviceMemory& deviceMemory);
 
     /**
     * @brief Release device memory back to system
     *
-    * @param[in] deviceMemory		VulkanDeviceMemory struct returned on AllocateBufferMemory call
+    * @param[in] deviceMemory		VulkanDeviceMemory struct returned on AllocateImageMemory call
     *
     */
     void ReleaseImageMemory(VulkanDeviceMemory& deviceMemory);
 
     /**
-    * @brief Allocate host visible staging buffer
+    * @brief Query block and dedicated allocation usage per memory heap and block usage per memory type
+    *
+    * @param[out] usage	Filled in HalMemoryUsage struct
+    *
+    */
+    void GetMemoryUsage(HalMemoryUsage& usage);
+
+    /**
+    * @brief Query all used and free ranges of the memory blocks
+    *
+    * @param[out] allocations	Receives one entry per range
+    *
+    */
+    void GetMemoryAllocations(std::vector<HalMemoryAllocation>& allocations);
+
+    /**
+    * @brief Query upload batching statistics
+    *
+    * @param[out] stats	Filled in HalUploadStats struct
+    *
+    */
+    void GetUploadStats(HalUploadStats& stats);
+
+    /**
+    * @brief Set how device local resources are filled. Applies to resources allocated afterwards
+    *
+    * @param[in] policy	Upload policy
+    *
+    */
+    void SetUploadPolicy(HalUploadPolicy policy);
+
+    /**
+    * @brief Query the heap budgets from the driver (VK_EXT_memory_budget).
+    * Without the extension budgets are estimated from the heap sizes and own allocations.
+    *
+    */
+    void UpdateBudget();
+
+    /**
+    * @brief Register the resource owning a sub-allocation so the defragmenter can move it
+    *
+    * @param[in] deviceMemory	Sub-allocated memory
+    * @param[in] owner			Resource bound to the memory
+    *
+    */
+    void SetMemoryOwner(const VulkanDeviceMemory& deviceMemory, VulkanMemoryOwner* owner);
+
+    /**
+    * @brief Allocate memory for a moved resource. Only existing blocks of the
+    * source memory type are used, never the source block itself.
+    *
+    * @param[in] memRequirements	VkMemoryRequirements struct of the new resource
+    * @param[in] kind				Resource kind (used for the granularity check)
+    * @param[in] sourceBlock		Block the resource is moved out of
+    * @param[out] deviceMemory		Filled in VulkanDeviceMemory struct on success
+    *
+    * return true on success
+    */
+    bool AllocateRelocation(VkMemoryRequirements& memRequirements, AllocatorTlsfKind kind, VulkanMemoryBlock* sourceBlock, VulkanDeviceMemory& deviceMemory);
+
+    /**
+    * @brief Move resources out of the least used device local block so it is freed.
+    * Waits for the device, only call it during idle frames. Moved resources get new handles.
+    *
+    * @param[in] maxBytes	Upper limit of bytes to move (at least one resource is moved)
+    *
+    * return number of moved resources
+    */
+    uint32_t Defragment(uint64_t maxBytes);
+
+    /**
+    * @brief Check if an image can be created with linear tiling and written by the host.
+    * Only small single level 2D images sampled by shaders qualify.
+    *
+    * @param[in] createInfo	Image create info with optimal tiling
+    *
+    * return true if linear tiling should be used
+    */
+    bool CanWriteImageDirect(const VkImageCreateInfo& createInfo);
+
+    /**
+    * @brief Count an update written straight to host visible memory
+    *
+    * @param[in] size	Bytes written
+    *
+    */
+    void AddDirectWrite(uint64_t size);
+
+    /**
+    * @brief Move a host written image from preinitialized to shader read layout with the next submission
+    *
+    * @param[in] image		VkImage handle
+    * @param[in] aspectMask	Image aspect
+    *
+    */
+    void TransitionHostWrittenImage(VkImage image, VkImageAspectFlags aspectMask);
+
+    /**
+    * @brief Allocate host visible staging space from the staging ring.
+    * The ring grows if finished copies don't free enough space. Only once it reached
+    * MaxStagingRingSize the oldest copies are waited for, which bounds staging memory.
+    * Requests should not be larger than StagingChunkSize, bigger uploads are split.
+    * The space is valid until the copies recorded with it are submitted and finished.
     *
     * @param[in] size				Required Size
     * @param[out] stagingBufferInfo	Filled in VulkanStagingBuffer struct on success
@@ -192,6 +432,19 @@ public:
     */
     void GetStagingBuffer(uint64_t size, VulkanStagingBufferInfo& stagingBufferInfo);
 
+    /**
+    * @brief Give the staging space of finished copies back to the ring.
+    * Only polls the copy fences, never waits.
+    *
+    */
+    void ReclaimStaging();
+
+    /**
+    * @brief Copy size and usage of the staging ring to the upload statistics
+    *
+    */
+    void UpdateStagingStats();
+
     /**
     * @brief Flush host visible memory
     *
@@ -201,36 +454,69 @@ public:
     void FlushStagingMemory(VulkanDeviceMemory& deviceMemory);
 
     /**
-    * @brief Copy host visible memory to device memory
+    * @brief Make host writes to a range of persistently mapped memory visible to the device.
+    * Does nothing for host coherent memory.
+    *
+    * @param[in] deviceMemory	VulkanDeviceMemory struct returned on AllocateBufferMemory call
+    * @param[in] offset		Offset into the allocation in bytes
+    * @param[in] size		Size of the range in bytes
+    *
+    */
+    void FlushMappedMemory(const VulkanDeviceMemory& deviceMemory, uint64_t offset, uint64_t size);
+
+    /**
+    * @brief Make device writes to a range of persistently mapped memory visible to the host.
+    * Does nothing for host coherent memory.
+    *
+    * @param[in] deviceMemory	VulkanDeviceMemory struct returned on AllocateBufferMemory call
+    * @param[in] offset		Offset into the allocation in bytes
+    * @param[in] size		Size of the range in bytes
+    *
+    */
+    void InvalidateMappedMemory(const VulkanDeviceMemory& deviceMemory, uint64_t offset, uint64_t size);
+
+    /**
+    * @brief Copy host visible memory to device memory.
+    * The copy is recorded on submission, together with all other copies to the same buffer.
     *
     * @param[in] srcBuffer	VkBuffer source handle
     * @param[in] dstBuffer	VkBuffer dest handle
     * @param[in] srcOffset	Source offset in bytes
     * @param[in] dstOffset	Dest offset in bytes
     * @param[in] size		Copy size in bytes
+    * @param[in] graphicsOwned	The buffer was uploaded before and may be in use by the graphics queue
     *
     */
-    void CopyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, uint64_t srcOffset, uint64_t dstOffset, uint64_t size);
+    void CopyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, uint64_t srcOffset, uint64_t dstOffset, uint64_t size, bool graphicsOwned);
 
     /**
-    * @brief Copy buffer memory to image memory
+    * @brief Copy buffer memory to image memory.
+    * An image upload may be split into several copies. The first one moves all levels
+    * to transfer layout, the last one to shader read layout.
+    * The copy is recorded on submission, the pieces of an upload as one command.
     *
     * @param[in] srcBuffer	VkBuffer source handle
-    * @param[in] dstBuffer	VkBuffer dest handle
+    * @param[in] dstImage	VkImage dest handle
     * @param[in] regions	Regions array to copy
+    * @param[in] levelCount	Number of mip levels of the image
+    * @param[in] size		Bytes of staging data the regions read
+    * @param[in] firstCopy	First copy of the upload
+    * @param[in] lastCopy	Last copy of the upload
+    * @param[in] graphicsOwned	The image was uploaded before and may be in use by the graphics queue
     *
     */
-    void CopyBufferToImage(VkBuffer srcBuffer, VkImage dstImage, caveVector<VkBufferImageCopy>& regions);
+    void CopyBufferToImage(VkBuffer srcBuffer, VkImage dstImage, caveVector<VkBufferImageCopy>& regions, uint32_t levelCount, uint64_t size, bool firstCopy, bool lastCopy, bool graphicsOwned);
 
     /**
-    * @brief Submit possibly scheduled copies
-    *
+    * @brief Submit possibly scheduled copies.
+    * Later submissions to the graphics queue see the copied data.
+    * With a dedicated transfer queue only the graphics queue waits for the copies, the CPU never does.
     *
     */
     void SubmitCopies();
 
     /**
-    * @brief Wait for possibly scheduled copies
+    * @brief Submit and wait for all scheduled copies
     *
     *
     */
@@ -249,14 +535,29 @@ public:
 private:
 
     /**
-    * @brief Allocate host visible new page for sub-allocations
-    * Note: We keep always one page arround for temp copies.
-    * On a per frame basis we free temp allocations and remove additional pages
+    * @brief Create a new staging ring and make it the current one.
+    * The previous ring is released once its submitted copies finished.
+    *
+    * @param[in] size	Ring size
+    *
+    * return true on success
+    */
+    bool CreateStagingRing(uint64_t size);
+
+    /**
+    * @brief Destroy a staging ring
     *
-    * @param[in] pageSize	Allocation size
+    * @param[in] ring	Ring to destroy
     *
     */
-    void AllocateStagingPage(uint64_t pageSize);
+    void ReleaseStagingRing(VulkanStagingRing* ring);
+
+    /**
+    * @brief Get the copy submission currently recorded, begin a new one if needed
+    *
+    * return Copy submission or nullptr on failure
+    */
+    VulkanCopySubmission* BeginCopies();
 
     /**
     * @brief Allocate host visible memory for memory copy
@@ -276,31 +577,145 @@ private:
     void ReleaseStagingMemory(VulkanDeviceMemory& deviceMemory);
 
     /**
-    * @brief Find a suitable and available staging buffer
+    * @brief Get the default block size of a memory type
+    *
+    * @param[in] memoryTypeIndex	Memory type
+    *
+    * return block size in bytes
+    */
+    uint64_t GetBlockSize(uint32_t memoryTypeIndex);
+
+    /**
+    * @brief Sub-allocate from the blocks of a memory type. A new block is added if all are full.
+    *
+    * @param[in] memoryTypeIndex	Memory type
+    * @param[in] memRequirements	VkMemoryRequirements struct
+    * @param[in] kind				Resource kind (used for the granularity check)
+    * @param[out] deviceMemory		Filled in VulkanDeviceMemory struct on success
+    * @param[in] checkBudget		Fail instead of adding a block that exceeds the heap budget
+    *
+    * return true on success
+    */
+    bool SubAllocate(uint32_t memoryTypeIndex, VkMemoryRequirements& memRequirements, AllocatorTlsfKind kind, VulkanDeviceMemory& deviceMemory, bool checkBudget);
+
+    /**
+    * @brief Fill in a sub-allocation
+    *
+    * @param[in] block			Block the memory is taken from
+    * @param[in] handle			Allocation handle inside the block
+    * @param[in] offset			Offset inside the block
+    * @param[in] size			Allocation size
+    * @param[out] deviceMemory	Filled in VulkanDeviceMemory struct
+    *
+    */
+    void SetSubAllocation(VulkanMemoryBlock* block, uint32_t handle, uint64_t offset, uint64_t size, VulkanDeviceMemory& deviceMemory);
+
+    /**
+    * @brief Select a memory type outside of device local heaps for allocations that exceed the budget
+    *
+    * @param[in] memRequirements	VkMemoryRequirements struct
+    * @param[in] properties			Memory property requirement
+    *
+    * return index into memory type array (~0u if there is none)
+    */
+    uint32_t ChooseFallbackMemoryType(VkMemoryRequirements& memRequirements, VkMemoryPropertyFlags properties);
+
+    /**
+    * @brief Check if an allocation keeps a heap within its budget. Only device local heaps are limited.
+    * The caller holds _blockMutex.
+    *
+    * @param[in] heapIndex	Memory heap
+    * @param[in] size		Allocation size
+    *
+    * return true if the allocation fits
+    */
+    bool IsWithinBudget(uint32_t heapIndex, uint64_t size);
+
+    /**
+    * @brief Get the current usage of a heap. The caller holds _blockMutex.
+    *
+    * @param[in] heapIndex	Memory heap
+    *
+    * return used bytes
+    */
+    uint64_t GetHeapUsage(uint32_t heapIndex);
+
+    /**
+    * @brief Release a sub-allocation. Empty blocks are freed, except the last one of a memory type.
+    *
+    * @param[in,out] deviceMemory	VulkanDeviceMemory struct returned on SubAllocate
+    *
+    */
+    void SubRelease(VulkanDeviceMemory& deviceMemory);
+
+    /**
+    * @brief Release a block and remove it from the list of its memory type
+    *
+    * @param[in] block	Block to free
+    *
+    */
+    void ReleaseBlock(VulkanMemoryBlock* block);
+
+    /**
+    * @brief Record a barrier ordering the following copies after all earlier work of the queue
+    *
+    * @param[in] commandBuffer	Command buffer to record to
+    *
+    */
+    void RecordWriteAfterReadBarrier(VkCommandBuffer commandBuffer);
+
+    /**
+    * @brief Check if the upload policy allows direct writes to device local memory
+    *
+    * return true if resources should use _directMemoryTypeIndex
+    */
+    bool UseDirectMemory() const;
+
+    /**
+    * @brief Get the nonCoherentAtomSize aligned range of a persistently mapped allocation
     *
-    * @param[in] size			Required buffer size
-    * @param[out] memoryInfo	Returned memory info required
+    * @param[in] deviceMemory	Sub-allocated memory
+    * @param[in] offset			Offset into the allocation in bytes
+    * @param[in] size			Size of the range in bytes
+    * @param[out] range			Filled in VkMappedMemoryRange struct
     *
-    * return Vulkan buffer handle
     */
-    VkBuffer FindStagingBuffer(uint64_t size, VulkanDeviceMemory& memoryInfo);
+    void GetMappedRange(const VulkanDeviceMemory& deviceMemory, uint64_t offset, uint64_t size, VkMappedMemoryRange& range);
 
 private:
     VulkanInstance* _pInstance;	///< Pointer to instance object
     VulkanPhysicalDevice* _pPhysicalDevice;	///< Pointer to physical device
     VulkanRenderDevice* _pRenderDevice;	///< Pointer to logical device
     uint64_t _nonCoherentAlignment;	///< Minimum alignment for non-coherent memory
-    VkCommandPool _vkCommandPool;	///< Vulkan command pool handle
-    VkCommandBuffer _vkTransferCommandBuffer;	///< Vulkan command buffer for data transfers
-    VkCommandBuffer _vkImageTransferCommandBuffer;	///< Vulkan command buffer for image transfers
-    CaveList<VulkanDeviceMemoryPageEntry> _bufferMemoryPages;	///< Memory pages allocated for bufferse
-    VkFence _vkCopyFence;	///< Fence used to wait for submited buffer copies
-    VkFence _vkCopyImageFence;	///< Fence used to wait for submited image copies
-    CaveList<VulkanDeviceMemoryPageEntry> _stagingMemoryPages;	///< Memory pages allocated for staging operations
-    size_t _copyCount;	///< keep track of submitted buffer copies
-    size_t _copyWaitCount;	///< keep track if we need to wait for buffer copies
-    size_t _copyImageCount;	///< keep track of submitted image copies
-    size_t _copyImageWaitCount;	///< keep track if we need to wait for image copies
+    uint64_t _bufferImageGranularity;	///< Page size linear and optimal resources must not share
+    uint64_t _stagingAlignment;	///< Offset alignment of staging allocations
+    uint32_t _graphicsFamilyIndex;	///< Queue familiy using the uploaded resources
+    uint32_t _transferFamilyIndex;	///< Queue familiy copies are submitted to
+    VkCommandPool _vkCommandPool;	///< Vulkan command pool handle (transfer queue familiy)
+    VkCommandPool _vkAcquireCommandPool;	///< Vulkan command pool for ownership acquires (graphics queue familiy, transfer queue only)
+    std::vector<VulkanMemoryBlock*> _memoryBlocks[VK_MAX_MEMORY_TYPES];	///< Memory blocks per memory type
+    std::mutex _blockMutex;	///< Protects the block lists, owners and heap counters
+    uint32_t _dedicatedCount[VK_MAX_MEMORY_HEAPS];	///< Dedicated allocations per heap
+    uint64_t _dedicatedSize[VK_MAX_MEMORY_HEAPS];	///< Dedicated allocation bytes per heap
+    uint64_t _blockSize[VK_MAX_MEMORY_HEAPS];	///< Memory block bytes per heap
+    uint64_t _heapBudget[VK_MAX_MEMORY_HEAPS];	///< Bytes this process may allocate per heap
+    uint64_t _heapUsage[VK_MAX_MEMORY_HEAPS];	///< Driver reported usage per heap at the last budget update
+    uint64_t _budgetAllocated[VK_MAX_MEMORY_HEAPS];	///< Own block and dedicated bytes per heap at the last budget update
+    uint64_t _fallbackCount;	///< Allocations moved to host memory because a device heap was over budget
+    uint64_t _relocationCount;	///< Resources moved by the defragmenter
+    uint64_t _relocatedSize;	///< Bytes moved by the defragmenter
+    VulkanStagingRing* _pStagingRing;	///< Ring new staging space is taken from
+    std::vector<VulkanStagingRing*> _retiredStagingRings;	///< Outgrown rings waiting for their copies to finish
+    VulkanCopySubmission* _pCopySubmission;	///< Copies currently recorded (nullptr if none)
+    uint64_t _recordedStagingSize;	///< Staging space handed out since the last submission
+    std::deque<VulkanCopySubmission*> _pendingCopySubmissions;	///< Submitted copies in submission order
+    std::vector<VulkanCopySubmission*> _freeCopySubmissions;	///< Finished copy submissions ready for reuse
+    HalUploadStats _uploadStats;	///< Upload batching statistics
+    std::mutex _statsMutex;	///< Protects _uploadStats, read from other threads
+    HalUploadPolicy _uploadPolicy;	///< How device local resources are filled
+    uint32_t _directMemoryTypeIndex;	///< Device local host visible memory type (~0u if none)
+    uint64_t _directHeapSize;	///< Size of the heap of _directMemoryTypeIndex
+    bool _directHeapFull;	///< The whole device local heap is host visible (UMA or resizable BAR)
 };
 
 }
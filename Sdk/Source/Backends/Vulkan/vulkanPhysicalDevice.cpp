@@ -101,6 +101,23 @@ void VulkanPhysicalDevice::SetupPhysicalDeviceExtension(HalDeviceExtensions& dev
 	{
 		deviceExtensionsCaps.caps.bits.bGLSLSupport = true;
 	}
+	if (CheckExtensionAvailability(VK_EXT_PIPELINE_CREATION_FEEDBACK_EXTENSION_NAME, deviceExtensions))
+	{
+		deviceExtensionsCaps.caps.bits.bPipelineCreationFeedback = true;
+	}
+	// core in Vulkan 1.1
+	if (_physicalDeviceProperties.apiVersion >= VK_MAKE_VERSION(1, 1, 0)
+		|| (CheckExtensionAvailability(VK_KHR_GET_MEMORY_REQUIREMENTS_2_EXTENSION_NAME, deviceExtensions)
+			&& CheckExtensionAvailability(VK_KHR_DEDICATED_ALLOCATION_EXTENSION_NAME, deviceExtensions)))
+	{
+		deviceExtensionsCaps.caps.bits.bDedicatedAllocation = true;
+	}
+	// budgets are queried with the Vulkan 1.1 memory properties
+	if (_physicalDeviceProperties.apiVersion >= VK_MAKE_VERSION(1, 1, 0) && VulkanApi::GetApi()->vkGetPhysicalDeviceMemoryProperties2
+		&& CheckExtensionAvailability(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME, deviceExtensions))
+	{
+		deviceExtensionsCaps.caps.bits.bMemoryBudget = true;
+	}
 }
 
 void VulkanPhysicalDevice::GetApiVersion(uint32_t& major, uint32_t& minor, uint32_t& patch)
@@ -186,6 +203,31 @@ uint32_t VulkanPhysicalDevice::GetQueueFamilyIndex(VkQueueFlagBits queueBit)
 	return index;
 }
 
+uint32_t VulkanPhysicalDevice::GetTransferQueueFamilyIndex()
+{
+	uint32_t index = (std::numeric_limits<uint32_t>::max)();
+
+	for (uint32_t i = 0; i < _physicalDeviceQueueFamilyCount; ++i)
+	{
+		const VkQueueFamilyProperties& family = _physicalDeviceQueueFamilyArray[i];
+		if (family.queueCount == 0 || !(family.queueFlags & VK_QUEUE_TRANSFER_BIT) || (family.queueFlags & VK_QUEUE_GRAPHICS_BIT))
+			continue;
+
+		// mip tails and image pieces must be copyable
+		if (family.minImageTransferGranularity.width != 1 || family.minImageTransferGranularity.height != 1
+			|| family.minImageTransferGranularity.depth != 1)
+			continue;
+
+		if (!(family.queueFlags & VK_QUEUE_COMPUTE_BIT))
+			return i;
+
+		if (index == (std::numeric_limits<uint32_t>::max)())
+			index = i;
+	}
+
+	return index;
+}
+
 uint32_t VulkanPhysicalDevice::GetPresentationQueueFamilyIndex(uint32_t graphisIndex, VkSurfaceKHR presentationSurface)
 {
 	bool findMatchingQueueIndex = (std::numeric_limits<uint32_t>::max)() != graphisIndex;
@@ -106,6 +106,15 @@ public:
 	*/
 	uint32_t GetQueueFamilyIndex(VkQueueFlagBits queueBit);
 
+	/**
+	* @brief Query a queue familiy dedicated to transfers (no graphics support).
+	*		 Families without compute support are preferred, they usually map to DMA engines.
+	*		 Only families which can copy single texels are taken.
+	*
+	* @return Index of queue familiy or MAX_UINT if there is none
+	*/
+	uint32_t GetTransferQueueFamilyIndex();
+
 	/**
 	* @brief Query queue presentation familiy index.
 	*		 If graphicsIndex != MAX_UINT try to find a queue which matches this index 
@@ -50,10 +50,51 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SO
 
 #include<limits>
 #include<set>
+#include<chrono>
+#include<fstream>
+#include<cstdio>
+#include<cstring>
+#include<string>
+#include<vector>
 
 namespace cave
 {
 
+/// Pipeline cache file identifier "CPLC"
+static const uint32_t g_pipelineCacheMagic = 0x434c5043;
+/// Pipeline cache file version
+static const uint32_t g_pipelineCacheVersion = 1;
+/// Maximum number of stages we collect creation feedback for
+static const uint32_t g_maxFeedbackStages = 8;
+
+/**
+* @brief Header written in front of the driver cache data.
+*		 The driver version is not part of the vulkan cache header, so it is stored here.
+*/
+struct PipelineCacheFileHeader
+{
+	uint32_t _magic;			///< g_pipelineCacheMagic
+	uint32_t _version;			///< g_pipelineCacheVersion
+	uint32_t _vendorID;			///< Vendor of the device which wrote the data
+	uint32_t _deviceID;			///< Device which wrote the data
+	uint32_t _driverVersion;	///< Driver which wrote the data
+	uint32_t _reserved;			///< Must be 0
+	uint64_t _dataSize;			///< Size of the driver data following the header
+	uint64_t _checksum;			///< FNV-1a hash of the driver data
+	uint8_t _pipelineCacheUUID[VK_UUID_SIZE];	///< Pipeline cache UUID of the device
+};
+
+static uint64_t PipelineCacheChecksum(const uint8_t* data, size_t size)
+{
+	uint64_t hash = 0xcbf29ce484222325ull;
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= data[i];
+		hash *= 0x100000001b3ull;
+	}
+	return hash;
+}
+
 VulkanRenderDevice::VulkanRenderDevice(VulkanInstance* instance, VulkanPhysicalDevice* physicalDevice, VkSurfaceKHR surface)
 	: HalRenderDevice(instance)
 	, _pInstance(instance)
@@ -63,12 +104,20 @@ VulkanRenderDevice::VulkanRenderDevice(VulkanInstance* instance, VulkanPhysicalD
 	, _vkDevice(VK_NULL_HANDLE)
 	, _presentQueue(VK_NULL_HANDLE)
 	, _graphicsQueue(VK_NULL_HANDLE)
+	, _transferQueue(VK_NULL_HANDLE)
 	, _pSwapChain(nullptr)
 	, _presentQueueCommandPool(VK_NULL_HANDLE)
 	, _graphicsQueueCommandPool(VK_NULL_HANDLE)
 	, _presentCommandBufferArray(nullptr)
     , _presentRenderPass(nullptr)
 	, _presentationFramebuffers(instance->GetEngineAllocator())
+	, _vkPipelineCache(VK_NULL_HANDLE)
+	, _pipelineCount(0)
+	, _pipelineCacheHits(0)
+	, _pipelineCacheMisses(0)
+	, _pipelineCacheUnknown(0)
+	, _pipelineCreationTime(0)
+	, _pipelineCacheLoadedSize(0)
 {
 	std::set<int> uniqueQueueFamilies;
 	// First query the graphics queue index
@@ -78,6 +127,13 @@ VulkanRenderDevice::VulkanRenderDevice(VulkanInstance* instance, VulkanPhysicalD
 
 	uniqueQueueFamilies.insert(_graphicsQueueFamilyIndex);
 
+	// uploads run on a dedicated transfer queue if there is one
+	_transferQueueFamilyIndex = physicalDevice->GetTransferQueueFamilyIndex();
+	if (_transferQueueFamilyIndex == (std::numeric_limits<uint32_t>::max)())
+		_transferQueueFamilyIndex = _graphicsQueueFamilyIndex;
+
+	uniqueQueueFamilies.insert(_transferQueueFamilyIndex);
+
 	_presentationQueueFamilyIndex = (std::numeric_limits<uint32_t>::max)();
 	if (surface)
 	{
@@ -97,6 +153,25 @@ VulkanRenderDevice::VulkanRenderDevice(VulkanInstance* instance, VulkanPhysicalD
 	{
 		extensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
 	}
+	// lets us tell pipeline cache hits from driver compiles
+	if (_deviceExtensions.caps.bits.bPipelineCreationFeedback)
+	{
+		extensions.push_back(VK_EXT_PIPELINE_CREATION_FEEDBACK_EXTENSION_NAME);
+	}
+	// lets the memory manager ask which images want their own allocation
+	uint32_t major, minor, patch;
+	physicalDevice->GetApiVersion(major, minor, patch);
+	bool dedicatedAllocationKHR = _deviceExtensions.caps.bits.bDedicatedAllocation && VK_MAKE_VERSION(major, minor, patch) < VK_MAKE_VERSION(1, 1, 0);
+	if (dedicatedAllocationKHR)
+	{
+		extensions.push_back(VK_KHR_GET_MEMORY_REQUIREMENTS_2_EXTENSION_NAME);
+		extensions.push_back(VK_KHR_DEDICATED_ALLOCATION_EXTENSION_NAME);
+	}
+	// lets the memory manager keep heaps within the budget of this process
+	if (_deviceExtensions.caps.bits.bMemoryBudget)
+	{
+		extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+	}
 
 	// enable minimum features
 	VkPhysicalDeviceFeatures supportedFeatures = _pPhysicalDevice->GetPhysicalDeviceFeatures();
@@ -138,19 +213,22 @@ VulkanRenderDevice::VulkanRenderDevice(VulkanInstance* instance, VulkanPhysicalD
 		throw BackendException("Failed to create vulkan device");
 	}
 
-	uint32_t major, minor, patch;
-	physicalDevice->GetApiVersion(major, minor, patch);
 	// finally load device level functions
 	if (!VulkanApi::GetApi()->LoadDeviceFunctions(&_vkDevice, VK_MAKE_VERSION(major, minor, patch)))
 	{
 		throw BackendException("Failed to create vulkan device");
 	}
+	if (dedicatedAllocationKHR && !VulkanApi::GetApi()->LoadMemoryRequirements2Functions(&_vkDevice))
+	{
+		_deviceExtensions.caps.bits.bDedicatedAllocation = false;
+	}
 
-	// create device memory manager
-	_pMemoryManager = AllocateObject<VulkanMemoryManager>(*_pInstance->GetEngineAllocator(), instance, physicalDevice, this);
-	if (!_pMemoryManager)
+	// create an empty pipeline cache. LoadPipelineCache merges saved data into it
+	VkPipelineCacheCreateInfo pipelineCacheInfo = {};
+	pipelineCacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+	if (VulkanApi::GetApi()->vkCreatePipelineCache(_vkDevice, &pipelineCacheInfo, nullptr, &_vkPipelineCache) != VK_SUCCESS)
 	{
-		throw BackendException("Failed to create vulkan device");
+		throw BackendException("Failed to create vulkan pipeline cache");
 	}
 
 	// get presentation queue
@@ -160,6 +238,16 @@ VulkanRenderDevice::VulkanRenderDevice(VulkanInstance* instance, VulkanPhysicalD
 	// get graphics queue
 	VulkanApi::GetApi()->vkGetDeviceQueue(_vkDevice, _graphicsQueueFamilyIndex, 0, &_graphicsQueue);
 
+	// get transfer queue
+	VulkanApi::GetApi()->vkGetDeviceQueue(_vkDevice, _transferQueueFamilyIndex, 0, &_transferQueue);
+
+	// create device memory manager. It submits uploads to the queues above
+	_pMemoryManager = AllocateObject<VulkanMemoryManager>(*_pInstance->GetEngineAllocator(), instance, physicalDevice, this);
+	if (!_pMemoryManager)
+	{
+		throw BackendException("Failed to create vulkan device");
+	}
+
 	// Create presentation command pool
 	VkCommandPoolCreateInfo CreateCommandPoolInfo = {};
 	CreateCommandPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
@@ -230,6 +318,9 @@ VulkanRenderDevice::~VulkanRenderDevice()
 		DeallocateDelete(*_pInstance->GetEngineAllocator(), *_pMemoryManager);
 	}
 
+	if (_vkPipelineCache)
+		VulkanApi::GetApi()->vkDestroyPipelineCache(_vkDevice, _vkPipelineCache, nullptr);
+
 	if (_vkDevice)
 	{
 		VulkanApi::GetApi()->vkDestroyDevice(_vkDevice, nullptr);
@@ -628,6 +719,7 @@ static void UpdateDescriptorSetBufferInfo(HalDescriptorBufferInfo** inBufferInfo
 	{
 		VulkanBuffer* buffer = static_cast<VulkanBuffer*>(inBufferInfos[i]->_buffer);
 		outBufferInfos[i]->buffer = buffer->GetBuffer();
+		buffer->SetDescriptorReference();
 		outBufferInfos[i]->offset = inBufferInfos[i]->_offset;
 		outBufferInfos[i]->range = inBufferInfos[i]->_range;
 	}
@@ -1371,8 +1463,12 @@ bool VulkanRenderDevice::PresentQueueSubmit(HalCommandBuffer* commandBuffer)
 	VkResult result = VK_INCOMPLETE;
 	if (_graphicsQueue)
 	{
-		// wait for possible copies
-		_pMemoryManager->WaitForCopies();
+		// copies are submitted ahead of the frame on the same queue, no need to wait for them.
+		// Staging space of copies the GPU already finished goes back to the ring
+		_pMemoryManager->SubmitCopies();
+		_pMemoryManager->ReclaimStaging();
+		// refresh heap budgets once per frame
+		_pMemoryManager->UpdateBudget();
 
 		VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
 		const VkSemaphore waitSemaphore = _pSwapChain->GetImageAvailableSemaphore();
@@ -1429,4 +1525,209 @@ void VulkanRenderDevice::ReadPixels(void* data)
 		_pSwapChain->ReadPixels(_graphicsQueueCommandPool, data);
 }
 
+VkResult VulkanRenderDevice::CreateGraphicsPipeline(const VkGraphicsPipelineCreateInfo& pipelineInfo, VkPipeline* pipeline)
+{
+	VkGraphicsPipelineCreateInfo createInfo = pipelineInfo;
+
+	// ask the driver whether the pipeline came from the cache
+	VkPipelineCreationFeedbackEXT pipelineFeedback = {};
+	VkPipelineCreationFeedbackEXT stageFeedback[g_maxFeedbackStages] = {};
+	VkPipelineCreationFeedbackCreateInfoEXT feedbackInfo = {};
+	if (_deviceExtensions.caps.bits.bPipelineCreationFeedback && createInfo.stageCount <= g_maxFeedbackStages)
+	{
+		feedbackInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CREATION_FEEDBACK_CREATE_INFO_EXT;
+		feedbackInfo.pNext = createInfo.pNext;
+		feedbackInfo.pPipelineCreationFeedback = &pipelineFeedback;
+		feedbackInfo.pipelineStageCreationFeedbackCount = createInfo.stageCount;
+		feedbackInfo.pPipelineStageCreationFeedbacks = stageFeedback;
+		createInfo.pNext = &feedbackInfo;
+	}
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	VkResult result = VulkanApi::GetApi()->vkCreateGraphicsPipelines(_vkDevice, _vkPipelineCache, 1, &createInfo, nullptr, pipeline);
+	std::chrono::steady_clock::duration elapsed = std::chrono::steady_clock::now() - start;
+
+	if (result != VK_SUCCESS)
+		return result;
+
+	_pipelineCount++;
+	_pipelineCreationTime += static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+
+	if (!(pipelineFeedback.flags & VK_PIPELINE_CREATION_FEEDBACK_VALID_BIT_EXT))
+		_pipelineCacheUnknown++;
+	else if (pipelineFeedback.flags & VK_PIPELINE_CREATION_FEEDBACK_APPLICATION_PIPELINE_CACHE_HIT_BIT_EXT)
+		_pipelineCacheHits++;
+	else
+		_pipelineCacheMisses++;
+
+	return result;
+}
+
+bool VulkanRenderDevice::IsPipelineCacheCompatible(const uint8_t* data, size_t size) const
+{
+	// the driver data starts with VkPipelineCacheHeaderVersionOne
+	const size_t headerSize = 16 + VK_UUID_SIZE;
+	if (size < headerSize)
+		return false;
+
+	uint32_t header[4];
+	memcpy(header, data, sizeof(header));
+	if (header[0] < headerSize || header[1] != VK_PIPELINE_CACHE_HEADER_VERSION_ONE)
+		return false;
+
+	const VkPhysicalDeviceProperties& properties = _pPhysicalDevice->GetPhysicalDeviceProperties();
+	if (header[2] != properties.vendorID || header[3] != properties.deviceID)
+		return false;
+
+	return memcmp(data + 16, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+bool VulkanRenderDevice::LoadPipelineCache(const char* path)
+{
+	if (!path || !_vkPipelineCache)
+		return false;
+
+	std::ifstream in(path, std::ios::in | std::ios::binary);
+	if (!in.is_open())
+		return false;
+
+	PipelineCacheFileHeader fileHeader;
+	if (!in.read(reinterpret_cast<char*>(&fileHeader), sizeof(fileHeader)))
+		return false;
+
+	// data from another device or driver is useless and may even crash the driver
+	const VkPhysicalDeviceProperties& properties = _pPhysicalDevice->GetPhysicalDeviceProperties();
+	if (fileHeader._magic != g_pipelineCacheMagic || fileHeader._version != g_pipelineCacheVersion
+		|| fileHeader._vendorID != properties.vendorID || fileHeader._deviceID != properties.deviceID
+		|| fileHeader._driverVersion != properties.driverVersion
+		|| memcmp(fileHeader._pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) != 0)
+		return false;
+
+	std::vector<uint8_t> data(static_cast<size_t>(fileHeader._dataSize));
+	if (data.empty() || !in.read(reinterpret_cast<char*>(&data[0]), data.size()))
+		return false;
+
+	if (PipelineCacheChecksum(&data[0], data.size()) != fileHeader._checksum
+		|| !IsPipelineCacheCompatible(&data[0], data.size()))
+		return false;
+
+	VkPipelineCacheCreateInfo pipelineCacheInfo = {};
+	pipelineCacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+	pipelineCacheInfo.initialDataSize = data.size();
+	pipelineCacheInfo.pInitialData = &data[0];
+
+	VkPipelineCache loadedCache = VK_NULL_HANDLE;
+	if (VulkanApi::GetApi()->vkCreatePipelineCache(_vkDevice, &pipelineCacheInfo, nullptr, &loadedCache) != VK_SUCCESS)
+		return false;
+
+	VkResult result = VulkanApi::GetApi()->vkMergePipelineCaches(_vkDevice, _vkPipelineCache, 1, &loadedCache);
+	VulkanApi::GetApi()->vkDestroyPipelineCache(_vkDevice, loadedCache, nullptr);
+	if (result != VK_SUCCESS)
+		return false;
+
+	_pipelineCacheLoadedSize = data.size();
+
+	return true;
+}
+
+bool VulkanRenderDevice::SavePipelineCache(const char* path)
+{
+	if (!path || !_vkPipelineCache)
+		return false;
+
+	size_t dataSize = 0;
+	if (VulkanApi::GetApi()->vkGetPipelineCacheData(_vkDevice, _vkPipelineCache, &dataSize, nullptr) != VK_SUCCESS || dataSize == 0)
+		return false;
+
+	std::vector<uint8_t> data(dataSize);
+	if (VulkanApi::GetApi()->vkGetPipelineCacheData(_vkDevice, _vkPipelineCache, &dataSize, &data[0]) != VK_SUCCESS)
+		return false;
+	data.resize(dataSize);
+
+	const VkPhysicalDeviceProperties& properties = _pPhysicalDevice->GetPhysicalDeviceProperties();
+	PipelineCacheFileHeader fileHeader = {};
+	fileHeader._magic = g_pipelineCacheMagic;
+	fileHeader._version = g_pipelineCacheVersion;
+	fileHeader._vendorID = properties.vendorID;
+	fileHeader._deviceID = properties.deviceID;
+	fileHeader._driverVersion = properties.driverVersion;
+	fileHeader._dataSize = data.size();
+	fileHeader._checksum = PipelineCacheChecksum(&data[0], data.size());
+	memcpy(fileHeader._pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE);
+
+	// write to a temporary file first so a crash never leaves a partial cache
+	std::string tmpPath(path);
+	tmpPath.append(".tmp");
+
+	{
+		std::ofstream out(tmpPath.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+		if (!out.is_open())
+			return false;
+
+		out.write(reinterpret_cast<const char*>(&fileHeader), sizeof(fileHeader));
+		out.write(reinterpret_cast<const char*>(&data[0]), data.size());
+
+		if (!out.good())
+		{
+			out.close();
+			std::remove(tmpPath.c_str());
+			return false;
+		}
+	}
+
+#ifdef _WIN32
+	// rename does not replace existing files on windows
+	std::remove(path);
+#endif
+	if (std::rename(tmpPath.c_str(), path) != 0)
+	{
+		std::remove(tmpPath.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+void VulkanRenderDevice::GetPipelineCacheStats(HalPipelineCacheStats& stats)
+{
+	stats._pipelineCount = _pipelineCount;
+	stats._hitCount = _pipelineCacheHits;
+	stats._missCount = _pipelineCacheMisses;
+	stats._unknownCount = _pipelineCacheUnknown;
+	stats._creationTime = _pipelineCreationTime;
+	stats._loadedSize = _pipelineCacheLoadedSize;
+}
+
+void VulkanRenderDevice::GetMemoryUsage(HalMemoryUsage& usage)
+{
+	usage = HalMemoryUsage();
+	if (_pMemoryManager)
+		_pMemoryManager->GetMemoryUsage(usage);
+}
+
+void VulkanRenderDevice::GetMemoryAllocations(std::vector<HalMemoryAllocation>& allocations)
+{
+	allocations.clear();
+	if (_pMemoryManager)
+		_pMemoryManager->GetMemoryAllocations(allocations);
+}
+
+void VulkanRenderDevice::GetUploadStats(HalUploadStats& stats)
+{
+	stats = HalUploadStats();
+	if (_pMemoryManager)
+		_pMemoryManager->GetUploadStats(stats);
+}
+
+void VulkanRenderDevice::SetUploadPolicy(HalUploadPolicy policy)
+{
+	if (_pMemoryManager)
+		_pMemoryManager->SetUploadPolicy(policy);
+}
+
+uint32_t VulkanRenderDevice::DefragmentMemory(uint64_t maxBytes)
+{
+	return (_pMemoryManager) ? _pMemoryManager->Defragment(maxBytes) : 0;
+}
+
 }
@@ -22,6 +22,8 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SO
 
 #include "vulkan.h"
 
+#include <atomic>
+
 /** \addtogroup backend 
 *  @{
 *		
@@ -70,6 +72,31 @@ public:
 	*/
 	VulkanMemoryManager* GetMemoryManager() { return _pMemoryManager; }
 
+	/**
+	* @brief Get the extensions enabled on this device
+	*
+	* @return Device extensions
+	*/
+	const HalDeviceExtensions& GetDeviceExtensions() const { return _deviceExtensions; }
+
+	/**
+	* @brief Get the device pipeline cache
+	*
+	* @return Lowlevel vulkan handle
+	*/
+	VkPipelineCache GetPipelineCache() { return _vkPipelineCache; }
+
+	/**
+	* @brief Create a graphics pipeline through the device pipeline cache.
+	*		 Creation time and cache usage are recorded in the pipeline cache statistics.
+	*
+	* @param[in] pipelineInfo	Pipeline create info
+	* @param[out] pipeline		Receives the pipeline handle
+	*
+	* @return vulkan result code
+	*/
+	VkResult CreateGraphicsPipeline(const VkGraphicsPipelineCreateInfo& pipelineInfo, VkPipeline* pipeline);
+
 	/**
 	* @brief Query physical device memory proeprties
 	*
@@ -633,6 +660,26 @@ public:
 		return _presentQueue;
 	}
 
+	/**
+	* @brief Get transfer familiy index. The same as the graphics familiy index
+	*		 if the device has no dedicated transfer queue
+	*
+	* @return transfer familiy index
+	*/
+	const uint32_t GetTransferFamilyIndex() const {
+		return _transferQueueFamilyIndex;
+	}
+
+	/**
+	* @brief Get the queue used for uploads. The graphics queue
+	*		 if the device has no dedicated transfer queue
+	*
+	* @return VkQueue handle
+	*/
+	const VkQueue GetTransferQueue() const {
+		return _transferQueue;
+	}
+
 	/**
 	* @brief Read pixels from the last used swap chain image
 	*		 The returned pixels are always in RGBA format.
@@ -644,7 +691,80 @@ public:
 	*/
 	void ReadPixels(void* data) override;
 
+	/**
+	* @brief Seed the device pipeline cache with data saved by a previous run.
+	*		 Data written by a different device or driver is ignored.
+	*
+	* @param[in] path	Path to the cache file
+	*
+	* @return true if the cache data was used
+	*/
+	bool LoadPipelineCache(const char* path) override;
+
+	/**
+	* @brief Write the device pipeline cache. The file is replaced atomically.
+	*
+	* @param[in] path	Path to the cache file
+	*
+	* @return true if successful
+	*/
+	bool SavePipelineCache(const char* path) override;
+
+	/**
+	* @brief Query pipeline cache statistics
+	*
+	* @param[out] stats	Receives the statistics
+	*/
+	void GetPipelineCacheStats(HalPipelineCacheStats& stats) override;
+
+	/**
+	* @brief Query device memory usage per memory heap and memory type
+	*
+	* @param[out] usage	Receives the usage
+	*/
+	void GetMemoryUsage(HalMemoryUsage& usage) override;
+
+	/**
+	* @brief Query all used and free ranges of the memory blocks
+	*
+	* @param[out] allocations	Receives the ranges in block and address order
+	*/
+	void GetMemoryAllocations(std::vector<HalMemoryAllocation>& allocations) override;
+
+	/**
+	* @brief Query upload batching statistics
+	*
+	* @param[out] stats	Receives the statistics
+	*/
+	void GetUploadStats(HalUploadStats& stats) override;
+
+	/**
+	* @brief Set how device local resources are filled. Applies to resources bound afterwards
+	*
+	* @param[in] policy	Upload policy
+	*/
+	void SetUploadPolicy(HalUploadPolicy policy) override;
+
+	/**
+	* @brief Move resources out of the least used device memory block so it can be freed
+	*
+	* @param[in] maxBytes	Upper limit of bytes to move
+	*
+	* @return number of resources moved
+	*/
+	uint32_t DefragmentMemory(uint64_t maxBytes) override;
+
 private:
+	/**
+	* @brief Check if pipeline cache data was created by this device and driver
+	*
+	* @param[in] data	Cache data as returned by vkGetPipelineCacheData
+	* @param[in] size	Size of the data in bytes
+	*
+	* @return true if the data can be handed to the driver
+	*/
+	bool IsPipelineCacheCompatible(const uint8_t* data, size_t size) const;
+
 	VulkanInstance* _pInstance;	///< Pointer to instance object
 	VulkanPhysicalDevice* _pPhysicalDevice;	///< Pointer to physical device
 	VulkanMemoryManager* _pMemoryManager;	///< Pointer to internal memory manager
@@ -652,6 +772,7 @@ private:
 	VkDevice _vkDevice;	///< Handle to vulkan device
 	VkQueue _presentQueue;	///< Handle to vulkan queue used for presentations
 	VkQueue _graphicsQueue;	///< Handle to vulkan queue used for graphics
+	VkQueue _transferQueue;	///< Handle to vulkan queue used for uploads
 	VulkanSwapChain* _pSwapChain;	///< Handle to a swap chain
 	VkCommandPool _presentQueueCommandPool;	///< Command pool used for presentations
 	VkCommandPool _graphicsQueueCommandPool;	///< Command pool used for rendering
@@ -660,6 +781,14 @@ private:
 	caveVector<VkFramebuffer> _presentationFramebuffers; ///< Array of framebuffers used for presentation
 	uint32_t _presentationQueueFamilyIndex; ///< Index of present queue familiy
 	uint32_t _graphicsQueueFamilyIndex; ///< Index of graphics queue familiy
+	uint32_t _transferQueueFamilyIndex; ///< Index of transfer queue familiy
+	VkPipelineCache _vkPipelineCache;	///< Device pipeline cache used for all pipeline creation
+	std::atomic<uint64_t> _pipelineCount;	///< Number of pipelines created
+	std::atomic<uint64_t> _pipelineCacheHits;	///< Pipelines found in the cache
+	std::atomic<uint64_t> _pipelineCacheMisses;	///< Pipelines compiled by the driver
+	std::atomic<uint64_t> _pipelineCacheUnknown;	///< Pipelines without creation feedback
+	std::atomic<uint64_t> _pipelineCreationTime;	///< Accumulated creation time in nano seconds
+	uint64_t _pipelineCacheLoadedSize;	///< Size of the cache data loaded from disk
 };
 
 }
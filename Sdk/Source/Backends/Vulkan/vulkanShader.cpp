@@ -21,6 +21,7 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SO
 
 #include<limits>
 #include<set>
+#include<cstddef>
 
 namespace cave
 {
@@ -68,6 +69,10 @@ VulkanShader::VulkanShader(VulkanRenderDevice* device, ShaderType type, ShaderLa
 	, _pDevice(device)
 	, _vkShader(VK_NULL_HANDLE)
 {
+	_vkSpecializationInfo.mapEntryCount = 0;
+	_vkSpecializationInfo.pMapEntries = nullptr;
+	_vkSpecializationInfo.dataSize = 0;
+	_vkSpecializationInfo.pData = nullptr;
 }
 
 VulkanShader::~VulkanShader()
@@ -101,6 +106,25 @@ bool VulkanShader::CompileShader(const char* code, size_t count)
 	return true;
 }
 
+void VulkanShader::SetSpecializationConstants(const HalSpecializationConstant* constants, uint32_t count)
+{
+	HalShader::SetSpecializationConstants(constants, count);
+
+	// the constant array is the specialization data, each entry points at the value of one element
+	_vkMapEntries.resize(_specializationConstants.size());
+	for (size_t i = 0; i < _specializationConstants.size(); ++i)
+	{
+		_vkMapEntries[i].constantID = _specializationConstants[i]._constantId;
+		_vkMapEntries[i].offset = static_cast<uint32_t>(i * sizeof(HalSpecializationConstant) + offsetof(HalSpecializationConstant, _value));
+		_vkMapEntries[i].size = sizeof(uint32_t);
+	}
+
+	_vkSpecializationInfo.mapEntryCount = static_cast<uint32_t>(_vkMapEntries.size());
+	_vkSpecializationInfo.pMapEntries = _vkMapEntries.data();
+	_vkSpecializationInfo.dataSize = _specializationConstants.size() * sizeof(HalSpecializationConstant);
+	_vkSpecializationInfo.pData = _specializationConstants.data();
+}
+
 bool VulkanShader::GetShaderStageInfo(VkPipelineShaderStageCreateInfo& info)
 {
 	if (_vkShader == VK_NULL_HANDLE)
@@ -112,7 +136,7 @@ bool VulkanShader::GetShaderStageInfo(VkPipelineShaderStageCreateInfo& info)
 	info.stage = ConvertShaderStageToVulkan(_type);
 	info.module = _vkShader;
 	info.pName = _entryFunc.c_str();
-	info.pSpecializationInfo = nullptr;
+	info.pSpecializationInfo = (_vkMapEntries.empty()) ? nullptr : &_vkSpecializationInfo;
 
 	return true;
 }
@@ -69,6 +69,15 @@ public:
 	*/
 	bool CompileShader(const char* code, size_t count) override;
 
+	/**
+	* @brief Set the specialization constants and build the vulkan specialization info
+	*
+	* @param[in] constants	Constant array (may be nullptr if count is 0)
+	* @param[in] count		Number of constants
+	*
+	*/
+	void SetSpecializationConstants(const HalSpecializationConstant* constants, uint32_t count) override;
+
 	/**
 	* @brief Fill structure with matching values
 	*
@@ -81,6 +90,8 @@ public:
 private:
 	VulkanRenderDevice* _pDevice;	///< Pointer to device object
 	VkShaderModule _vkShader;	///< Handle to vulkan shader module
+	std::vector<VkSpecializationMapEntry> _vkMapEntries;	///< One map entry per specialization constant
+	VkSpecializationInfo _vkSpecializationInfo;	///< Specialization info (data is _specializationConstants)
 };
 
 }
@@ -38,7 +38,6 @@ VulkanSwapChain::VulkanSwapChain(VulkanInstance* instance, VulkanPhysicalDevice*
 	, _swapChainImageFormat(VK_FORMAT_UNDEFINED)
 	, _swapChainDepthImageFormat(VK_FORMAT_UNDEFINED)
 	, _swapChainDepthImage(VK_NULL_HANDLE)
-	, _swapChainDepthImageMemory(VK_NULL_HANDLE)
 	, _swapChainDepthImageView(VK_NULL_HANDLE)
 	, _ImageAvailableSemaphore(VK_NULL_HANDLE)
 	, _RenderingFinishedSemaphore(VK_NULL_HANDLE)
@@ -68,8 +67,8 @@ VulkanSwapChain::~VulkanSwapChain()
 	if (_swapChainDepthImage != VK_NULL_HANDLE)
 		VulkanApi::GetApi()->vkDestroyImage(_pRenderDevice->GetDeviceHandle(), _swapChainDepthImage, nullptr);
 
-	if (_swapChainDepthImageMemory != VK_NULL_HANDLE)
-		VulkanApi::GetApi()->vkFreeMemory(_pRenderDevice->GetDeviceHandle(), _swapChainDepthImageMemory, nullptr);
+	if (_swapChainDepthImageMemory._vkDeviceMemory != VK_NULL_HANDLE)
+		_pRenderDevice->GetMemoryManager()->ReleaseImageMemory(_swapChainDepthImageMemory);
 
 	if (_ImageAvailableSemaphore)
 		VulkanApi::GetApi()->vkDestroySemaphore(_pRenderDevice->GetDeviceHandle(), _ImageAvailableSemaphore, nullptr);
@@ -238,20 +237,10 @@ void VulkanSwapChain::CreateDepthResource(uint32_t depthBits, uint32_t StencilBi
 	if (VulkanApi::GetApi()->vkCreateImage(_pRenderDevice->GetDeviceHandle(), &imageInfo, nullptr, &_swapChainDepthImage) != VK_SUCCESS)
 		throw BackendException("Error creating swapchain depthimage!");
 
-	VkMemoryRequirements memRequirements;
-	VulkanApi::GetApi()->vkGetImageMemoryRequirements(_pRenderDevice->GetDeviceHandle(), _swapChainDepthImage, &memRequirements);
-
 	VulkanMemoryManager* memManager = _pRenderDevice->GetMemoryManager();
+	memManager->AllocateImageMemory(_swapChainDepthImage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VK_IMAGE_TILING_OPTIMAL, _swapChainDepthImageMemory);
 
-	VkMemoryAllocateInfo allocInfo = {};
-	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	allocInfo.allocationSize = memRequirements.size;
-	allocInfo.memoryTypeIndex = memManager->ChooseMemoryType(memRequirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-
-	if (VulkanApi::GetApi()->vkAllocateMemory(_pRenderDevice->GetDeviceHandle(), &allocInfo, nullptr, &_swapChainDepthImageMemory) != VK_SUCCESS)
-		throw BackendException("Error allocating depth image memory!");
-
-	VulkanApi::GetApi()->vkBindImageMemory(_pRenderDevice->GetDeviceHandle(), _swapChainDepthImage, _swapChainDepthImageMemory, 0);
+	VulkanApi::GetApi()->vkBindImageMemory(_pRenderDevice->GetDeviceHandle(), _swapChainDepthImage, _swapChainDepthImageMemory._vkDeviceMemory, _swapChainDepthImageMemory._offset);
 
 	// 3. Create depth image view
 	VkImageViewCreateInfo viewInfo = {};
@@ -572,10 +561,10 @@ void VulkanSwapChain::ReadPixels(VkCommandPool commandPool, void* data)
 
 	VulkanApi::GetApi()->vkFreeCommandBuffers(_pRenderDevice->GetDeviceHandle(), commandPool, 1, &copyCmdBuffer);
 
-	// map buffer
-	const uint8_t* pixels;
+	// host visible memory is mapped persistently
 	uint32_t rowPitch = _swapChainExtent.width * 4;
-	VulkanApi::GetApi()->vkMapMemory(_pRenderDevice->GetDeviceHandle(), destMemory._vkDeviceMemory, 0, VK_WHOLE_SIZE, 0, (void**)&pixels);
+	memManager->InvalidateMappedMemory(destMemory, 0, memRequirements.size);
+	const uint8_t* pixels = static_cast<const uint8_t*>(destMemory._mappedAddress);
 	pixels += memRequirements.size - rowPitch; // we start at last row
 
 	// check for swizzle
@@ -610,7 +599,6 @@ void VulkanSwapChain::ReadPixels(VkCommandPool commandPool, void* data)
 		pixels -= rowPitch; // from bottom to top
 	}
 
-	VulkanApi::GetApi()->vkUnmapMemory(_pRenderDevice->GetDeviceHandle(), destMemory._vkDeviceMemory);
 	VulkanApi::GetApi()->vkDestroyBuffer(_pRenderDevice->GetDeviceHandle(), destBuffer, nullptr);
 	memManager->ReleaseBufferMemory(destMemory);
 }
@@ -255,7 +255,7 @@ private:
 	VkFormat _swapChainImageFormat;	///< The chosen image format
 	VkFormat _swapChainDepthImageFormat;	///< The chosen depth image format
 	VkImage _swapChainDepthImage;	/// swap chain depth image
-	VkDeviceMemory _swapChainDepthImageMemory;	///< swap chain depth image memory
+	VulkanDeviceMemory _swapChainDepthImageMemory;	///< swap chain depth image memory
 	VkImageView _swapChainDepthImageView;	/// swap chain depth image view
 	VkExtent2D _swapChainExtent;	///< The current extend
 	VkSemaphore _ImageAvailableSemaphore; ///< Next image available semaphore
@@ -0,0 +1,258 @@
+/*
+Copyright (c) <2017> <Udo Lugauer>
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE
+*/
+
+/// @file vulkanUploadBatcher.cpp
+///       Collects staging copies and records them with as few commands as possible
+
+#include "vulkanUploadBatcher.h"
+#include "vulkanApi.h"
+
+namespace cave
+{
+
+VulkanUploadBatcher::VulkanUploadBatcher()
+    : _copyCount(0)
+    , _byteCount(0)
+{
+}
+
+void VulkanUploadBatcher::AddBufferCopy(VkBuffer srcBuffer, VkBuffer dstBuffer, const VkBufferCopy& region)
+{
+    _copyCount++;
+    _byteCount += region.size;
+
+    // Regions of one copy command must not overlap. Look at the batches of this destination
+    // back to the last barrier, they are the ones executed without ordering.
+    BufferBatch* target = nullptr;
+    bool overlap = false;
+    for (size_t i = _bufferBatches.size(); i > 0; i--)
+    {
+        BufferBatch& batch = _bufferBatches[i - 1];
+        if (batch._dstBuffer != dstBuffer)
+            continue;
+
+        for (const VkBufferCopy& copy : batch._regions)
+        {
+            if (copy.dstOffset < region.dstOffset + region.size && region.dstOffset < copy.dstOffset + copy.size)
+            {
+                overlap = true;
+                break;
+            }
+        }
+
+        if (overlap)
+            break;
+
+        if (!target && batch._srcBuffer == srcBuffer)
+            target = &batch;
+
+        if (batch._barrier)
+            break;
+    }
+
+    if (target && !overlap)
+    {
+        // continue a contiguous piece or add a region
+        VkBufferCopy& last = target->_regions.back();
+        if (last.srcOffset + last.size == region.srcOffset && last.dstOffset + last.size == region.dstOffset)
+            last.size += region.size;
+        else
+            target->_regions.push_back(region);
+
+        return;
+    }
+
+    _bufferBatches.push_back(BufferBatch());
+    BufferBatch& batch = _bufferBatches.back();
+    batch._srcBuffer = srcBuffer;
+    batch._dstBuffer = dstBuffer;
+    batch._barrier = overlap;
+    batch._regions.push_back(region);
+}
+
+void VulkanUploadBatcher::AddImageCopy(VkBuffer srcBuffer, VkImage dstImage, const VkBufferImageCopy* regions, uint32_t regionCount
+    , uint32_t levelCount, uint64_t size, bool firstCopy, bool lastCopy)
+{
+    if (regionCount == 0)
+        return;
+
+    _copyCount++;
+    _byteCount += size;
+
+    // continue the pieces of an upload still in progress
+    for (size_t i = _imageBatches.size(); i > 0; i--)
+    {
+        ImageBatch& batch = _imageBatches[i - 1];
+        if (batch._dstImage != dstImage)
+            continue;
+
+        if (batch._srcBuffer == srcBuffer && !batch._lastCopy && !firstCopy)
+        {
+            batch._regions.insert(batch._regions.end(), regions, regions + regionCount);
+            batch._lastCopy = lastCopy;
+            return;
+        }
+        break;
+    }
+
+    _imageBatches.push_back(ImageBatch());
+    ImageBatch& batch = _imageBatches.back();
+    batch._srcBuffer = srcBuffer;
+    batch._dstImage = dstImage;
+    batch._aspectMask = regions[0].imageSubresource.aspectMask;   // the same for all
+    batch._levelCount = levelCount;
+    batch._firstCopy = firstCopy;
+    batch._lastCopy = lastCopy;
+    batch._regions.assign(regions, regions + regionCount);
+}
+
+uint32_t VulkanUploadBatcher::Record(VkCommandBuffer commandBuffer, uint32_t srcFamilyIndex, uint32_t dstFamilyIndex
+    , std::vector<VkImageMemoryBarrier>& releaseBarriers)
+{
+    uint32_t commandCount = 0;
+
+    for (BufferBatch& batch : _bufferBatches)
+    {
+        if (batch._barrier)
+        {
+            // order overlapping writes
+            VkMemoryBarrier barrier = {};
+            barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            VulkanApi::GetApi()->vkCmdPipelineBarrier(commandBuffer,
+                VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                0,
+                1, &barrier,
+                0, nullptr, // no buffer barriers
+                0, nullptr); // no image barriers
+        }
+
+        VulkanApi::GetApi()->vkCmdCopyBuffer(commandBuffer, batch._srcBuffer, batch._dstBuffer,
+            static_cast<uint32_t>(batch._regions.size()), batch._regions.data());
+        commandCount++;
+    }
+
+    // images are recorded in runs without repeated images, so every run needs only two barriers
+    size_t begin = 0;
+    for (size_t i = 0; i < _imageBatches.size(); i++)
+    {
+        for (size_t j = begin; j < i; j++)
+        {
+            if (_imageBatches[j]._dstImage == _imageBatches[i]._dstImage)
+            {
+                commandCount += RecordImageBatches(commandBuffer, begin, i, srcFamilyIndex, dstFamilyIndex, releaseBarriers);
+                begin = i;
+                break;
+            }
+        }
+    }
+    commandCount += RecordImageBatches(commandBuffer, begin, _imageBatches.size(), srcFamilyIndex, dstFamilyIndex, releaseBarriers);
+
+    return commandCount;
+}
+
+uint32_t VulkanUploadBatcher::RecordImageBatches(VkCommandBuffer commandBuffer, size_t begin, size_t end
+    , uint32_t srcFamilyIndex, uint32_t dstFamilyIndex, std::vector<VkImageMemoryBarrier>& releaseBarriers)
+{
+    if (begin == end)
+        return 0;
+
+    VkImageMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.subresourceRange.baseMipLevel = 0;
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount = 1;
+
+    // transition for copy
+    _barriers.clear();
+    barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT; // We are going to write to the texture
+    for (size_t i = begin; i < end; i++)
+    {
+        if (!_imageBatches[i]._firstCopy)
+            continue;
+
+        barrier.image = _imageBatches[i]._dstImage;
+        barrier.subresourceRange.aspectMask = _imageBatches[i]._aspectMask;
+        barrier.subresourceRange.levelCount = _imageBatches[i]._levelCount;
+        _barriers.push_back(barrier);
+    }
+
+    if (!_barriers.empty())
+    {
+        VulkanApi::GetApi()->vkCmdPipelineBarrier(commandBuffer,
+            VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+            0,
+            0, nullptr, // no memory barriers
+            0, nullptr, // no buffer barriers
+            static_cast<uint32_t>(_barriers.size()), _barriers.data());
+    }
+
+    for (size_t i = begin; i < end; i++)
+    {
+        ImageBatch& batch = _imageBatches[i];
+        VulkanApi::GetApi()->vkCmdCopyBufferToImage(commandBuffer, batch._srcBuffer, batch._dstImage,
+            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(batch._regions.size()), batch._regions.data());
+    }
+
+    // transition for shader usage. With different queue families this also releases the images,
+    // the destination family does the same transition when it acquires them
+    bool release = (srcFamilyIndex != dstFamilyIndex);
+    _barriers.clear();
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = (release) ? 0 : VK_ACCESS_SHADER_READ_BIT; // Next access is shader reads
+    barrier.srcQueueFamilyIndex = (release) ? srcFamilyIndex : VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = (release) ? dstFamilyIndex : VK_QUEUE_FAMILY_IGNORED;
+    for (size_t i = begin; i < end; i++)
+    {
+        if (!_imageBatches[i]._lastCopy)
+            continue;
+
+        barrier.image = _imageBatches[i]._dstImage;
+        barrier.subresourceRange.aspectMask = _imageBatches[i]._aspectMask;
+        barrier.subresourceRange.levelCount = _imageBatches[i]._levelCount;
+        _barriers.push_back(barrier);
+        if (release)
+            releaseBarriers.push_back(barrier);
+    }
+
+    if (!_barriers.empty())
+    {
+        VulkanApi::GetApi()->vkCmdPipelineBarrier(commandBuffer,
+            VK_PIPELINE_STAGE_TRANSFER_BIT, (release) ? VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT : VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+            0,
+            0, nullptr, // no memory barriers
+            0, nullptr, // no buffer barriers
+            static_cast<uint32_t>(_barriers.size()), _barriers.data());
+    }
+
+    return static_cast<uint32_t>(end - begin);
+}
+
+void VulkanUploadBatcher::Clear()
+{
+    _bufferBatches.clear();
+    _imageBatches.clear();
+    _copyCount = 0;
+    _byteCount = 0;
+}
+
+}
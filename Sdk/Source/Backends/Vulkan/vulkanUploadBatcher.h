@@ -0,0 +1,140 @@
+/*
+Copyright (c) <2017> <Udo Lugauer>
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE
+*/
+#pragma once
+/// @file vulkanUploadBatcher.h
+///       Collects staging copies and records them with as few commands as possible
+
+#include "osPlatformLib.h"
+
+#include "vulkan.h"
+
+#include <vector>
+
+/** \addtogroup backend
+*  @{
+*
+*/
+
+namespace cave
+{
+
+/**
+* @brief Collects the buffer and image copies of one upload submission.
+* Buffer copies are recorded as one vkCmdCopyBuffer per source and destination
+* with all regions, contiguous pieces are merged into one region.
+* Image copies are recorded as one vkCmdCopyBufferToImage per image and their
+* layout transitions are merged into one barrier before and one after the copies.
+*/
+class VulkanUploadBatcher
+{
+public:
+    /** @brief Constructor */
+    VulkanUploadBatcher();
+
+    /**
+    * @brief Add a buffer copy
+    *
+    * @param[in] srcBuffer	VkBuffer source handle
+    * @param[in] dstBuffer	VkBuffer dest handle
+    * @param[in] region		Copy region
+    *
+    */
+    void AddBufferCopy(VkBuffer srcBuffer, VkBuffer dstBuffer, const VkBufferCopy& region);
+
+    /**
+    * @brief Add a buffer to image copy.
+    * An image upload may be split into several copies. The first one moves all levels
+    * to transfer layout, the last one to shader read layout.
+    *
+    * @param[in] srcBuffer		VkBuffer source handle
+    * @param[in] dstImage		VkImage dest handle
+    * @param[in] regions		Regions array to copy
+    * @param[in] regionCount	Number of regions
+    * @param[in] levelCount		Number of mip levels of the image
+    * @param[in] size			Bytes of staging data the regions read
+    * @param[in] firstCopy		First copy of the upload
+    * @param[in] lastCopy		Last copy of the upload
+    *
+    */
+    void AddImageCopy(VkBuffer srcBuffer, VkImage dstImage, const VkBufferImageCopy* regions, uint32_t regionCount
+        , uint32_t levelCount, uint64_t size, bool firstCopy, bool lastCopy);
+
+    /**
+    * @brief Record all collected copies.
+    * If the queue families differ the final image transitions also release the images
+    * to the destination family. These barriers are returned for the matching acquire.
+    *
+    * @param[in] commandBuffer		Command buffer to record to
+    * @param[in] srcFamilyIndex		Queue family the copies are executed on
+    * @param[in] dstFamilyIndex		Queue family using the images
+    * @param[out] releaseBarriers	Receives the image release barriers
+    *
+    * @return number of copy commands recorded
+    */
+    uint32_t Record(VkCommandBuffer commandBuffer, uint32_t srcFamilyIndex, uint32_t dstFamilyIndex
+        , std::vector<VkImageMemoryBarrier>& releaseBarriers);
+
+    /** @brief Forget all collected copies */
+    void Clear();
+
+    /** @brief Number of copies added since the last clear */
+    uint32_t GetCopyCount() const { return _copyCount; }
+
+    /** @brief Bytes of staging data copied by the added copies */
+    uint64_t GetByteCount() const { return _byteCount; }
+
+private:
+    /**
+    * @brief Buffer copies sharing source and destination
+    */
+    struct BufferBatch
+    {
+        VkBuffer _srcBuffer;	///< Source buffer
+        VkBuffer _dstBuffer;	///< Dest buffer
+        bool _barrier;	///< Overwrites a range of an earlier batch, needs a barrier before
+        std::vector<VkBufferCopy> _regions;	///< Copy regions
+    };
+
+    /**
+    * @brief Copies to one image from the same source
+    */
+    struct ImageBatch
+    {
+        VkBuffer _srcBuffer;	///< Source buffer
+        VkImage _dstImage;	///< Dest image
+        VkImageAspectFlags _aspectMask;	///< Image aspect
+        uint32_t _levelCount;	///< Number of mip levels of the image
+        bool _firstCopy;	///< Transition to transfer layout before the copies
+        bool _lastCopy;	///< Transition to shader read layout after the copies
+        std::vector<VkBufferImageCopy> _regions;	///< Copy regions
+    };
+
+    /**
+    * @brief Record image batches [begin, end). None of them uses the same image.
+    *
+    * @return number of copy commands recorded
+    */
+    uint32_t RecordImageBatches(VkCommandBuffer commandBuffer, size_t begin, size_t end
+        , uint32_t srcFamilyIndex, uint32_t dstFamilyIndex, std::vector<VkImageMemoryBarrier>& releaseBarriers);
+
+    std::vector<BufferBatch> _bufferBatches;	///< Buffer copies in submission order
+    std::vector<ImageBatch> _imageBatches;	///< Image copies in submission order
+    std::vector<VkImageMemoryBarrier> _barriers;	///< Scratch space for merged barriers
+    uint32_t _copyCount;	///< Copies added
+    uint64_t _byteCount;	///< Bytes added
+};
+
+}
+
+/** @}*/
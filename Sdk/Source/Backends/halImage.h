@@ -22,6 +22,7 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SO
 
 #include <iostream>		// includes exception handling
 #include <memory>
+#include <functional>
 
 /** \addtogroup backend
 *  @{
@@ -34,6 +35,10 @@ namespace cave
 ///< forwards
 class HalRenderDevice;
 
+/// Writes a byte range of the image data into mapped staging memory. Receives the destination,
+/// the offset of the range inside the data and its size in bytes, returns false on failure
+typedef std::function<bool(void* pDst, uint64_t offset, uint64_t size)> HalImageWriteFunction;
+
 /**
 * @brief Abstraction of device images
 */
@@ -65,6 +70,18 @@ public:
 	*/
 	virtual void Update(const void* pData) = 0;
 
+	/**
+	* @brief Copy data to device memory. The caller writes the data straight
+	*		 into staging memory, no intermediate host copy is required.
+	*		 The data layout is the same as for Update. Large images are uploaded
+	*		 in pieces, so writeFunc must be able to write any range of the data.
+	*
+	* @param[in] writeFunc	Called with the mapped staging memory of every piece, in data order
+	*
+	* @return false if no staging memory was available or writeFunc failed
+	*/
+	virtual bool UpdateStaging(const HalImageWriteFunction& writeFunc) = 0;
+
     /**
     * @brief Query image format
     *
@@ -45,6 +45,7 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SO
 
 #include <iostream>		// includes exception handling
 #include <memory>
+#include <vector>
 
 /** \addtogroup backend
 *  @{
@@ -612,6 +613,69 @@ public:
 	*/
 	virtual void ReadPixels(void* data) = 0;
 
+	/**
+	* @brief Seed the device pipeline cache with data saved by a previous run.
+	*		 Data written by a different device or driver is ignored.
+	*
+	* @param[in] path	Path to the cache file
+	*
+	* @return true if the cache data was used
+	*/
+	virtual bool LoadPipelineCache(const char* path) = 0;
+
+	/**
+	* @brief Write the device pipeline cache. The file is replaced atomically.
+	*
+	* @param[in] path	Path to the cache file
+	*
+	* @return true if successful
+	*/
+	virtual bool SavePipelineCache(const char* path) = 0;
+
+	/**
+	* @brief Query pipeline cache statistics
+	*
+	* @param[out] stats	Receives the statistics
+	*/
+	virtual void GetPipelineCacheStats(HalPipelineCacheStats& stats) = 0;
+
+	/**
+	* @brief Query device memory usage per memory heap and memory type
+	*
+	* @param[out] usage	Receives the usage
+	*/
+	virtual void GetMemoryUsage(HalMemoryUsage& usage) = 0;
+
+	/**
+	* @brief Query all used and free ranges of the memory blocks
+	*
+	* @param[out] allocations	Receives the ranges in block and address order
+	*/
+	virtual void GetMemoryAllocations(std::vector<HalMemoryAllocation>& allocations) = 0;
+
+	/**
+	* @brief Query upload batching statistics
+	*
+	* @param[out] stats	Receives the statistics
+	*/
+	virtual void GetUploadStats(HalUploadStats& stats) = 0;
+
+	/**
+	* @brief Set how device local resources are filled. Applies to resources bound afterwards
+	*
+	* @param[in] policy	Upload policy
+	*/
+	virtual void SetUploadPolicy(HalUploadPolicy policy) = 0;
+
+	/**
+	* @brief Move resources out of the least used device memory block so it can be freed
+	*
+	* @param[in] maxBytes	Upper limit of bytes to move
+	*
+	* @return number of resources moved
+	*/
+	virtual uint32_t DefragmentMemory(uint64_t maxBytes) = 0;
+
 private:
 	HalInstance* _pInstance;	///< Pointer to instance object
 
@@ -71,4 +71,12 @@ void HalShader::SetShaderEntryFunc(const char* funcName)
 	_entryFunc = funcName;
 }
 
+void HalShader::SetSpecializationConstants(const HalSpecializationConstant* constants, uint32_t count)
+{
+	if (constants && count)
+		_specializationConstants.assign(constants, constants + count);
+	else
+		_specializationConstants.clear();
+}
+
 }
@@ -20,6 +20,8 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SO
 #include "Memory/allocatorBase.h"
 
 #include <memory>
+#include <string>
+#include <vector>
 
 /** \addtogroup backend
 *  @{
@@ -54,6 +56,15 @@ enum class ShaderLanguage
 	Unknown
 };
 
+/**
+* @brief Specialization constant of a shader stage
+*/
+struct HalSpecializationConstant
+{
+	uint32_t _constantId;	///< Constant id as declared in the shader (constant_id)
+	uint32_t _value;		///< 32 bit value. Bit pattern of an int, uint, float or bool (0 or 1)
+};
+
 /**
 * Abstraction type of a device shader
 */
@@ -99,6 +110,16 @@ public:
 	*/
 	virtual void SetShaderEntryFunc(const char* funcName);
 
+	/**
+	* @brief Set the specialization constants used when the shader is bound to a pipeline.
+	*		 Replaces previously set constants.
+	*
+	* @param[in] constants	Constant array (may be nullptr if count is 0)
+	* @param[in] count		Number of constants
+	*
+	*/
+	virtual void SetSpecializationConstants(const HalSpecializationConstant* constants, uint32_t count);
+
 	/**
 	* @brief[in] Compile a shader and create a shader module
 	*
@@ -113,6 +134,7 @@ protected:
 	ShaderType _type;				///< Shader type
 	ShaderLanguage _language;		///< Shader language
 	std::string _entryFunc;			///< Name of shader module entry func
+	std::vector<HalSpecializationConstant> _specializationConstants;	///< Specialization constants
 };
 
 }
@@ -30,6 +30,8 @@ namespace cave
 
 #define HAL_SUBPASS_EXTERNAL            (~0U)	///< Special value for subpass before or after present
 #define HAL_WHOLE_SIZE					(~0ULL)	///< Special value for memory size
+#define HAL_MAX_MEMORY_HEAPS			16		///< Maximum number of device memory heaps reported
+#define HAL_MAX_MEMORY_TYPES			32		///< Maximum number of device memory types reported
 
 // forward
 class HalSampler;
@@ -89,6 +91,16 @@ enum class HalImageFormat
 	BC7Srgb = 146,
 };
 
+/**
+* @brief How resources in device local memory are filled
+*/
+enum class HalUploadPolicy
+{
+	Staging = 0,	///< Always upload through staging copies
+	Auto = 1,		///< Write directly if the whole device local heap is host visible (UMA, resizable BAR)
+	Direct = 2		///< Write directly whenever device local host visible memory exists (also a small BAR window)
+};
+
 /**
 * @brief A strongly typed enum class representing image type
 */
@@ -744,6 +756,9 @@ struct CAVE_INTERFACE HalDeviceExtensions
 		struct {
 			bool bSwapChainSupport : 1;		///< swap chain support
 			bool bGLSLSupport : 1;			///< GLSL shader supported (Vulkan only)
+			bool bPipelineCreationFeedback : 1;	///< Pipeline creation reports pipeline cache hits (Vulkan only)
+			bool bDedicatedAllocation : 1;	///< Driver reports when a resource wants its own allocation (Vulkan only)
+			bool bMemoryBudget : 1;			///< Driver reports memory heap budgets (Vulkan only)
 		} bits;
 
 		uint32_t u32Values;
@@ -766,6 +781,139 @@ struct CAVE_INTERFACE HalDeviceFeatures
 	} caps;	///< combiend value
 };
 
+/**
+* @brief Pipeline cache statistics
+*/
+struct CAVE_INTERFACE HalPipelineCacheStats
+{
+	uint64_t _pipelineCount;	///< Number of pipelines created
+	uint64_t _hitCount;			///< Pipelines found in the pipeline cache
+	uint64_t _missCount;		///< Pipelines compiled by the driver
+	uint64_t _unknownCount;		///< Pipelines the driver did not report cache usage for
+	uint64_t _creationTime;		///< Accumulated pipeline creation time in nano seconds
+	uint64_t _loadedSize;		///< Size of the cache data loaded at startup in bytes (0 if none was loaded)
+
+	HalPipelineCacheStats()
+		: _pipelineCount(0), _hitCount(0), _missCount(0), _unknownCount(0), _creationTime(0), _loadedSize(0)
+	{
+	}
+};
+
+/**
+* @brief Device memory usage of one memory heap
+*/
+struct CAVE_INTERFACE HalMemoryHeapUsage
+{
+	uint64_t _heapSize;			///< Size of the heap in bytes
+	bool _deviceLocal;			///< Heap is device local memory
+	uint32_t _blockCount;		///< Number of memory blocks resources are sub-allocated from
+	uint64_t _blockSize;		///< Bytes allocated for memory blocks
+	uint64_t _usedSize;			///< Bytes of the blocks used by sub-allocations
+	uint32_t _allocationCount;	///< Number of sub-allocations
+	uint32_t _dedicatedCount;	///< Number of resources with their own allocation
+	uint64_t _dedicatedSize;	///< Bytes allocated for resources with their own allocation
+	uint64_t _budget;			///< Bytes the process may allocate from the heap (driver reported or an estimate)
+	uint64_t _usage;			///< Bytes the process allocated from the heap (driver reported or own allocations)
+
+	HalMemoryHeapUsage()
+		: _heapSize(0), _deviceLocal(false), _blockCount(0), _blockSize(0), _usedSize(0)
+		, _allocationCount(0), _dedicatedCount(0), _dedicatedSize(0), _budget(0), _usage(0)
+	{
+	}
+};
+
+/**
+* @brief Sub-allocation usage of one memory type
+*/
+struct CAVE_INTERFACE HalMemoryTypeUsage
+{
+	uint32_t _heapIndex;		///< Heap the type allocates from
+	bool _deviceLocal;			///< Memory is device local
+	bool _hostVisible;			///< Memory is host visible (blocks are mapped)
+	bool _hostCoherent;			///< Memory is host coherent
+	uint32_t _blockCount;		///< Number of memory blocks
+	uint64_t _blockSize;		///< Bytes allocated for memory blocks
+	uint64_t _usedSize;			///< Bytes of the blocks used by sub-allocations
+	uint32_t _allocationCount;	///< Number of sub-allocations
+	uint32_t _freeRangeCount;	///< Number of free ranges in all blocks
+	uint64_t _largestFreeRange;	///< Largest free range of any block (largest allocation that fits without a new block)
+	float _fragmentation;		///< Free bytes outside the largest free range of their block relative to all free bytes (0 = not fragmented)
+
+	HalMemoryTypeUsage()
+		: _heapIndex(0), _deviceLocal(false), _hostVisible(false), _hostCoherent(false), _blockCount(0), _blockSize(0)
+		, _usedSize(0), _allocationCount(0), _freeRangeCount(0), _largestFreeRange(0), _fragmentation(0.0f)
+	{
+	}
+};
+
+/**
+* @brief Device memory usage of all memory heaps and types
+*/
+struct CAVE_INTERFACE HalMemoryUsage
+{
+	uint32_t _heapCount;							///< Number of valid heap entries
+	HalMemoryHeapUsage _heaps[HAL_MAX_MEMORY_HEAPS];	///< Usage per heap
+	uint32_t _typeCount;							///< Number of valid memory type entries
+	HalMemoryTypeUsage _types[HAL_MAX_MEMORY_TYPES];	///< Usage per memory type
+	bool _driverBudget;								///< Budgets are reported by the driver
+	uint64_t _fallbackCount;						///< Allocations placed in host memory because a device heap was over budget
+	uint64_t _relocationCount;						///< Resources moved by the defragmenter
+	uint64_t _relocatedSize;						///< Bytes moved by the defragmenter
+
+	HalMemoryUsage()
+		: _heapCount(0), _typeCount(0), _driverBudget(false), _fallbackCount(0), _relocationCount(0), _relocatedSize(0)
+	{
+	}
+};
+
+/**
+* @brief Used or free range of a memory block, an entry of the per allocation memory map
+*/
+struct CAVE_INTERFACE HalMemoryAllocation
+{
+	uint32_t _memoryType;	///< Memory type of the block
+	uint32_t _block;		///< Block index within the memory type
+	uint64_t _offset;		///< Offset in the block
+	uint64_t _size;			///< Size in bytes
+	bool _free;				///< Range is free
+	bool _image;			///< Range holds an optimal tiled image (otherwise a buffer or linear image)
+	bool _movable;			///< The defragmenter may move the resource
+
+	HalMemoryAllocation()
+		: _memoryType(0), _block(0), _offset(0), _size(0), _free(true), _image(false), _movable(false)
+	{
+	}
+};
+
+/**
+* @brief Upload batching statistics accumulated since device creation.
+*		 Commands saved is _copyCount - _commandCount, bytes per submit is _byteCount / _submitCount.
+*		 Writes to host visible memory bypass staging and are counted separately.
+*/
+struct CAVE_INTERFACE HalUploadStats
+{
+	uint64_t _submitCount;		///< Number of upload submissions
+	uint64_t _copyCount;		///< Buffer and image copies requested
+	uint64_t _commandCount;		///< Copy commands recorded for them
+	uint64_t _byteCount;		///< Bytes uploaded through staging
+	uint64_t _lastSubmitSize;	///< Bytes uploaded by the last submission
+	uint64_t _directWriteCount;	///< Buffer and image updates written directly
+	uint64_t _directByteCount;	///< Bytes written directly
+	uint64_t _directMemorySize;	///< Size of the heap direct writes go to (0 if the policy does not allow direct writes)
+	uint64_t _stagingSize;		///< Size of the current staging ring
+	uint64_t _stagingUsedSize;	///< Staging bytes in use by copies not finished yet
+	uint64_t _stagingHighWater;	///< Most staging bytes in use at once
+	uint64_t _stagingWaitCount;	///< Staging requests that waited for copies because the ring reached its limit
+	uint64_t _copyWaitCount;	///< Explicit waits for all outstanding copies
+
+	HalUploadStats()
+		: _submitCount(0), _copyCount(0), _commandCount(0), _byteCount(0), _lastSubmitSize(0)
+		, _directWriteCount(0), _directByteCount(0), _directMemorySize(0)
+		, _stagingSize(0), _stagingUsedSize(0), _stagingHighWater(0), _stagingWaitCount(0), _copyWaitCount(0)
+	{
+	}
+};
+
 /**
 * @brief Rasterizer state setup
 */
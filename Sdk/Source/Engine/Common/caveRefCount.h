@@ -78,10 +78,11 @@ public:
 	*/
 	void Relase()
 	{
+		// take the value under the lock, another thread may release concurrently
 		_refCountMutex.lock();
-		_refCount--;
+		int32_t refCount = --_refCount;
 		_refCountMutex.unlock();
-		if (_refCount == 0 && _pAllocator)
+		if (refCount == 0 && _pAllocator)
 		{ 
 			DeallocateDelete(*_pAllocator, *(CaveRefCount *)this);
 		}
@@ -0,0 +1,522 @@
+/*
+Copyright (c) <2017> <Udo Lugauer>
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE
+*/
+
+/// @file jobSystem.cpp
+///       Work stealing job scheduler
+
+#include "jobSystem.h"
+
+#include <cassert>
+#include <algorithm>
+
+namespace cave
+{
+
+/// Job system the calling worker thread belongs to. Only set on worker threads,
+/// they run for exactly one job system. Owner threads are recognized by their id
+static thread_local JobSystem* tlsJobSystem = nullptr;
+/// Index of the calling worker thread inside tlsJobSystem
+static thread_local int32_t tlsThreadIndex = -1;
+/// Victim selection state for foreign threads
+static thread_local uint32_t tlsRandom = 0x9E3779B9;
+
+/// Empty polls before a worker goes to sleep
+static const uint32_t JobSpinCount = 64;
+
+/**
+* @brief xorshift random number
+*/
+static inline uint32_t NextRandom(uint32_t& state)
+{
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+	return state;
+}
+
+//-----------------------------------------------------------------------------
+// JobCounter
+//-----------------------------------------------------------------------------
+
+void JobCounter::Decrement()
+{
+	int32_t value = _value.load(std::memory_order_acquire);
+	while (value > 1)
+	{
+		if (_value.compare_exchange_weak(value, value - 1, std::memory_order_acq_rel, std::memory_order_acquire))
+			return;
+	}
+
+	// The last decrement happens under the lock. Wait takes the lock before it returns,
+	// so the counter may be destroyed once Wait returned
+	Job* jobs = nullptr;
+	JobSystem* jobSystem = nullptr;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		// incremented again in the meantime, the next decrement releases the jobs
+		if (_value.fetch_sub(1, std::memory_order_acq_rel) != 1)
+			return;
+
+		jobs = _waitingJobs;
+		_waitingJobs = nullptr;
+		jobSystem = _pJobSystem;
+	}
+
+	if (jobSystem)
+		jobSystem->ReleaseWaitingJobs(jobs);
+}
+
+bool JobCounter::AddWaitingJob(Job* job, JobSystem* jobSystem)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	if (_value.load(std::memory_order_acquire) == 0)
+		return false;
+
+	job->_next = _waitingJobs;
+	_waitingJobs = job;
+	_pJobSystem = jobSystem;
+
+	return true;
+}
+
+void JobCounter::SetJobSystem(JobSystem* jobSystem)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	_pJobSystem = jobSystem;
+}
+
+//-----------------------------------------------------------------------------
+// JobDeque
+//-----------------------------------------------------------------------------
+
+JobDeque::JobDeque()
+	: _top(0)
+	, _bottom(0)
+{
+	for (int64_t i = 0; i < Capacity; ++i)
+		_buffer[i].store(nullptr, std::memory_order_relaxed);
+}
+
+bool JobDeque::Push(Job* job)
+{
+	int64_t b = _bottom.load(std::memory_order_relaxed);
+	int64_t t = _top.load(std::memory_order_acquire);
+	if (b - t >= Capacity)
+		return false;
+
+	_buffer[b & (Capacity - 1)].store(job, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	_bottom.store(b + 1, std::memory_order_relaxed);
+
+	return true;
+}
+
+Job* JobDeque::Pop()
+{
+	int64_t b = _bottom.load(std::memory_order_relaxed) - 1;
+	_bottom.store(b, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	int64_t t = _top.load(std::memory_order_relaxed);
+
+	if (t > b)
+	{
+		// empty
+		_bottom.store(b + 1, std::memory_order_relaxed);
+		return nullptr;
+	}
+
+	Job* job = _buffer[b & (Capacity - 1)].load(std::memory_order_relaxed);
+	if (t == b)
+	{
+		// last element. Race against stealers
+		if (!_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+			job = nullptr;
+		_bottom.store(b + 1, std::memory_order_relaxed);
+	}
+
+	return job;
+}
+
+Job* JobDeque::Steal()
+{
+	int64_t t = _top.load(std::memory_order_acquire);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	int64_t b = _bottom.load(std::memory_order_acquire);
+
+	if (t >= b)
+		return nullptr;
+
+	Job* job = _buffer[t & (Capacity - 1)].load(std::memory_order_relaxed);
+	if (!_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+		return nullptr;
+
+	return job;
+}
+
+int64_t JobDeque::Size() const
+{
+	int64_t b = _bottom.load(std::memory_order_relaxed);
+	int64_t t = _top.load(std::memory_order_relaxed);
+	return (b > t) ? b - t : 0;
+}
+
+//-----------------------------------------------------------------------------
+// JobSystem
+//-----------------------------------------------------------------------------
+
+JobSystem::JobSystem(std::shared_ptr<AllocatorBase> allocator, uint32_t workerCount)
+	: _pAllocator(allocator)
+	, _workers(allocator)
+	, _workerData(nullptr)
+	, _workerDataCount(0)
+	, _ownerThread(std::this_thread::get_id())
+	, _globalQueueSize(0)
+	, _pendingJobs(0)
+	, _queuedJobs(0)
+	, _sleepingWorkers(0)
+	, _quit(false)
+	, _executedJobs(0)
+	, _stolenJobs(0)
+{
+	if (workerCount == 0)
+	{
+		uint32_t hardwareThreads = std::thread::hardware_concurrency();
+		workerCount = (hardwareThreads > 1) ? hardwareThreads - 1 : 1;
+	}
+
+	// index 0 belongs to the thread creating the job system
+	_workerDataCount = workerCount + 1;
+	_workerData = AllocateArray<WorkerData>(*_pAllocator, _workerDataCount);
+	for (uint32_t i = 0; i < _workerDataCount; ++i)
+	{
+		_workerData[i]._jobPool = AllocateArray<Job>(*_pAllocator, JobPoolSize);
+		_workerData[i]._nextJob = 0;
+		_workerData[i]._random = 0x9E3779B9 ^ (i * 0x85EBCA6B + 1);
+	}
+
+	_workers.Reserve(workerCount);
+	for (uint32_t i = 0; i < workerCount; ++i)
+		_workers.Push(new std::thread(&JobSystem::WorkerThread, this, static_cast<int32_t>(i + 1)));
+}
+
+JobSystem::~JobSystem()
+{
+	// finish outstanding work
+	int32_t threadIndex = GetCurrentThreadIndex();
+	while (_pendingJobs.load() > 0)
+	{
+		if (!RunOneJob(threadIndex))
+			std::this_thread::yield();
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(_sleepMutex);
+		_quit.store(true);
+	}
+	_sleepCondition.notify_all();
+
+	for (size_t i = 0; i < _workers.Size(); ++i)
+	{
+		_workers[i]->join();
+		delete _workers[i];
+	}
+	_workers.Clear();
+
+	for (uint32_t i = 0; i < _workerDataCount; ++i)
+		DeallocateArray<Job>(*_pAllocator, _workerData[i]._jobPool);
+	DeallocateArray<WorkerData>(*_pAllocator, _workerData);
+}
+
+int32_t JobSystem::GetCurrentThreadIndex() const
+{
+	// several job systems may share the owner thread, each one knows its own
+	if (tlsJobSystem == this)
+		return tlsThreadIndex;
+
+	return (std::this_thread::get_id() == _ownerThread) ? 0 : -1;
+}
+
+Job* JobSystem::AllocateJob(int32_t threadIndex)
+{
+	if (threadIndex >= 0)
+	{
+		WorkerData& data = _workerData[threadIndex];
+		Job* job = &data._jobPool[data._nextJob % JobPoolSize];
+		if (!job->_inUse.load(std::memory_order_acquire))
+		{
+			data._nextJob++;
+			job->_inUse.store(true, std::memory_order_relaxed);
+			job->_pooled = true;
+			return job;
+		}
+	}
+
+	// foreign thread or pool exhausted
+	Job* job = AllocateObject<Job>(*_pAllocator);
+	job->_pooled = false;
+	return job;
+}
+
+void JobSystem::FreeJob(Job* job)
+{
+	job->_task = nullptr;
+	job->_counter = nullptr;
+	job->_dependency = nullptr;
+	job->_next = nullptr;
+
+	if (job->_pooled)
+		job->_inUse.store(false, std::memory_order_release);
+	else
+		DeallocateDelete(*_pAllocator, *job);
+}
+
+void JobSystem::PushGlobal(Job* job)
+{
+	std::lock_guard<std::mutex> lock(_globalMutex);
+	_globalQueue.push_back(job);
+	_globalQueueSize.fetch_add(1);
+}
+
+void JobSystem::WakeWorkers()
+{
+	if (_sleepingWorkers.load() > 0)
+	{
+		std::lock_guard<std::mutex> lock(_sleepMutex);
+		_sleepCondition.notify_one();
+	}
+}
+
+void JobSystem::WakeAll()
+{
+	if (_sleepingWorkers.load() > 0)
+	{
+		std::lock_guard<std::mutex> lock(_sleepMutex);
+		_sleepCondition.notify_all();
+	}
+}
+
+void JobSystem::Submit(const std::function<void()>& task, JobCounter* counter, JobCounter* dependency)
+{
+	if (counter)
+		counter->_value.fetch_add(1);
+
+	Job* job = AllocateJob(GetCurrentThreadIndex());
+	job->_task = task;
+	job->_counter = counter;
+	job->_dependency = dependency;
+
+	_pendingJobs.fetch_add(1);
+
+	// the dependency submits the job once it completes
+	if (dependency && dependency->AddWaitingJob(job, this))
+		return;
+
+	Schedule(job);
+}
+
+void JobSystem::Schedule(Job* job)
+{
+	int32_t threadIndex = GetCurrentThreadIndex();
+
+	// counted first so a worker going to sleep sees it
+	_queuedJobs.fetch_add(1);
+	if (threadIndex >= 0)
+	{
+		// deque full. Run it right away
+		if (!_workerData[threadIndex]._deque.Push(job))
+		{
+			_queuedJobs.fetch_sub(1);
+			Execute(job);
+			return;
+		}
+	}
+	else
+	{
+		PushGlobal(job);
+	}
+
+	WakeWorkers();
+}
+
+void JobSystem::ReleaseWaitingJobs(Job* jobs)
+{
+	while (jobs)
+	{
+		Job* next = jobs->_next;
+		jobs->_next = nullptr;
+		Schedule(jobs);
+		jobs = next;
+	}
+
+	// threads blocked in Wait check their counter again
+	WakeAll();
+}
+
+Job* JobSystem::GetJob(int32_t threadIndex)
+{
+	// own work first
+	if (threadIndex >= 0)
+	{
+		Job* job = _workerData[threadIndex]._deque.Pop();
+		if (job)
+		{
+			_queuedJobs.fetch_sub(1);
+			return job;
+		}
+	}
+
+	// shared queue
+	if (_globalQueueSize.load(std::memory_order_relaxed) > 0)
+	{
+		std::lock_guard<std::mutex> lock(_globalMutex);
+		if (!_globalQueue.empty())
+		{
+			Job* job = _globalQueue.front();
+			_globalQueue.pop_front();
+			_globalQueueSize.fetch_sub(1);
+			_queuedJobs.fetch_sub(1);
+			return job;
+		}
+	}
+
+	// steal starting at a random victim
+	uint32_t& random = (threadIndex >= 0) ? _workerData[threadIndex]._random : tlsRandom;
+	uint32_t start = NextRandom(random) % _workerDataCount;
+	for (uint32_t i = 0; i < _workerDataCount; ++i)
+	{
+		uint32_t victim = (start + i) % _workerDataCount;
+		if (static_cast<int32_t>(victim) == threadIndex)
+			continue;
+
+		Job* job = _workerData[victim]._deque.Steal();
+		if (job)
+		{
+			_queuedJobs.fetch_sub(1);
+			_stolenJobs.fetch_add(1, std::memory_order_relaxed);
+			return job;
+		}
+	}
+
+	return nullptr;
+}
+
+void JobSystem::Execute(Job* job)
+{
+	_pendingJobs.fetch_sub(1);
+
+	try
+	{
+		job->_task();
+	}
+	catch (...)
+	{
+		// jobs must not throw. There is nobody to propagate the error to
+	}
+
+	JobCounter* counter = job->_counter;
+	FreeJob(job);
+	_executedJobs.fetch_add(1, std::memory_order_relaxed);
+
+	if (counter)
+		counter->Decrement();
+}
+
+bool JobSystem::RunOneJob(int32_t threadIndex)
+{
+	Job* job = GetJob(threadIndex);
+	if (!job)
+		return false;
+
+	Execute(job);
+
+	return true;
+}
+
+void JobSystem::Wait(JobCounter& counter)
+{
+	int32_t threadIndex = GetCurrentThreadIndex();
+
+	// the counter wakes us once it completes
+	counter.SetJobSystem(this);
+
+	while (!counter.IsComplete())
+	{
+		if (RunOneJob(threadIndex))
+			continue;
+
+		// nothing to help with. Sleep until work arrives or the counter completes
+		std::unique_lock<std::mutex> lock(_sleepMutex);
+		_sleepingWorkers.fetch_add(1);
+		_sleepCondition.wait(lock, [this, &counter]() { return counter.IsComplete() || _queuedJobs.load() > 0; });
+		_sleepingWorkers.fetch_sub(1);
+	}
+
+	// the last Decrement may still hold the counter
+	std::lock_guard<std::mutex> lock(counter._mutex);
+}
+
+void JobSystem::ParallelFor(size_t begin, size_t end, const std::function<void(size_t)>& func, size_t grainSize)
+{
+	if (end <= begin)
+		return;
+
+	size_t count = end - begin;
+	if (grainSize == 0)
+		grainSize = (std::max)(static_cast<size_t>(1), count / (GetThreadCount() * 4));
+
+	JobCounter counter;
+	for (size_t first = begin; first < end; first += grainSize)
+	{
+		size_t last = (std::min)(first + grainSize, end);
+		Submit([&func, first, last]()
+		{
+			for (size_t i = first; i < last; ++i)
+				func(i);
+		}, &counter);
+	}
+
+	Wait(counter);
+}
+
+void JobSystem::WorkerThread(int32_t index)
+{
+	tlsJobSystem = this;
+	tlsThreadIndex = index;
+
+	uint32_t idleCount = 0;
+	while (!_quit.load(std::memory_order_relaxed))
+	{
+		if (RunOneJob(index))
+		{
+			idleCount = 0;
+			continue;
+		}
+
+		if (++idleCount < JobSpinCount)
+		{
+			std::this_thread::yield();
+			continue;
+		}
+
+		// nothing to do. Sleep until new work arrives. Jobs waiting on a dependency
+		// are queued by their counter once it completes
+		std::unique_lock<std::mutex> lock(_sleepMutex);
+		_sleepingWorkers.fetch_add(1);
+		_sleepCondition.wait(lock, [this]() { return _queuedJobs.load() > 0 || _quit.load(); });
+		_sleepingWorkers.fetch_sub(1);
+		idleCount = 0;
+	}
+}
+
+}
@@ -0,0 +1,293 @@
+/*
+Copyright (c) <2017> <Udo Lugauer>
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE
+*/
+#pragma once
+
+/// @file jobSystem.h
+///       Work stealing job scheduler
+
+#include "engineDefines.h"
+#include "Common/caveVector.h"
+#include "Memory/allocatorBase.h"
+
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <deque>
+#include <memory>
+
+/** \addtogroup engine
+*  @{
+*		This module contains all code related to the engine
+*/
+
+namespace cave
+{
+
+/// forward declaration
+class JobSystem;
+struct Job;
+
+/**
+* @brief Counts outstanding jobs. A counter is complete if it reached zero.
+*		 Counters are used to wait for a group of jobs and to express dependencies.
+*		 Jobs depending on a counter are kept with it and submitted once it completes.
+*/
+class CAVE_INTERFACE JobCounter
+{
+	friend class JobSystem;
+public:
+	/** @brief Constructor */
+	JobCounter() : _value(0), _waitingJobs(nullptr), _pJobSystem(nullptr) {}
+
+	/**
+	* @brief Check if all jobs tracked by this counter are finished
+	*
+	* @return true if complete
+	*/
+	bool IsComplete() const { return _value.load(std::memory_order_acquire) == 0; }
+
+	/**
+	* @brief Get number of outstanding jobs
+	*
+	* @return job count
+	*/
+	int32_t GetValue() const { return _value.load(std::memory_order_acquire); }
+
+	/**
+	* @brief Track work which does not run as a job (e.g. file I/O on a dedicated thread).
+	*		 Every call must be matched by a call to Decrement.
+	*/
+	void Increment() { _value.fetch_add(1, std::memory_order_acq_rel); }
+
+	/**
+	* @brief Mark work tracked by Increment as finished.
+	*		 Reaching zero submits the dependent jobs and wakes threads waiting for the counter.
+	*/
+	void Decrement();
+
+private:
+	JobCounter(const JobCounter&) = delete;
+	JobCounter& operator=(const JobCounter&) = delete;
+
+	/**
+	* @brief Keep a job until the counter is complete
+	*
+	* @param[in] job		Dependent job
+	* @param[in] jobSystem	Job system the job is submitted to
+	*
+	* @return false if the counter is complete already
+	*/
+	bool AddWaitingJob(Job* job, JobSystem* jobSystem);
+
+	/**
+	* @brief Remember the job system which must be woken once the counter completes
+	*
+	* @param[in] jobSystem	Job system with threads waiting for the counter
+	*/
+	void SetJobSystem(JobSystem* jobSystem);
+
+	std::atomic<int32_t> _value;	///< Outstanding jobs
+	std::mutex _mutex;				///< Protects the waiting jobs and the job system
+	Job* _waitingJobs;				///< Jobs depending on this counter (linked through Job::_next)
+	JobSystem* _pJobSystem;			///< Job system waiting for this counter (nullptr if none)
+};
+
+/**
+* @brief A unit of work
+*/
+struct Job
+{
+	std::function<void()> _task;	///< Work to execute
+	JobCounter* _counter;			///< Decremented when the job finished (may be nullptr)
+	JobCounter* _dependency;		///< Job only runs once this counter is complete (may be nullptr)
+	Job* _next;						///< Next job waiting on the same dependency
+	std::atomic<bool> _inUse;		///< Pool slot is in use
+	bool _pooled;					///< Job lives in a worker pool (else allocated)
+
+	/** @brief Constructor */
+	Job() : _counter(nullptr), _dependency(nullptr), _next(nullptr), _inUse(false), _pooled(false) {}
+};
+
+/**
+* @brief Lock free work stealing deque (Chase-Lev).
+*		 The owning worker pushes and pops at the bottom, other workers steal from the top.
+*/
+class JobDeque
+{
+public:
+	/// Deque capacity. Must be a power of two
+	static const int64_t Capacity = 4096;
+
+	/** @brief Constructor */
+	JobDeque();
+
+	/**
+	* @brief Push a job. Owner thread only.
+	*
+	* @param[in] job	Job to push
+	*
+	* @return false if the deque is full
+	*/
+	bool Push(Job* job);
+
+	/**
+	* @brief Pop the most recently pushed job. Owner thread only.
+	*
+	* @return job or nullptr if empty
+	*/
+	Job* Pop();
+
+	/**
+	* @brief Steal the oldest job. Any thread.
+	*
+	* @return job or nullptr if empty or lost a race
+	*/
+	Job* Steal();
+
+	/** @brief Approximate number of jobs */
+	int64_t Size() const;
+
+private:
+	std::atomic<int64_t> _top;				///< Steal end
+	std::atomic<int64_t> _bottom;			///< Owner end
+	std::atomic<Job*> _buffer[Capacity];	///< Circular job buffer
+};
+
+/**
+* @brief Work stealing job scheduler.
+*		 One worker thread per additional core. The thread which creates the job system
+*		 is registered as worker 0 and executes jobs while it waits on counters.
+*		 Threads not owned by the job system can submit and wait, their jobs go through a shared queue.
+*/
+class CAVE_INTERFACE JobSystem
+{
+	friend class JobCounter;
+public:
+	/**
+	* @brief Constructor
+	*
+	* @param[in] allocator		Engine allocator
+	* @param[in] workerCount	Number of worker threads. 0 uses one per hardware thread minus the calling thread
+	*/
+	JobSystem(std::shared_ptr<AllocatorBase> allocator, uint32_t workerCount = 0);
+
+	/** @brief Destructor. Waits for all submitted jobs */
+	~JobSystem();
+
+	/**
+	* @brief Submit a job
+	*
+	* @param[in] task		Work to execute
+	* @param[in] counter	Optional counter incremented now and decremented when the job finished
+	* @param[in] dependency	Optional counter which must be complete before the job runs
+	*/
+	void Submit(const std::function<void()>& task, JobCounter* counter = nullptr, JobCounter* dependency = nullptr);
+
+	/**
+	* @brief Wait until a counter is complete. The calling thread executes jobs while waiting
+	*		 and sleeps if there are none.
+	*
+	* @param[in] counter	Counter to wait for
+	*/
+	void Wait(JobCounter& counter);
+
+	/**
+	* @brief Run func for every element of a vector in parallel and wait for completion
+	*
+	* @param[in] range		Vector to iterate
+	* @param[in] func		Called with element reference and index
+	* @param[in] grainSize	Elements per job (0 picks a size based on the worker count)
+	*/
+	template<typename T, typename F>
+	void ParallelFor(caveVector<T>& range, F func, size_t grainSize = 0)
+	{
+		ParallelFor(static_cast<size_t>(0), range.Size(), [&range, &func](size_t index) { func(range[index], index); }, grainSize);
+	}
+
+	/**
+	* @brief Run func for every index in [begin, end) in parallel and wait for completion
+	*
+	* @param[in] begin		First index
+	* @param[in] end		One past the last index
+	* @param[in] func		Called with the index
+	* @param[in] grainSize	Indices per job (0 picks a size based on the worker count)
+	*/
+	void ParallelFor(size_t begin, size_t end, const std::function<void(size_t)>& func, size_t grainSize = 0);
+
+	/** @brief Get number of threads executing jobs (workers plus the owner thread) */
+	uint32_t GetThreadCount() const { return static_cast<uint32_t>(_workers.Size()) + 1; }
+
+	/** @brief Get the index of the calling thread. -1 if the thread is not part of this job system */
+	int32_t GetCurrentThreadIndex() const;
+
+	/** @brief Number of executed jobs */
+	uint64_t GetExecutedJobCount() const { return _executedJobs.load(std::memory_order_relaxed); }
+
+	/** @brief Number of jobs taken from other workers */
+	uint64_t GetStolenJobCount() const { return _stolenJobs.load(std::memory_order_relaxed); }
+
+private:
+	/// Jobs per thread pool. Larger than the deque so in flight jobs do not block reuse
+	static const uint32_t JobPoolSize = 8192;
+
+	/**
+	* @brief Per thread state
+	*/
+	struct WorkerData
+	{
+		JobDeque _deque;		///< Work stealing deque
+		Job* _jobPool;			///< Ring of preallocated jobs
+		uint32_t _nextJob;		///< Next pool slot
+		uint32_t _random;		///< Victim selection state
+	};
+
+	void WorkerThread(int32_t index);
+	Job* AllocateJob(int32_t threadIndex);
+	void FreeJob(Job* job);
+	Job* GetJob(int32_t threadIndex);
+	bool RunOneJob(int32_t threadIndex);
+	void Execute(Job* job);
+	void Schedule(Job* job);
+	void PushGlobal(Job* job);
+	void WakeWorkers();
+	void WakeAll();
+	void ReleaseWaitingJobs(Job* jobs);
+
+private:
+	std::shared_ptr<AllocatorBase> _pAllocator;	///< Engine allocator
+	caveVector<std::thread*> _workers;			///< Worker threads
+	WorkerData* _workerData;					///< Worker data (index 0 is the owner thread)
+	uint32_t _workerDataCount;					///< Number of worker data entries
+	std::thread::id _ownerThread;				///< Thread which created the job system (thread index 0)
+
+	std::mutex _globalMutex;					///< Protects the global queue
+	std::deque<Job*> _globalQueue;				///< Jobs from foreign threads or requeued jobs
+	std::atomic<int32_t> _globalQueueSize;		///< Global queue size for lock free checks
+
+	std::mutex _sleepMutex;						///< Sleep mutex
+	std::condition_variable _sleepCondition;	///< Wakes sleeping workers
+	std::atomic<int32_t> _pendingJobs;			///< Submitted but not yet started jobs
+	std::atomic<int32_t> _queuedJobs;			///< Jobs in a deque or the global queue, ready to run
+	std::atomic<int32_t> _sleepingWorkers;		///< Workers and waiting threads sleeping on the sleep condition
+	std::atomic<bool> _quit;					///< Stop workers
+
+	std::atomic<uint64_t> _executedJobs;		///< Statistics
+	std::atomic<uint64_t> _stolenJobs;			///< Statistics
+};
+
+}
+
+/** @}*/
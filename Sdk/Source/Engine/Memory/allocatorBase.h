@@ -26,6 +26,7 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SO
 #include "engineError.h"
 
 #include <cassert>
+#include <atomic>
 
 namespace cave
 {
@@ -120,8 +121,8 @@ public:
     }
 
 protected:
-    size_t        _usedMemory;		///< Current size of used memory
-    size_t        _numAllocations;	///< Current allocation count
+    std::atomic<size_t> _usedMemory;		///< Current size of used memory
+    std::atomic<size_t> _numAllocations;	///< Current allocation count (updated from job threads)
 
     void*         _start;	///< Heap start adress
     size_t        _size;	///< Maximum Heap size
@@ -30,7 +30,7 @@ namespace cave
 /**
 * Engine internal global allocation Handling
 */
-class AllocatorGlobal : public AllocatorBase
+class CAVE_INTERFACE AllocatorGlobal : public AllocatorBase
 {
 public:
 	/**
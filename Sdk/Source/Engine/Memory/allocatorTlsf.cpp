@@ -0,0 +1,455 @@
+/*
+Copyright (c) <2017> <Udo Lugauer>
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE
+*/
+
+/// @file allocatorTlsf.cpp
+///       Two level segregated fit allocator for address ranges
+
+#include "allocatorTlsf.h"
+
+#include <cassert>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace cave
+{
+
+/**
+* @brief Index of the highest set bit
+*
+* @param[in] value	Value (must not be 0)
+*
+* @return bit index
+*/
+static inline uint32_t HighestBit(uint64_t value)
+{
+#if defined(_MSC_VER)
+	unsigned long index;
+	_BitScanReverse64(&index, value);
+	return static_cast<uint32_t>(index);
+#else
+	return 63 - static_cast<uint32_t>(__builtin_clzll(value));
+#endif
+}
+
+/**
+* @brief Index of the lowest set bit
+*
+* @param[in] value	Value (must not be 0)
+*
+* @return bit index
+*/
+static inline uint32_t LowestBit(uint64_t value)
+{
+#if defined(_MSC_VER)
+	unsigned long index;
+	_BitScanForward64(&index, value);
+	return static_cast<uint32_t>(index);
+#else
+	return static_cast<uint32_t>(__builtin_ctzll(value));
+#endif
+}
+
+/**
+* @brief Align an offset
+*
+* @param[in] value		Offset
+* @param[in] alignment	Alignment (power of two)
+*
+* @return aligned offset
+*/
+static inline uint64_t AlignUp(uint64_t value, uint64_t alignment)
+{
+	return (value + alignment - 1) & ~(alignment - 1);
+}
+
+AllocatorTlsf::AllocatorTlsf(uint64_t size, uint64_t granularity)
+	: _size(size)
+	, _granularity(granularity ? granularity : 1)
+	, _usedSize(0)
+	, _allocationCount(0)
+	, _freeCount(0)
+	, _flBitmap(0)
+{
+	assert((_granularity & (_granularity - 1)) == 0);
+
+	for (uint32_t fl = 0; fl < FlCount; fl++)
+	{
+		_slBitmap[fl] = 0;
+		for (uint32_t sl = 0; sl < SlCount; sl++)
+			_freeLists[fl][sl] = InvalidHandle;
+	}
+
+	if (_size == 0)
+		return;
+
+	// one free range covering everything
+	uint32_t index = NewBlock();
+	_blocks[index]._offset = 0;
+	_blocks[index]._size = _size;
+	InsertFree(index);
+}
+
+AllocatorTlsf::~AllocatorTlsf()
+{
+}
+
+uint32_t AllocatorTlsf::NewBlock()
+{
+	uint32_t index;
+	if (!_unusedBlocks.empty())
+	{
+		index = _unusedBlocks.back();
+		_unusedBlocks.pop_back();
+	}
+	else
+	{
+		index = static_cast<uint32_t>(_blocks.size());
+		_blocks.push_back(Block());
+	}
+
+	Block& block = _blocks[index];
+	block._offset = 0;
+	block._size = 0;
+	block._prevPhysical = InvalidHandle;
+	block._nextPhysical = InvalidHandle;
+	block._prevFree = InvalidHandle;
+	block._nextFree = InvalidHandle;
+	block._free = true;
+	block._kind = AllocatorTlsfKind::Linear;
+
+	return index;
+}
+
+void AllocatorTlsf::DeleteBlock(uint32_t index)
+{
+	_unusedBlocks.push_back(index);
+}
+
+void AllocatorTlsf::Mapping(uint64_t size, uint32_t& fl, uint32_t& sl) const
+{
+	if (size < (1ull << SmallLog2))
+	{
+		fl = 0;
+		sl = static_cast<uint32_t>(size >> (SmallLog2 - SlLog2));
+	}
+	else
+	{
+		uint32_t highestBit = HighestBit(size);
+		fl = highestBit - SmallLog2 + 1;
+		sl = static_cast<uint32_t>(size >> (highestBit - SlLog2)) - SlCount;
+	}
+}
+
+void AllocatorTlsf::InsertFree(uint32_t index)
+{
+	uint32_t fl, sl;
+	Mapping(_blocks[index]._size, fl, sl);
+
+	Block& block = _blocks[index];
+	uint32_t head = _freeLists[fl][sl];
+	block._free = true;
+	block._prevFree = InvalidHandle;
+	block._nextFree = head;
+	if (head != InvalidHandle)
+		_blocks[head]._prevFree = index;
+
+	_freeLists[fl][sl] = index;
+	_slBitmap[fl] |= 1u << sl;
+	_flBitmap |= 1ull << fl;
+	_freeCount++;
+}
+
+void AllocatorTlsf::RemoveFree(uint32_t index)
+{
+	uint32_t fl, sl;
+	Mapping(_blocks[index]._size, fl, sl);
+
+	Block& block = _blocks[index];
+	if (block._prevFree != InvalidHandle)
+		_blocks[block._prevFree]._nextFree = block._nextFree;
+	if (block._nextFree != InvalidHandle)
+		_blocks[block._nextFree]._prevFree = block._prevFree;
+
+	if (_freeLists[fl][sl] == index)
+	{
+		_freeLists[fl][sl] = block._nextFree;
+		if (_freeLists[fl][sl] == InvalidHandle)
+		{
+			_slBitmap[fl] &= ~(1u << sl);
+			if (_slBitmap[fl] == 0)
+				_flBitmap &= ~(1ull << fl);
+		}
+	}
+
+	block._prevFree = InvalidHandle;
+	block._nextFree = InvalidHandle;
+	_freeCount--;
+}
+
+uint32_t AllocatorTlsf::FindFree(uint32_t& fl, uint32_t& sl) const
+{
+	uint32_t slMap = (sl < SlCount) ? (_slBitmap[fl] & (~0u << sl)) : 0;
+	if (slMap == 0)
+	{
+		// no list left in this first level, take the next larger one
+		uint64_t flMap = (fl + 1 < FlCount) ? (_flBitmap & (~0ull << (fl + 1))) : 0;
+		if (flMap == 0)
+			return InvalidHandle;
+
+		fl = LowestBit(flMap);
+		slMap = _slBitmap[fl];
+	}
+
+	sl = LowestBit(slMap);
+	return _freeLists[fl][sl];
+}
+
+bool AllocatorTlsf::Fits(uint32_t index, uint64_t size, uint64_t alignment, AllocatorTlsfKind kind, uint64_t& offset) const
+{
+	// neighbours of a free range are always in use, free ones are merged
+	const Block& block = _blocks[index];
+	uint64_t start = AlignUp(block._offset, alignment);
+	if (_granularity > 1 && block._prevPhysical != InvalidHandle)
+	{
+		const Block& prev = _blocks[block._prevPhysical];
+		if (prev._kind != kind && OnSamePage(prev._offset + prev._size - 1, start))
+			start = AlignUp(start, _granularity);
+	}
+
+	if (start + size > block._offset + block._size)
+		return false;
+
+	if (_granularity > 1 && block._nextPhysical != InvalidHandle)
+	{
+		const Block& next = _blocks[block._nextPhysical];
+		if (next._kind != kind && OnSamePage(start + size - 1, next._offset))
+			return false;
+	}
+
+	offset = start;
+	return true;
+}
+
+uint32_t AllocatorTlsf::Allocate(uint64_t size, uint64_t alignment, AllocatorTlsfKind kind, uint64_t& offset)
+{
+	if (size == 0 || size > _size)
+		return InvalidHandle;
+
+	alignment = (alignment > 0) ? alignment : 1;
+	assert((alignment & (alignment - 1)) == 0);
+
+	// search a size class where every range can take the aligned allocation.
+	// Granularity conflicts may move the start to the next page, so reserve for that too
+	uint64_t padding = alignment - 1;
+	if (_granularity > alignment)
+		padding = _granularity - 1;
+
+	uint64_t searchSize = size + padding;
+	if (searchSize >= (1ull << SmallLog2))
+		searchSize += (1ull << (HighestBit(searchSize) - SlLog2)) - 1;
+
+	uint32_t index = InvalidHandle;
+	uint64_t start = 0;
+	if (searchSize <= _size)
+	{
+		uint32_t fl, sl;
+		Mapping(searchSize, fl, sl);
+		uint32_t candidate = FindFree(fl, sl);
+		while (candidate != InvalidHandle)
+		{
+			if (Fits(candidate, size, alignment, kind, start))
+			{
+				index = candidate;
+				break;
+			}
+
+			// only a neighbour conflict gets here, try the rest of the list then larger classes
+			candidate = _blocks[candidate]._nextFree;
+			if (candidate == InvalidHandle)
+			{
+				sl++;
+				candidate = FindFree(fl, sl);
+			}
+		}
+	}
+
+	if (index == InvalidHandle)
+	{
+		// nearly full: ranges of the classes below the search class may still fit without the padding.
+		// Everything from the search class on was checked above
+		uint32_t fl, sl;
+		uint32_t searchFl = FlCount, searchSl = 0;
+		Mapping(size, fl, sl);
+		if (searchSize <= _size)
+			Mapping(searchSize, searchFl, searchSl);
+
+		uint32_t candidate = FindFree(fl, sl);
+		while (candidate != InvalidHandle && (fl < searchFl || (fl == searchFl && sl < searchSl)))
+		{
+			if (Fits(candidate, size, alignment, kind, start))
+			{
+				index = candidate;
+				break;
+			}
+
+			candidate = _blocks[candidate]._nextFree;
+			if (candidate == InvalidHandle)
+			{
+				sl++;
+				candidate = FindFree(fl, sl);
+			}
+		}
+
+		if (index == InvalidHandle)
+			return InvalidHandle;
+	}
+
+	RemoveFree(index);
+
+	// alignment padding in front stays free
+	if (start > _blocks[index]._offset)
+	{
+		uint32_t front = NewBlock();
+		Block& block = _blocks[index];
+		Block& frontBlock = _blocks[front];
+		frontBlock._offset = block._offset;
+		frontBlock._size = start - block._offset;
+		frontBlock._prevPhysical = block._prevPhysical;
+		frontBlock._nextPhysical = index;
+		if (block._prevPhysical != InvalidHandle)
+			_blocks[block._prevPhysical]._nextPhysical = front;
+
+		block._prevPhysical = front;
+		block._offset = start;
+		block._size -= frontBlock._size;
+		InsertFree(front);
+	}
+
+	// the rest behind stays free
+	if (_blocks[index]._size > size)
+	{
+		uint32_t back = NewBlock();
+		Block& block = _blocks[index];
+		Block& backBlock = _blocks[back];
+		backBlock._offset = start + size;
+		backBlock._size = block._size - size;
+		backBlock._prevPhysical = index;
+		backBlock._nextPhysical = block._nextPhysical;
+		if (block._nextPhysical != InvalidHandle)
+			_blocks[block._nextPhysical]._prevPhysical = back;
+
+		block._nextPhysical = back;
+		block._size = size;
+		InsertFree(back);
+	}
+
+	Block& block = _blocks[index];
+	block._free = false;
+	block._kind = kind;
+	_usedSize += size;
+	_allocationCount++;
+
+	offset = start;
+	return index;
+}
+
+void AllocatorTlsf::Free(uint32_t handle)
+{
+	if (handle >= _blocks.size() || _blocks[handle]._free)
+	{
+		assert(false && "AllocatorTlsf: invalid handle");
+		return;
+	}
+
+	_usedSize -= _blocks[handle]._size;
+	_allocationCount--;
+	_blocks[handle]._free = true;
+
+	// merge with the range behind
+	uint32_t next = _blocks[handle]._nextPhysical;
+	if (next != InvalidHandle && _blocks[next]._free)
+	{
+		RemoveFree(next);
+		_blocks[handle]._size += _blocks[next]._size;
+		_blocks[handle]._nextPhysical = _blocks[next]._nextPhysical;
+		if (_blocks[handle]._nextPhysical != InvalidHandle)
+			_blocks[_blocks[handle]._nextPhysical]._prevPhysical = handle;
+		DeleteBlock(next);
+	}
+
+	// merge with the range in front
+	uint32_t prev = _blocks[handle]._prevPhysical;
+	if (prev != InvalidHandle && _blocks[prev]._free)
+	{
+		RemoveFree(prev);
+		_blocks[prev]._size += _blocks[handle]._size;
+		_blocks[prev]._nextPhysical = _blocks[handle]._nextPhysical;
+		if (_blocks[prev]._nextPhysical != InvalidHandle)
+			_blocks[_blocks[prev]._nextPhysical]._prevPhysical = prev;
+		DeleteBlock(handle);
+		handle = prev;
+	}
+
+	InsertFree(handle);
+}
+
+uint64_t AllocatorTlsf::GetLargestFreeRange() const
+{
+	if (_flBitmap == 0)
+		return 0;
+
+	// the largest range is in the highest non empty size class
+	uint32_t fl = HighestBit(_flBitmap);
+	uint32_t sl = HighestBit(_slBitmap[fl]);
+	uint64_t largest = 0;
+	for (uint32_t index = _freeLists[fl][sl]; index != InvalidHandle; index = _blocks[index]._nextFree)
+	{
+		if (_blocks[index]._size > largest)
+			largest = _blocks[index]._size;
+	}
+
+	return largest;
+}
+
+void AllocatorTlsf::GetRanges(std::vector<AllocatorTlsfRange>& ranges) const
+{
+	ranges.clear();
+
+	// the first range is the only live one without a range in front
+	std::vector<bool> unused(_blocks.size(), false);
+	for (uint32_t index : _unusedBlocks)
+		unused[index] = true;
+
+	uint32_t first = InvalidHandle;
+	for (uint32_t index = 0; index < _blocks.size() && first == InvalidHandle; index++)
+	{
+		if (!unused[index] && _blocks[index]._prevPhysical == InvalidHandle)
+			first = index;
+	}
+
+	for (uint32_t index = first; index != InvalidHandle; index = _blocks[index]._nextPhysical)
+	{
+		const Block& block = _blocks[index];
+		AllocatorTlsfRange range;
+		range._offset = block._offset;
+		range._size = block._size;
+		range._handle = (block._free) ? InvalidHandle : index;
+		range._kind = block._kind;
+		ranges.push_back(range);
+	}
+}
+
+}
@@ -0,0 +1,179 @@
+/*
+Copyright (c) <2017> <Udo Lugauer>
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE
+*/
+#pragma once
+
+/// @file allocatorTlsf.h
+///       Two level segregated fit allocator for address ranges
+
+
+/** @addtogroup engine 
+*  @{
+*       
+*/
+
+#include "engineDefines.h"
+#include "engineTypes.h"
+
+#include <vector>
+
+namespace cave
+{
+
+/**
+* Resource kind of a range allocation. Linear and optimal resources
+* must not share a granularity page (vulkan bufferImageGranularity).
+*/
+enum class AllocatorTlsfKind : uint32_t
+{
+	Linear = 0,		///< Buffers and linear images
+	Optimal = 1		///< Optimal tiled images
+};
+
+/**
+* Used or free range as reported by AllocatorTlsf::GetRanges
+*/
+struct CAVE_INTERFACE AllocatorTlsfRange
+{
+	uint64_t _offset;			///< Start offset
+	uint64_t _size;				///< Size in bytes
+	uint32_t _handle;			///< Allocation handle (AllocatorTlsf::InvalidHandle if free)
+	AllocatorTlsfKind _kind;	///< Resource kind if in use
+};
+
+/**
+* Sub-allocates offsets inside a range of fixed size (e.g. a device memory block).
+* The managed memory is never touched, all book keeping lives in a block table.
+* Allocation and free are O(1), free neighbours are merged immediately.
+*/
+class CAVE_INTERFACE AllocatorTlsf
+{
+public:
+	static const uint32_t InvalidHandle = ~0u;	///< Returned if an allocation failed
+
+	/**
+	* @brief Constructor
+	*
+	* @param[in] size			Size of the managed range in bytes
+	* @param[in] granularity	Page size linear and optimal resources must not share (power of two, 1 disables the check)
+	*
+	*/
+	AllocatorTlsf(uint64_t size, uint64_t granularity = 1);
+
+	/** destructor */
+	~AllocatorTlsf();
+
+	/**
+	* @brief Allocate a range
+	*
+	* @param[in] size		Allocation size in bytes
+	* @param[in] alignment	Offset alignment (power of two)
+	* @param[in] kind		Resource kind
+	* @param[out] offset	Offset of the allocation
+	*
+	* @return allocation handle or InvalidHandle if there is no space left
+	*/
+	uint32_t Allocate(uint64_t size, uint64_t alignment, AllocatorTlsfKind kind, uint64_t& offset);
+
+	/**
+	* @brief Release an allocation
+	*
+	* @param[in] handle	Handle returned by Allocate
+	*
+	*/
+	void Free(uint32_t handle);
+
+	/** @brief Get the size of the managed range */
+	uint64_t GetSize() const { return _size; }
+
+	/** @brief Get the number of bytes in use (without alignment padding) */
+	uint64_t GetUsedSize() const { return _usedSize; }
+
+	/** @brief Get the number of live allocations */
+	uint32_t GetAllocationCount() const { return _allocationCount; }
+
+	/** @brief Get the number of free ranges */
+	uint32_t GetFreeRangeCount() const { return _freeCount; }
+
+	/** @brief Check if there are no allocations */
+	bool IsEmpty() const { return _allocationCount == 0; }
+
+	/**
+	* @brief Get the size of the largest free range
+	*
+	* @return size in bytes
+	*/
+	uint64_t GetLargestFreeRange() const;
+
+	/**
+	* @brief Get all used and free ranges in address order. Walks the whole block table, meant for diagnostics
+	*
+	* @param[out] ranges	Receives the ranges (cleared first)
+	*
+	*/
+	void GetRanges(std::vector<AllocatorTlsfRange>& ranges) const;
+
+private:
+	static const uint32_t SlLog2 = 4;					///< Second level subdivisions as power of two
+	static const uint32_t SlCount = 1 << SlLog2;		///< Second level lists per first level
+	static const uint32_t SmallLog2 = 8;				///< Ranges below 256 bytes share the first list
+	static const uint32_t FlCount = 64 - SmallLog2 + 1;	///< First level lists
+
+	/**
+	* Physical range of the managed memory. Ranges are linked in address order,
+	* free ranges are also linked in their size class list.
+	*/
+	struct Block
+	{
+		uint64_t _offset;			///< Start offset
+		uint64_t _size;				///< Size in bytes
+		uint32_t _prevPhysical;		///< Range in front (InvalidHandle if first)
+		uint32_t _nextPhysical;		///< Range behind (InvalidHandle if last)
+		uint32_t _prevFree;			///< Previous range in the size class list
+		uint32_t _nextFree;			///< Next range in the size class list
+		bool _free;					///< Range is free
+		AllocatorTlsfKind _kind;	///< Resource kind if in use
+	};
+
+	/** @brief Get an unused block table entry */
+	uint32_t NewBlock();
+	/** @brief Return a block table entry */
+	void DeleteBlock(uint32_t index);
+	/** @brief Get the size class of a range size (rounded down) */
+	void Mapping(uint64_t size, uint32_t& fl, uint32_t& sl) const;
+	/** @brief Link a free range into its size class list */
+	void InsertFree(uint32_t index);
+	/** @brief Unlink a free range from its size class list */
+	void RemoveFree(uint32_t index);
+	/** @brief Get the first free range of the first non empty size class at or above fl/sl */
+	uint32_t FindFree(uint32_t& fl, uint32_t& sl) const;
+	/** @brief Check if an allocation fits into a free range and compute its offset */
+	bool Fits(uint32_t index, uint64_t size, uint64_t alignment, AllocatorTlsfKind kind, uint64_t& offset) const;
+	/** @brief Check if two offsets are on the same granularity page */
+	bool OnSamePage(uint64_t first, uint64_t second) const { return (first & ~(_granularity - 1)) == (second & ~(_granularity - 1)); }
+
+	uint64_t _size;					///< Size of the managed range
+	uint64_t _granularity;			///< Page size of the linear/optimal conflict check
+	uint64_t _usedSize;				///< Bytes in use
+	uint32_t _allocationCount;		///< Live allocations
+	uint32_t _freeCount;			///< Free ranges
+	uint64_t _flBitmap;				///< Bit per first level with free ranges
+	uint32_t _slBitmap[FlCount];	///< Bit per second level list with free ranges
+	uint32_t _freeLists[FlCount][SlCount];	///< Heads of the size class lists
+	std::vector<Block> _blocks;		///< Block table, handles index into it
+	std::vector<uint32_t> _unusedBlocks;	///< Recycled block table entries
+};
+
+}
+
+/** @}*/
@@ -19,6 +19,7 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SO
 #include "renderDevice.h"
 #include "engineError.h"
 #include "halColorBlend.h"
+#include "renderStateHash.h"
 
 #include <cassert>
 
@@ -30,6 +31,27 @@ RenderColorBlend::RenderColorBlend(RenderDevice& renderDevice
 	: CaveRefCount(renderDevice.GetEngineAllocator())
 	, _renderDevice(renderDevice)
 {
+	// content hash used to share pipelines
+	RenderStateHash hash;
+	hash.Add(colorBlendInfo._logicOpEnable);
+	hash.Add(colorBlendInfo._logicOp);
+	for (uint32_t i = 0; i < 4; i++)
+		hash.Add(colorBlendInfo._blendConstants[i]);
+	hash.Add(static_cast<uint32_t>(blendAttachments.Size()));
+	for (size_t i = 0; i < blendAttachments.Size(); i++)
+	{
+		const HalColorBlendAttachment& attachment = blendAttachments[i];
+		hash.Add(attachment._blendEnable);
+		hash.Add(attachment._srcColorBlendFactor);
+		hash.Add(attachment._dstColorBlendFactor);
+		hash.Add(attachment._colorBlendOp);
+		hash.Add(attachment._srcAlphaBlendFactor);
+		hash.Add(attachment._dstAlphaBlendFactor);
+		hash.Add(attachment._alphaBlendOp);
+		hash.Add(attachment._colorWriteMask);
+	}
+	_stateHash = hash.GetValue();
+
 	// Allocate low level object
 	_halColorBlend = renderDevice.GetHalRenderDevice()->CreateColorBlendState(colorBlendInfo, blendAttachments);
 	assert(_halColorBlend);
@@ -63,9 +63,17 @@ public:
 	*/
 	HalColorBlend* GetHalHandle() { return _halColorBlend; }
 
+	/**
+	* @brief Get the content hash used to share graphics pipelines
+	*
+	* @return hash value
+	*/
+	uint64_t GetStateHash() const { return _stateHash; }
+
 private:
 	RenderDevice& _renderDevice;	///< Render device object
 	HalColorBlend* _halColorBlend;	///< Pointer to low level color blend state object
+	uint64_t _stateHash;	///< Content hash of the state
 };
 
 }
@@ -19,6 +19,7 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SO
 #include "renderDevice.h"
 #include "engineError.h"
 #include "halDepthStencil.h"
+#include "renderStateHash.h"
 
 #include <cassert>
 
@@ -28,6 +29,29 @@ RenderDepthStencil::RenderDepthStencil(RenderDevice& renderDevice, HalDepthStenc
 	: CaveRefCount(renderDevice.GetEngineAllocator())
 	, _renderDevice(renderDevice)
 {
+	// content hash used to share pipelines
+	RenderStateHash hash;
+	hash.Add(depthStencilInfo._depthTestEnable);
+	hash.Add(depthStencilInfo._depthWriteEnable);
+	hash.Add(depthStencilInfo._depthCompareOp);
+	hash.Add(depthStencilInfo._depthBoundsTestEnable);
+	hash.Add(depthStencilInfo._stencilTestEnable);
+	const HalStencilOpSetup* stencilSetup[2] = { &depthStencilInfo._front, &depthStencilInfo._back };
+	for (uint32_t i = 0; i < 2; i++)
+	{
+		hash.Add(stencilSetup[i]->_failOp);
+		hash.Add(stencilSetup[i]->_passOp);
+		hash.Add(stencilSetup[i]->_depthFailOp);
+		hash.Add(stencilSetup[i]->_depthPassOp);
+		hash.Add(stencilSetup[i]->_compareOp);
+		hash.Add(stencilSetup[i]->_compareMask);
+		hash.Add(stencilSetup[i]->_writeMask);
+		hash.Add(stencilSetup[i]->_reference);
+	}
+	hash.Add(depthStencilInfo._minDepthBounds);
+	hash.Add(depthStencilInfo._maxDepthBounds);
+	_stateHash = hash.GetValue();
+
 	// Allocate low level object
 	_halDepthStencil = renderDevice.GetHalRenderDevice()->CreateDepthStencilState(depthStencilInfo);
 	assert(_halDepthStencil);
@@ -59,9 +59,17 @@ public:
 	*/
 	HalDepthStencil* GetHalHandle() { return _halDepthStencil; }
 
+	/**
+	* @brief Get the content hash used to share graphics pipelines
+	*
+	* @return hash value
+	*/
+	uint64_t GetStateHash() const { return _stateHash; }
+
 private:
 	RenderDevice& _renderDevice;	///< Render device object
 	HalDepthStencil* _halDepthStencil;	///< Pointer to low level depth stencil state object
+	uint64_t _stateHash;	///< Content hash of the state
 };
 
 }
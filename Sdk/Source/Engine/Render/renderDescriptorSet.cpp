@@ -21,6 +21,7 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SO
 #include "engineError.h"
 #include "halDescriptorPool.h"
 #include "halDescriptorSet.h"
+#include "renderStateHash.h"
 
 #include <cassert>
 
@@ -32,6 +33,26 @@ RenderDescriptorSet::RenderDescriptorSet(RenderDevice& renderDevice
 	, _renderDevice(renderDevice)
 	, _descriptorPool(nullptr)
 {
+	// content hash used to share pipelines
+	RenderStateHash hash;
+	hash.Add(static_cast<uint32_t>(descriptorSetLayouts.Size()));
+	for (size_t i = 0; i < descriptorSetLayouts.Size(); i++)
+	{
+		const HalDescriptorSetLayout& layout = descriptorSetLayouts[i];
+		hash.Add(layout._flags);
+		hash.Add(layout._bindingCount);
+		for (uint32_t j = 0; j < layout._bindingCount; j++)
+		{
+			const HalDescriptorSetLayoutBinding& binding = layout._pBindings[j];
+			hash.Add(binding._binding);
+			hash.Add(binding._descriptorType);
+			hash.Add(binding._descriptorCount);
+			hash.Add(binding._stageFlags);
+			hash.Add(binding._pImmutableSamplers);
+		}
+	}
+	_stateHash = hash.GetValue();
+
 	// Allocate low level object
 	_halDescriptorSet = renderDevice.GetHalRenderDevice()->CreateDescriptorSetLayouts(descriptorSetLayouts);
 	assert(_halDescriptorSet);
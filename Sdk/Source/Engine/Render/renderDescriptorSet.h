@@ -119,10 +119,18 @@ public:
 	*/
 	HalDescriptorSet* GetHalHandle() { return _halDescriptorSet; }
 
+	/**
+	* @brief Get the content hash used to share graphics pipelines
+	*
+	* @return hash value
+	*/
+	uint64_t GetStateHash() const { return _stateHash; }
+
 private:
 	RenderDevice& _renderDevice;			///< Render device object
 	RenderDescriptorPool* _descriptorPool;	///< Pointer to a RenderDescriptorPool object
 	HalDescriptorSet* _halDescriptorSet;	///< Pointer to low level pipeline layout object
+	uint64_t _stateHash;	///< Content hash of the state
 };
 
 }
@@ -45,15 +45,27 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SO
 #include "halRenderDevice.h"
 #include "engineError.h"
 #include "engineLog.h"
+#include "Jobs/jobSystem.h"
+
+#include "json.hpp"
+
+#include <fstream>
 
 namespace cave
 {
 
+// pipeline cache next to the content folder
+static const char* g_pipelineCacheLocation = "/PipelineCache.bin";
+
 RenderDevice::RenderDevice(RenderInstance* renderInstance, HalInstance* halInstance, FrontendWindowInfo& windowInfo)
 	: _pRenderInstance(renderInstance)
 	, _pHalInstance(halInstance)
 	, _pHalRenderDevice(nullptr)
 	, _pResourceManager(nullptr)
+	, _pipelineCompileCounter(nullptr)
+	, _pipelineCompileSubmitted(0)
+	, _pipelineCompileCompleted(0)
+	, _pipelineCompileFailed(0)
 {
 	// first copy data
 	_swapChainInfo.colorBits = windowInfo.colorBits;
@@ -75,6 +87,18 @@ RenderDevice::RenderDevice(RenderInstance* renderInstance, HalInstance* halInsta
 	try
 	{
 		_pHalRenderDevice = halInstance->CreateRenderDevice(renderInstance->GetEngineAllocator(), _swapChainInfo);
+		_pipelineCompileCounter = AllocateObject<JobCounter>(*renderInstance->GetEngineAllocator());
+
+		// seed the pipeline cache before any pipeline is created
+		const char* projectPath = renderInstance->GetProjectPath();
+		const char* appPath = renderInstance->GetApplicationPath();
+		if (projectPath && projectPath[0])
+			_pipelineCachePath = std::string(projectPath) + g_pipelineCacheLocation;
+		else if (appPath && appPath[0])
+			_pipelineCachePath = std::string(appPath) + g_pipelineCacheLocation;
+		if (!_pipelineCachePath.empty())
+			_pHalRenderDevice->LoadPipelineCache(_pipelineCachePath.c_str());
+
 		_pResourceManager = AllocateObject<ResourceManager>(*renderInstance->GetEngineAllocator()
 				, this
 				, renderInstance->GetApplicationPath()
@@ -89,11 +113,21 @@ RenderDevice::RenderDevice(RenderInstance* renderInstance, HalInstance* halInsta
 
 RenderDevice::~RenderDevice()
 {
+	// background compilations still use the device
+	if (_pipelineCompileCounter)
+	{
+		GetJobSystem()->Wait(*_pipelineCompileCounter);
+		DeallocateDelete(*_pRenderInstance->GetEngineAllocator(), *_pipelineCompileCounter);
+	}
+
 	if (_pResourceManager)
 		DeallocateDelete(*_pRenderInstance->GetEngineAllocator(), *_pResourceManager);
 
 	if (_pHalRenderDevice)
+	{
+		SavePipelineCache();
 		DeallocateDelete(*_pRenderInstance->GetEngineAllocator(), *_pHalRenderDevice);
+	}
 }
 
 std::shared_ptr<AllocatorGlobal>
@@ -107,6 +141,11 @@ EngineLog* RenderDevice::GetEngineLog() const
 	return _pRenderInstance->GetEngineLog();
 }
 
+JobSystem* RenderDevice::GetJobSystem() const
+{
+	return _pRenderInstance->GetJobSystem();
+}
+
 void RenderDevice::GetApiVersion(uint32_t& major, uint32_t& minor, uint32_t& patch)
 {
 	if (!_pHalRenderDevice)
@@ -509,21 +548,154 @@ void RenderDevice::ReleaseRenderPass(RenderPass* renderPass)
 
 RenderGraphicsPipeline* RenderDevice::CreateGraphicsPipeline(RenderGraphicsPipelineInfo& graphicsPipelineInfo)
 {
-	RenderGraphicsPipeline* graphicsPipeline = AllocateObject<RenderGraphicsPipeline>(*_pRenderInstance->GetEngineAllocator(), *this, graphicsPipelineInfo);
-	if (graphicsPipeline)
-		graphicsPipeline->AddRef();
+	const uint64_t stateHash = RenderGraphicsPipeline::ComputeStateHash(graphicsPipelineInfo);
+
+	RenderGraphicsPipeline* graphicsPipeline = nullptr;
+	{
+		std::lock_guard<std::mutex> lock(_graphicsPipelineMutex);
+		std::unordered_map<uint64_t, RenderGraphicsPipeline*>::iterator it = _graphicsPipelines.find(stateHash);
+		if (it != _graphicsPipelines.end() && it->second->MatchesState(graphicsPipelineInfo))
+		{
+			graphicsPipeline = it->second;
+			graphicsPipeline->AddRef();
+		}
+	}
+
+	if (!graphicsPipeline)
+	{
+		// compiled outside the lock. Once created the pipeline no longer points into the caller's objects
+		graphicsPipeline = AllocateObject<RenderGraphicsPipeline>(*_pRenderInstance->GetEngineAllocator(), *this, graphicsPipelineInfo);
+		if (graphicsPipeline)
+		{
+			graphicsPipeline->AddRef();
+			// Keep the first one if another thread was faster or the hash collides.
+			// Failed pipelines are not shared so the next request tries again
+			if (graphicsPipeline->IsReady())
+			{
+				std::lock_guard<std::mutex> lock(_graphicsPipelineMutex);
+				if (_graphicsPipelines.find(stateHash) == _graphicsPipelines.end())
+					_graphicsPipelines[stateHash] = graphicsPipeline;
+			}
+		}
+		return graphicsPipeline;
+	}
+
+	// the shared pipeline is still queued for background compilation, callers expect a usable pipeline.
+	// Compile it here or wait until its job finished, other queued compiles don't matter
+	if (graphicsPipeline->GetState() == RenderPipelineState::Pending)
+	{
+		if (!graphicsPipeline->Compile())
+			UnshareGraphicsPipeline(graphicsPipeline);
+	}
 
 	return graphicsPipeline;
 }
 
+RenderGraphicsPipeline* RenderDevice::CreateGraphicsPipelineAsync(RenderGraphicsPipelineInfo& graphicsPipelineInfo
+	, RenderGraphicsPipeline* fallback, const RenderPipelineCallback& callback)
+{
+	const uint64_t stateHash = RenderGraphicsPipeline::ComputeStateHash(graphicsPipelineInfo);
+
+	RenderGraphicsPipeline* graphicsPipeline = nullptr;
+	bool submit = false;
+	{
+		std::lock_guard<std::mutex> lock(_graphicsPipelineMutex);
+		std::unordered_map<uint64_t, RenderGraphicsPipeline*>::iterator it = _graphicsPipelines.find(stateHash);
+		if (it != _graphicsPipelines.end() && it->second->MatchesState(graphicsPipelineInfo))
+		{
+			graphicsPipeline = it->second;
+			graphicsPipeline->AddRef();
+		}
+		else
+		{
+			graphicsPipeline = AllocateObject<RenderGraphicsPipeline>(*_pRenderInstance->GetEngineAllocator(), *this, graphicsPipelineInfo, true);
+			if (!graphicsPipeline)
+				return nullptr;
+
+			// one reference for the caller, one for the compile job
+			graphicsPipeline->AddRef();
+			graphicsPipeline->AddRef();
+			if (fallback)
+			{
+				fallback->AddRef();
+				graphicsPipeline->SetFallback(fallback);
+			}
+			// a hash collision with other content is not shared
+			if (it == _graphicsPipelines.end())
+				_graphicsPipelines[stateHash] = graphicsPipeline;
+
+			submit = true;
+		}
+	}
+
+	// Submitted without the lock. A full worker queue runs the job inline
+	// and the job takes the lock to release its reference
+	if (submit)
+	{
+		_pipelineCompileSubmitted++;
+		GetJobSystem()->Submit([this, graphicsPipeline]()
+		{
+			if (graphicsPipeline->Compile())
+			{
+				_pipelineCompileCompleted++;
+			}
+			else
+			{
+				_pipelineCompileFailed++;
+				UnshareGraphicsPipeline(graphicsPipeline);
+			}
+
+			// may delete the pipeline if all users are gone already
+			ReleaseGraphicsPipeline(graphicsPipeline);
+		}, _pipelineCompileCounter);
+	}
+
+	if (callback)
+		graphicsPipeline->AddCallback(callback);
+
+	return graphicsPipeline;
+}
+
+void RenderDevice::GetPipelineCompileStats(RenderPipelineCompileStats& stats)
+{
+	stats._queueDepth = (_pipelineCompileCounter) ? static_cast<uint32_t>(_pipelineCompileCounter->GetValue()) : 0;
+	stats._submitted = _pipelineCompileSubmitted;
+	stats._completed = _pipelineCompileCompleted;
+	stats._failed = _pipelineCompileFailed;
+}
+
 void RenderDevice::ReleaseGraphicsPipeline(RenderGraphicsPipeline* graphicsPipeline)
 {
 	if (graphicsPipeline)
 	{
-		graphicsPipeline->Relase();
+		RenderGraphicsPipeline* fallback = nullptr;
+		{
+			std::lock_guard<std::mutex> lock(_graphicsPipelineMutex);
+			// the last user is gone, stop sharing the pipeline
+			if (graphicsPipeline->GetRefCount() == 1)
+			{
+				std::unordered_map<uint64_t, RenderGraphicsPipeline*>::iterator it = _graphicsPipelines.find(graphicsPipeline->GetStateHash());
+				if (it != _graphicsPipelines.end() && it->second == graphicsPipeline)
+					_graphicsPipelines.erase(it);
+				fallback = graphicsPipeline->GetFallback();
+			}
+			graphicsPipeline->Relase();
+		}
+
+		// drop the reference we took on the fallback
+		if (fallback)
+			ReleaseGraphicsPipeline(fallback);
 	}
 }
 
+void RenderDevice::UnshareGraphicsPipeline(RenderGraphicsPipeline* graphicsPipeline)
+{
+	std::lock_guard<std::mutex> lock(_graphicsPipelineMutex);
+	std::unordered_map<uint64_t, RenderGraphicsPipeline*>::iterator it = _graphicsPipelines.find(graphicsPipeline->GetStateHash());
+	if (it != _graphicsPipelines.end() && it->second == graphicsPipeline)
+		_graphicsPipelines.erase(it);
+}
+
 RenderFrameBuffer* RenderDevice::CreateFrameBuffer(RenderPass& renderPass,
     uint32_t width, uint32_t height, caveVector<RenderTarget*>& renderAttachments)
 {
@@ -795,10 +967,21 @@ void RenderDevice::CmdTransitionResource(RenderCommandBuffer* commandBuffer,
         _pHalRenderDevice->CmdTransitionResource(commandBuffer->GetHalHandle(), srcStageMask, dstStageMask, TransitionBarrierDes);
 }
 
-void RenderDevice::CmdBindGraphicsPipeline(RenderCommandBuffer* commandBuffer, RenderGraphicsPipeline* graphicsPipelineInfo)
+bool RenderDevice::CmdBindGraphicsPipeline(RenderCommandBuffer* commandBuffer, RenderGraphicsPipeline* graphicsPipelineInfo)
 {
-	if (commandBuffer && graphicsPipelineInfo)
-		_pHalRenderDevice->CmdBindGraphicsPipeline(commandBuffer->GetHalHandle(), graphicsPipelineInfo->GetHalHandle());
+	if (!commandBuffer || !graphicsPipelineInfo)
+		return false;
+
+	// still compiling in the background
+	if (!graphicsPipelineInfo->IsReady())
+	{
+		graphicsPipelineInfo = graphicsPipelineInfo->GetFallback();
+		if (!graphicsPipelineInfo || !graphicsPipelineInfo->IsReady())
+			return false;
+	}
+
+	_pHalRenderDevice->CmdBindGraphicsPipeline(commandBuffer->GetHalHandle(), graphicsPipelineInfo->GetHalHandle());
+	return true;
 }
 
 void RenderDevice::CmdBindVertexBuffers(RenderCommandBuffer* commandBuffer, uint32_t firstBinding, uint32_t bindingCount
@@ -944,4 +1127,120 @@ void RenderDevice::ReadPixels(void* data)
 		_pHalRenderDevice->ReadPixels(data);
 }
 
-}
\ No newline at end of file
+bool RenderDevice::SavePipelineCache()
+{
+	if (!_pHalRenderDevice || _pipelineCachePath.empty())
+		return false;
+
+	return _pHalRenderDevice->SavePipelineCache(_pipelineCachePath.c_str());
+}
+
+void RenderDevice::GetPipelineCacheStats(HalPipelineCacheStats& stats)
+{
+	if (!_pHalRenderDevice)
+		throw EngineError("Render device not properly setup");
+
+	_pHalRenderDevice->GetPipelineCacheStats(stats);
+}
+
+void RenderDevice::GetMemoryUsage(HalMemoryUsage& usage)
+{
+	if (!_pHalRenderDevice)
+		throw EngineError("Render device not properly setup");
+
+	_pHalRenderDevice->GetMemoryUsage(usage);
+}
+
+bool RenderDevice::DumpMemoryStats(const char* path)
+{
+	if (!_pHalRenderDevice)
+		throw EngineError("Render device not properly setup");
+
+	HalMemoryUsage usage;
+	HalUploadStats uploadStats;
+	std::vector<HalMemoryAllocation> allocations;
+	_pHalRenderDevice->GetMemoryUsage(usage);
+	_pHalRenderDevice->GetUploadStats(uploadStats);
+	_pHalRenderDevice->GetMemoryAllocations(allocations);
+
+	nlohmann::json snapshot;
+	nlohmann::json& heaps = snapshot["heaps"] = nlohmann::json::array();
+	for (uint32_t i = 0; i < usage._heapCount; i++)
+	{
+		const HalMemoryHeapUsage& heap = usage._heaps[i];
+		heaps.push_back({
+			{ "heapSize", heap._heapSize }, { "deviceLocal", heap._deviceLocal },
+			{ "blockCount", heap._blockCount }, { "blockSize", heap._blockSize }, { "usedSize", heap._usedSize },
+			{ "allocationCount", heap._allocationCount }, { "dedicatedCount", heap._dedicatedCount },
+			{ "dedicatedSize", heap._dedicatedSize }, { "budget", heap._budget }, { "usage", heap._usage } });
+	}
+
+	nlohmann::json& types = snapshot["types"] = nlohmann::json::array();
+	for (uint32_t i = 0; i < usage._typeCount; i++)
+	{
+		const HalMemoryTypeUsage& type = usage._types[i];
+		types.push_back({
+			{ "heapIndex", type._heapIndex }, { "deviceLocal", type._deviceLocal },
+			{ "hostVisible", type._hostVisible }, { "hostCoherent", type._hostCoherent },
+			{ "blockCount", type._blockCount }, { "blockSize", type._blockSize }, { "usedSize", type._usedSize },
+			{ "allocationCount", type._allocationCount }, { "freeRangeCount", type._freeRangeCount },
+			{ "largestFreeRange", type._largestFreeRange }, { "fragmentation", type._fragmentation } });
+	}
+
+	snapshot["budget"] = {
+		{ "driverBudget", usage._driverBudget }, { "fallbackCount", usage._fallbackCount },
+		{ "relocationCount", usage._relocationCount }, { "relocatedSize", usage._relocatedSize } };
+
+	snapshot["upload"] = {
+		{ "submitCount", uploadStats._submitCount }, { "copyCount", uploadStats._copyCount },
+		{ "commandCount", uploadStats._commandCount }, { "byteCount", uploadStats._byteCount },
+		{ "lastSubmitSize", uploadStats._lastSubmitSize }, { "directWriteCount", uploadStats._directWriteCount },
+		{ "directByteCount", uploadStats._directByteCount }, { "directMemorySize", uploadStats._directMemorySize },
+		{ "stagingSize", uploadStats._stagingSize }, { "stagingUsedSize", uploadStats._stagingUsedSize },
+		{ "stagingHighWater", uploadStats._stagingHighWater }, { "stagingWaitCount", uploadStats._stagingWaitCount },
+		{ "copyWaitCount", uploadStats._copyWaitCount } };
+
+	// one entry per used or free range, enough to draw a map of every block
+	nlohmann::json& ranges = snapshot["allocations"] = nlohmann::json::array();
+	for (const HalMemoryAllocation& allocation : allocations)
+	{
+		ranges.push_back({
+			{ "type", allocation._memoryType }, { "block", allocation._block },
+			{ "offset", allocation._offset }, { "size", allocation._size }, { "free", allocation._free },
+			{ "image", allocation._image }, { "movable", allocation._movable } });
+	}
+
+	std::ofstream out(path, std::ios::out | std::ios::trunc);
+	if (!out.is_open())
+		return false;
+
+	out << snapshot.dump(1, '\t') << "\n";
+
+	return out.good();
+}
+
+void RenderDevice::GetUploadStats(HalUploadStats& stats)
+{
+	if (!_pHalRenderDevice)
+		throw EngineError("Render device not properly setup");
+
+	_pHalRenderDevice->GetUploadStats(stats);
+}
+
+void RenderDevice::SetUploadPolicy(HalUploadPolicy policy)
+{
+	if (!_pHalRenderDevice)
+		throw EngineError("Render device not properly setup");
+
+	_pHalRenderDevice->SetUploadPolicy(policy);
+}
+
+uint32_t RenderDevice::DefragmentMemory(uint64_t maxBytes)
+{
+	if (!_pHalRenderDevice)
+		throw EngineError("Render device not properly setup");
+
+	return _pHalRenderDevice->DefragmentMemory(maxBytes);
+}
+
+}
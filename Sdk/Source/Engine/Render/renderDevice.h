@@ -17,11 +17,16 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SO
 ///       Render device interface
 
 #include "Resource/resourceManager.h"
+#include "renderGraphicsPipeline.h"
 #include "halRenderDevice.h"
 #include "engineTypes.h"
 #include "frontend.h"
 
 #include <map>
+#include <string>
+#include <unordered_map>
+#include <mutex>
+#include <atomic>
 
 /** @addtogroup engine
 *  @{
@@ -35,6 +40,8 @@ namespace cave
 class HalInstance;
 class HalRenderDevice;
 class RenderInstance;
+class JobSystem;
+class JobCounter;
 class RenderVertexInput;
 class RenderInputAssembly;
 struct RenderLayerSectionInfo;
@@ -100,6 +107,13 @@ public:
     */
     EngineLog* GetEngineLog() const;
 
+    /**
+    * @brief Get engine job system
+    *
+    * @return Pointer to job system
+    */
+    JobSystem* GetJobSystem() const;
+
     /**
     * @brief Query API version number
     *
@@ -545,6 +559,8 @@ public:
 
     /**
     * @brief Create a graphics pipeline object
+    *		 Pipelines are shared. If an existing pipeline was created from an equal setup
+    *		 (compared by the content of the referenced objects) it is returned with an added reference.
     *
     * @param[in] graphicsPipelineInfo	Graphics pipeline setup struct
     *
@@ -552,6 +568,28 @@ public:
     */
     RenderGraphicsPipeline* CreateGraphicsPipeline(RenderGraphicsPipelineInfo& graphicsPipelineInfo);
 
+    /**
+    * @brief Create a graphics pipeline compiled on a job system worker.
+    *		 Returns a pending pipeline immediately. Binding a pending pipeline binds the fallback instead
+    *		 or fails (see CmdBindGraphicsPipeline). Shared like pipelines from CreateGraphicsPipeline.
+    *		 The pipeline keeps the objects referenced by the setup alive until it is compiled.
+    *
+    * @param[in] graphicsPipelineInfo	Graphics pipeline setup struct
+    * @param[in] fallback				Pipeline bound while compiling (may be nullptr)
+    * @param[in] callback				Called on a worker thread once compilation finished (may be empty)
+    *
+    * @return RenderGraphicsPipeline object
+    */
+    RenderGraphicsPipeline* CreateGraphicsPipelineAsync(RenderGraphicsPipelineInfo& graphicsPipelineInfo
+        , RenderGraphicsPipeline* fallback = nullptr, const RenderPipelineCallback& callback = RenderPipelineCallback());
+
+    /**
+    * @brief Query background pipeline compilation statistics
+    *
+    * @param[out] stats	Receives queue depth and completion counts
+    */
+    void GetPipelineCompileStats(RenderPipelineCompileStats& stats);
+
     /**
     * @brief Release a graphics pipeline object
     *
@@ -648,11 +686,14 @@ public:
 
     /**
     * @brief Bind graphics pipeline
+    *		 A pending pipeline binds its fallback. Without a ready fallback nothing is bound.
     *
     * @param[in] commandBuffer			Command buffer we use for recording
     * @param[in] graphicsPipelineInfo	Graphics pipeline object
+    *
+    * @return false if nothing was bound. Skip the draws using this pipeline
     */
-    void CmdBindGraphicsPipeline(RenderCommandBuffer* commandBuffer, RenderGraphicsPipeline* graphicsPipelineInfo);
+    bool CmdBindGraphicsPipeline(RenderCommandBuffer* commandBuffer, RenderGraphicsPipeline* graphicsPipelineInfo);
 
     /**
     * @brief Bind vertex buffers to the command buffer
@@ -814,12 +855,88 @@ public:
     */
     void ReadPixels(void* data);
 
+    /**
+    * @brief Write the pipeline cache now instead of waiting for shutdown.
+    *		 Useful after a loading screen compiled a batch of pipelines.
+    *
+    * @return true if successful
+    */
+    bool SavePipelineCache();
+
+    /**
+    * @brief Query pipeline cache statistics
+    *
+    * @param[out] stats	Receives pipeline count, cache hits, misses and creation time
+    */
+    void GetPipelineCacheStats(HalPipelineCacheStats& stats);
+
+    /**
+    * @brief Query device memory usage per memory heap and memory type
+    *
+    * @param[out] usage	Receives block count, used bytes and dedicated allocations per heap,
+    *					free ranges, largest free range and fragmentation per memory type
+    */
+    void GetMemoryUsage(HalMemoryUsage& usage);
+
+    /**
+    * @brief Write a JSON snapshot of memory usage, upload statistics and the
+    * used and free ranges of all memory blocks for offline analysis
+    *
+    * @param[in] path	Output file
+    *
+    * @return false if writing failed
+    */
+    bool DumpMemoryStats(const char* path);
+
+    /**
+    * @brief Query upload batching statistics
+    *
+    * @param[out] stats	Receives copies requested, copy commands recorded and uploaded bytes per submission
+    */
+    void GetUploadStats(HalUploadStats& stats);
+
+    /**
+    * @brief Set how device local resources are filled.
+    * Direct writes skip the staging copy, but the caller must not update ranges the GPU still reads.
+    * Applies to resources bound afterwards.
+    *
+    * @param[in] policy	Upload policy (default HalUploadPolicy::Auto)
+    */
+    void SetUploadPolicy(HalUploadPolicy policy);
+
+    /**
+    * @brief Move resources out of the least used device memory block so it can be freed.
+    * Call it in idle frames, it waits for the device. Buffers written to descriptor sets
+    * and images with views stay in place. Moved resources get new low level handles,
+    * command buffers recorded with them must be recorded again.
+    *
+    * @param[in] maxBytes	Upper limit of bytes to move in this call
+    *
+    * @return number of resources moved
+    */
+    uint32_t DefragmentMemory(uint64_t maxBytes);
+
 private:
+    /**
+    * @brief Remove a pipeline from the shared map, e.g. after its compilation failed.
+    * Current users keep their reference.
+    *
+    * @param[in] graphicsPipeline	Pipeline to remove
+    */
+    void UnshareGraphicsPipeline(RenderGraphicsPipeline* graphicsPipeline);
+
     RenderInstance* _pRenderInstance;	///< Pointer to the render instance we belong to
     HalInstance* _pHalInstance;	///< Pointer to HAL Instance
     HalRenderDevice* _pHalRenderDevice;	///< Pointer to HAL render device
     ResourceManager* _pResourceManager;	///< Our device resource manager
     SwapChainInfo _swapChainInfo;	///< swap chain info
+    std::string _pipelineCachePath;	///< Pipeline cache file (empty if no content root is known)
+    std::unordered_map<uint64_t, RenderGraphicsPipeline*> _graphicsPipelines;	///< Shared graphics pipelines by create info hash
+    std::mutex _graphicsPipelineMutex;	///< Guards the shared pipeline map
+    JobCounter* _pipelineCompileCounter;	///< Outstanding background pipeline compilations
+    std::atomic<uint64_t> _pipelineCompileSubmitted;	///< Statistics
+    std::atomic<uint64_t> _pipelineCompileCompleted;	///< Statistics
+    std::atomic<uint64_t> _pipelineCompileFailed;	///< Statistics
 };
 
 }
@@ -19,6 +19,7 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SO
 #include "renderDevice.h"
 #include "engineError.h"
 #include "halDynamicState.h"
+#include "renderStateHash.h"
 
 #include <cassert>
 
@@ -29,6 +30,13 @@ RenderDynamicState::RenderDynamicState(RenderDevice& renderDevice
 	: CaveRefCount(renderDevice.GetEngineAllocator())
 	, _renderDevice(renderDevice)
 {
+	// content hash used to share pipelines
+	RenderStateHash hash;
+	hash.Add(static_cast<uint32_t>(dynamicStates.Size()));
+	for (size_t i = 0; i < dynamicStates.Size(); i++)
+		hash.Add(dynamicStates[i]);
+	_stateHash = hash.GetValue();
+
 	// Allocate low level object
 	_halDynamicState = renderDevice.GetHalRenderDevice()->CreateDynamicState(dynamicStates);
 	assert(_halDynamicState);
@@ -61,9 +61,17 @@ public:
 	*/
 	HalDynamicState* GetHalHandle() { return _halDynamicState; }
 
+	/**
+	* @brief Get the content hash used to share graphics pipelines
+	*
+	* @return hash value
+	*/
+	uint64_t GetStateHash() const { return _stateHash; }
+
 private:
 	RenderDevice& _renderDevice;	///< Render device object
 	HalDynamicState* _halDynamicState;	///< Pointer to low level dynamic state object
+	uint64_t _stateHash;	///< Content hash of the state
 };
 
 }
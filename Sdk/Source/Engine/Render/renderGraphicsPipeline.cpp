@@ -29,6 +29,7 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SO
 #include "renderDynamicState.h"
 #include "renderPipelineLayout.h"
 #include "renderRenderPass.h"
+#include "renderStateHash.h"
 #include "engineError.h"
 #include "halGraphicsPipeline.h"
 #include "halShader.h"
@@ -36,26 +37,61 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SO
 #include "Common/caveVector.h"
 
 #include <cassert>
+#include <cstring>
 
 namespace cave
 {
 RenderGraphicsPipeline::RenderGraphicsPipeline(RenderDevice& renderDevice
-	, RenderGraphicsPipelineInfo& graphicsPipelineInfo)
+	, RenderGraphicsPipelineInfo& graphicsPipelineInfo, bool deferred)
 	: CaveRefCount(renderDevice.GetEngineAllocator())
 	, _renderDevice(renderDevice)
+	, _halGraphicsPipeline(nullptr)
+	, _stateHash(ComputeStateHash(graphicsPipelineInfo))
+	, _createInfo(graphicsPipelineInfo)
+	, _material(nullptr)
+	, _viewport(nullptr)
+	, _holdsCreateInfo(false)
+	, _state(static_cast<uint32_t>(RenderPipelineState::Pending))
+	, _fallback(nullptr)
+{
+	ComputeStateKey(graphicsPipelineInfo, _stateKey);
+
+	if (!deferred)
+	{
+		// create the low level pipeline now, it points into the setup objects until then
+		bool success = Build() && _halGraphicsPipeline->CompilePipeline();
+		_state.store(static_cast<uint32_t>(success ? RenderPipelineState::Ready : RenderPipelineState::Failed), std::memory_order_release);
+		_createInfo = RenderGraphicsPipelineInfo();
+	}
+	else
+	{
+		HoldCreateInfo();
+	}
+}
+
+RenderGraphicsPipeline::~RenderGraphicsPipeline()
+{
+	// never compiled
+	ReleaseCreateInfo();
+
+	if (_halGraphicsPipeline)
+		DeallocateDelete(*_renderDevice.GetEngineAllocator(), *_halGraphicsPipeline);
+}
+
+bool RenderGraphicsPipeline::Build()
 {
 	HalGraphicsPipelineInfo graphicsPipeline;
 
 	// temp allocation
-	caveVector<HalShader*> stages(renderDevice.GetEngineAllocator());
-	if (graphicsPipelineInfo._material)
+	caveVector<HalShader*> stages(_renderDevice.GetEngineAllocator());
+	if (_createInfo._material)
 	{
-		graphicsPipelineInfo._material->Update(); // compile if needed
-		stages.Reserve(graphicsPipelineInfo._material->GetStageCount());
-		if (graphicsPipelineInfo._material->_vertexShader)
-			stages.Push(graphicsPipelineInfo._material->_vertexShader->GetHalHandle());
-		if (graphicsPipelineInfo._material->_fragmentShader)
-			stages.Push(graphicsPipelineInfo._material->_fragmentShader->GetHalHandle());
+		_createInfo._material->Update(); // compile if needed
+		stages.Reserve(_createInfo._material->GetStageCount());
+		if (_createInfo._material->_vertexShader)
+			stages.Push(_createInfo._material->_vertexShader->GetHalHandle());
+		if (_createInfo._material->_fragmentShader)
+			stages.Push(_createInfo._material->_fragmentShader->GetHalHandle());
 	}
 
 	graphicsPipeline._stageCount = static_cast<uint32_t>(stages.Size());
@@ -64,42 +100,193 @@ RenderGraphicsPipeline::RenderGraphicsPipeline(RenderDevice& renderDevice
 	// we need at least a vertex program
 	assert(graphicsPipeline._stageCount);
 
-	if (graphicsPipelineInfo._vertexInput)
-		graphicsPipeline._vertexInput = graphicsPipelineInfo._vertexInput->GetHalHandle();
-	if (graphicsPipelineInfo._inputAssembly)
-		graphicsPipeline._inputAssembly = graphicsPipelineInfo._inputAssembly->GetHalHandle();
-	if (graphicsPipelineInfo._viewport)
-		graphicsPipeline._viewport = graphicsPipelineInfo._viewport->GetHalHandle();
-	if (graphicsPipelineInfo._raterizer)
-		graphicsPipeline._raterizer = graphicsPipelineInfo._raterizer->GetHalHandle();
-	if (graphicsPipelineInfo._multisample)
-		graphicsPipeline._multisample = graphicsPipelineInfo._multisample->GetHalHandle();
-	if (graphicsPipelineInfo._depthStencil)
-		graphicsPipeline._depthStencil = graphicsPipelineInfo._depthStencil->GetHalHandle();
-	if (graphicsPipelineInfo._colorBlend)
-		graphicsPipeline._colorBlend = graphicsPipelineInfo._colorBlend->GetHalHandle();
-	if (graphicsPipelineInfo._dynamicState)
-		graphicsPipeline._dynamicState = graphicsPipelineInfo._dynamicState->GetHalHandle();
-	if (graphicsPipelineInfo._layout)
-		graphicsPipeline._layout = graphicsPipelineInfo._layout->GetHalHandle();
-	if (graphicsPipelineInfo._renderPass)
-		graphicsPipeline._renderPass = graphicsPipelineInfo._renderPass->GetHalHandle();
+	if (_createInfo._vertexInput)
+		graphicsPipeline._vertexInput = _createInfo._vertexInput->GetHalHandle();
+	if (_createInfo._inputAssembly)
+		graphicsPipeline._inputAssembly = _createInfo._inputAssembly->GetHalHandle();
+	if (_createInfo._viewport)
+		graphicsPipeline._viewport = _createInfo._viewport->GetHalHandle();
+	if (_createInfo._raterizer)
+		graphicsPipeline._raterizer = _createInfo._raterizer->GetHalHandle();
+	if (_createInfo._multisample)
+		graphicsPipeline._multisample = _createInfo._multisample->GetHalHandle();
+	if (_createInfo._depthStencil)
+		graphicsPipeline._depthStencil = _createInfo._depthStencil->GetHalHandle();
+	if (_createInfo._colorBlend)
+		graphicsPipeline._colorBlend = _createInfo._colorBlend->GetHalHandle();
+	if (_createInfo._dynamicState)
+		graphicsPipeline._dynamicState = _createInfo._dynamicState->GetHalHandle();
+	if (_createInfo._layout)
+		graphicsPipeline._layout = _createInfo._layout->GetHalHandle();
+	if (_createInfo._renderPass)
+		graphicsPipeline._renderPass = _createInfo._renderPass->GetHalHandle();
 	
 	// Allocate low level object
-	_halGraphicsPipeline = renderDevice.GetHalRenderDevice()->CreateGraphicsPipeline(graphicsPipeline);
+	_halGraphicsPipeline = _renderDevice.GetHalRenderDevice()->CreateGraphicsPipeline(graphicsPipeline);
 	assert(_halGraphicsPipeline);
+
+	return (_halGraphicsPipeline != nullptr);
 }
 
-RenderGraphicsPipeline::~RenderGraphicsPipeline()
+void RenderGraphicsPipeline::ComputeStateKey(const RenderGraphicsPipelineInfo& graphicsPipelineInfo, uint64_t* key)
 {
-	if (_halGraphicsPipeline)
-		DeallocateDelete(*_renderDevice.GetEngineAllocator(), *_halGraphicsPipeline);
+	const RenderMaterial* material = graphicsPipelineInfo._material;
+	key[0] = (material && material->_vertexShader) ? material->_vertexShader->GetStateHash() : 0;
+	key[1] = (material && material->_fragmentShader) ? material->_fragmentShader->GetStateHash() : 0;
+	key[2] = (graphicsPipelineInfo._vertexInput) ? graphicsPipelineInfo._vertexInput->GetStateHash() : 0;
+	key[3] = (graphicsPipelineInfo._inputAssembly) ? graphicsPipelineInfo._inputAssembly->GetStateHash() : 0;
+	key[4] = (graphicsPipelineInfo._viewport) ? graphicsPipelineInfo._viewport->GetStateHash() : 0;
+	key[5] = (graphicsPipelineInfo._raterizer) ? graphicsPipelineInfo._raterizer->GetStateHash() : 0;
+	key[6] = (graphicsPipelineInfo._multisample) ? graphicsPipelineInfo._multisample->GetStateHash() : 0;
+	key[7] = (graphicsPipelineInfo._depthStencil) ? graphicsPipelineInfo._depthStencil->GetStateHash() : 0;
+	key[8] = (graphicsPipelineInfo._colorBlend) ? graphicsPipelineInfo._colorBlend->GetStateHash() : 0;
+	key[9] = (graphicsPipelineInfo._dynamicState) ? graphicsPipelineInfo._dynamicState->GetStateHash() : 0;
+	key[10] = (graphicsPipelineInfo._layout) ? graphicsPipelineInfo._layout->GetStateHash() : 0;
+	key[11] = (graphicsPipelineInfo._renderPass) ? graphicsPipelineInfo._renderPass->GetStateHash() : 0;
+	key[12] = graphicsPipelineInfo._subpass;
+}
+
+void RenderGraphicsPipeline::HoldCreateInfo()
+{
+	std::shared_ptr<AllocatorBase> allocator = _renderDevice.GetEngineAllocator();
+
+	// the state objects are reference counted. Material and viewport are owned by others, we use copies
+	if (_createInfo._material)
+	{
+		_material = AllocateObject<RenderMaterial>(*allocator, *_createInfo._material);
+		_createInfo._material = _material;
+	}
+	if (_createInfo._viewport)
+	{
+		_viewport = AllocateObject<RenderViewportScissor>(*allocator, *_createInfo._viewport);
+		_createInfo._viewport = _viewport;
+	}
+	if (_createInfo._vertexInput)
+		_createInfo._vertexInput->AddRef();
+	if (_createInfo._inputAssembly)
+		_createInfo._inputAssembly->AddRef();
+	if (_createInfo._raterizer)
+		_createInfo._raterizer->AddRef();
+	if (_createInfo._multisample)
+		_createInfo._multisample->AddRef();
+	if (_createInfo._depthStencil)
+		_createInfo._depthStencil->AddRef();
+	if (_createInfo._colorBlend)
+		_createInfo._colorBlend->AddRef();
+	if (_createInfo._dynamicState)
+		_createInfo._dynamicState->AddRef();
+	if (_createInfo._layout)
+		_createInfo._layout->AddRef();
+	if (_createInfo._renderPass)
+		_createInfo._renderPass->AddRef();
+
+	// only a creation hint
+	_createInfo._basePipelineHandle = nullptr;
+	_holdsCreateInfo = true;
+}
+
+void RenderGraphicsPipeline::ReleaseCreateInfo()
+{
+	if (!_holdsCreateInfo)
+		return;
+
+	std::shared_ptr<AllocatorBase> allocator = _renderDevice.GetEngineAllocator();
+	if (_material)
+		DeallocateDelete(*allocator, *_material);
+	if (_viewport)
+		DeallocateDelete(*allocator, *_viewport);
+	if (_createInfo._vertexInput)
+		_createInfo._vertexInput->Relase();
+	if (_createInfo._inputAssembly)
+		_createInfo._inputAssembly->Relase();
+	if (_createInfo._raterizer)
+		_createInfo._raterizer->Relase();
+	if (_createInfo._multisample)
+		_createInfo._multisample->Relase();
+	if (_createInfo._depthStencil)
+		_createInfo._depthStencil->Relase();
+	if (_createInfo._colorBlend)
+		_createInfo._colorBlend->Relase();
+	if (_createInfo._dynamicState)
+		_createInfo._dynamicState->Relase();
+	if (_createInfo._layout)
+		_createInfo._layout->Relase();
+	if (_createInfo._renderPass)
+		_createInfo._renderPass->Relase();
+
+	_material = nullptr;
+	_viewport = nullptr;
+	_createInfo = RenderGraphicsPipelineInfo();
+	_holdsCreateInfo = false;
+}
+
+uint64_t RenderGraphicsPipeline::ComputeStateHash(const RenderGraphicsPipelineInfo& graphicsPipelineInfo)
+{
+	uint64_t key[RenderGraphicsPipelineKeySize];
+	ComputeStateKey(graphicsPipelineInfo, key);
+
+	RenderStateHash hash;
+	for (uint32_t i = 0; i < RenderGraphicsPipelineKeySize; i++)
+		hash.Add(key[i]);
+
+	return hash.GetValue();
+}
+
+bool RenderGraphicsPipeline::MatchesState(const RenderGraphicsPipelineInfo& graphicsPipelineInfo) const
+{
+	uint64_t key[RenderGraphicsPipelineKeySize];
+	ComputeStateKey(graphicsPipelineInfo, key);
+
+	return memcmp(key, _stateKey, sizeof(_stateKey)) == 0;
 }
 
 void RenderGraphicsPipeline::Update()
 {
-	if (_halGraphicsPipeline)
+	// a pending pipeline is owned by its compile job
+	if (_halGraphicsPipeline && IsReady())
 		_halGraphicsPipeline->CompilePipeline();
 }
 
+bool RenderGraphicsPipeline::Compile()
+{
+	bool success = false;
+	{
+		// a second caller waits here until the first one is done
+		std::lock_guard<std::mutex> compileLock(_compileMutex);
+		if (GetState() != RenderPipelineState::Pending)
+			return IsReady();
+
+		success = Build() && _halGraphicsPipeline->CompilePipeline();
+
+		// the referenced objects may go away now
+		ReleaseCreateInfo();
+
+		_state.store(static_cast<uint32_t>(success ? RenderPipelineState::Ready : RenderPipelineState::Failed), std::memory_order_release);
+	}
+
+	std::vector<RenderPipelineCallback> callbacks;
+	{
+		std::lock_guard<std::mutex> lock(_callbackMutex);
+		callbacks.swap(_callbacks);
+	}
+	for (size_t i = 0; i < callbacks.size(); i++)
+		callbacks[i](this, success);
+
+	return success;
+}
+
+void RenderGraphicsPipeline::AddCallback(const RenderPipelineCallback& callback)
+{
+	{
+		std::lock_guard<std::mutex> lock(_callbackMutex);
+		if (GetState() == RenderPipelineState::Pending)
+		{
+			_callbacks.push_back(callback);
+			return;
+		}
+	}
+
+	callback(this, IsReady());
+}
+
 }
@@ -22,6 +22,10 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SO
 #include "halTypes.h"
 
 #include <memory>
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <functional>
 
 /** \addtogroup engine
 *  @{
@@ -87,6 +91,38 @@ struct CAVE_INTERFACE RenderGraphicsPipelineInfo
 	}
 };
 
+/// Number of values a graphics pipeline is keyed by: one content hash per referenced object and the subpass
+static const uint32_t RenderGraphicsPipelineKeySize = 13;
+
+/**
+* @brief Compile state of a graphics pipeline
+*/
+enum class RenderPipelineState : uint32_t
+{
+	Pending = 0,	///< Waiting for or in background compilation
+	Ready = 1,		///< Can be bound
+	Failed = 2		///< Compilation failed
+};
+
+/// Called once a background compilation finished. The bool is true on success. Runs on a worker thread
+typedef std::function<void(RenderGraphicsPipeline*, bool)> RenderPipelineCallback;
+
+/**
+* @brief Background pipeline compilation statistics
+*/
+struct CAVE_INTERFACE RenderPipelineCompileStats
+{
+	uint32_t _queueDepth;	///< Pipelines waiting for or in compilation
+	uint64_t _submitted;	///< Pipelines handed to background compilation
+	uint64_t _completed;	///< Successfully compiled pipelines
+	uint64_t _failed;		///< Failed compilations
+
+	RenderPipelineCompileStats()
+		: _queueDepth(0), _submitted(0), _completed(0), _failed(0)
+	{
+	}
+};
+
 /**
 * @brief Interface for graphics pipeline setup
 */
@@ -99,9 +135,13 @@ public:
 	*
 	* @param[in] renderDevice			Pointer to render device
 	* @param[in] graphicsPipelineInfo	Graphics pipeline setup struct
+	* @param[in] deferred				Skip building the pipeline, Compile does it later.
+	*									The pipeline holds references to the setup objects until then.
+	*									Otherwise the low level pipeline is created right away and
+	*									the setup objects are no longer referenced afterwards.
 	*
 	*/
-	RenderGraphicsPipeline(RenderDevice& renderDevice, RenderGraphicsPipelineInfo& graphicsPipelineInfo);
+	RenderGraphicsPipeline(RenderDevice& renderDevice, RenderGraphicsPipelineInfo& graphicsPipelineInfo, bool deferred = false);
 
 	/** @brief destructor */
 	virtual ~RenderGraphicsPipeline();
@@ -114,6 +154,42 @@ public:
 	*/
 	void Update();
 
+	/**
+	* @brief Build the pipeline including its shaders and create the low level pipeline.
+	*		 Used by background compilation. Notifies registered callbacks.
+	*		 Safe to call from several threads, one compiles while the others wait for this pipeline only.
+	*
+	* @return true if successful
+	*/
+	bool Compile();
+
+	/** @brief Get compile state */
+	RenderPipelineState GetState() const { return static_cast<RenderPipelineState>(_state.load(std::memory_order_acquire)); }
+
+	/** @brief Check if the pipeline can be bound */
+	bool IsReady() const { return GetState() == RenderPipelineState::Ready; }
+
+	/**
+	* @brief Get the pipeline bound while this one is pending
+	*
+	* @return fallback pipeline or nullptr
+	*/
+	RenderGraphicsPipeline* GetFallback() const { return _fallback; }
+
+	/**
+	* @brief Set the pipeline bound while this one is pending. The caller passes a reference to it
+	*
+	* @param[in] fallback	Fallback pipeline
+	*/
+	void SetFallback(RenderGraphicsPipeline* fallback) { _fallback = fallback; }
+
+	/**
+	* @brief Register a completion callback. Called immediately if the pipeline is not pending
+	*
+	* @param[in] callback	Completion callback
+	*/
+	void AddCallback(const RenderPipelineCallback& callback);
+
 	/**
 	* @brief Get low level HAL handle
 	*
@@ -121,9 +197,69 @@ public:
 	*/
 	HalGraphicsPipeline* GetHalHandle() { return _halGraphicsPipeline; }
 
+	/**
+	* @brief Get the hash of the create info this pipeline was built from
+	*
+	* @return hash value
+	*/
+	uint64_t GetStateHash() const { return _stateHash; }
+
+	/**
+	* @brief Hash a pipeline create info by the content of the referenced objects.
+	*		 Create infos with equal hashes result in interchangeable pipelines.
+	*		 The base pipeline is only a creation hint and not part of the hash.
+	*
+	* @param[in] graphicsPipelineInfo	Graphics pipeline setup struct
+	*
+	* @return hash value
+	*/
+	static uint64_t ComputeStateHash(const RenderGraphicsPipelineInfo& graphicsPipelineInfo);
+
+	/**
+	* @brief Check if a create info results in this pipeline. Compares the content hash of every
+	*		 referenced object, equal combined hashes alone don't make pipelines interchangeable.
+	*
+	* @param[in] graphicsPipelineInfo	Graphics pipeline setup struct
+	*
+	* @return true if the pipeline can be shared
+	*/
+	bool MatchesState(const RenderGraphicsPipelineInfo& graphicsPipelineInfo) const;
+
 private:
+	/**
+	* @brief Get the values a create info is keyed by
+	*
+	* @param[in] graphicsPipelineInfo	Graphics pipeline setup struct
+	* @param[out] key					Receives the key values
+	*/
+	static void ComputeStateKey(const RenderGraphicsPipelineInfo& graphicsPipelineInfo, uint64_t* key);
+
+	/**
+	* @brief Compile the shaders and create the low level pipeline object
+	*
+	* @return true if successful
+	*/
+	bool Build();
+
+	/** @brief Keep the objects referenced by the deferred setup alive */
+	void HoldCreateInfo();
+
+	/** @brief Drop the references taken by HoldCreateInfo */
+	void ReleaseCreateInfo();
+
 	RenderDevice& _renderDevice;	///< Render device object
 	HalGraphicsPipeline* _halGraphicsPipeline;	///< Pointer to low level graphics pipeline object
+	uint64_t _stateHash;	///< Hash of the create info
+	uint64_t _stateKey[RenderGraphicsPipelineKeySize];	///< Content hashes of the create info objects
+	RenderGraphicsPipelineInfo _createInfo;	///< Setup kept for deferred building
+	RenderMaterial* _material;	///< Copy of the deferred setup material
+	RenderViewportScissor* _viewport;	///< Copy of the deferred setup viewport
+	bool _holdsCreateInfo;	///< We hold references to the setup objects
+	std::mutex _compileMutex;	///< Serializes compilation
+	std::atomic<uint32_t> _state;	///< RenderPipelineState
+	RenderGraphicsPipeline* _fallback;	///< Bound while pending (we hold a reference)
+	std::mutex _callbackMutex;	///< Guards the callback list
+	std::vector<RenderPipelineCallback> _callbacks;	///< Called when compilation finished
 };
 
 }
@@ -19,6 +19,7 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SO
 #include "renderDevice.h"
 #include "engineError.h"
 #include "halInputAssembly.h"
+#include "renderStateHash.h"
 
 #include <cassert>
 
@@ -28,6 +29,12 @@ RenderInputAssembly::RenderInputAssembly(RenderDevice& renderDevice, HalInputAss
 	: CaveRefCount(renderDevice.GetEngineAllocator())
 	, _renderDevice(renderDevice)
 {
+	// content hash used to share pipelines
+	RenderStateHash hash;
+	hash.Add(inputAssemblyState._topology);
+	hash.Add(inputAssemblyState._primitiveRestartEnable);
+	_stateHash = hash.GetValue();
+
 	// Allocate low level object
 	_halInputAssembly = renderDevice.GetHalRenderDevice()->CreateInputAssembly(inputAssemblyState);
 	assert(_halInputAssembly);
@@ -59,9 +59,17 @@ public:
 	*/
 	HalInputAssembly* GetHalHandle() { return _halInputAssembly; }
 
+	/**
+	* @brief Get the content hash used to share graphics pipelines
+	*
+	* @return hash value
+	*/
+	uint64_t GetStateHash() const { return _stateHash; }
+
 private:
 	RenderDevice& _renderDevice;	///< Render device object
 	HalInputAssembly* _halInputAssembly;	///< Pointer to low level input assembly object
+	uint64_t _stateHash;	///< Content hash of the state
 };
 
 }
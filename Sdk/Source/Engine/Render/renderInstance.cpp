@@ -70,6 +70,11 @@ EngineLog* RenderInstance::GetEngineLog() const
 	return _pEngineInstance->GetEngineLog();
 }
 
+JobSystem* RenderInstance::GetJobSystem() const
+{
+	return _pEngineInstance->GetJobSystem();
+}
+
 RenderDevice* RenderInstance::CreateRenderDevice(FrontendWindowInfo& windowInfo)
 {
 	RenderDevice* renderDevice = nullptr;
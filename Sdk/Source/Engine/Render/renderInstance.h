@@ -35,6 +35,7 @@ namespace cave
 class EngineInstancePrivate;
 class RenderDevice;
 class EngineLog;
+class JobSystem;
 
 /**
 * Abstraction type of a device instance
@@ -68,6 +69,13 @@ public:
 	*/
 	EngineLog* GetEngineLog() const;
 
+	/**
+	* @brief Get engine job system
+	*
+	* @return Pointer to job system
+	*/
+	JobSystem* GetJobSystem() const;
+
 	/**
 	* @brief Create a render device
 	*
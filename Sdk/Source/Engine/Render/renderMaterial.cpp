@@ -48,7 +48,7 @@ RenderMaterial& RenderMaterial::operator=(const RenderMaterial& rhs)
 {
 	_vertexShader = rhs._vertexShader;
 	_fragmentShader = rhs._fragmentShader;
-	_renderDevice = rhs._renderDevice;
+	// _renderDevice is a reference, materials are only assigned within the same device
 
 	// copy data
 	_materialData = rhs._materialData;
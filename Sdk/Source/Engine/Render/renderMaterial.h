@@ -121,6 +121,17 @@ public:
 	*/
 	void Update();
 
+	/**
+	* @brief Set all material values
+	*
+	* @param[in] materialData	Material values
+	*
+	*/
+	void SetMaterialData(const RenderMaterialDataStruct& materialData)
+	{
+		_materialData = materialData;
+	}
+
 	/**
 	* @brief Set ambient color
 	*
@@ -19,6 +19,7 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SO
 #include "renderDevice.h"
 #include "engineError.h"
 #include "halMultisample.h"
+#include "renderStateHash.h"
 
 #include <cassert>
 
@@ -28,6 +29,21 @@ RenderMultisample::RenderMultisample(RenderDevice& renderDevice, HalMultisampleS
 	: CaveRefCount(renderDevice.GetEngineAllocator())
 	, _renderDevice(renderDevice)
 {
+	// content hash used to share pipelines
+	RenderStateHash hash;
+	hash.Add(multisampleInfo._alphaToCoverageEnable);
+	hash.Add(multisampleInfo._alphaToOneEnable);
+	hash.Add(multisampleInfo._minSampleShading);
+	hash.Add(multisampleInfo._rasterizationSamples);
+	hash.Add(multisampleInfo._sampleShadingEnable);
+	if (multisampleInfo._pSampleMask)
+	{
+		// one mask word per 32 samples
+		uint32_t wordCount = (static_cast<uint32_t>(multisampleInfo._rasterizationSamples) + 31) / 32;
+		hash.AddBytes(multisampleInfo._pSampleMask, wordCount * sizeof(uint32_t));
+	}
+	_stateHash = hash.GetValue();
+
 	// Allocate low level object
 	_halMultisample = renderDevice.GetHalRenderDevice()->CreateMultisampleState(multisampleInfo);
 	assert(_halMultisample);
@@ -59,9 +59,17 @@ public:
 	*/
 	HalMultisample* GetHalHandle() { return _halMultisample; }
 
+	/**
+	* @brief Get the content hash used to share graphics pipelines
+	*
+	* @return hash value
+	*/
+	uint64_t GetStateHash() const { return _stateHash; }
+
 private:
 	RenderDevice& _renderDevice;	///< Render device object
 	HalMultisample* _halMultisample;	///< Pointer to low level multisample state object
+	uint64_t _stateHash;	///< Content hash of the state
 };
 
 }
@@ -20,6 +20,7 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SO
 #include "renderDevice.h"
 #include "engineError.h"
 #include "halPipelineLayout.h"
+#include "renderStateHash.h"
 
 #include <cassert>
 
@@ -32,6 +33,18 @@ RenderPipelineLayout::RenderPipelineLayout(RenderDevice& renderDevice
 	, _renderDevice(renderDevice)
 {
 	HalDescriptorSet* pDescriptorSet = (descriptorSet) ? descriptorSet->GetHalHandle() : nullptr;
+	// content hash used to share pipelines. Layouts with equal content are compatible
+	RenderStateHash hash;
+	hash.Add<uint64_t>((descriptorSet) ? descriptorSet->GetStateHash() : 0);
+	hash.Add(static_cast<uint32_t>(pushConstants.Size()));
+	for (size_t i = 0; i < pushConstants.Size(); i++)
+	{
+		hash.Add(pushConstants[i]._shaderStagesFlags);
+		hash.Add(pushConstants[i]._offset);
+		hash.Add(pushConstants[i]._size);
+	}
+	_stateHash = hash.GetValue();
+
 	// Allocate low level object
 	_halPipelineLayout = renderDevice.GetHalRenderDevice()->CreatePipelineLayout(pDescriptorSet, pushConstants);
 	assert(_halPipelineLayout);
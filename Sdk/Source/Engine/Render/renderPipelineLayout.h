@@ -65,9 +65,17 @@ public:
 	*/
 	HalPipelineLayout* GetHalHandle() { return _halPipelineLayout; }
 
+	/**
+	* @brief Get the content hash used to share graphics pipelines
+	*
+	* @return hash value
+	*/
+	uint64_t GetStateHash() const { return _stateHash; }
+
 private:
 	RenderDevice& _renderDevice;	///< Render device object
 	HalPipelineLayout* _halPipelineLayout;	///< Pointer to low level pipeline layout object
+	uint64_t _stateHash;	///< Content hash of the state
 };
 
 }
@@ -19,6 +19,7 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SO
 #include "renderDevice.h"
 #include "engineError.h"
 #include "halRasterizerState.h"
+#include "renderStateHash.h"
 
 #include <cassert>
 
@@ -28,6 +29,20 @@ RenderRasterizerState::RenderRasterizerState(RenderDevice& renderDevice, HalRast
 	: CaveRefCount(renderDevice.GetEngineAllocator())
 	, _renderDevice(renderDevice)
 {
+	// content hash used to share pipelines
+	RenderStateHash hash;
+	hash.Add(rasterizerInfo._cullMode);
+	hash.Add(rasterizerInfo._frontFace);
+	hash.Add(rasterizerInfo._depthClampEnable);
+	hash.Add(rasterizerInfo._depthBiasEnable);
+	hash.Add(rasterizerInfo._depthBiasConstantFactor);
+	hash.Add(rasterizerInfo._depthBiasClamp);
+	hash.Add(rasterizerInfo._depthBiasSlopeFactor);
+	hash.Add(rasterizerInfo._lineWidth);
+	hash.Add(rasterizerInfo._polygonMode);
+	hash.Add(rasterizerInfo._rasterizerDiscardEnable);
+	_stateHash = hash.GetValue();
+
 	// Allocate low level object
 	_halRasterizerState = renderDevice.GetHalRenderDevice()->CreateRasterizerState(rasterizerInfo);
 	assert(_halRasterizerState);
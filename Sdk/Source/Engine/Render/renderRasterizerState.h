@@ -59,9 +59,17 @@ public:
 	*/
 	HalRasterizerState* GetHalHandle() { return _halRasterizerState; }
 
+	/**
+	* @brief Get the content hash used to share graphics pipelines
+	*
+	* @return hash value
+	*/
+	uint64_t GetStateHash() const { return _stateHash; }
+
 private:
 	RenderDevice& _renderDevice;	///< Render device object
 	HalRasterizerState* _halRasterizerState;	///< Pointer to low level rasterizer state object
+	uint64_t _stateHash;	///< Content hash of the state
 };
 
 }
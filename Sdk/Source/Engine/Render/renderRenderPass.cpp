@@ -19,15 +19,68 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SO
 #include "renderDevice.h"
 #include "engineError.h"
 #include "halRenderPass.h"
+#include "renderStateHash.h"
 
 #include <cassert>
 
 namespace cave
 {
+static void HashAttachmentReferences(RenderStateHash& hash, uint32_t count, const HalAttachmentReference* references)
+{
+	hash.Add(count);
+	for (uint32_t i = 0; i < count; i++)
+	{
+		hash.Add(references[i]._attachment);
+		hash.Add(references[i]._layout);
+	}
+}
+
 RenderPass::RenderPass(RenderDevice& renderDevice, HalRenderPassInfo& renderPassInfo)
 	: CaveRefCount(renderDevice.GetEngineAllocator())
 	, _renderDevice(renderDevice)
 {
+	// content hash used to share pipelines. Render passes with equal content are compatible
+	RenderStateHash hash;
+	hash.Add(renderPassInfo._attachmentCount);
+	for (uint32_t i = 0; i < renderPassInfo._attachmentCount; i++)
+	{
+		const HalRenderPassAttachment& attachment = renderPassInfo._pAttachments[i];
+		hash.Add(attachment._format);
+		hash.Add(attachment._samples);
+		hash.Add(attachment._loadOp);
+		hash.Add(attachment._storeOp);
+		hash.Add(attachment._loadStencilOp);
+		hash.Add(attachment._storeStencilOp);
+		hash.Add(attachment._initialLayout);
+		hash.Add(attachment._finalLayout);
+	}
+	hash.Add(renderPassInfo._subpassCount);
+	for (uint32_t i = 0; i < renderPassInfo._subpassCount; i++)
+	{
+		const HalSubpassDescription& subpass = renderPassInfo._pSubpasses[i];
+		hash.Add(subpass._pipelineBindPoint);
+		HashAttachmentReferences(hash, subpass._inputAttachmentCount, subpass._pInputAttachments);
+		HashAttachmentReferences(hash, subpass._colorAttachmentCount, subpass._pColorAttachments);
+		HashAttachmentReferences(hash, (subpass._pResolveAttachments) ? subpass._colorAttachmentCount : 0, subpass._pResolveAttachments);
+		HashAttachmentReferences(hash, (subpass._pDepthStencilAttachment) ? 1 : 0, subpass._pDepthStencilAttachment);
+		hash.Add(subpass._preserveAttachmentCount);
+		for (uint32_t j = 0; j < subpass._preserveAttachmentCount; j++)
+			hash.Add(subpass._pPreserveAttachments[j]);
+	}
+	hash.Add(renderPassInfo._dependencyCount);
+	for (uint32_t i = 0; i < renderPassInfo._dependencyCount; i++)
+	{
+		const HalSubpassDependency& dependency = renderPassInfo._pDependencies[i];
+		hash.Add(dependency._srcSubpass);
+		hash.Add(dependency._dstSubpass);
+		hash.Add(dependency._srcStageMask);
+		hash.Add(dependency._dstStageMask);
+		hash.Add(dependency._srcAccessMask);
+		hash.Add(dependency._dstAccessMask);
+		hash.Add(dependency._dependencyFlags);
+	}
+	_stateHash = hash.GetValue();
+
 	// Allocate low level object
     try
     {
@@ -59,9 +59,17 @@ public:
 	*/
 	HalRenderPass* GetHalHandle() { return _halRenderPass; }
 
+	/**
+	* @brief Get the content hash used to share graphics pipelines
+	*
+	* @return hash value
+	*/
+	uint64_t GetStateHash() const { return _stateHash; }
+
 private:
 	RenderDevice& _renderDevice;	///< Render device object
 	HalRenderPass* _halRenderPass;	///< Pointer to low level render pass object
+	uint64_t _stateHash;	///< Content hash of the state
 };
 
 }
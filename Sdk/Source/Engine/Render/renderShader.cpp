@@ -20,6 +20,7 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SO
 #include "engineError.h"
 #include "engineLog.h"
 #include "halShader.h"
+#include "renderStateHash.h"
 
 #include <cstring>
 #include <cassert>
@@ -33,6 +34,7 @@ RenderShader::RenderShader(RenderDevice& renderDevice, const char* shaderType, c
 	, _halShader(nullptr)
 	, _sourceSize(0)
 	, _source(nullptr)
+	, _compiled(false)
 	, _refCount(0)
 {
 	// convert to enums
@@ -40,6 +42,14 @@ RenderShader::RenderShader(RenderDevice& renderDevice, const char* shaderType, c
 	ShaderLanguage language = HalShader::ConvertToShaderLanguage(shaderLanguage);
 	assert(type != ShaderType::Unknown && language != ShaderLanguage::Unknown);
 
+	RenderStateHash typeHash;
+	typeHash.Add(type);
+	typeHash.Add(language);
+	_typeHash = typeHash.GetValue();
+	_entryHash = RenderStateHash().GetValue();
+	_sourceHash = RenderStateHash().GetValue();
+	_constantHash = 0;
+
 	// Allocate low level object
 	_halShader = renderDevice.GetHalRenderDevice()->CreateShader(type, language);
 	assert(_halShader);
@@ -67,25 +77,34 @@ void RenderShader::DecrementUsageCount()
 
 void RenderShader::SetShaderSource(const std::vector<char>& code)
 {
-	if (_sourceSize > 0 || _source)
+	SetShaderSource(code.data(), code.size());
+}
+
+void RenderShader::SetShaderSource(const char* code, size_t size)
+{
+	if (_sourceSize > 0 || _source || _compiled)
 	{
 		// we already have the source
 		_renderDevice.GetEngineLog()->Error("Warning: Source code already set");
 		return;
 	}
 
-	if (code.empty())
+	if (!code || size == 0)
 	{
 		// no code
 		_renderDevice.GetEngineLog()->Error("Warning: No source code provided");
 		return;
 	}
 
-	_source = (char *)_renderDevice.GetEngineAllocator()->Allocate(code.size(), 4);
+	_source = (char *)_renderDevice.GetEngineAllocator()->Allocate(size, 4);
 	if (_source)
 	{
-		_sourceSize = code.size();
-		memcpy(_source, code.data(), _sourceSize);
+		_sourceSize = size;
+		memcpy(_source, code, _sourceSize);
+
+		RenderStateHash sourceHash;
+		sourceHash.AddBytes(_source, _sourceSize);
+		_sourceHash = sourceHash.GetValue();
 	}
 }
 
@@ -95,18 +114,72 @@ void RenderShader::SetShaderEntryFunc(const char* funcName)
 		return;
 
 	_halShader->SetShaderEntryFunc(funcName);
+
+	RenderStateHash entryHash;
+	entryHash.AddString(funcName);
+	_entryHash = entryHash.GetValue();
+}
+
+void RenderShader::SetSpecializationConstants(const HalSpecializationConstant* constants, uint32_t count)
+{
+	if (!_halShader)
+		return;
+
+	if (_compiled)
+		_renderDevice.GetEngineLog()->Error("Warning: Specialization constants set after the shader was used");
+
+	_halShader->SetSpecializationConstants(constants, count);
+	_constantHash = HashSpecializationConstants(constants, count);
+}
+
+uint64_t RenderShader::HashSpecializationConstants(const HalSpecializationConstant* constants, uint32_t count)
+{
+	if (!constants || count == 0)
+		return 0;
+
+	RenderStateHash hash;
+	hash.Add(count);
+	for (uint32_t i = 0; i < count; i++)
+	{
+		hash.Add(constants[i]._constantId);
+		hash.Add(constants[i]._value);
+	}
+
+	return hash.GetValue();
+}
+
+uint64_t RenderShader::GetStateHash() const
+{
+	RenderStateHash hash;
+	hash.Add(_typeHash);
+	hash.Add(_entryHash);
+	hash.Add(_constantHash);
+	hash.Add(_sourceHash);
+	return hash.GetValue();
 }
 
 bool RenderShader::CompileShader()
 {
+	std::lock_guard<std::mutex> lock(_compileMutex);
+	if (_compiled)
+		return true;
+
 	if (!_halShader || !_source || !_sourceSize)
 		return false;
 
 	bool success =  _halShader->CompileShader(_source, _sourceSize);
 	if (!success)
+	{
 		_renderDevice.GetEngineLog()->Error("Error: Failed to compile shader");
+		return false;
+	}
+
+	// the module holds the code now
+	_renderDevice.GetEngineAllocator()->Deallocate(_source);
+	_source = nullptr;
+	_compiled = true;
 
-	return success;
+	return true;
 }
 
 }
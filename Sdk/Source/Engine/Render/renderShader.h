@@ -35,6 +35,7 @@ namespace cave
 /// forward declaration
 class HalShader;
 class RenderDevice;
+struct HalSpecializationConstant;
 
 /**
 * Interface of renderer materials
@@ -77,6 +78,15 @@ public:
 	*/
 	void SetShaderSource(const std::vector<char>& code);
 
+	/**
+	* @brief Set shader source code from a memory range (e.g. a mapped file)
+	*
+	* @param[in] code	Pointer to source code (Readable shader code or byte code)
+	* @param[in] size	Size of the code in bytes
+	*
+	*/
+	void SetShaderSource(const char* code, size_t size);
+
 	/**
 	* @brief Set shader entry function
 	*
@@ -86,7 +96,29 @@ public:
 	void SetShaderEntryFunc(const char* funcName);
 
 	/**
-	* @brief[in] Compile a shader and create a vulkan shader module
+	* @brief Set the specialization constants of this shader.
+	*		 Must be set before the first pipeline uses the shader.
+	*
+	* @param[in] constants	Constant array (may be nullptr if count is 0)
+	* @param[in] count		Number of constants
+	*
+	*/
+	void SetSpecializationConstants(const HalSpecializationConstant* constants, uint32_t count);
+
+	/**
+	* @brief Hash a set of specialization constants.
+	*		 Shaders are shared by content, the hash keeps shaders with different constants apart.
+	*
+	* @param[in] constants	Constant array (may be nullptr if count is 0)
+	* @param[in] count		Number of constants
+	*
+	* @return hash value, 0 if there are no constants
+	*/
+	static uint64_t HashSpecializationConstants(const HalSpecializationConstant* constants, uint32_t count);
+
+	/**
+	* @brief[in] Compile a shader and create a vulkan shader module.
+	*		 Called on first pipeline use, later calls return immediately. Thread safe.
 	*
 	* @return true if compiling was successful
 	*/
@@ -99,13 +131,27 @@ public:
 	*/
 	HalShader* GetHalHandle() { return _halShader; }
 
+	/**
+	* @brief Get the content hash used to share graphics pipelines.
+	*		 Covers type, language, entry function, specialization constants and source code.
+	*
+	* @return hash value
+	*/
+	uint64_t GetStateHash() const;
+
 private:
 	RenderDevice& _renderDevice;	///< Render device object
 	HalShader* _halShader;	///< Pointer to low level shader object
 	size_t _sourceSize;	///< Size of source code in bytes
-	char* _source;	///< Pointer to source code might be a readable string or byte code
+	char* _source;	///< Pointer to source code might be a readable string or byte code (released once compiled)
+	bool _compiled;	///< Shader module was created
 	int32_t _refCount;	///< Our reference count
 	class CAVE_INTERFACE std::mutex _refCountMutex; ///< mutex object for ref counter
+	uint64_t _typeHash;	///< Hash of shader type and language
+	uint64_t _entryHash;	///< Hash of the entry function name
+	uint64_t _sourceHash;	///< Hash of the source code (kept after the source is released)
+	uint64_t _constantHash;	///< Hash of the specialization constants
+	std::mutex _compileMutex;	///< Serializes compilation (pipelines compile on worker threads)
 };
 
 }
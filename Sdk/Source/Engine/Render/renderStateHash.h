@@ -0,0 +1,102 @@
+/*
+Copyright (c) <2017> <Udo Lugauer>
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE
+*/
+#pragma once
+
+/// @file renderStateHash.h
+///       Content hash of render state objects
+
+#include "engineDefines.h"
+
+#include <cstdint>
+#include <cstring>
+
+/** \addtogroup engine
+*  @{
+*		This module contains all code related to the engine
+*/
+
+namespace cave
+{
+
+/**
+* @brief Incremental FNV-1a hash used to key render state objects by content.
+*		 Values are added member by member, so structure padding never enters the hash.
+*/
+class RenderStateHash
+{
+public:
+	/** @brief Constructor */
+	RenderStateHash()
+		: _value(0xcbf29ce484222325ull)
+	{}
+
+	/**
+	* @brief Add raw bytes
+	*
+	* @param[in] data	Data to hash
+	* @param[in] size	Size in bytes
+	*/
+	void AddBytes(const void* data, size_t size)
+	{
+		const uint8_t* bytes = static_cast<const uint8_t*>(data);
+		for (size_t i = 0; i < size; i++)
+		{
+			_value ^= bytes[i];
+			_value *= 0x100000001b3ull;
+		}
+	}
+
+	/**
+	* @brief Add a scalar, enum or pointer value
+	*
+	* @param[in] value	Value to hash
+	*/
+	template<typename T>
+	void Add(const T& value)
+	{
+		AddBytes(&value, sizeof(T));
+	}
+
+	/**
+	* @brief Add a bool. Bools are normalized to one byte
+	*
+	* @param[in] value	Value to hash
+	*/
+	void Add(const bool& value)
+	{
+		uint8_t byte = value ? 1 : 0;
+		AddBytes(&byte, 1);
+	}
+
+	/**
+	* @brief Add a zero terminated string (nullptr hashes like an empty string)
+	*
+	* @param[in] str	String to hash
+	*/
+	void AddString(const char* str)
+	{
+		if (str)
+			AddBytes(str, strlen(str));
+		Add(static_cast<uint8_t>(0));
+	}
+
+	/** @brief Get the hash value */
+	uint64_t GetValue() const { return _value; }
+
+private:
+	uint64_t _value;	///< Current hash value
+};
+
+}
+/** @}*/
@@ -75,6 +75,14 @@ void RenderTexture::Update(const void* pData)
 		_halImage->Update(pData);
 }
 
+bool RenderTexture::UpdateStaging(const HalImageWriteFunction& writeFunc)
+{
+	if (!_halImage)
+		return false;
+
+	return _halImage->UpdateStaging(writeFunc);
+}
+
 HalImageFormat RenderTexture::GetImageFormat()
 {
     HalImageFormat format = HalImageFormat::Undefined;
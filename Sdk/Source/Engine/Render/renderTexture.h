@@ -20,6 +20,7 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SO
 #include "Common/caveString.h"
 #include "Memory/allocatorGlobal.h"
 #include "halTypes.h"
+#include "halImage.h"
 
 #include <memory>
 
@@ -70,6 +71,15 @@ public:
 	*/
 	virtual void Update(const void* pData);
 
+	/**
+	* @brief Copy data to buffer. writeFunc writes the data straight into staging memory.
+	*
+	* @param[in] writeFunc	Called once with the mapped staging memory
+	*
+	* @return true on success
+	*/
+	virtual bool UpdateStaging(const HalImageWriteFunction& writeFunc);
+
 	/**
 	* @brief Get file name
 	*
@@ -19,6 +19,7 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SO
 #include "renderDevice.h"
 #include "engineError.h"
 #include "halVertexInput.h"
+#include "renderStateHash.h"
 
 #include <cassert>
 
@@ -28,6 +29,27 @@ RenderVertexInput::RenderVertexInput(RenderDevice& renderDevice, HalVertexInputS
 	: CaveRefCount(renderDevice.GetEngineAllocator())
 	, _renderDevice(renderDevice)
 {
+	// content hash used to share pipelines
+	RenderStateHash hash;
+	hash.Add(vertexInputState._vertexBindingDescriptionCount);
+	for (uint32_t i = 0; i < vertexInputState._vertexBindingDescriptionCount; i++)
+	{
+		const HalVertexInputBindingDescription& binding = vertexInputState._pVertexBindingDescriptions[i];
+		hash.Add(binding._binding);
+		hash.Add(binding._stride);
+		hash.Add(binding._inputRate);
+	}
+	hash.Add(vertexInputState._vertexAttributeDescriptionCount);
+	for (uint32_t i = 0; i < vertexInputState._vertexAttributeDescriptionCount; i++)
+	{
+		const HalVertexInputAttributeDescription& attribute = vertexInputState._pVertexAttributeDescriptions[i];
+		hash.Add(attribute._location);
+		hash.Add(attribute._binding);
+		hash.Add(attribute._format);
+		hash.Add(attribute._offset);
+	}
+	_stateHash = hash.GetValue();
+
 	// Allocate low level object
 	_halVertexInput = renderDevice.GetHalRenderDevice()->CreateVertexInput(vertexInputState);
 	assert(_halVertexInput);
@@ -59,6 +59,13 @@ public:
 	*/
 	HalVertexInput* GetHalHandle() { return _halVertexInput; }
 
+	/**
+	* @brief Get the content hash used to share graphics pipelines
+	*
+	* @return hash value
+	*/
+	uint64_t GetStateHash() const { return _stateHash; }
+
 	/**
 	* @brief Get start of binding index
 	*		 This basically tells you where your vertex buffers should be bound
@@ -80,6 +87,7 @@ private:
 	HalVertexInput* _halVertexInput;	///< Pointer to low level shader object
 	uint32_t _bindingBase;	///< Base binding of first descriptor
 	uint32_t _bindingCount;	///< Number of bindings
+	uint64_t _stateHash;	///< Content hash of the state
 };
 
 }
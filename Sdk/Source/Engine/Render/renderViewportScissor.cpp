@@ -19,6 +19,7 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SO
 #include "renderLayerSection.h"
 #include "renderDevice.h"
 #include "engineError.h"
+#include "renderStateHash.h"
 
 #include <cassert>
 
@@ -27,19 +28,36 @@ namespace cave
 RenderViewportScissor::RenderViewportScissor(RenderDevice& renderDevice, RenderLayerSectionInfo& sectionInfo)
 	: _renderDevice(renderDevice)
 {
+	// content hash used to share pipelines
+	RenderStateHash hash;
+	hash.Add(sectionInfo.x);
+	hash.Add(sectionInfo.y);
+	hash.Add(sectionInfo.width);
+	hash.Add(sectionInfo.height);
+	_stateHash = hash.GetValue();
+
 	// Allocate low level object
-	HalViewport viewport;
-	viewport._offset._x = static_cast<float>(sectionInfo.x); 
-	viewport._offset._y = static_cast<float>(sectionInfo.y);
-	viewport._extend._x = static_cast<float>(sectionInfo.width);
-	viewport._extend._y = static_cast<float>(sectionInfo.height);
-	viewport._depthRange._x = 0; viewport._depthRange._y = 1;
-	HalScissor scissor;
-	scissor._offset._x = sectionInfo.x;
-	scissor._offset._y = sectionInfo.y;
-	scissor._extend._x = sectionInfo.width;
-	scissor._extend._y = sectionInfo.height;
-	_halViewportAndScissor = renderDevice.GetHalRenderDevice()->CreateViewportAndScissor(viewport, scissor);
+	_viewport._offset._x = static_cast<float>(sectionInfo.x); 
+	_viewport._offset._y = static_cast<float>(sectionInfo.y);
+	_viewport._extend._x = static_cast<float>(sectionInfo.width);
+	_viewport._extend._y = static_cast<float>(sectionInfo.height);
+	_viewport._depthRange._x = 0; _viewport._depthRange._y = 1;
+	_scissor._offset._x = sectionInfo.x;
+	_scissor._offset._y = sectionInfo.y;
+	_scissor._extend._x = sectionInfo.width;
+	_scissor._extend._y = sectionInfo.height;
+	_halViewportAndScissor = renderDevice.GetHalRenderDevice()->CreateViewportAndScissor(_viewport, _scissor);
+	assert(_halViewportAndScissor);
+}
+
+RenderViewportScissor::RenderViewportScissor(const RenderViewportScissor& rhs)
+	: _renderDevice(rhs._renderDevice)
+	, _viewport(rhs._viewport)
+	, _scissor(rhs._scissor)
+	, _halViewportAndScissor(nullptr)
+	, _stateHash(rhs._stateHash)
+{
+	_halViewportAndScissor = _renderDevice.GetHalRenderDevice()->CreateViewportAndScissor(_viewport, _scissor);
 	assert(_halViewportAndScissor);
 }
 
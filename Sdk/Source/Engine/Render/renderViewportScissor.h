@@ -49,7 +49,9 @@ public:
 	*
 	*/
 	RenderViewportScissor(RenderDevice& renderDevice, RenderLayerSectionInfo& sectionInfo);
-	/** @brief copy constructor */
+	/** @brief copy constructor. Creates an own low level object with the same setup */
+	RenderViewportScissor(const RenderViewportScissor& rhs);
+	/** @brief destructor */
 	virtual ~RenderViewportScissor();
 
 	/**
@@ -59,9 +61,21 @@ public:
 	*/
 	HalViewportAndScissor* GetHalHandle() { return _halViewportAndScissor; }
 
+	/**
+	* @brief Get the content hash used to share graphics pipelines
+	*
+	* @return hash value
+	*/
+	uint64_t GetStateHash() const { return _stateHash; }
+
 private:
+	RenderViewportScissor& operator=(const RenderViewportScissor&) = delete;
+
 	RenderDevice& _renderDevice;	///< Render device object
+	HalViewport _viewport;	///< Viewport setup
+	HalScissor _scissor;	///< Scissor setup
 	HalViewportAndScissor* _halViewportAndScissor;	///< Pointer to low level viewport and scissor object
+	uint64_t _stateHash;	///< Content hash of the state
 };
 
 }
@@ -32,6 +32,14 @@ static const char* g_imageLocation = "Images/";
 
 ImageResource::ImageResource(ResourceManagerPrivate* rm)
 	: _pResourceManagerPrivate(rm)
+	, _pAllocator(rm->GetEngineAllocator())
+{
+
+}
+
+ImageResource::ImageResource(std::shared_ptr<AllocatorBase> allocator)
+	: _pResourceManagerPrivate(nullptr)
+	, _pAllocator(allocator)
 {
 
 }
@@ -64,14 +72,7 @@ bool ImageResource::ImageFileExists(ResourceObjectFinder& objectFinder, const ch
 	// add default local serach path
 	objectFinder._localSearchPath.push_back(g_imageLocation);
 
-	std::ifstream fileStream;
-	if (!objectFinder.OpenFileBinary(fileString.c_str(), fileStream))
-	{
-		return false;
-	}
-
-	fileStream.close();
-	return true;
+	return objectFinder.FileExists(fileString.c_str());
 }
 
 ImageResource* ImageResource::CreateImageResource(ResourceManagerPrivate* rm, ResourceObjectFinder& objectFinder, const char* filename)
@@ -89,7 +90,7 @@ ImageResource* ImageResource::CreateImageResource(ResourceManagerPrivate* rm, Re
 	return image;
 }
 
-void ImageResource::LoadImageResource(ResourceObjectFinder& objectFinder, ImageResource* image, const char* filename)
+bool ImageResource::ReadImageFile(ResourceObjectFinder& objectFinder, const char* filename, ResourceLoadData& data)
 {
 	std::string fileString = objectFinder.GetFileName(filename);
 	std::string directory = objectFinder.GetDirectory(filename);
@@ -101,12 +102,28 @@ void ImageResource::LoadImageResource(ResourceObjectFinder& objectFinder, ImageR
 	// add default local serach path
 	objectFinder._localSearchPath.push_back(g_imageLocation);
 
-	std::ifstream fileStream;
-	if (objectFinder.OpenFileBinary(fileString.c_str(), fileStream))
-	{
-		image->decode(false, fileStream);
-		fileStream.close();
-	}
+	if (!objectFinder.OpenFile(fileString.c_str(), data, OsMappedFileAccess::Sequential))
+		return false;
+
+	// the I/O thread waits for the disk, not the decoder
+	data.Prefault();
+
+	return true;
+}
+
+bool ImageResource::DecodeImageResource(ImageResource* image, ResourceLoadData& data, bool hostCopy)
+{
+	if (data.GetSize() == 0)
+		return false;
+
+	if (!image->decode(false, hostCopy, data.GetData(), data.GetSize()))
+		return false;
+
+	// the levels point into the file content, keep it alive. Swapping does not move the content
+	if (!hostCopy)
+		image->_fileData.Swap(data);
+
+	return true;
 }
 
 }
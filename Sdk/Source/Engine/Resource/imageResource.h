@@ -39,7 +39,7 @@ struct ImageData
 	HalImageFormat format; ///< image format
 	uint32_t componentCount;	///< amount of components (1-4)
 	uint32_t componentSize; ///< size of a single component in bytes (1-4)
-	uint8_t* data;	///< pointer to host data of that level
+	uint8_t* data;	///< pointer to host data (nullptr if the image was decoded without host copy)
 };
 
 /**
@@ -69,6 +69,14 @@ public:
 	*/
 	ImageResource(ResourceManagerPrivate* rm);
 
+	/**
+	* @brief Constructor for use without resource manager (e.g. offline tools)
+	*
+	* @param[in] allocator	Allocator used for image data
+	*
+	*/
+	ImageResource(std::shared_ptr<AllocatorBase> allocator);
+
 	/** @brief Destructor */
 	virtual ~ImageResource();
 
@@ -104,14 +112,28 @@ public:
 	static ImageResource* CreateImageResource(ResourceManagerPrivate* rm, ResourceObjectFinder& objectFinder, const char* filename);
 
 	/**
-	* @brief Load an image resource object
+	* @brief Map an image file and fault in its pages. This is the I/O part of loading an image.
 	*
 	* @param[in] objectFinder	Helper class to find resource
-	* @param[in] image			Pointer to a ImageResource object create by a CreateImageResource call
 	* @param[in] filename		filename
+	* @param[out] data			Receives the file content
+	*
+	* @return true if the file was mapped
+	*/
+	static bool ReadImageFile(ResourceObjectFinder& objectFinder, const char* filename, ResourceLoadData& data);
+
+	/**
+	* @brief Decode an image resource object from the mapped file content.
+	*		 Without a host copy only the header is decoded. The image takes over the
+	*		 file content and writeImageData reads the levels from it.
 	*
+	* @param[in] image		Pointer to a ImageResource object create by a CreateImageResource call
+	* @param[in] data		File content read by ReadImageFile
+	* @param[in] hostCopy	Copy the levels into host memory
+	*
+	* @return true if successfuly decoded
 	*/
-	static void LoadImageResource(ResourceObjectFinder& objectFinder, ImageResource* image, const char* filename);
+	static bool DecodeImageResource(ImageResource* image, ResourceLoadData& data, bool hostCopy);
 
 	/*
 	* @brief Query the image host data.
@@ -132,6 +154,18 @@ public:
 	*/
 	virtual ImageLevelData getLevelData(uint32_t face, uint32_t mipLevel) = 0;
 
+	/*
+	* @brief Write a byte range of the mip chain of the first face into a destination buffer
+	*		 (e.g. mapped staging memory). Flips and channel swaps are applied while writing.
+	*
+	* @param[in] pDst	Destination
+	* @param[in] offset	Start of the range inside the mip chain in bytes
+	* @param[in] size	Size of the range in bytes
+	*
+	* @return false if no image data is available
+	*/
+	virtual bool writeImageData(void* pDst, uint64_t offset, uint64_t size) = 0;
+
 	/*
 	* @brief Relase all internal memory allocated
 	*/
@@ -144,13 +178,17 @@ protected:
 	*		 All classes derived from this must provide this function
 	*
 	* @param[in] flipVertical	Flipe image vertical
-	* @param[in] dataStream		A valid file stream
+	* @param[in] hostCopy		Copy the levels into host memory. Else they reference data
+	* @param[in] data			File content
+	* @param[in] size			File content size in bytes
 	*
 	* @return true if successfuly loaded
 	*/
-	virtual bool decode(bool flipVertical, std::ifstream& dataStream) = 0;
+	virtual bool decode(bool flipVertical, bool hostCopy, const uint8_t* data, size_t size) = 0;
 
-	ResourceManagerPrivate * _pResourceManagerPrivate;	///< Pointer to private resource manger
+	ResourceManagerPrivate * _pResourceManagerPrivate;	///< Pointer to private resource manger (may be nullptr)
+	std::shared_ptr<AllocatorBase> _pAllocator;	///< Allocator used for image data
+	ResourceLoadData _fileData;	///< File content referenced by the levels if decoded without host copy
 };
 
 }
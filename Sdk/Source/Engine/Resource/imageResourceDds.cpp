@@ -21,6 +21,7 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SO
 #include <fstream>
 #include <iostream>
 #include <cstring>
+#include <algorithm>
 
 namespace cave
 {
@@ -866,20 +867,51 @@ void getImageFormatInfo(DDSImageInfo& imageInfo, DXGI_FORMAT format)
     assert(imageInfo.format != HalImageFormat::Undefined);
 }
 
+/**
+* @brief Copy bytes out of the file content and advance the read offset
+*
+* @return false if the content is too short
+*/
+static bool ReadDdsBytes(const uint8_t* data, size_t size, size_t& offset, void* dst, size_t count)
+{
+    if (offset > size || count > size - offset)
+        return false;
+
+    std::memcpy(dst, data + offset, count);
+    offset += count;
+    return true;
+}
+
 //-----------------------------------------------------------------------------
 // class functions
 //-----------------------------------------------------------------------------
 
 ImageResourceDds::ImageResourceDds(ResourceManagerPrivate* rm)
     : ImageResource(rm)
-{}
+    , m_flipVertical(false)
+    , m_swapRedBlue(false)
+    , m_preparedLevel(nullptr)
+    , m_preparedIndex(0)
+{
+    std::memset(&m_imageInfo, 0, sizeof(DDSImageInfo));
+}
+
+ImageResourceDds::ImageResourceDds(std::shared_ptr<AllocatorBase> allocator)
+    : ImageResource(allocator)
+    , m_flipVertical(false)
+    , m_swapRedBlue(false)
+    , m_preparedLevel(nullptr)
+    , m_preparedIndex(0)
+{
+    std::memset(&m_imageInfo, 0, sizeof(DDSImageInfo));
+}
 
 ImageResourceDds::~ImageResourceDds()
 {
     releaseImageData();
 }
 
-bool ImageResourceDds::decode(bool flipVertical, std::ifstream& dataStream)
+bool ImageResourceDds::decode(bool flipVertical, bool hostCopy, const uint8_t* data, size_t size)
 {
     DDS_HEADER ddsh;
     DDS_HEADER_DXT10 ddsdx10;   // extended header for DX 10 formats
@@ -887,9 +919,10 @@ bool ImageResourceDds::decode(bool flipVertical, std::ifstream& dataStream)
     bool needsBGRASwap = false;
     bool isAllreadyFlipped = false;
 
+    size_t offset = 0;
+
     // check file code
-    dataStream.read(filecode, 4);
-    if (std::memcmp(filecode, "DDS ", 4))
+    if (!ReadDdsBytes(data, size, offset, filecode, 4) || std::memcmp(filecode, "DDS ", 4))
     {
         return false;
     }
@@ -897,7 +930,8 @@ bool ImageResourceDds::decode(bool flipVertical, std::ifstream& dataStream)
     std::memset(&m_imageInfo, 0, sizeof(DDSImageInfo));
 
     // read in DDS header
-    dataStream.read(reinterpret_cast<char*>(&ddsh), sizeof(DDS_HEADER));
+    if (!ReadDdsBytes(data, size, offset, &ddsh, sizeof(DDS_HEADER)))
+        return false;
     // check if image is a cubempap
     if (ddsh.dwCaps2 & DDS_CUBEMAP)
     {
@@ -985,7 +1019,8 @@ bool ImageResourceDds::decode(bool flipVertical, std::ifstream& dataStream)
     if (isDX10)
     {
         // read in DDS DX10 extended header
-        dataStream.read(reinterpret_cast<char*>(&ddsdx10), sizeof(DDS_HEADER_DXT10));
+        if (!ReadDdsBytes(data, size, offset, &ddsdx10, sizeof(DDS_HEADER_DXT10)))
+            return false;
         dxgiFormat = ddsdx10.dxgiFormat;
     }
 
@@ -1012,93 +1047,75 @@ bool ImageResourceDds::decode(bool flipVertical, std::ifstream& dataStream)
         return false;
     }
 
-    // allocate the meta datablock for all mip storage.
-    DDSAllocDataBlock(&m_imageInfo, *_pResourceManagerPrivate->GetEngineAllocator());
-    if (m_imageInfo.dataBlock == nullptr)
-    {
-        return false;
-    }
+    m_flipVertical = flipVertical;
+    m_swapRedBlue = needsBGRASwap;
 
-    uint32_t faces = m_imageInfo.cubemap ? 6 : 1;
+    uint32_t planes = m_imageInfo.numMipmaps * (m_imageInfo.cubemap ? DDS_NUM_CUBEMAP_FACES : 1);
 
-    int32_t index = 0;
-    for (uint32_t j = 0; j < faces; j++)
+    if (hostCopy)
     {
-        // load all surfaces for the image
-        uint32_t width = m_imageInfo.width;
-        uint32_t height = m_imageInfo.height;
-
-        for (uint32_t i = 0; i < m_imageInfo.numMipmaps; i++)
+        // allocate the meta datablock for all mip storage.
+        DDSAllocDataBlock(&m_imageInfo, *_pAllocator);
+        if (m_imageInfo.dataBlock == nullptr)
         {
-            // Get the size, read in the data.
-            dataStream.read(reinterpret_cast<char*>(m_imageInfo.data[index]), m_imageInfo.size[index]);
-
-            // Flip in Y for OpenGL if needed
-            if (flipVertical)
-                flip_data_vertical(static_cast<int8_t*>(m_imageInfo.data[index]), width, height, &m_imageInfo, *_pResourceManagerPrivate->GetEngineAllocator());
-
-            // shrink to next power of 2
-            width >>= 1;
-            height >>= 1;
-
-            if (!width)
-                width = 1;
-
-            if (!height)
-                height = 1;
+            return false;
+        }
 
-            // make sure DXT isn't <4 on a side...
-            if (m_imageInfo.compressed)
-            {
-                if (width < 4)
-                    width = 4;
-                if (height < 4)
-                    height = 4;
-            }
+        for (uint32_t index = 0; index < planes; index++)
+        {
+            // Get the size, copy the data straight from the mapped file
+            if (!ReadDdsBytes(data, size, offset, m_imageInfo.data[index], m_imageInfo.size[index]))
+                return false;
 
-            index++;
+            prepareLevel(m_imageInfo.data[index], index);
         }
     }
-
-    if (needsBGRASwap)
+    else
     {
-        index = 0;
+        // reference the levels in the file content. Flip and swap are applied by writeImageData
+        total_image_data_size(&m_imageInfo);
 
-        for (uint32_t k = 0; k < faces; k++)
+        for (uint32_t index = 0; index < planes; index++)
         {
-            uint32_t width = m_imageInfo.width;
-            uint32_t height = m_imageInfo.height;
+            if (offset > size || m_imageInfo.size[index] > size - offset)
+                return false;
 
-            for (uint32_t i = 0; i < m_imageInfo.numMipmaps; i++)
-            {
-                int8_t* data = static_cast<int8_t*>(m_imageInfo.data[index]);
-                uint32_t pixels = width * height;
+            m_imageInfo.data[index] = const_cast<int8_t*>(reinterpret_cast<const int8_t*>(data + offset));
+            offset += m_imageInfo.size[index];
+        }
+    }
 
-                for (uint32_t j = 0; j < pixels; j++)
-                {
-                    int8_t temp = data[0];
-                    data[0] = data[2];
-                    data[2] = temp;
+    return true;
+}
 
-                    data += 4;
-                }
+void ImageResourceDds::prepareLevel(int8_t* level, uint32_t index)
+{
+    uint32_t width = m_imageInfo.mipwidth[index];
+    uint32_t height = m_imageInfo.mipheight[index];
 
-                // shrink to next power of 2
-                width >>= 1;
-                height >>= 1;
+    // Flip in Y for OpenGL if needed
+    if (m_flipVertical)
+    {
+        // make sure DXT isn't <4 on a side...
+        uint32_t flipWidth = (m_imageInfo.compressed && width < 4) ? 4 : width;
+        uint32_t flipHeight = (m_imageInfo.compressed && height < 4) ? 4 : height;
+        flip_data_vertical(level, flipWidth, flipHeight, &m_imageInfo, *_pAllocator);
+    }
 
-                if (!width)
-                    width = 1;
+    if (m_swapRedBlue)
+    {
+        int8_t* pixel = level;
+        uint32_t pixels = width * height;
 
-                if (!height)
-                    height = 1;
+        for (uint32_t j = 0; j < pixels; j++)
+        {
+            int8_t temp = pixel[0];
+            pixel[0] = pixel[2];
+            pixel[2] = temp;
 
-                index++;
-            }
+            pixel += 4;
         }
     }
-
-    return true;
 }
 
 ImageData ImageResourceDds::getImageData()
@@ -1133,13 +1150,168 @@ ImageLevelData ImageResourceDds::getLevelData(uint32_t face, uint32_t mipLevel)
     return imageData;
 }
 
+bool ImageResourceDds::writeImageData(void* pDst, uint64_t offset, uint64_t size)
+{
+    if (m_imageInfo.data[0] == nullptr)
+        return false;
+
+    AllocatorBase& allocator = *_pAllocator;
+    // levels in the file content are read only. Staging memory may be write combined, so never
+    // read it back: levels which need a flip or swap are prepared in a temporary buffer
+    bool prepare = (m_imageInfo.dataBlock == nullptr) && (m_flipVertical || m_swapRedBlue);
+    int8_t* dst = static_cast<int8_t*>(pDst);
+    uint64_t remaining = size;
+    uint64_t levelStart = 0;
+
+    // the first face holds the mip chain uploaded to the device
+    for (uint32_t i = 0; i < m_imageInfo.numMipmaps && remaining > 0; i++)
+    {
+        uint64_t levelSize = static_cast<uint64_t>(m_imageInfo.size[i]);
+        if (offset >= levelStart + levelSize)
+        {
+            // range starts behind this level
+            levelStart += levelSize;
+            continue;
+        }
+
+        uint64_t levelOffset = offset - levelStart;
+        uint64_t copySize = (std::min)(remaining, levelSize - levelOffset);
+        const int8_t* src = m_imageInfo.data[i];
+
+        if (prepare)
+        {
+            // a level written in pieces is prepared only once
+            if (m_preparedLevel == nullptr || m_preparedIndex != i)
+            {
+                if (m_preparedLevel)
+                    DeallocateArray<int8_t>(allocator, m_preparedLevel);
+
+                m_preparedLevel = AllocateArray<int8_t>(allocator, m_imageInfo.size[i]);
+                if (!m_preparedLevel)
+                    return false;
+
+                std::memcpy(m_preparedLevel, m_imageInfo.data[i], m_imageInfo.size[i]);
+                prepareLevel(m_preparedLevel, i);
+                m_preparedIndex = i;
+            }
+            src = m_preparedLevel;
+        }
+
+        std::memcpy(dst, src + levelOffset, (size_t)copySize);
+
+        dst += copySize;
+        remaining -= copySize;
+        offset += copySize;
+        levelStart += levelSize;
+
+        // done with the prepared level
+        if (prepare && levelOffset + copySize == levelSize)
+        {
+            DeallocateArray<int8_t>(allocator, m_preparedLevel);
+            m_preparedLevel = nullptr;
+        }
+    }
+
+    return true;
+}
+
+bool ImageResourceDds::writeDds(std::vector<uint8_t>& out)
+{
+    if (m_imageInfo.dataBlock == nullptr)
+        return false;
+
+    // levels are already swapped, so BGRA sources are written as RGBA
+    DXGI_FORMAT dxgiFormat = DXGI_FORMAT_UNKNOWN;
+    switch (m_imageInfo.format)
+    {
+    case HalImageFormat::R8G8B8A8UNorm:
+    case HalImageFormat::B8G8R8A8UNorm:
+        dxgiFormat = DXGI_FORMAT_R8G8B8A8_UNORM;
+        break;
+    case HalImageFormat::BC1RgbaUnorm:
+        dxgiFormat = DXGI_FORMAT_BC1_UNORM;
+        break;
+    case HalImageFormat::BC2Unorm:
+        dxgiFormat = DXGI_FORMAT_BC2_UNORM;
+        break;
+    case HalImageFormat::BC3Unorm:
+        dxgiFormat = DXGI_FORMAT_BC3_UNORM;
+        break;
+    case HalImageFormat::BC7Unorm:
+        dxgiFormat = DXGI_FORMAT_BC7_UNORM;
+        break;
+    case HalImageFormat::BC7Srgb:
+        dxgiFormat = DXGI_FORMAT_BC7_UNORM_SRGB;
+        break;
+    default:
+        return false;
+    }
+
+    DDS_HEADER ddsh;
+    std::memset(&ddsh, 0, sizeof(DDS_HEADER));
+    ddsh.dwSize = sizeof(DDS_HEADER);
+    ddsh.dwFlags = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT | DDS_MIPMAPCOUNT | DDS_LINEARSIZE;
+    ddsh.dwHeight = m_imageInfo.height;
+    ddsh.dwWidth = m_imageInfo.width;
+    ddsh.dwPitchOrLinearSize = m_imageInfo.size[0];
+    ddsh.dwMipMapCount = m_imageInfo.numMipmaps;
+    ddsh.ddspf.dwSize = sizeof(DDS_PIXELFORMAT);
+    ddsh.ddspf.dwFlags = DDS_FOURCC;
+    ddsh.ddspf.dwFourCC = FOURCC_DX10;
+    ddsh.dwCaps1 = DDS_TEXTURE;
+    if (m_imageInfo.numMipmaps > 1)
+        ddsh.dwCaps1 |= DDS_MIPMAP | DDS_COMPLEX;
+    if (m_imageInfo.cubemap)
+    {
+        ddsh.dwCaps1 |= DDS_COMPLEX;
+        ddsh.dwCaps2 = DDS_CUBEMAP | DDS_CUBEMAP_POSITIVEX | DDS_CUBEMAP_NEGATIVEX | DDS_CUBEMAP_POSITIVEY
+            | DDS_CUBEMAP_NEGATIVEY | DDS_CUBEMAP_POSITIVEZ | DDS_CUBEMAP_NEGATIVEZ;
+    }
+
+    DDS_HEADER_DXT10 ddsdx10;
+    std::memset(&ddsdx10, 0, sizeof(DDS_HEADER_DXT10));
+    ddsdx10.dxgiFormat = dxgiFormat;
+    ddsdx10.resourceDimension = D3D10_RESOURCE_DIMENSION_TEXTURE2D;
+    ddsdx10.miscFlag = m_imageInfo.cubemap ? 0x4 : 0;  // D3D11_RESOURCE_MISC_TEXTURECUBE
+    ddsdx10.arraySize = 1;
+
+    uint32_t planes = m_imageInfo.numMipmaps * (m_imageInfo.cubemap ? DDS_NUM_CUBEMAP_FACES : 1);
+    size_t dataSize = 0;
+    for (uint32_t i = 0; i < planes; i++)
+        dataSize += m_imageInfo.size[i];
+
+    out.resize(4 + sizeof(DDS_HEADER) + sizeof(DDS_HEADER_DXT10) + dataSize);
+    uint8_t* dst = out.data();
+    std::memcpy(dst, "DDS ", 4);
+    dst += 4;
+    std::memcpy(dst, &ddsh, sizeof(DDS_HEADER));
+    dst += sizeof(DDS_HEADER);
+    std::memcpy(dst, &ddsdx10, sizeof(DDS_HEADER_DXT10));
+    dst += sizeof(DDS_HEADER_DXT10);
+
+    // the data block holds all levels back to back
+    std::memcpy(dst, m_imageInfo.dataBlock, dataSize);
+
+    return true;
+}
+
 void ImageResourceDds::releaseImageData()
 {
+    if (m_preparedLevel)
+    {
+        DeallocateArray<int8_t>(*_pAllocator, m_preparedLevel);
+        m_preparedLevel = nullptr;
+    }
+
     if (m_imageInfo.dataBlock)
     {
-        DeallocateArray<int8_t>(*_pResourceManagerPrivate->GetEngineAllocator(), m_imageInfo.dataBlock);
+        DeallocateArray<int8_t>(*_pAllocator, m_imageInfo.dataBlock);
         m_imageInfo.dataBlock = nullptr;
     }
+
+    // unmap the file content referenced by the levels
+    _fileData.Release();
+    std::memset(m_imageInfo.data, 0, sizeof(m_imageInfo.data));
 }
 
 
@@ -68,10 +68,11 @@ struct DDSImageInfo
 	/** Nonzero if the texture data includes alpha */
 	uint32_t alpha;
 
-	/** Base of the allocated block of all texel data */
+	/** Base of the allocated block of all texel data (nullptr if decoded without host copy) */
 	int8_t *dataBlock;
 
-	/** Pointers to the mipmap levels for the texture or each cubemap face */
+	/** Pointers to the mipmap levels for the texture or each cubemap face.
+	*	Point into the read only file content if dataBlock is nullptr */
 	int8_t *data[DDS_MAX_MIPMAPS * DDS_NUM_CUBEMAP_FACES];
 
 	/** Array of sizes of the mipmap levels for the texture or each cubemap face */
@@ -100,6 +101,14 @@ public:
 	*/
 	ImageResourceDds(ResourceManagerPrivate* rm);
 
+	/**
+	* @brief Constructor for use without resource manager (e.g. offline tools)
+	*
+	* @param[in] allocator	Allocator used for image data
+	*
+	*/
+	ImageResourceDds(std::shared_ptr<AllocatorBase> allocator);
+
 	/** @brief Destructor */
 	virtual ~ImageResourceDds();
 
@@ -123,6 +132,29 @@ public:
 	*/
 	ImageLevelData getLevelData(uint32_t face, uint32_t mipLevel);
 
+	/*
+	* @brief Write a byte range of the mip chain of the first face into a destination buffer
+	*		 (e.g. mapped staging memory). Flips and channel swaps are applied while writing.
+	*
+	* @param[in] pDst	Destination
+	* @param[in] offset	Start of the range inside the mip chain in bytes
+	* @param[in] size	Size of the range in bytes
+	*
+	* @return false if no image data is available
+	*/
+	bool writeImageData(void* pDst, uint64_t offset, uint64_t size);
+
+	/*
+	* @brief Write the decoded image as normalized DDS file: DX10 header, flips and
+	*		 channel swaps applied, all levels tightly packed. Loading such a file
+	*		 needs no preparation. The image must be decoded with host copy.
+	*
+	* @param[out] out	Receives the file content
+	*
+	* @return false if the image has no host copy or the format can't be written
+	*/
+	bool writeDds(std::vector<uint8_t>& out);
+
 	/*
 	* @brief Relase all internal memory allocated
 	*/
@@ -134,14 +166,28 @@ protected:
 	*		 All classes derived from this must provide this function
 	*
 	* @param[in] flipVertical	Flipe image vertical
-	* @param[in] dataStream		A valid file stream
+	* @param[in] hostCopy		Copy the levels into host memory. Else they reference data
+	* @param[in] data			File content
+	* @param[in] size			File content size in bytes
 	*
 	* @return true if successfuly loaded
 	*/
-	bool decode(bool flipVertical, std::ifstream& dataStream);
+	bool decode(bool flipVertical, bool hostCopy, const uint8_t* data, size_t size);
 
 private:
+	/*
+	* @brief Apply pending flip and channel swap to a level in host memory
+	*
+	* @param[in] level	Level data
+	* @param[in] index	Level index into the DDSImageInfo arrays
+	*/
+	void prepareLevel(int8_t* level, uint32_t index);
+
 	DDSImageInfo m_imageInfo;	///< DDS image data and info
+	bool m_flipVertical;	///< Levels must be flipped when written
+	bool m_swapRedBlue;	///< Levels must be converted from BGRA when written
+	int8_t* m_preparedLevel;	///< Last level prepared by writeImageData (reused while a level is written in pieces)
+	uint32_t m_preparedIndex;	///< Index of the prepared level
 };
 
 }
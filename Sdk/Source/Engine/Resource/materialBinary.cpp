@@ -0,0 +1,358 @@
+/*
+Copyright (c) <2017> <Udo Lugauer>
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE
+*/
+
+/// @file materialBinary.cpp
+///       Compiled binary material format
+
+#include "materialBinary.h"
+
+#include "json.hpp"
+
+#include <cstring>
+#include <cstdint>
+
+using json = nlohmann::json;	///< convenience shortcut
+
+namespace cave
+{
+
+// shader stages of a program in the order they are written
+static const char* g_stageNames[] = { "vertex", "fragment" };
+static const MaterialBinaryStageType g_stageTypes[] = { MaterialBinaryStageType::Vertex, MaterialBinaryStageType::Fragment };
+
+/**
+* @brief Parse the specialization constants of a shader stage.
+*		 Expects an array of {"id": n, "value": v} objects. Numbers and booleans are stored as 32 bit values.
+*
+* @param[in] constantsJson	Json constants array
+* @param[in,out] constants	Receives the constants
+* @param[out] error			Receives a message if parsing failed (may be nullptr)
+*
+* @return number of constants added, -1 on error
+*/
+static int32_t ParseConstants(const json& constantsJson, std::vector<MaterialBinaryConstant>& constants, std::string* error)
+{
+	if (!constantsJson.is_array())
+	{
+		if (error)
+			*error = "constants is not an array";
+		return -1;
+	}
+
+	size_t first = constants.size();
+	for (const json& constantJson : constantsJson)
+	{
+		json::const_iterator itId = constantJson.find("id");
+		json::const_iterator itValue = constantJson.find("value");
+		if (!constantJson.is_object() || itId == constantJson.end() || itValue == constantJson.end())
+		{
+			if (error)
+				*error = "constant needs an id and a value";
+			return -1;
+		}
+
+		MaterialBinaryConstant constant;
+		constant._id = itId->get<uint32_t>();
+		constant._value = 0;
+
+		// the shader declares the type, we only keep the bit pattern
+		if (itValue->is_boolean())
+			constant._value = itValue->get<bool>() ? 1 : 0;
+		else if (itValue->is_number_float())
+		{
+			float value = itValue->get<float>();
+			std::memcpy(&constant._value, &value, sizeof(value));
+		}
+		else if (itValue->is_number_unsigned() && itValue->get<uint64_t>() <= UINT32_MAX)
+			constant._value = itValue->get<uint32_t>();
+		else if (itValue->is_number_integer() && itValue->get<int64_t>() >= INT32_MIN && itValue->get<int64_t>() <= INT32_MAX)
+		{
+			int32_t value = itValue->get<int32_t>();
+			std::memcpy(&constant._value, &value, sizeof(value));
+		}
+		else
+		{
+			if (error)
+				*error = "constant value must be a 32 bit number or a bool";
+			return -1;
+		}
+
+		for (size_t i = first; i < constants.size(); i++)
+		{
+			if (constants[i]._id == constant._id)
+			{
+				if (error)
+					*error = "constant id used twice";
+				return -1;
+			}
+		}
+
+		constants.push_back(constant);
+	}
+
+	return static_cast<int32_t>(constants.size() - first);
+}
+
+//-----------------------------------------------------------------------------
+// MaterialBinary class
+//-----------------------------------------------------------------------------
+MaterialBinary::MaterialBinary()
+	: _pHeader(nullptr)
+	, _pMaterialData(nullptr)
+	, _pStages(nullptr)
+	, _pConstants(nullptr)
+	, _pStrings(nullptr)
+{
+}
+
+bool MaterialBinary::IsBinary(const uint8_t* data, size_t size)
+{
+	uint32_t magic = 0;
+	if (size < sizeof(magic))
+		return false;
+
+	std::memcpy(&magic, data, sizeof(magic));
+	return magic == MaterialBinaryMagic;
+}
+
+bool MaterialBinary::Open(const uint8_t* data, size_t size)
+{
+	if (size < sizeof(MaterialBinaryHeader) + sizeof(RenderMaterialDataStruct))
+		return false;
+
+	const MaterialBinaryHeader* header = reinterpret_cast<const MaterialBinaryHeader*>(data);
+	if (header->_magic != MaterialBinaryMagic || header->_version != MaterialBinaryVersion)
+		return false;
+
+	// stage count is bounded by the stage types, this also keeps the size math below in range
+	uint64_t stagesOffset = sizeof(MaterialBinaryHeader) + sizeof(RenderMaterialDataStruct);
+	uint64_t constantsOffset = stagesOffset + uint64_t(header->_stageCount) * sizeof(MaterialBinaryStage);
+	uint64_t stringsOffset = constantsOffset + uint64_t(header->_constantCount) * sizeof(MaterialBinaryConstant);
+	if (header->_stageCount > sizeof(g_stageTypes) / sizeof(g_stageTypes[0])
+		|| header->_stringSize == 0 || stringsOffset + header->_stringSize != size)
+		return false;
+
+	// the string table must end with a terminator, then every offset inside it is a valid string
+	const char* strings = reinterpret_cast<const char*>(data + stringsOffset);
+	if (strings[header->_stringSize - 1] != 0)
+		return false;
+
+	const MaterialBinaryStage* stages = reinterpret_cast<const MaterialBinaryStage*>(data + stagesOffset);
+	if (header->_nameOffset >= header->_stringSize || header->_programOffset >= header->_stringSize
+		|| header->_languageOffset >= header->_stringSize)
+		return false;
+
+	uint64_t constantCount = 0;
+	for (uint32_t i = 0; i < header->_stageCount; i++)
+	{
+		if (stages[i]._type > static_cast<uint32_t>(MaterialBinaryStageType::Fragment)
+			|| stages[i]._sourceOffset >= header->_stringSize || stages[i]._entryOffset >= header->_stringSize)
+			return false;
+
+		constantCount += stages[i]._constantCount;
+	}
+
+	// the stages must own exactly the stored constants
+	if (constantCount != header->_constantCount)
+		return false;
+
+	_pHeader = header;
+	_pMaterialData = data + sizeof(MaterialBinaryHeader);
+	_pStages = stages;
+	_pConstants = reinterpret_cast<const MaterialBinaryConstant*>(data + constantsOffset);
+	_pStrings = strings;
+
+	return true;
+}
+
+const MaterialBinaryConstant* MaterialBinary::GetStageConstants(uint32_t index) const
+{
+	uint32_t first = 0;
+	for (uint32_t i = 0; i < index; i++)
+		first += _pStages[i]._constantCount;
+
+	return _pConstants + first;
+}
+
+void MaterialBinary::GetMaterialData(RenderMaterialDataStruct& materialData) const
+{
+	std::memcpy(static_cast<void*>(&materialData), _pMaterialData, sizeof(RenderMaterialDataStruct));
+}
+
+//-----------------------------------------------------------------------------
+// MaterialBinaryWriter class
+//-----------------------------------------------------------------------------
+uint32_t MaterialBinaryWriter::InternString(std::string& strings, const std::string& str)
+{
+	size_t offset = 0;
+	while (offset < strings.size())
+	{
+		const char* existing = strings.c_str() + offset;
+		size_t length = std::strlen(existing);
+		if (str == existing)
+			return static_cast<uint32_t>(offset);
+
+		offset += length + 1;
+	}
+
+	strings.append(str);
+	strings.push_back('\0');
+
+	return static_cast<uint32_t>(offset);
+}
+
+bool MaterialBinaryWriter::Compile(const char* data, size_t size, std::vector<uint8_t>& out, std::string* error)
+{
+	json asset;
+	try
+	{
+		asset = json::parse(data, data + size);
+	}
+	catch (const std::exception& e)
+	{
+		if (error)
+			*error = e.what();
+		return false;
+	}
+
+	if (!asset.is_object())
+	{
+		if (error)
+			*error = "material asset is not an object";
+		return false;
+	}
+
+	// same defaults as materials created in code
+	RenderMaterialDataStruct materialData;
+	materialData._ambient = Vector4f(0, 0, 0, 1);
+	materialData._diffuse = Vector4f(1, 1, 1, 1);
+	materialData._emissive = Vector4f(0, 0, 0, 0);
+	materialData._opacity = 0.0f;
+	std::memset(materialData._padding, 0, sizeof(materialData._padding));
+
+	// offset 0 is the empty string
+	std::string strings(1, '\0');
+	MaterialBinaryHeader header;
+	std::memset(&header, 0, sizeof(MaterialBinaryHeader));
+	header._magic = MaterialBinaryMagic;
+	header._version = MaterialBinaryVersion;
+
+	std::vector<MaterialBinaryStage> stages;
+	std::vector<MaterialBinaryConstant> constants;
+
+	try
+	{
+		json::const_iterator itM = asset.find("material");
+		if (itM != asset.end() && itM->is_object())
+		{
+			const json& materialJson = *itM;
+			json::const_iterator itName = materialJson.find("name");
+			if (itName != materialJson.end())
+				header._nameOffset = InternString(strings, itName->get<std::string>());
+
+			json::const_iterator itV = materialJson.find("values");
+			if (itV != materialJson.end() && itV->is_object())
+			{
+				json::const_iterator itOpacity = itV->find("opacity");
+				if (itOpacity != itV->end())
+					materialData._opacity = itOpacity->get<float>();
+
+				json::const_iterator itDiffuse = itV->find("diffuse");
+				if (itDiffuse != itV->end() && itDiffuse->is_array() && itDiffuse->size() == 3)
+				{
+					materialData._diffuse._x = (*itDiffuse)[0].get<float>();
+					materialData._diffuse._y = (*itDiffuse)[1].get<float>();
+					materialData._diffuse._z = (*itDiffuse)[2].get<float>();
+				}
+			}
+		}
+
+		json::const_iterator itP = asset.find("program");
+		if (itP != asset.end() && itP->is_object())
+		{
+			const json& programJson = *itP;
+			json::const_iterator itName = programJson.find("name");
+			if (itName != programJson.end())
+				header._programOffset = InternString(strings, itName->get<std::string>());
+
+			json::const_iterator itLanguage = programJson.find("language");
+			if (itLanguage != programJson.end())
+				header._languageOffset = InternString(strings, itLanguage->get<std::string>());
+
+			for (size_t i = 0; i < sizeof(g_stageNames) / sizeof(g_stageNames[0]); i++)
+			{
+				json::const_iterator itS = programJson.find(g_stageNames[i]);
+				if (itS == programJson.end() || !itS->is_object())
+					continue;
+
+				json::const_iterator itSource = itS->find("source");
+				if (itSource == itS->end())
+					continue;
+
+				MaterialBinaryStage stage;
+				stage._type = static_cast<uint32_t>(g_stageTypes[i]);
+				stage._sourceOffset = InternString(strings, itSource->get<std::string>());
+				stage._entryOffset = 0;
+				stage._constantCount = 0;
+
+				json::const_iterator itEntry = itS->find("entry");
+				if (itEntry != itS->end())
+					stage._entryOffset = InternString(strings, itEntry->get<std::string>());
+
+				json::const_iterator itConstants = itS->find("constants");
+				if (itConstants != itS->end())
+				{
+					int32_t count = ParseConstants(*itConstants, constants, error);
+					if (count < 0)
+						return false;
+
+					stage._constantCount = static_cast<uint32_t>(count);
+				}
+
+				stages.push_back(stage);
+			}
+		}
+	}
+	catch (const std::exception& e)
+	{
+		// wrong value types
+		if (error)
+			*error = e.what();
+		return false;
+	}
+
+	header._stageCount = static_cast<uint32_t>(stages.size());
+	header._constantCount = static_cast<uint32_t>(constants.size());
+	header._stringSize = static_cast<uint32_t>(strings.size());
+
+	size_t stagesSize = stages.size() * sizeof(MaterialBinaryStage);
+	size_t constantsSize = constants.size() * sizeof(MaterialBinaryConstant);
+	out.resize(sizeof(MaterialBinaryHeader) + sizeof(RenderMaterialDataStruct) + stagesSize + constantsSize + strings.size());
+	uint8_t* dst = out.data();
+	std::memcpy(dst, &header, sizeof(MaterialBinaryHeader));
+	dst += sizeof(MaterialBinaryHeader);
+	std::memcpy(dst, static_cast<const void*>(&materialData), sizeof(RenderMaterialDataStruct));
+	dst += sizeof(RenderMaterialDataStruct);
+	if (stagesSize)
+		std::memcpy(dst, stages.data(), stagesSize);
+	dst += stagesSize;
+	if (constantsSize)
+		std::memcpy(dst, constants.data(), constantsSize);
+	dst += constantsSize;
+	std::memcpy(dst, strings.data(), strings.size());
+
+	return true;
+}
+
+}
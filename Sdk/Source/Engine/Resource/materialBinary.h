@@ -0,0 +1,200 @@
+/*
+Copyright (c) <2017> <Udo Lugauer>
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE
+*/
+#pragma once
+
+/// @file materialBinary.h
+///       Compiled binary material format
+
+#include "engineDefines.h"
+#include "Render/renderMaterial.h"
+
+#include <string>
+#include <vector>
+
+/** \addtogroup engine
+*  @{
+*		This module contains all code related to resource handling
+*/
+
+namespace cave
+{
+
+/// Material file identifier "CMTL"
+static const uint32_t MaterialBinaryMagic = 0x4c544d43;
+/// Material format version
+static const uint32_t MaterialBinaryVersion = 2;
+
+/**
+* @brief Shader stage of a program
+*/
+enum class MaterialBinaryStageType : uint32_t
+{
+	Vertex = 0,		///< Vertex shader
+	Fragment = 1	///< Fragment shader
+};
+
+/**
+* @brief Material file header. All values are little endian.
+*		 Layout: header, RenderMaterialDataStruct, stages, specialization constants, string table.
+*		 Strings are zero terminated and stored once, all names are offsets into the string table.
+*		 Constants are stored in stage order, each stage owns the next _constantCount entries.
+*/
+struct MaterialBinaryHeader
+{
+	uint32_t _magic;			///< MaterialBinaryMagic
+	uint32_t _version;			///< MaterialBinaryVersion
+	uint32_t _stageCount;		///< Number of shader stages
+	uint32_t _stringSize;		///< Size of the string table in bytes
+	uint32_t _nameOffset;		///< Material name
+	uint32_t _programOffset;	///< Program name
+	uint32_t _languageOffset;	///< Shader language
+	uint32_t _constantCount;	///< Number of specialization constants of all stages
+};
+
+/**
+* @brief Shader stage entry
+*/
+struct MaterialBinaryStage
+{
+	uint32_t _type;			///< MaterialBinaryStageType
+	uint32_t _sourceOffset;	///< Shader source (content relative path)
+	uint32_t _entryOffset;	///< Entry function (empty string if not set)
+	uint32_t _constantCount;	///< Number of specialization constants of this stage
+};
+
+/**
+* @brief Specialization constant entry
+*/
+struct MaterialBinaryConstant
+{
+	uint32_t _id;		///< Constant id as declared in the shader (constant_id)
+	uint32_t _value;	///< 32 bit value. Bit pattern of an int, uint, float or bool (0 or 1)
+};
+
+/**
+* @brief Read only view of a compiled material. The material is used in place, nothing is copied.
+*/
+class CAVE_INTERFACE MaterialBinary
+{
+public:
+	/** @brief Constructor */
+	MaterialBinary();
+
+	/**
+	* @brief Check if data starts like a compiled material
+	*
+	* @param[in] data	File content
+	* @param[in] size	Content size in bytes
+	*
+	* @return true if the magic matches
+	*/
+	static bool IsBinary(const uint8_t* data, size_t size);
+
+	/**
+	* @brief Validate a compiled material and reference it
+	*
+	* @param[in] data	File content. Must outlive this object
+	* @param[in] size	Content size in bytes
+	*
+	* @return false if the data is damaged or has a different version
+	*/
+	bool Open(const uint8_t* data, size_t size);
+
+	/**
+	* @brief Get the material values
+	*
+	* @param[out] materialData	Receives the values
+	*/
+	void GetMaterialData(RenderMaterialDataStruct& materialData) const;
+
+	/** @brief Get the material name */
+	const char* GetName() const { return GetString(_pHeader->_nameOffset); }
+
+	/** @brief Get the program name */
+	const char* GetProgramName() const { return GetString(_pHeader->_programOffset); }
+
+	/** @brief Get the shader language */
+	const char* GetLanguage() const { return GetString(_pHeader->_languageOffset); }
+
+	/** @brief Get number of shader stages */
+	uint32_t GetStageCount() const { return _pHeader->_stageCount; }
+
+	/**
+	* @brief Get a shader stage
+	*
+	* @param[in] index	Stage index
+	*
+	* @return stage
+	*/
+	const MaterialBinaryStage& GetStage(uint32_t index) const { return _pStages[index]; }
+
+	/**
+	* @brief Get the specialization constants of a shader stage
+	*
+	* @param[in] index	Stage index
+	*
+	* @return first constant of the stage, GetStage(index)._constantCount entries follow
+	*/
+	const MaterialBinaryConstant* GetStageConstants(uint32_t index) const;
+
+	/**
+	* @brief Get a string of the string table
+	*
+	* @param[in] offset	String offset
+	*
+	* @return zero terminated string
+	*/
+	const char* GetString(uint32_t offset) const { return _pStrings + offset; }
+
+private:
+	const MaterialBinaryHeader* _pHeader;	///< Header
+	const uint8_t* _pMaterialData;			///< Material values (may be unaligned)
+	const MaterialBinaryStage* _pStages;	///< Stages
+	const MaterialBinaryConstant* _pConstants;	///< Specialization constants of all stages
+	const char* _pStrings;					///< String table
+};
+
+/**
+* @brief Compiles material assets from json into the binary format
+*/
+class CAVE_INTERFACE MaterialBinaryWriter
+{
+public:
+	/**
+	* @brief Compile a json material asset
+	*
+	* @param[in] data	Json text
+	* @param[in] size	Size of the text in bytes
+	* @param[out] out	Receives the compiled material
+	* @param[out] error	Receives a message if compiling failed (may be nullptr)
+	*
+	* @return false if the json is invalid
+	*/
+	static bool Compile(const char* data, size_t size, std::vector<uint8_t>& out, std::string* error = nullptr);
+
+private:
+	/**
+	* @brief Add a string to the string table. Equal strings are stored once.
+	*
+	* @param[in,out] strings	String table
+	* @param[in] str			String to add
+	*
+	* @return string offset
+	*/
+	static uint32_t InternString(std::string& strings, const std::string& str);
+};
+
+}
+
+/** @}*/
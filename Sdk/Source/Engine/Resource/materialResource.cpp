@@ -18,15 +18,16 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SO
 #include "materialResource.h"
 #include "Render/renderMaterial.h"
 #include "Render/renderShader.h"
+#include "halShader.h"
 #include "engineError.h"
 #include "Math/vector4.h"
 
-#include "json.hpp"
+#include "materialBinary.h"
+#include "shaderCache.h"
 
 #include <fstream>
 #include <iostream>
-
-using json = nlohmann::json;	///< convenience shortcut
+#include <cstdio>
 
 namespace cave
 {
@@ -46,7 +47,7 @@ MaterialResource::~MaterialResource()
 {
 }
 
-bool MaterialResource::LoadShader(ResourceObjectFinder& objectFinder, std::string& filename, RenderShader* shader)
+bool MaterialResource::OpenShader(ResourceObjectFinder& objectFinder, const std::string& filename, ResourceLoadData& fileData, std::string& path)
 {
 	// get file and path
 	std::string fileString = objectFinder.GetFileName(filename.c_str());
@@ -56,26 +57,13 @@ bool MaterialResource::LoadShader(ResourceObjectFinder& objectFinder, std::strin
 	if (!shaderDir.empty())
 		objectFinder._localSearchPath.push_back(shaderDir);
 
-	std::ifstream fileStream;
-	if (!objectFinder.OpenFileBinary(fileString.c_str(), fileStream))
-	{
-		return false;
-	}
-
-	// get content size
-	std::streampos begin, end;
-	begin = fileStream.tellg();
-	fileStream.seekg(0, std::ios::end);
-	end = fileStream.tellg();
+	// mapped without read ahead, the content is only read if the shader index can't tell the content hash
+	bool found = objectFinder.OpenFile(fileString.c_str(), fileData, OsMappedFileAccess::Random, &path);
 
-	std::vector<char> code(static_cast<size_t>(end - begin));
-	fileStream.seekg(0, std::ios::beg);
-	fileStream.read(&code[0], end - begin);
-	fileStream.close();
-
-	shader->SetShaderSource(code);
+	if (!shaderDir.empty())
+		objectFinder._localSearchPath.pop_back();
 
-	return true;
+	return found;
 }
 
 RenderMaterial* MaterialResource::LoadMaterialAsset(ResourceObjectFinder& objectFinder, const char* file)
@@ -95,157 +83,130 @@ RenderMaterial* MaterialResource::LoadMaterialAsset(ResourceObjectFinder& object
 	// create a new material
 	RenderMaterial* newMaterial = AllocateObject<RenderMaterial>(*_pResourceManagerPrivate->GetEngineAllocator(), *_pResourceManagerPrivate->GetRenderDevice());
 
-	std::ifstream fileStream;
-	if (!objectFinder.OpenFileAscii(fileString.c_str(), fileStream))
+	ResourceLoadData fileData;
+	if (!objectFinder.OpenFile(fileString.c_str(), fileData, OsMappedFileAccess::Sequential))
 	{
 		return newMaterial;
 	}
 
 	if (newMaterial)
 	{
-		LoadMaterialJson(objectFinder, fileStream, newMaterial);
-		fileStream.close();
+		// cooked materials are used in place, json assets are compiled first
+		if (MaterialBinary::IsBinary(fileData.GetData(), fileData.GetSize()))
+			LoadMaterialBinary(objectFinder, fileData.GetData(), fileData.GetSize(), newMaterial);
+		else
+			LoadMaterialJson(objectFinder, reinterpret_cast<const char*>(fileData.GetData()), fileData.GetSize(), newMaterial);
 	}
 
 	return newMaterial;
 }
 
-bool MaterialResource::LoadMaterialJson(ResourceObjectFinder& objectFinder, std::ifstream& fileStream, RenderMaterial* material)
+bool MaterialResource::LoadMaterialJson(ResourceObjectFinder& objectFinder, const char* data, size_t size, RenderMaterial* material)
 {
-	json asset;
-	fileStream >> asset;
-	std::string materialName("");
-	float opacity = 0.0f;
-	Vector4f ambientColor(0, 0, 0, 1);
-	Vector4f diffuseColor(1,1,1,1);
-	Vector4f emissiveColor(0, 0, 0, 0);
-	std::vector<float> diffuseValue;
-
-	// find material entry
-	if (asset.find("material") != asset.end())
+	std::vector<uint8_t> compiled;
+	if (!MaterialBinaryWriter::Compile(data, size, compiled))
+		return false;
+
+	return LoadMaterialBinary(objectFinder, compiled.data(), compiled.size(), material);
+}
+
+bool MaterialResource::LoadMaterialBinary(ResourceObjectFinder& objectFinder, const uint8_t* data, size_t size, RenderMaterial* material)
+{
+	MaterialBinary binary;
+	if (!binary.Open(data, size))
+		return false;
+
+	RenderMaterialDataStruct materialData;
+	binary.GetMaterialData(materialData);
+	material->SetMaterialData(materialData);
+
+	const char* language = binary.GetLanguage();
+	for (uint32_t i = 0; i < binary.GetStageCount(); i++)
 	{
-		// there is an entry with key "material"
-		json::iterator itM = asset.find("material");
-		if (itM != asset.end() && itM.value().is_object())
+		const MaterialBinaryStage& stage = binary.GetStage(i);
+		bool isVertex = (stage._type == static_cast<uint32_t>(MaterialBinaryStageType::Vertex));
+
+		const MaterialBinaryConstant* binaryConstants = binary.GetStageConstants(i);
+		std::vector<HalSpecializationConstant> constants(stage._constantCount);
+		for (uint32_t c = 0; c < stage._constantCount; c++)
 		{
-			json materialJson = itM.value();
-			if (materialJson.count("name") > 0)
-				materialName = materialJson["name"].get<std::string>();
-
-			// read material value object
-			json::iterator itV = materialJson.find("values");
-			if (itV != materialJson.end() && itV.value().is_object())
-			{
-				json materialValues = itV.value();
-				if (materialValues.count("opacity") > 0)
-					opacity = materialValues["opacity"].get<float>();
-				if (materialValues.count("diffuse") > 0)
-				{
-					diffuseValue = materialValues["diffuse"].get< std::vector<float> >();
-					if (diffuseValue.size() == 3)
-					{
-						diffuseColor._x = diffuseValue[0];
-						diffuseColor._y = diffuseValue[1];
-						diffuseColor._z = diffuseValue[2];
-					}
-				}
-			}
+			constants[c]._constantId = binaryConstants[c]._id;
+			constants[c]._value = binaryConstants[c]._value;
 		}
+
+		RenderShader* shader = GetShader(objectFinder, binary.GetString(stage._sourceOffset)
+			, isVertex ? "vertex" : "fragment", language, binary.GetString(stage._entryOffset)
+			, constants.data(), stage._constantCount);
+
+		if (isVertex)
+			material->_vertexShader = shader;
+		else
+			material->_fragmentShader = shader;
 	}
 
-	material->SetAmbientColor(ambientColor);
-	material->SetDiffuseColor(diffuseColor);
-	material->SetEmissiveColor(emissiveColor);
-	material->SetOpacity(opacity);
-
-	// find program entry
-	std::string programName("");
-	std::string language("");
-	std::string vertexShaderName("");
-	std::string vertexShaderEntry("");
-	std::string fragmentShaderName("");
-	std::string fragmentShaderEntry("");
-	if (asset.find("program") != asset.end())
+	return true;
+}
+
+RenderShader* MaterialResource::GetShader(ResourceObjectFinder& objectFinder, const char* source, const char* type
+	, const char* language, const char* entry, const HalSpecializationConstant* constants, uint32_t constantCount)
+{
+	if (source[0] == 0)
+		return nullptr;
+
+	// a shader specialized with other constants is another shader, keep the names apart
+	uint64_t constantHash = RenderShader::HashSpecializationConstants(constants, constantCount);
+	std::string name(source);
+	if (constantHash)
 	{
-		// there is an entry with key "program"
-		json::iterator itP = asset.find("program");
-		if (itP != asset.end() && itP.value().is_object())
-		{
-			json programJson = itP.value();
-			if (programJson.count("name") > 0)
-				programName = programJson["name"].get<std::string>();
-			if (programJson.count("language") > 0)
-				language = programJson["language"].get<std::string>();
-
-			// read vertex shader
-			json::iterator itVertex = programJson.find("vertex");
-			if (itVertex != programJson.end() && itVertex.value().is_object())
-			{
-				json vertexValues = itVertex.value();
-				if (vertexValues.count("source") > 0)
-					vertexShaderName = vertexValues["source"].get<std::string>();
-				if (vertexValues.count("entry") > 0)
-					vertexShaderEntry = vertexValues["entry"].get<std::string>();
-			}
-			// read fragment shader
-			json::iterator itFragment = programJson.find("fragment");
-			if (itFragment != programJson.end() && itFragment.value().is_object())
-			{
-				json fragmentValues = itFragment.value();
-				if (fragmentValues.count("source") > 0)
-					fragmentShaderName = fragmentValues["source"].get<std::string>();
-				if (fragmentValues.count("entry") > 0)
-					fragmentShaderEntry = fragmentValues["entry"].get<std::string>();
-			}
-		}
+		char hash[18];
+		std::snprintf(hash, sizeof(hash), "#%016llx", static_cast<unsigned long long>(constantHash));
+		name.append(hash);
+	}
 
-		if (!vertexShaderName.empty())
-		{
-			// check if material already exists
-			RenderShader* vertexShader = _pResourceManagerPrivate->FindRenderShaderResource(vertexShaderName.c_str());
-			if (!vertexShader)
-			{
-				// create new shader object
-				vertexShader = AllocateObject<RenderShader>(*_pResourceManagerPrivate->GetEngineAllocator()
-								, *_pResourceManagerPrivate->GetRenderDevice(), "vertex", language.c_str());
-				if (vertexShader)
-				{
-					LoadShader(objectFinder, vertexShaderName, vertexShader);
-					// set shader entry function if available
-					if (!vertexShaderEntry.empty())
-						vertexShader->SetShaderEntryFunc(vertexShaderEntry.c_str());
-
-					// Insert new shader into our map
-					_pResourceManagerPrivate->InsertRenderShaderResource(vertexShaderName.c_str(), vertexShader);
-				}
-			}
-			material->_vertexShader = vertexShader;
-		}
-		if (!fragmentShaderName.empty())
-		{
-			// check if material already exists
-			RenderShader* fragmentShader = _pResourceManagerPrivate->FindRenderShaderResource(fragmentShaderName.c_str());
-			if (!fragmentShader)
-			{
-				// create new shader object
-				fragmentShader = AllocateObject<RenderShader>(*_pResourceManagerPrivate->GetEngineAllocator()
-								, *_pResourceManagerPrivate->GetRenderDevice(), "fragment", language.c_str());
-				if (fragmentShader)
-				{
-					LoadShader(objectFinder, fragmentShaderName, fragmentShader);
-					// set shader entry function if available
-					if (!fragmentShaderEntry.empty())
-						fragmentShader->SetShaderEntryFunc(fragmentShaderEntry.c_str());
-
-					// Insert new shader into our map
-					_pResourceManagerPrivate->InsertRenderShaderResource(fragmentShaderName.c_str(), fragmentShader);
-				}
-			}
-			material->_fragmentShader = fragmentShader;
-		}
+	// check if shader already exists
+	RenderShader* shader = _pResourceManagerPrivate->FindRenderShaderResource(name.c_str());
+	if (shader)
+		return shader;
+
+	std::string filename(source);
+	ResourceLoadData fileData;
+	std::string path;
+	if (!OpenShader(objectFinder, filename, fileData, path))
+		return nullptr;
+
+	// the same bytecode may already be loaded under another name.
+	// The index is keyed by the resolved path, equal names in other directories are other files
+	ShaderCache* shaderCache = _pResourceManagerPrivate->GetShaderCache();
+	uint64_t contentHash = 0;
+	if (!shaderCache->LookupIndex(path, fileData.GetSize(), fileData.GetModificationTime(), contentHash))
+	{
+		contentHash = ShaderCache::HashContent(fileData.GetData(), fileData.GetSize());
+		shaderCache->UpdateIndex(path, fileData.GetSize(), fileData.GetModificationTime(), contentHash);
 	}
 
-	return true;
+	shader = shaderCache->Find(contentHash, type, language, entry, constantHash);
+	if (!shader)
+	{
+		// create new shader object. The shader module is created on first pipeline use
+		shader = AllocateObject<RenderShader>(*_pResourceManagerPrivate->GetEngineAllocator()
+						, *_pResourceManagerPrivate->GetRenderDevice(), type, language);
+		if (!shader)
+			return nullptr;
+
+		shader->SetShaderSource(reinterpret_cast<const char*>(fileData.GetData()), fileData.GetSize());
+		// set shader entry function if available
+		if (entry[0] != 0)
+			shader->SetShaderEntryFunc(entry);
+		if (constantCount)
+			shader->SetSpecializationConstants(constants, constantCount);
+
+		shader = shaderCache->Insert(contentHash, type, language, entry, constantHash, shader);
+	}
+
+	// Insert new name into our map
+	_pResourceManagerPrivate->InsertRenderShaderResource(name.c_str(), shader);
+
+	return shader;
 }
 
 }
@@ -28,6 +28,8 @@ namespace cave
 
 // forwards
 class RenderMaterial;
+class RenderShader;
+struct HalSpecializationConstant;
 
 /**
 * Load material assets
@@ -76,26 +78,56 @@ public:
 private:
 
 	/**
-	* @brief Load a material asset from a json file
+	* @brief Load a material asset from a json file. The json is compiled to the binary format first
 	*
 	* @param[in] objectFinder		Helper class to find resource
-	* @param[in] fileStream	File	stream where we read from
+	* @param[in] data				Json text (mapped file content)
+	* @param[in] size				Size of the text in bytes
 	* @param[in,out] material		Pointer to material we fill with data
 	*
 	* @return true if successful
 	*/
-	bool LoadMaterialJson(ResourceObjectFinder& objectFinder, std::ifstream& fileStream, RenderMaterial* material);
+	bool LoadMaterialJson(ResourceObjectFinder& objectFinder, const char* data, size_t size, RenderMaterial* material);
 
 	/**
-	* @brief Load a shader code from file
+	* @brief Load a material asset from a compiled material
+	*
+	* @param[in] objectFinder		Helper class to find resource
+	* @param[in] data				Compiled material (mapped file content)
+	* @param[in] size				Size of the data in bytes
+	* @param[in,out] material		Pointer to material we fill with data
+	*
+	* @return true if successful
+	*/
+	bool LoadMaterialBinary(ResourceObjectFinder& objectFinder, const uint8_t* data, size_t size, RenderMaterial* material);
+
+	/**
+	* @brief Find a shader by name or content or create and load it
+	*
+	* @param[in] objectFinder	Helper class to find resource
+	* @param[in] source			Shader file name (empty if the stage is not used)
+	* @param[in] type			Shader type (vertex, fragment)
+	* @param[in] language		Shader language
+	* @param[in] entry			Entry function (empty for the default)
+	* @param[in] constants		Specialization constants (may be nullptr if constantCount is 0)
+	* @param[in] constantCount	Number of specialization constants
+	*
+	* @return shader or nullptr
+	*/
+	RenderShader* GetShader(ResourceObjectFinder& objectFinder, const char* source, const char* type
+		, const char* language, const char* entry, const HalSpecializationConstant* constants, uint32_t constantCount);
+
+	/**
+	* @brief Find and map a shader file
 	*
 	* @param[in] objectFinder	Helper class to find resource
 	* @param[in] filename		File name
-	* @param[in,out] shader		RenderShader object we fill in
+	* @param[out] fileData		Receives the file content
+	* @param[out] path			Receives the resolved path of the file
 	*
 	* @return true if successful
 	*/
-	bool LoadShader(ResourceObjectFinder& objectFinder, std::string& filename, RenderShader* shader);
+	bool OpenShader(ResourceObjectFinder& objectFinder, const std::string& filename, ResourceLoadData& fileData, std::string& path);
 
 private:
 	ResourceManagerPrivate* _pResourceManagerPrivate;	///< Pointer to private resource manger
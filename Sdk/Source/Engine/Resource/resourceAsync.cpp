@@ -0,0 +1,57 @@
+/*
+Copyright (c) <2017> <Udo Lugauer>
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE
+*/
+
+/// @file resourceAsync.cpp
+///       Asynchronous resource requests
+
+#include "resourceAsync.h"
+
+namespace cave
+{
+
+ResourceTextureRequest::ResourceTextureRequest(const char* file, const ResourceTextureCallback& callback)
+	: _fileName(file)
+	, _callback(callback)
+	, _texture(nullptr)
+	, _state(ResourceRequestState::Loading)
+	, _cancelled(false)
+{
+}
+
+ResourceTextureRequest::~ResourceTextureRequest()
+{
+}
+
+bool ResourceTextureRequest::IsDone() const
+{
+	ResourceRequestState state = GetState();
+	return state == ResourceRequestState::Ready || state == ResourceRequestState::Failed || state == ResourceRequestState::Cancelled;
+}
+
+void ResourceTextureRequest::Complete(RenderTexture* texture)
+{
+	if (IsCancelled())
+	{
+		SetState(ResourceRequestState::Cancelled);
+		return;
+	}
+
+	_texture = texture;
+	SetState(texture ? ResourceRequestState::Ready : ResourceRequestState::Failed);
+
+	if (texture && _callback)
+		_callback(texture);
+}
+
+}
@@ -0,0 +1,127 @@
+/*
+Copyright (c) <2017> <Udo Lugauer>
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE
+*/
+#pragma once
+
+/// @file resourceAsync.h
+///       Asynchronous resource requests
+
+#include "engineDefines.h"
+
+#include <atomic>
+#include <string>
+#include <functional>
+#include <memory>
+
+/** \addtogroup engine
+*  @{
+*		This module contains all code related to resource handling
+*/
+
+namespace cave
+{
+
+/// forward declaration
+class RenderTexture;
+
+/**
+* @brief State of an asynchronous resource request
+*/
+enum class ResourceRequestState
+{
+	Loading = 0,	///< File is loaded and decoded by a job
+	Uploading = 1,	///< Waiting for the render thread to create and upload the GPU object
+	Ready = 2,		///< Request finished successfully
+	Failed = 3,		///< Resource could not be found or created
+	Cancelled = 4	///< Request was cancelled before it finished
+};
+
+/// Callback invoked on the render thread once a texture request finished successfully
+typedef std::function<void(RenderTexture*)> ResourceTextureCallback;
+
+/// Scheduler hook. Receives GPU work which must run on the render thread
+typedef std::function<void(const std::function<void()>&)> ResourceRenderThreadScheduler;
+
+/**
+* @brief Handle to an asynchronous texture request.
+*		 The request chains image load, decode, texture creation and upload without blocking the caller.
+*		 Loading and decoding run on the job system. Creating and uploading the texture
+*		 is handed to the render thread scheduler.
+*/
+class CAVE_INTERFACE ResourceTextureRequest
+{
+public:
+	/**
+	* @brief Constructor
+	*
+	* @param[in] file		Image file name
+	* @param[in] callback	Completion callback (may be empty)
+	*/
+	ResourceTextureRequest(const char* file, const ResourceTextureCallback& callback);
+
+	/** @brief Destructor */
+	~ResourceTextureRequest();
+
+	/** @brief Get file name */
+	const char* GetFileName() const { return _fileName.c_str(); }
+
+	/** @brief Get current state */
+	ResourceRequestState GetState() const { return _state.load(std::memory_order_acquire); }
+
+	/** @brief Check if the request reached a final state */
+	bool IsDone() const;
+
+	/**
+	* @brief Get the texture. Only valid if the state is Ready.
+	*
+	* @return RenderTexture or nullptr
+	*/
+	RenderTexture* GetTexture() const { return (GetState() == ResourceRequestState::Ready) ? _texture : nullptr; }
+
+	/**
+	* @brief Cancel the request. The texture is not created if the request did not reach the upload step yet.
+	*		 The decoded image stays in the resource cache.
+	*/
+	void Cancel() { _cancelled.store(true, std::memory_order_release); }
+
+	/** @brief Check if cancel was requested */
+	bool IsCancelled() const { return _cancelled.load(std::memory_order_acquire); }
+
+	/**
+	* @brief Set state. Used by the resource manager
+	*
+	* @param[in] state	New state
+	*/
+	void SetState(ResourceRequestState state) { _state.store(state, std::memory_order_release); }
+
+	/**
+	* @brief Finish the request. Used by the resource manager on the render thread
+	*
+	* @param[in] texture	Created texture or nullptr on failure
+	*/
+	void Complete(RenderTexture* texture);
+
+private:
+	std::string _fileName;						///< Image file
+	ResourceTextureCallback _callback;			///< Completion callback
+	RenderTexture* _texture;					///< Created texture
+	std::atomic<ResourceRequestState> _state;	///< Request state
+	std::atomic<bool> _cancelled;				///< Cancel requested
+};
+
+/// Shared handle type returned to the application
+typedef std::shared_ptr<ResourceTextureRequest> ResourceTextureRequestHandle;
+
+}
+
+/** @}*/
@@ -0,0 +1,485 @@
+/*
+Copyright (c) <2017> <Udo Lugauer>
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE
+*/
+#pragma once
+
+/// @file resourceCache.h
+///       Concurrent resource table with lock free lookups
+
+#include "engineDefines.h"
+#include "Memory/allocatorBase.h"
+
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <string>
+#include <functional>
+#include <memory>
+
+/** \addtogroup engine
+*  @{
+*		This module contains all code related to resource handling
+*/
+
+namespace cave
+{
+
+/**
+* @brief Load state of a cache entry
+*/
+enum class ResourceCacheState
+{
+	Missing = 0,	///< No entry or entry was removed
+	Pending = 1,	///< Entry is reserved and being loaded
+	Ready = 2,		///< Entry holds a valid resource
+	Failed = 3		///< Loading failed
+};
+
+/**
+* @brief Concurrent map from resource name to resource object.
+*		 Keys are distributed over shards, each shard has its own writer lock.
+*		 Lookups take no lock: every shard publishes an open addressing table through an atomic pointer.
+*		 Writers add entries to the published table or publish a larger copy when growing (read copy update).
+*		 Replaced tables and entries are only released with the cache, so readers never see freed memory.
+*		 Removed entries are kept and reused if the key is added again, which bounds the memory to
+*		 the number of distinct keys.
+*		 Threads waiting for a pending entry sleep until the entry is published, failed or removed.
+*/
+template<class T>
+class ResourceCache
+{
+public:
+	/**
+	* @brief Constructor
+	*
+	* @param[in] allocator	Engine allocator
+	*/
+	ResourceCache(std::shared_ptr<AllocatorBase> allocator)
+		: _pAllocator(allocator)
+	{
+		for (uint32_t i = 0; i < ShardCount; ++i)
+		{
+			_shards[i]._table.store(nullptr, std::memory_order_relaxed);
+			_shards[i]._count = 0;
+			_shards[i]._retired = nullptr;
+		}
+	}
+
+	/** @brief Destructor. Does not delete the resource objects */
+	~ResourceCache()
+	{
+		for (uint32_t i = 0; i < ShardCount; ++i)
+		{
+			Shard& shard = _shards[i];
+			Table* table = shard._table.load(std::memory_order_relaxed);
+			if (table)
+			{
+				// every entry is part of the latest table
+				for (uint32_t slot = 0; slot < table->_capacity; ++slot)
+				{
+					Entry* entry = table->_slots[slot].load(std::memory_order_relaxed);
+					if (entry)
+						DeallocateDelete(*_pAllocator, *entry);
+				}
+				FreeTable(table);
+			}
+
+			while (shard._retired)
+			{
+				Table* next = shard._retired->_next;
+				FreeTable(shard._retired);
+				shard._retired = next;
+			}
+		}
+	}
+
+	/** @brief copy constructor */
+	ResourceCache(const ResourceCache&) = delete; // no copy constructor
+	ResourceCache& operator=(const ResourceCache&) = delete; // no assignment operator
+
+	/**
+	* @brief Find a resource. Lock free.
+	*
+	* @param[in] key	Resource name
+	*
+	* @return Resource if the entry is ready or nullptr
+	*/
+	T* Find(const std::string& key) const
+	{
+		T* value = nullptr;
+		return (Lookup(key, &value) == ResourceCacheState::Ready) ? value : nullptr;
+	}
+
+	/**
+	* @brief Look up an entry. Lock free.
+	*
+	* @param[in] key	Resource name
+	* @param[out] value	Receives the stored resource (may be nullptr while pending)
+	*
+	* @return Entry state
+	*/
+	ResourceCacheState Lookup(const std::string& key, T** value) const
+	{
+		const Entry* entry = FindEntry(key, Hash(key));
+		if (!entry)
+		{
+			*value = nullptr;
+			return ResourceCacheState::Missing;
+		}
+
+		// state is published after the value
+		ResourceCacheState state = entry->_state.load(std::memory_order_acquire);
+		*value = entry->_value.load(std::memory_order_acquire);
+		return state;
+	}
+
+	/**
+	* @brief Reserve an entry for loading. Only one thread succeeds for a key,
+	*		 this thread must call Publish once loading finished.
+	*
+	* @param[in] key	Resource name
+	*
+	* @return true if the caller owns the load
+	*/
+	bool Reserve(const std::string& key)
+	{
+		return Insert(key, nullptr, ResourceCacheState::Pending);
+	}
+
+	/**
+	* @brief Add an entry if the key is missing
+	*
+	* @param[in] key	Resource name
+	* @param[in] value	Resource object
+	* @param[in] state	Initial state
+	*
+	* @return true if added. false if the key already exists
+	*/
+	bool Insert(const std::string& key, T* value, ResourceCacheState state = ResourceCacheState::Ready)
+	{
+		size_t hash = Hash(key);
+		Shard& shard = GetShard(hash);
+		std::lock_guard<std::mutex> lock(shard._mutex);
+
+		Entry* entry = FindEntry(key, hash);
+		if (entry)
+		{
+			if (entry->_state.load(std::memory_order_relaxed) != ResourceCacheState::Missing)
+				return false;
+		}
+		else
+		{
+			entry = AllocateObject<Entry>(*_pAllocator, key, hash);
+			InsertEntry(shard, entry);
+		}
+
+		entry->_value.store(value, std::memory_order_release);
+		entry->_state.store(state, std::memory_order_release);
+		WakeWaiters();
+		return true;
+	}
+
+	/**
+	* @brief Set value and state of an existing entry (usually after Reserve).
+	*		 The reserving thread must resolve the entry on every path, also when loading throws:
+	*		 publish it as ready or failed or remove it.
+	*
+	* @param[in] key	Resource name
+	* @param[in] value	Resource object
+	* @param[in] state	New state
+	*/
+	void Publish(const std::string& key, T* value, ResourceCacheState state)
+	{
+		size_t hash = Hash(key);
+		Shard& shard = GetShard(hash);
+		{
+			std::lock_guard<std::mutex> lock(shard._mutex);
+
+			Entry* entry = FindEntry(key, hash);
+			if (entry)
+			{
+				entry->_value.store(value, std::memory_order_release);
+				entry->_state.store(state, std::memory_order_release);
+			}
+		}
+		WakeWaiters();
+	}
+
+	/**
+	* @brief Change the state of an existing entry
+	*
+	* @param[in] key	Resource name
+	* @param[in] state	New state
+	*/
+	void SetState(const std::string& key, ResourceCacheState state)
+	{
+		Entry* entry = FindEntry(key, Hash(key));
+		if (entry)
+			entry->_state.store(state, std::memory_order_release);
+		WakeWaiters();
+	}
+
+	/**
+	* @brief Wait while an entry is pending. Sleeps until the entry changes
+	*
+	* @param[in] key	Resource name
+	*
+	* @return Resource if the entry is ready or nullptr
+	*/
+	T* Wait(const std::string& key) const
+	{
+		T* value = nullptr;
+		ResourceCacheState state = Lookup(key, &value);
+		if (state != ResourceCacheState::Pending)
+			return (state == ResourceCacheState::Ready) ? value : nullptr;
+
+		std::unique_lock<std::mutex> lock(_waitMutex);
+		_waitCondition.wait(lock, [&]()
+		{
+			state = Lookup(key, &value);
+			return state != ResourceCacheState::Pending;
+		});
+
+		return (state == ResourceCacheState::Ready) ? value : nullptr;
+	}
+
+	/**
+	* @brief Remove an entry
+	*
+	* @param[in] key	Resource name
+	*
+	* @return Removed resource or nullptr
+	*/
+	T* Remove(const std::string& key)
+	{
+		size_t hash = Hash(key);
+		Shard& shard = GetShard(hash);
+		std::lock_guard<std::mutex> lock(shard._mutex);
+
+		Entry* entry = FindEntry(key, hash);
+		if (!entry || entry->_state.load(std::memory_order_relaxed) == ResourceCacheState::Missing)
+			return nullptr;
+
+		entry->_state.store(ResourceCacheState::Missing, std::memory_order_release);
+		T* value = entry->_value.exchange(nullptr, std::memory_order_acq_rel);
+		WakeWaiters();
+		return value;
+	}
+
+	/**
+	* @brief Call func for every entry which is not missing.
+	*		 Entries added concurrently may be skipped.
+	*
+	* @param[in] func	Called with the resource name and object
+	*/
+	void ForEach(const std::function<void(const std::string&, T*)>& func) const
+	{
+		for (uint32_t i = 0; i < ShardCount; ++i)
+		{
+			const Table* table = _shards[i]._table.load(std::memory_order_acquire);
+			if (!table)
+				continue;
+
+			for (uint32_t slot = 0; slot < table->_capacity; ++slot)
+			{
+				const Entry* entry = table->_slots[slot].load(std::memory_order_acquire);
+				if (entry && entry->_state.load(std::memory_order_acquire) != ResourceCacheState::Missing)
+					func(entry->_key, entry->_value.load(std::memory_order_acquire));
+			}
+		}
+	}
+
+	/**
+	* @brief Mark all entries as missing. Not safe against concurrent writers.
+	*/
+	void Clear()
+	{
+		for (uint32_t i = 0; i < ShardCount; ++i)
+		{
+			Table* table = _shards[i]._table.load(std::memory_order_acquire);
+			if (!table)
+				continue;
+
+			for (uint32_t slot = 0; slot < table->_capacity; ++slot)
+			{
+				Entry* entry = table->_slots[slot].load(std::memory_order_acquire);
+				if (entry)
+				{
+					entry->_state.store(ResourceCacheState::Missing, std::memory_order_release);
+					entry->_value.store(nullptr, std::memory_order_release);
+				}
+			}
+		}
+		WakeWaiters();
+	}
+
+private:
+	/// Number of shards. Must be a power of two
+	static const uint32_t ShardCount = 16;
+	/// Initial table size of a shard. Must be a power of two
+	static const uint32_t InitialCapacity = 16;
+
+	/**
+	* @brief Cache entry. Never moves or gets released while the cache exists.
+	*/
+	struct Entry
+	{
+		const std::string _key;						///< Resource name
+		const size_t _hash;							///< Hash of the name
+		std::atomic<T*> _value;						///< Resource object
+		std::atomic<ResourceCacheState> _state;		///< Load state
+
+		/** @brief Constructor */
+		Entry(const std::string& key, size_t hash)
+			: _key(key), _hash(hash), _value(nullptr), _state(ResourceCacheState::Missing)
+		{}
+	};
+
+	/**
+	* @brief Open addressing table with linear probing. At most half full.
+	*/
+	struct Table
+	{
+		uint32_t _capacity;					///< Number of slots
+		std::atomic<Entry*>* _slots;		///< Slots
+		Table* _next;						///< Next retired table
+	};
+
+	/**
+	* @brief A shard of the cache
+	*/
+	struct Shard
+	{
+		std::mutex _mutex;					///< Writer lock
+		std::atomic<Table*> _table;			///< Published table
+		uint32_t _count;					///< Entries in the table
+		Table* _retired;					///< Tables replaced by a larger copy
+	};
+
+	static size_t Hash(const std::string& key)
+	{
+		size_t hash = std::hash<std::string>()(key);
+		// spread the bits, the low bits select the shard
+		hash ^= hash >> 15;
+		hash *= static_cast<size_t>(0x2C1B3C6DU);
+		hash ^= hash >> 12;
+		return hash;
+	}
+
+	/** @brief Wake threads in Wait after an entry changed its state */
+	void WakeWaiters()
+	{
+		// a waiter checks the state while holding the mutex, taking it here closes the gap
+		// between its check and going to sleep
+		{
+			std::lock_guard<std::mutex> lock(_waitMutex);
+		}
+		_waitCondition.notify_all();
+	}
+
+	Shard& GetShard(size_t hash)
+	{
+		return _shards[hash & (ShardCount - 1)];
+	}
+
+	Entry* FindEntry(const std::string& key, size_t hash) const
+	{
+		const Table* table = _shards[hash & (ShardCount - 1)]._table.load(std::memory_order_acquire);
+		if (!table)
+			return nullptr;
+
+		uint32_t mask = table->_capacity - 1;
+		uint32_t slot = static_cast<uint32_t>(hash >> 4) & mask;
+		while (true)
+		{
+			Entry* entry = table->_slots[slot].load(std::memory_order_acquire);
+			if (!entry)
+				return nullptr;
+			if (entry->_hash == hash && entry->_key == key)
+				return entry;
+			slot = (slot + 1) & mask;
+		}
+	}
+
+	Table* AllocateTable(uint32_t capacity)
+	{
+		Table* table = AllocateObject<Table>(*_pAllocator);
+		table->_capacity = capacity;
+		table->_slots = AllocateArray<std::atomic<Entry*>>(*_pAllocator, capacity);
+		table->_next = nullptr;
+		for (uint32_t i = 0; i < capacity; ++i)
+			table->_slots[i].store(nullptr, std::memory_order_relaxed);
+
+		return table;
+	}
+
+	void FreeTable(Table* table)
+	{
+		DeallocateArray<std::atomic<Entry*>>(*_pAllocator, table->_slots);
+		DeallocateDelete(*_pAllocator, *table);
+	}
+
+	static void PlaceEntry(Table* table, Entry* entry)
+	{
+		uint32_t mask = table->_capacity - 1;
+		uint32_t slot = static_cast<uint32_t>(entry->_hash >> 4) & mask;
+		while (table->_slots[slot].load(std::memory_order_relaxed))
+			slot = (slot + 1) & mask;
+
+		table->_slots[slot].store(entry, std::memory_order_release);
+	}
+
+	/**
+	* Note the caller must hold the shard lock
+	*/
+	void InsertEntry(Shard& shard, Entry* entry)
+	{
+		Table* table = shard._table.load(std::memory_order_relaxed);
+		if (!table || (shard._count + 1) * 2 > table->_capacity)
+		{
+			// publish a larger copy, readers may still use the old table
+			Table* grown = AllocateTable(table ? table->_capacity * 2 : InitialCapacity);
+			if (table)
+			{
+				for (uint32_t i = 0; i < table->_capacity; ++i)
+				{
+					Entry* existing = table->_slots[i].load(std::memory_order_relaxed);
+					if (existing)
+						PlaceEntry(grown, existing);
+				}
+
+				table->_next = shard._retired;
+				shard._retired = table;
+			}
+
+			PlaceEntry(grown, entry);
+			shard._table.store(grown, std::memory_order_release);
+		}
+		else
+		{
+			PlaceEntry(table, entry);
+		}
+
+		shard._count++;
+	}
+
+private:
+	std::shared_ptr<AllocatorBase> _pAllocator;	///< Engine allocator
+	Shard _shards[ShardCount];					///< Shards
+	mutable std::mutex _waitMutex;				///< Mutex for waiting threads
+	mutable std::condition_variable _waitCondition;	///< Signaled on state changes
+};
+
+}
+
+/** @}*/
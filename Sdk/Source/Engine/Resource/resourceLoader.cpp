@@ -0,0 +1,560 @@
+/*
+Copyright (c) <2017> <Udo Lugauer>
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE
+*/
+
+/// @file resourceLoader.cpp
+///       Bounded loader service for resource files
+
+#include "resourceLoader.h"
+#include "Jobs/jobSystem.h"
+
+#include <algorithm>
+
+namespace cave
+{
+
+/**
+* @brief Microseconds between two time points
+*/
+static inline uint64_t ElapsedMicroseconds(const std::chrono::steady_clock::time_point& start, const std::chrono::steady_clock::time_point& end)
+{
+	return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(end - start).count());
+}
+
+/**
+* @brief Average in milliseconds
+*/
+static inline float AverageMilliseconds(uint64_t sumUs, uint64_t count)
+{
+	return (count > 0) ? static_cast<float>(static_cast<double>(sumUs) / static_cast<double>(count) / 1000.0) : 0.0f;
+}
+
+ResourceLoader::ResourceLoader(std::shared_ptr<AllocatorBase> allocator, JobSystem* jobSystem, uint32_t ioThreadCount, uint32_t maxDecodeJobs)
+	: _pAllocator(allocator)
+	, _pJobSystem(jobSystem)
+	, _ioThreads(allocator)
+	, _maxDecodeJobs(maxDecodeJobs)
+	, _activeReads(0)
+	, _activeDecodes(0)
+	, _decodeCounter(nullptr)
+	, _quit(false)
+	, _requested(0)
+	, _deduplicated(0)
+	, _completed(0)
+	, _failed(0)
+	, _cancelled(0)
+	, _readCount(0)
+	, _decodeCount(0)
+	, _queueTimeUs(0)
+	, _readTimeUs(0)
+	, _decodeTimeUs(0)
+	, _latencyUs(0)
+	, _maxLatencyUs(0)
+{
+	// leave one job thread for the rest of the engine
+	if (_maxDecodeJobs == 0)
+		_maxDecodeJobs = (std::max)(1u, _pJobSystem->GetThreadCount() - 1);
+
+	_decodeCounter = AllocateObject<JobCounter>(*_pAllocator);
+
+	ioThreadCount = (std::max)(1u, ioThreadCount);
+	_ioThreads.Reserve(ioThreadCount);
+	for (uint32_t i = 0; i < ioThreadCount; ++i)
+		_ioThreads.Push(new std::thread(&ResourceLoader::IoThread, this));
+}
+
+ResourceLoader::~ResourceLoader()
+{
+	TRequestList finished;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_quit = true;
+		for (uint32_t i = 0; i < ResourceLoadPriorityCount; ++i)
+		{
+			while (!_ioQueue[i].empty())
+			{
+				Finish(_ioQueue[i].front(), ResourceLoadState::Cancelled, finished);
+				_ioQueue[i].pop_front();
+			}
+			while (!_decodeQueue[i].empty())
+			{
+				Finish(_decodeQueue[i].front(), ResourceLoadState::Cancelled, finished);
+				_decodeQueue[i].pop_front();
+			}
+		}
+	}
+	_ioCondition.notify_all();
+	Complete(finished);
+
+	// reads in progress finish as cancelled
+	for (size_t i = 0; i < _ioThreads.Size(); ++i)
+	{
+		_ioThreads[i]->join();
+		delete _ioThreads[i];
+	}
+	_ioThreads.Clear();
+
+	// running decodes still access their request
+	_pJobSystem->Wait(*_decodeCounter);
+	DeallocateDelete(*_pAllocator, *_decodeCounter);
+
+	// only requests somebody still waits for are left
+	TRequestMap::iterator iter;
+	for (iter = _requests.begin(); iter != _requests.end(); ++iter)
+		DeleteRequest(iter->second);
+	_requests.clear();
+}
+
+bool ResourceLoader::Request(const std::string& key, ResourceLoadPriority priority, const ResourceReadFunction& read, const ResourceDecodeFunction& decode)
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		if (_quit)
+			return false;
+
+		LoadRequest* request = nullptr;
+		TRequestMap::iterator entry = _requests.find(key);
+		if (entry != _requests.end())
+		{
+			request = entry->second;
+			// finished requests still used by a waiting thread or continuation are queued again
+			if (request->_state == ResourceLoadState::Queued || request->_state == ResourceLoadState::Reading
+				|| request->_state == ResourceLoadState::DecodePending || request->_state == ResourceLoadState::Decoding)
+			{
+				// already known, only raise the priority and revoke a pending cancel
+				_deduplicated++;
+				request->_cancelRequested = false;
+				if (priority < request->_priority)
+					Reprioritize(request, priority);
+				return false;
+			}
+		}
+		else
+		{
+			request = AllocateObject<LoadRequest>(*_pAllocator);
+			request->_key = key;
+			request->_refCount = 0;
+			request->_counter = AllocateObject<JobCounter>(*_pAllocator);
+			_requests.insert(TRequestMap::value_type(key, request));
+		}
+
+		request->_read = read;
+		request->_decode = decode;
+		request->_priority = priority;
+		request->_state = ResourceLoadState::Queued;
+		request->_cancelRequested = false;
+		request->_requestTime = TClock::now();
+		// the load keeps the request until its counter was decremented
+		request->_refCount++;
+		request->_counter->Increment();
+		_ioQueue[static_cast<uint32_t>(priority)].push_back(request);
+		_requested++;
+	}
+
+	_ioCondition.notify_one();
+	return true;
+}
+
+void ResourceLoader::SetPriority(const std::string& key, ResourceLoadPriority priority)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	TRequestMap::iterator entry = _requests.find(key);
+	if (entry != _requests.end())
+		Reprioritize(entry->second, priority);
+}
+
+bool ResourceLoader::Cancel(const std::string& key)
+{
+	TRequestList finished;
+	bool cancelled = false;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		TRequestMap::iterator entry = _requests.find(key);
+		if (entry == _requests.end())
+			return false;
+
+		cancelled = CancelRequest(entry->second, finished);
+	}
+
+	Complete(finished);
+	return cancelled;
+}
+
+uint32_t ResourceLoader::CancelPriority(ResourceLoadPriority priority)
+{
+	TRequestList finished;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		uint32_t index = static_cast<uint32_t>(priority);
+
+		while (!_ioQueue[index].empty())
+		{
+			Finish(_ioQueue[index].front(), ResourceLoadState::Cancelled, finished);
+			_ioQueue[index].pop_front();
+		}
+
+		while (!_decodeQueue[index].empty())
+		{
+			Finish(_decodeQueue[index].front(), ResourceLoadState::Cancelled, finished);
+			_decodeQueue[index].pop_front();
+		}
+	}
+
+	uint32_t count = static_cast<uint32_t>(finished.size());
+	Complete(finished);
+	return count;
+}
+
+uint32_t ResourceLoader::CancelAll()
+{
+	uint32_t count = 0;
+	for (uint32_t i = 0; i < ResourceLoadPriorityCount; ++i)
+		count += CancelPriority(static_cast<ResourceLoadPriority>(i));
+
+	return count;
+}
+
+ResourceLoadState ResourceLoader::Wait(const std::string& key)
+{
+	LoadRequest* request = nullptr;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		TRequestMap::iterator entry = _requests.find(key);
+		if (entry == _requests.end())
+			return ResourceLoadState::Unknown;
+
+		// somebody blocks on it now
+		request = entry->second;
+		request->_refCount++;
+		Reprioritize(request, ResourceLoadPriority::Visible);
+	}
+
+	_pJobSystem->Wait(*request->_counter);
+
+	return ReleaseRequest(request);
+}
+
+ResourceLoadState ResourceLoader::GetState(const std::string& key)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	TRequestMap::const_iterator entry = _requests.find(key);
+	if (entry == _requests.end())
+		return ResourceLoadState::Unknown;
+
+	return entry->second->_state;
+}
+
+bool ResourceLoader::AddContinuation(const std::string& key, const ResourceContinuationFunction& continuation, JobCounter* counter)
+{
+	LoadRequest* request = nullptr;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		TRequestMap::iterator entry = _requests.find(key);
+		if (entry == _requests.end())
+			return false;
+
+		request = entry->second;
+		request->_refCount++;
+	}
+
+	// runs once the request counter completes
+	_pJobSystem->Submit([this, request, continuation]()
+	{
+		continuation(ReleaseRequest(request));
+	}, counter, request->_counter);
+
+	return true;
+}
+
+void ResourceLoader::GetStats(ResourceLoaderStats& stats)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	for (uint32_t i = 0; i < ResourceLoadPriorityCount; ++i)
+	{
+		stats._ioQueueDepth[i] = static_cast<uint32_t>(_ioQueue[i].size());
+		stats._decodeQueueDepth[i] = static_cast<uint32_t>(_decodeQueue[i].size());
+	}
+	stats._activeReads = _activeReads;
+	stats._activeDecodes = _activeDecodes;
+	stats._requested = _requested;
+	stats._deduplicated = _deduplicated;
+	stats._completed = _completed;
+	stats._failed = _failed;
+	stats._cancelled = _cancelled;
+	stats._averageQueueTimeMs = AverageMilliseconds(_queueTimeUs, _readCount);
+	stats._averageReadTimeMs = AverageMilliseconds(_readTimeUs, _readCount);
+	stats._averageDecodeTimeMs = AverageMilliseconds(_decodeTimeUs, _decodeCount);
+	stats._averageLatencyMs = AverageMilliseconds(_latencyUs, _completed + _failed);
+	stats._maxLatencyMs = static_cast<float>(static_cast<double>(_maxLatencyUs) / 1000.0);
+}
+
+void ResourceLoader::IoThread()
+{
+	while (true)
+	{
+		LoadRequest* request = nullptr;
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			while (!_quit && (request = PopQueue(_ioQueue)) == nullptr)
+				_ioCondition.wait(lock);
+
+			if (!request)
+				return;
+
+			request->_state = ResourceLoadState::Reading;
+			request->_readTime = TClock::now();
+			_activeReads++;
+		}
+
+		// blocking file access happens here, outside of the job system
+		bool success = false;
+		try
+		{
+			success = request->_read(request->_data);
+		}
+		catch (std::exception&)
+		{
+			success = false;
+		}
+
+		TRequestList finished;
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			TClock::time_point now = TClock::now();
+			_activeReads--;
+			_readCount++;
+			_queueTimeUs += ElapsedMicroseconds(request->_requestTime, request->_readTime);
+			_readTimeUs += ElapsedMicroseconds(request->_readTime, now);
+
+			if (request->_cancelRequested || _quit)
+			{
+				Finish(request, ResourceLoadState::Cancelled, finished);
+			}
+			else if (!success)
+			{
+				Finish(request, ResourceLoadState::Failed, finished);
+			}
+			else
+			{
+				request->_state = ResourceLoadState::DecodePending;
+				_decodeQueue[static_cast<uint32_t>(request->_priority)].push_back(request);
+			}
+		}
+
+		Complete(finished);
+		DispatchDecodes();
+	}
+}
+
+void ResourceLoader::DispatchDecodes()
+{
+	while (true)
+	{
+		LoadRequest* request = nullptr;
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			if (_activeDecodes >= _maxDecodeJobs)
+				return;
+
+			request = PopQueue(_decodeQueue);
+			if (!request)
+				return;
+
+			request->_state = ResourceLoadState::Decoding;
+			request->_decodeTime = TClock::now();
+			_activeDecodes++;
+		}
+
+		_pJobSystem->Submit([this, request]()
+		{
+			Decode(request);
+		}, _decodeCounter);
+	}
+}
+
+/**
+* Note this function is called from a job system worker
+*/
+void ResourceLoader::Decode(LoadRequest* request)
+{
+	bool success = false;
+	try
+	{
+		success = request->_decode(request->_data);
+	}
+	catch (std::exception&)
+	{
+		success = false;
+	}
+
+	TRequestList finished;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_activeDecodes--;
+		_decodeCount++;
+		_decodeTimeUs += ElapsedMicroseconds(request->_decodeTime, TClock::now());
+		Finish(request, success ? ResourceLoadState::Ready : ResourceLoadState::Failed, finished);
+	}
+	Complete(finished);
+
+	// our slot is free again
+	DispatchDecodes();
+}
+
+/**
+* Note the caller must hold the mutex and remove the request from its queue.
+* The caller passes finished to Complete once it released the mutex
+*/
+void ResourceLoader::Finish(LoadRequest* request, ResourceLoadState state, TRequestList& finished)
+{
+	request->_state = state;
+
+	// release the file content and function captures
+	request->_data.Release();
+	request->_read = ResourceReadFunction();
+	request->_decode = ResourceDecodeFunction();
+
+	if (state == ResourceLoadState::Cancelled)
+	{
+		_cancelled++;
+	}
+	else
+	{
+		uint64_t latency = ElapsedMicroseconds(request->_requestTime, TClock::now());
+		_latencyUs += latency;
+		_maxLatencyUs = (std::max)(_maxLatencyUs, latency);
+		if (state == ResourceLoadState::Ready)
+			_completed++;
+		else
+			_failed++;
+	}
+
+	finished.push_back(request);
+}
+
+/**
+* Note the caller must not hold the mutex, decrementing the counter may run dependent jobs
+*/
+void ResourceLoader::Complete(TRequestList& finished)
+{
+	for (size_t i = 0; i < finished.size(); ++i)
+	{
+		finished[i]->_counter->Decrement();
+		// drop the reference of the load
+		ReleaseRequest(finished[i]);
+	}
+	finished.clear();
+}
+
+ResourceLoadState ResourceLoader::ReleaseRequest(LoadRequest* request)
+{
+	ResourceLoadState state = ResourceLoadState::Unknown;
+	bool remove = false;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		state = request->_state;
+		// the last user forgets the request. A later request of the key starts a new load
+		if (--request->_refCount == 0)
+		{
+			TRequestMap::iterator entry = _requests.find(request->_key);
+			if (entry != _requests.end() && entry->second == request)
+				_requests.erase(entry);
+			remove = true;
+		}
+	}
+
+	if (remove)
+		DeleteRequest(request);
+
+	return state;
+}
+
+void ResourceLoader::DeleteRequest(LoadRequest* request)
+{
+	DeallocateDelete(*_pAllocator, *request->_counter);
+	DeallocateDelete(*_pAllocator, *request);
+}
+
+bool ResourceLoader::CancelRequest(LoadRequest* request, TRequestList& finished)
+{
+	uint32_t index = static_cast<uint32_t>(request->_priority);
+
+	switch (request->_state)
+	{
+	case ResourceLoadState::Queued:
+		RemoveFromQueue(&_ioQueue[index], request);
+		Finish(request, ResourceLoadState::Cancelled, finished);
+		return true;
+	case ResourceLoadState::Reading:
+		// the I/O thread finishes the request
+		request->_cancelRequested = true;
+		return true;
+	case ResourceLoadState::DecodePending:
+		RemoveFromQueue(&_decodeQueue[index], request);
+		Finish(request, ResourceLoadState::Cancelled, finished);
+		return true;
+	case ResourceLoadState::Cancelled:
+		return true;
+	default:
+		return false;
+	}
+}
+
+void ResourceLoader::Reprioritize(LoadRequest* request, ResourceLoadPriority priority)
+{
+	if (request->_priority == priority)
+		return;
+
+	uint32_t from = static_cast<uint32_t>(request->_priority);
+	uint32_t to = static_cast<uint32_t>(priority);
+	request->_priority = priority;
+
+	// requests which already reached a stage keep running
+	if (request->_state == ResourceLoadState::Queued)
+	{
+		if (RemoveFromQueue(&_ioQueue[from], request))
+			_ioQueue[to].push_back(request);
+	}
+	else if (request->_state == ResourceLoadState::DecodePending)
+	{
+		if (RemoveFromQueue(&_decodeQueue[from], request))
+			_decodeQueue[to].push_back(request);
+	}
+}
+
+bool ResourceLoader::RemoveFromQueue(TRequestQueue* queue, LoadRequest* request)
+{
+	TRequestQueue::iterator iter = std::find(queue->begin(), queue->end(), request);
+	if (iter == queue->end())
+		return false;
+
+	queue->erase(iter);
+	return true;
+}
+
+ResourceLoader::LoadRequest* ResourceLoader::PopQueue(TRequestQueue* queues)
+{
+	for (uint32_t i = 0; i < ResourceLoadPriorityCount; ++i)
+	{
+		if (!queues[i].empty())
+		{
+			LoadRequest* request = queues[i].front();
+			queues[i].pop_front();
+			return request;
+		}
+	}
+
+	return nullptr;
+}
+
+}
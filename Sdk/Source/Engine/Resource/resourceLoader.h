@@ -0,0 +1,385 @@
+/*
+Copyright (c) <2017> <Udo Lugauer>
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE
+*/
+#pragma once
+
+/// @file resourceLoader.h
+///       Bounded loader service for resource files
+
+#include "engineDefines.h"
+#include "Common/caveVector.h"
+#include "Memory/allocatorBase.h"
+#include "osMappedFile.h"
+
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <memory>
+
+/** \addtogroup engine
+*  @{
+*		This module contains all code related to resource handling
+*/
+
+namespace cave
+{
+
+/// forward declaration
+class JobSystem;
+class JobCounter;
+
+/**
+* @brief Priority class of a load request. Lower values are served first.
+*/
+enum class ResourceLoadPriority
+{
+	Visible = 0,	///< Needed for the current frame
+	Prefetch = 1,	///< Needed soon (e.g. level preload)
+	Background = 2	///< Speculative loads
+};
+
+/// Number of priority classes
+static const uint32_t ResourceLoadPriorityCount = 3;
+
+/**
+* @brief State of a load request
+*/
+enum class ResourceLoadState
+{
+	Unknown = 0,		///< No request with this key
+	Queued = 1,			///< Waiting for an I/O thread
+	Reading = 2,		///< File is read by an I/O thread
+	DecodePending = 3,	///< Waiting for a decode slot
+	Decoding = 4,		///< Decoded by a job
+	Ready = 5,			///< Finished successfully
+	Failed = 6,			///< Read or decode failed
+	Cancelled = 7		///< Cancelled before decoding started
+};
+
+/**
+* @brief File content handed from the I/O stage to the decode stage.
+*		 Either a memory mapping, a view into memory owned by someone else (e.g. a mounted package)
+*		 or a buffer. Mappings and views are preferred, the decoder reads them in place.
+*/
+class CAVE_INTERFACE ResourceLoadData
+{
+public:
+	/** @brief Constructor */
+	ResourceLoadData() : _view(nullptr), _viewSize(0) {}
+
+	/** @brief Get the mapping to fill in the I/O stage */
+	OsMappedFile& GetMappedFile() { return _mappedFile; }
+
+	/** @brief Get the buffer to fill in the I/O stage if the content can't be mapped */
+	std::vector<char>& GetBuffer() { return _buffer; }
+
+	/**
+	* @brief Reference content which outlives this object instead of owning it
+	*
+	* @param[in] data	Content
+	* @param[in] size	Content size in bytes
+	*/
+	void SetView(const uint8_t* data, size_t size)
+	{
+		_view = data;
+		_viewSize = size;
+	}
+
+	/** @brief Get the content */
+	const uint8_t* GetData() const
+	{
+		if (_mappedFile.IsOpen())
+			return _mappedFile.GetData();
+		if (_view)
+			return _view;
+		return reinterpret_cast<const uint8_t*>(_buffer.data());
+	}
+
+	/** @brief Get the content size in bytes */
+	size_t GetSize() const
+	{
+		if (_mappedFile.IsOpen())
+			return _mappedFile.GetSize();
+		if (_view)
+			return _viewSize;
+		return _buffer.size();
+	}
+
+	/** @brief Get the modification time of mapped content. 0 if unknown (views and buffers) */
+	uint64_t GetModificationTime() const
+	{
+		return _mappedFile.IsOpen() ? _mappedFile.GetModificationTime() : 0;
+	}
+
+	/** @brief Fault in the pages of mapped content so later consumers don't stall */
+	void Prefault() const
+	{
+		if (_mappedFile.IsOpen())
+		{
+			_mappedFile.Prefault();
+		}
+		else if (_view)
+		{
+			// touch one byte per page
+			volatile uint8_t sink = 0;
+			for (size_t offset = 0; offset < _viewSize; offset += 4096)
+				sink ^= _view[offset];
+			(void)sink;
+		}
+	}
+
+	/**
+	* @brief Take over the content of another object. Pointers into the content stay valid.
+	*
+	* @param[in,out] other	Content to swap with
+	*/
+	void Swap(ResourceLoadData& other)
+	{
+		_mappedFile.Swap(other._mappedFile);
+		_buffer.swap(other._buffer);
+		std::swap(_view, other._view);
+		std::swap(_viewSize, other._viewSize);
+	}
+
+	/** @brief Unmap and release the content */
+	void Release()
+	{
+		_mappedFile.Close();
+		std::vector<char>().swap(_buffer);
+		_view = nullptr;
+		_viewSize = 0;
+	}
+
+private:
+	OsMappedFile _mappedFile;	///< Mapped content
+	std::vector<char> _buffer;	///< Buffered content
+	const uint8_t* _view;		///< Referenced content (not owned)
+	size_t _viewSize;			///< Size of the referenced content
+};
+
+/// I/O stage. Maps or reads the file content, returns false if the file could not be read
+typedef std::function<bool(ResourceLoadData&)> ResourceReadFunction;
+
+/// Decode stage. Receives the file content, returns false on failure. The decoder may take the content over with Swap
+typedef std::function<bool(ResourceLoadData&)> ResourceDecodeFunction;
+
+/// Runs as a job once a request finished. Receives the final state of the request
+typedef std::function<void(ResourceLoadState)> ResourceContinuationFunction;
+
+/**
+* @brief Loader statistics. Latencies are averaged over all finished requests.
+*/
+struct ResourceLoaderStats
+{
+	uint32_t _ioQueueDepth[ResourceLoadPriorityCount];		///< Requests waiting for an I/O thread per priority
+	uint32_t _decodeQueueDepth[ResourceLoadPriorityCount];	///< Requests waiting for a decode slot per priority
+	uint32_t _activeReads;		///< Requests currently read
+	uint32_t _activeDecodes;	///< Requests currently decoded
+	uint64_t _requested;		///< Accepted requests
+	uint64_t _deduplicated;		///< Requests merged into an existing request
+	uint64_t _completed;		///< Successfully finished requests
+	uint64_t _failed;			///< Failed requests
+	uint64_t _cancelled;		///< Cancelled requests
+	float _averageQueueTimeMs;	///< Time from request to I/O start
+	float _averageReadTimeMs;	///< Time spent in the I/O stage
+	float _averageDecodeTimeMs;	///< Time spent in the decode stage
+	float _averageLatencyMs;	///< Time from request to completion
+	float _maxLatencyMs;		///< Worst time from request to completion
+};
+
+/**
+* @brief Loads resources with a fixed number of I/O threads and a bounded number of decode jobs.
+*		 File reads run on dedicated I/O threads so blocking disk access never stalls job system workers.
+*		 Decoding runs on the job system with a limit on concurrently running decode jobs.
+*		 Both stages serve the highest priority class first. Requests are identified by a key,
+*		 requesting a key which is already in flight only raises its priority.
+*		 Requests can be cancelled as long as decoding did not start.
+*		 Finished requests are forgotten once no waiting thread or continuation uses them anymore.
+*/
+class CAVE_INTERFACE ResourceLoader
+{
+public:
+	/**
+	* @brief Constructor
+	*
+	* @param[in] allocator		Engine allocator
+	* @param[in] jobSystem		Job system used for decoding
+	* @param[in] ioThreadCount	Number of I/O threads (minimum 1)
+	* @param[in] maxDecodeJobs	Maximum concurrent decode jobs. 0 uses the job system thread count minus one
+	*/
+	ResourceLoader(std::shared_ptr<AllocatorBase> allocator, JobSystem* jobSystem, uint32_t ioThreadCount = 2, uint32_t maxDecodeJobs = 0);
+
+	/** @brief Destructor. Cancels queued requests and waits for running ones */
+	~ResourceLoader();
+
+	/**
+	* @brief Request a load. If the key is in flight only its priority is raised.
+	*		 A finished request which is still known is started again.
+	*
+	* @param[in] key		Unique request key (usually the file name)
+	* @param[in] priority	Priority class
+	* @param[in] read		I/O stage function
+	* @param[in] decode		Decode stage function
+	*
+	* @return true if a new request was queued, false if merged into one in flight
+	*/
+	bool Request(const std::string& key, ResourceLoadPriority priority, const ResourceReadFunction& read, const ResourceDecodeFunction& decode);
+
+	/**
+	* @brief Change the priority of a request which did not reach a stage yet
+	*
+	* @param[in] key		Request key
+	* @param[in] priority	New priority class
+	*/
+	void SetPriority(const std::string& key, ResourceLoadPriority priority);
+
+	/**
+	* @brief Cancel a request. A request being read is cancelled once the read finished.
+	*
+	* @param[in] key	Request key
+	*
+	* @return true if the request will not be decoded
+	*/
+	bool Cancel(const std::string& key);
+
+	/**
+	* @brief Cancel all queued requests of a priority class (e.g. stale prefetches after a level switch)
+	*
+	* @param[in] priority	Priority class
+	*
+	* @return Number of cancelled requests
+	*/
+	uint32_t CancelPriority(ResourceLoadPriority priority);
+
+	/**
+	* @brief Cancel all queued requests
+	*
+	* @return Number of cancelled requests
+	*/
+	uint32_t CancelAll();
+
+	/**
+	* @brief Wait until a request finished. The request is raised to Visible priority first.
+	*		 The calling thread executes jobs while waiting.
+	*
+	* @param[in] key	Request key
+	*
+	* @return Final state or Unknown if there is no such request
+	*/
+	ResourceLoadState Wait(const std::string& key);
+
+	/**
+	* @brief Get the state of a request
+	*
+	* @param[in] key	Request key
+	*
+	* @return Request state or Unknown
+	*/
+	ResourceLoadState GetState(const std::string& key);
+
+	/**
+	* @brief Run a job once a request finished. The request is kept until the job ran.
+	*
+	* @param[in] key			Request key
+	* @param[in] continuation	Job function, receives the final state
+	* @param[in] counter		Optional counter tracking the job as in JobSystem::Submit
+	*
+	* @return false if there is no such request
+	*/
+	bool AddContinuation(const std::string& key, const ResourceContinuationFunction& continuation, JobCounter* counter = nullptr);
+
+	/**
+	* @brief Get loader statistics
+	*
+	* @param[out] stats	Filled with current values
+	*/
+	void GetStats(ResourceLoaderStats& stats);
+
+private:
+	typedef std::chrono::steady_clock TClock;	///< Clock used for latencies
+
+	/**
+	* @brief A load request
+	*/
+	struct LoadRequest
+	{
+		std::string _key;					///< Request key
+		ResourceReadFunction _read;			///< I/O stage
+		ResourceDecodeFunction _decode;		///< Decode stage
+		ResourceLoadData _data;				///< File content between the stages
+		ResourceLoadPriority _priority;		///< Priority class
+		ResourceLoadState _state;			///< Current state
+		bool _cancelRequested;				///< Cancel once the read finished
+		uint32_t _refCount;					///< Load in flight, waiting threads and continuations
+		JobCounter* _counter;				///< One while in flight
+		TClock::time_point _requestTime;	///< Time of request
+		TClock::time_point _readTime;		///< Time the read started
+		TClock::time_point _decodeTime;		///< Time the decode started
+	};
+
+	typedef std::deque<LoadRequest*> TRequestQueue;					///< Queue of one priority class
+	typedef std::map<std::string, LoadRequest*> TRequestMap;		///< Requests by key
+	typedef std::vector<LoadRequest*> TRequestList;					///< Finished requests to complete outside the lock
+
+	void IoThread();
+	void DispatchDecodes();
+	void Decode(LoadRequest* request);
+	void Finish(LoadRequest* request, ResourceLoadState state, TRequestList& finished);
+	void Complete(TRequestList& finished);
+	ResourceLoadState ReleaseRequest(LoadRequest* request);
+	void DeleteRequest(LoadRequest* request);
+	bool CancelRequest(LoadRequest* request, TRequestList& finished);
+	void Reprioritize(LoadRequest* request, ResourceLoadPriority priority);
+	bool RemoveFromQueue(TRequestQueue* queue, LoadRequest* request);
+	LoadRequest* PopQueue(TRequestQueue* queues);
+
+private:
+	std::shared_ptr<AllocatorBase> _pAllocator;		///< Engine allocator
+	JobSystem* _pJobSystem;							///< Job system used for decoding
+	caveVector<std::thread*> _ioThreads;			///< I/O threads
+	uint32_t _maxDecodeJobs;						///< Decode job limit
+
+	std::mutex _mutex;								///< Protects all members below
+	std::condition_variable _ioCondition;			///< Wakes I/O threads
+	TRequestMap _requests;							///< All requests
+	TRequestQueue _ioQueue[ResourceLoadPriorityCount];		///< Requests waiting for I/O
+	TRequestQueue _decodeQueue[ResourceLoadPriorityCount];	///< Requests waiting for decode
+	uint32_t _activeReads;							///< Running reads
+	uint32_t _activeDecodes;						///< Running decode jobs
+	JobCounter* _decodeCounter;						///< Outstanding decode jobs
+	bool _quit;										///< Stop I/O threads
+
+	uint64_t _requested;							///< Statistics
+	uint64_t _deduplicated;							///< Statistics
+	uint64_t _completed;							///< Statistics
+	uint64_t _failed;								///< Statistics
+	uint64_t _cancelled;							///< Statistics
+	uint64_t _readCount;							///< Number of finished reads
+	uint64_t _decodeCount;							///< Number of finished decodes
+	uint64_t _queueTimeUs;							///< Summed queue time
+	uint64_t _readTimeUs;							///< Summed read time
+	uint64_t _decodeTimeUs;							///< Summed decode time
+	uint64_t _latencyUs;							///< Summed request latency
+	uint64_t _maxLatencyUs;							///< Worst request latency
+};
+
+}
+
+/** @}*/
@@ -63,7 +63,7 @@ RenderMaterial ResourceManager::LoadMaterialAsset(const char* file)
 	return RenderMaterial(*material);
 }
 
-void ResourceManager::LoadImageAsset(const char* file)
+void ResourceManager::LoadImageAsset(const char* file, ResourceLoadPriority priority)
 {
 	if (!file)
 	{
@@ -71,7 +71,35 @@ void ResourceManager::LoadImageAsset(const char* file)
 		return;
 	}
 
-	_pResourceManagerPrivate->LoadImageAsset(file);
+	_pResourceManagerPrivate->LoadImageAsset(file, priority);
+}
+
+bool ResourceManager::CancelImageAsset(const char* file)
+{
+	if (!file)
+		return false;
+
+	return _pResourceManagerPrivate->CancelImageAsset(file);
+}
+
+uint32_t ResourceManager::CancelImageAssets(ResourceLoadPriority priority)
+{
+	return _pResourceManagerPrivate->GetResourceLoader()->CancelPriority(priority);
+}
+
+void ResourceManager::GetLoaderStats(ResourceLoaderStats& stats)
+{
+	_pResourceManagerPrivate->GetResourceLoader()->GetStats(stats);
+}
+
+void ResourceManager::SetImageHostCopy(bool keep)
+{
+	_pResourceManagerPrivate->SetImageHostCopy(keep);
+}
+
+bool ResourceManager::MountPackage(const char* path)
+{
+	return _pResourceManagerPrivate->MountPackage(path);
 }
 
 RenderTexture* ResourceManager::GetTexture(const char* file)
@@ -84,4 +112,27 @@ void ResourceManager::ReleaseTexture(RenderTexture* texture)
 	_pResourceManagerPrivate->ReleaseTexture(texture);
 }
 
+ResourceTextureRequestHandle ResourceManager::LoadTextureAsync(const char* file, const ResourceTextureCallback& callback, ResourceLoadPriority priority)
+{
+	if (!file)
+	{
+		_pResourceManagerPrivate->_pRenderDevice->GetEngineLog()->Error("Could not find file %s", file);
+		ResourceTextureRequestHandle request = std::make_shared<ResourceTextureRequest>("", callback);
+		request->SetState(ResourceRequestState::Failed);
+		return request;
+	}
+
+	return _pResourceManagerPrivate->LoadTextureAsync(file, callback, priority);
+}
+
+void ResourceManager::SetRenderThreadScheduler(const ResourceRenderThreadScheduler& scheduler)
+{
+	_pResourceManagerPrivate->SetRenderThreadScheduler(scheduler);
+}
+
+uint32_t ResourceManager::ProcessRenderThreadTasks(uint32_t maxTasks)
+{
+	return _pResourceManagerPrivate->ProcessRenderThreadTasks(maxTasks);
+}
+
 }
@@ -68,13 +68,61 @@ public:
 	virtual RenderMaterial LoadMaterialAsset(const char* file);
 
 	/**
-	* @brief Load an image asset
+	* @brief Load an image asset. Loading runs in the background, requesting an image
+	* which is already loading only raises its priority.
 	*
 	* @param[in] file					String to file
+	* @param[in] priority				Loader priority class
+	*/
+	virtual void LoadImageAsset(const char* file, ResourceLoadPriority priority = ResourceLoadPriority::Prefetch);
+
+	/**
+	* @brief Cancel loading an image asset which is no longer needed.
+	* Has no effect once decoding started.
 	*
-	* @return true if successful
+	* @param[in] file					String to file
+	*
+	* @return true if the image will not be decoded
+	*/
+	bool CancelImageAsset(const char* file);
+
+	/**
+	* @brief Cancel all queued image loads of a priority class (e.g. stale prefetches)
+	*
+	* @param[in] priority				Loader priority class
+	*
+	* @return Number of cancelled loads
+	*/
+	uint32_t CancelImageAssets(ResourceLoadPriority priority);
+
+	/**
+	* @brief Get resource loader statistics (queue depth and latency)
+	*
+	* @param[out] stats					Filled with current values
+	*/
+	void GetLoaderStats(ResourceLoaderStats& stats);
+
+	/**
+	* @brief Keep a host copy of decoded images.
+	* Disabled by default: images then reference the mapped file and textures
+	* are written straight into staging memory, touching the data once.
+	* Affects images decoded after the call.
+	*
+	* @param[in] keep					true to decode into a host copy
 	*/
-	virtual void LoadImageAsset(const char* file);
+	void SetImageHostCopy(bool keep);
+
+	/**
+	* @brief Mount a resource package (.cavepak). Files found in the package are loaded from it
+	* without searching the content folders. A Content.cavepak next to the project or
+	* application content folder is mounted automatically.
+	* Can be called from any thread, loads already in flight keep reading loose files.
+	*
+	* @param[in] path					Path to the package file
+	*
+	* @return false if the package is invalid or a package is already mounted
+	*/
+	bool MountPackage(const char* path);
 
 	/**
 	* @brief Get/create a texture object
@@ -95,6 +143,36 @@ public:
 	*/
 	void ReleaseTexture(RenderTexture* texture);
 
+	/**
+	* @brief Request a texture without blocking the caller.
+	* Load and decode run on the resource loader, texture creation and upload run on the render thread.
+	* Use ProcessRenderThreadTasks once per frame or install a scheduler hook.
+	*
+	* @param[in] file		String to file
+	* @param[in] callback	Called on the render thread when the texture is ready (may be empty)
+	* @param[in] priority	Loader priority class
+	*
+	* @return Request handle. Use it to poll state, get the texture or cancel
+	*/
+	ResourceTextureRequestHandle LoadTextureAsync(const char* file, const ResourceTextureCallback& callback = ResourceTextureCallback()
+		, ResourceLoadPriority priority = ResourceLoadPriority::Visible);
+
+	/**
+	* @brief Install a scheduler hook which receives all render thread work of async requests
+	*
+	* @param[in] scheduler	Scheduler hook or empty function to use the internal queue
+	*/
+	void SetRenderThreadScheduler(const ResourceRenderThreadScheduler& scheduler);
+
+	/**
+	* @brief Execute queued render thread work of async requests. Call from the render thread.
+	*
+	* @param[in] maxTasks	Maximum tasks to execute (0 means all)
+	*
+	* @return Number of executed tasks
+	*/
+	uint32_t ProcessRenderThreadTasks(uint32_t maxTasks = 0);
+
 private:
 	ResourceManagerPrivate* _pResourceManagerPrivate;	///< Pointer to private resource manger
 };
@@ -18,6 +18,7 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SO
 #include "resourceManagerPrivate.h"
 #include "materialResource.h"
 #include "imageResource.h"
+#include "shaderCache.h"
 #include "engineInstancePrivate.h"
 #include "engineError.h"
 #include "Render/renderMaterial.h"
@@ -31,11 +32,18 @@ namespace cave
 
 // our default relative locations
 static const char* g_contentLocation = "/Content/";
+// default package next to the content folder
+static const char* g_packageLocation = "/Content.cavepak";
+// persistent shader index next to the content folder
+static const char* g_shaderIndexLocation = "/ShaderCache.index";
+// threads reading resource files
+static const uint32_t g_loaderIoThreads = 2;
 
 //-----------------------------------------------------------------------------
 // ResourceObjectFinder class
 //-----------------------------------------------------------------------------
 ResourceObjectFinder::ResourceObjectFinder(ResourceManagerPrivate& rm)
+    : _pPackage(rm.GetPackage())
 {
     std::string tmp = rm.GetProjectPath();
     if (!tmp.empty())
@@ -127,6 +135,83 @@ bool ResourceObjectFinder::OpenFileBinary(const char* file, std::ifstream& fileS
     return false;
 }
 
+bool ResourceObjectFinder::OpenFileMapped(const char* file, OsMappedFile& mappedFile, OsMappedFileAccess access, std::string* path)
+{
+    // first search in project dir if available
+    if (!_projectContentPath.empty())
+    {
+        for (size_t i = 0; i < _localSearchPath.size(); i++)
+        {
+            std::string projPath(_projectContentPath);
+            projPath.append(_localSearchPath[i]);
+            projPath.append(file);
+            if (mappedFile.Open(projPath.c_str(), access))
+            {
+                if (path)
+                    path->swap(projPath);
+                return true;
+            }
+        }
+    }
+
+    if (!_appContentPath.empty())
+    {
+        for (size_t i = 0; i < _localSearchPath.size(); i++)
+        {
+            std::string appPath(_appContentPath);
+            appPath.append(_localSearchPath[i]);
+            appPath.append(file);
+            if (mappedFile.Open(appPath.c_str(), access))
+            {
+                if (path)
+                    path->swap(appPath);
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+bool ResourceObjectFinder::OpenFile(const char* file, ResourceLoadData& data, OsMappedFileAccess access, std::string* path)
+{
+    // a package lookup is a hash and a binary search, no path strings and no file system calls
+    if (_pPackage)
+    {
+        for (size_t i = 0; i < _localSearchPath.size(); i++)
+        {
+            const ResourcePackageEntry* entry = _pPackage->Find(_localSearchPath[i].c_str(), file);
+            if (entry)
+            {
+                if (path)
+                    path->assign("pak:").append(_pPackage->GetPath(*entry));
+                return _pPackage->Read(*entry, data);
+            }
+        }
+    }
+
+    return OpenFileMapped(file, data.GetMappedFile(), access, path);
+}
+
+bool ResourceObjectFinder::FileExists(const char* file)
+{
+    if (_pPackage)
+    {
+        for (size_t i = 0; i < _localSearchPath.size(); i++)
+        {
+            if (_pPackage->Find(_localSearchPath[i].c_str(), file))
+                return true;
+        }
+    }
+
+    std::ifstream fileStream;
+    if (!OpenFileBinary(file, fileStream))
+        return false;
+
+    fileStream.close();
+    return true;
+}
+
 std::string ResourceObjectFinder::GetFileName(const char* file)
 {
     std::string input(file);
@@ -192,51 +277,91 @@ ResourceManagerPrivate::ResourceManagerPrivate(RenderDevice* device
     : _pRenderDevice(device)
     , _appPath(applicationPath)
     , _projectPath(projectPath)
+    , _materialMap(device->GetEngineAllocator())
+    , _shaderMap(device->GetEngineAllocator())
+    , _imageMap(device->GetEngineAllocator())
+    , _textureMap(device->GetEngineAllocator())
+    , _pResourceLoader(nullptr)
+    , _asyncJobCounter(nullptr)
+    , _imageHostCopy(false)
+    , _pPackage(nullptr)
+    , _pMountedPackage(nullptr)
+    , _pShaderCache(nullptr)
 {
-
+    _pPackage = AllocateObject<ResourcePackage>(*_pRenderDevice->GetEngineAllocator());
+    _pShaderCache = AllocateObject<ShaderCache>(*_pRenderDevice->GetEngineAllocator(), _pRenderDevice->GetEngineAllocator());
+
+    // the shader index lives with the project, shipped applications keep it next to the application
+    if (!_projectPath.empty())
+        _shaderIndexPath = _projectPath + g_shaderIndexLocation;
+    else if (!_appPath.empty())
+        _shaderIndexPath = _appPath + g_shaderIndexLocation;
+    if (!_shaderIndexPath.empty())
+        _pShaderCache->LoadIndex(_shaderIndexPath.c_str());
+
+    // shipping builds keep all content in one package. Project content wins
+    if (!_projectPath.empty())
+        MountPackage((_projectPath + g_packageLocation).c_str());
+    if (!GetPackage() && !_appPath.empty())
+        MountPackage((_appPath + g_packageLocation).c_str());
+
+    _pResourceLoader = AllocateObject<ResourceLoader>(*_pRenderDevice->GetEngineAllocator()
+        , _pRenderDevice->GetEngineAllocator(), _pRenderDevice->GetJobSystem(), g_loaderIoThreads, 0u);
+    _asyncJobCounter = AllocateObject<JobCounter>(*_pRenderDevice->GetEngineAllocator());
 }
 
 ResourceManagerPrivate::~ResourceManagerPrivate()
 {
-    // release shader
-    TResourceShaderMap::iterator shaderIter;
-    for (shaderIter = _shaderMap.begin(); shaderIter != _shaderMap.end(); ++shaderIter)
-    {
-        DeallocateDelete(*_pRenderDevice->GetEngineAllocator(), *shaderIter->second);
-    }
-    _shaderMap.clear();
+    // drop queued loads, wait for async continuations and drop render thread work not executed yet
+    _pResourceLoader->CancelAll();
+    _pRenderDevice->GetJobSystem()->Wait(*_asyncJobCounter);
+    DeallocateDelete(*_pRenderDevice->GetEngineAllocator(), *_asyncJobCounter);
+    _renderThreadTasks.clear();
+
+    // shaders are owned by the shader cache, the map only holds names
+    _shaderMap.Clear();
 
     // release materials
-    TResourceMaterialMap::iterator matIter;
-    for (matIter = _materialMap.begin(); matIter != _materialMap.end(); ++matIter)
+    _materialMap.ForEach([this](const std::string&, RenderMaterial* material)
     {
-        if (matIter->second)
-        {
-            DeallocateDelete(*_pRenderDevice->GetEngineAllocator(), *matIter->second);
-        }
-    }
-    _materialMap.clear();
+        if (material)
+            DeallocateDelete(*_pRenderDevice->GetEngineAllocator(), *material);
+    });
+    _materialMap.Clear();
 
-    // stop threads
-    TResourceLoadingThreadMap::iterator threadIter;
-    for (threadIter = _loadingThreadMap.begin(); threadIter != _loadingThreadMap.end(); ++threadIter)
-    {
-        if (threadIter->second.valid())
-            threadIter->second.wait();
-    }
-    _loadingThreadMap.clear();
+    // release shader
+    if (!_shaderIndexPath.empty())
+        _pShaderCache->SaveIndex(_shaderIndexPath.c_str());
+    DeallocateDelete(*_pRenderDevice->GetEngineAllocator(), *_pShaderCache);
+
+    // wait for reads and decodes in progress
+    DeallocateDelete(*_pRenderDevice->GetEngineAllocator(), *_pResourceLoader);
 
     // release image resources
-    TResourceImageMap::iterator imageIter;
-    for (imageIter = _imageMap.begin(); imageIter != _imageMap.end(); ++imageIter)
+    _imageMap.ForEach([this](const std::string&, ImageResource* image)
     {
-        if (imageIter->second)
-        {
-            DeallocateDelete(*_pRenderDevice->GetEngineAllocator(), *imageIter->second);
-        }
-    }
-    _imageMap.clear();
+        if (image)
+            DeallocateDelete(*_pRenderDevice->GetEngineAllocator(), *image);
+    });
+    _imageMap.Clear();
 
+    // images may reference package content
+    DeallocateDelete(*_pRenderDevice->GetEngineAllocator(), *_pPackage);
+}
+
+bool ResourceManagerPrivate::MountPackage(const char* path)
+{
+    if (!path)
+        return false;
+
+    // I/O threads only see the package through _pMountedPackage, which is set once it is fully open.
+    // It is never closed or replaced afterwards, so readers don't need the lock
+    std::lock_guard<std::mutex> lock(_packageMutex);
+    if (_pMountedPackage.load(std::memory_order_relaxed) || !_pPackage->Open(path))
+        return false;
+
+    _pMountedPackage.store(_pPackage, std::memory_order_release);
+    return true;
 }
 
 std::shared_ptr<AllocatorGlobal>
@@ -247,23 +372,16 @@ ResourceManagerPrivate::GetEngineAllocator()
 
 RenderShader* ResourceManagerPrivate::FindRenderShaderResource(const char* fileName)
 {
-    std::string stringKey(fileName);
-    TResourceShaderMap::const_iterator entry = _shaderMap.find(stringKey);
-    if (entry != _shaderMap.end())
-        return entry->second;
-
-    return nullptr;
+    return _shaderMap.Find(std::string(fileName));
 }
 
 bool ResourceManagerPrivate::InsertRenderShaderResource(const char* fileName, RenderShader* shader)
 {
-    if (FindRenderShaderResource(fileName) || !shader || !fileName)
+    if (!shader || !fileName)
         return false;
 
-    std::string stringKey(fileName);
-    _shaderMap.insert(TResourceShaderMap::value_type(stringKey, shader));
-
-    return true;
+    // fails if the shader already exists
+    return _shaderMap.Insert(std::string(fileName), shader);
 }
 
 RenderMaterial* ResourceManagerPrivate::LoadMaterialAsset(const char* file)
@@ -273,55 +391,105 @@ RenderMaterial* ResourceManagerPrivate::LoadMaterialAsset(const char* file)
 
     std::string stringKey(file);
     // check if material already exists
-    TResourceMaterialMap::const_iterator entry = _materialMap.find(stringKey);
-    if (entry != _materialMap.end())
-        return entry->second;
+    RenderMaterial* material = _materialMap.Find(stringKey);
+    if (material)
+        return material;
 
+    // another thread is loading it
+    if (!_materialMap.Reserve(stringKey))
+        return _materialMap.Wait(stringKey);
 
-    RenderMaterial* material = mr.LoadMaterialAsset(objectFinder, file);
-    _materialMap.insert(TResourceMaterialMap::value_type(stringKey, material));
+    try
+    {
+        material = mr.LoadMaterialAsset(objectFinder, file);
+    }
+    catch (std::exception&)
+    {
+        // release waiting threads
+        _materialMap.Publish(stringKey, nullptr, ResourceCacheState::Failed);
+        throw;
+    }
+    _materialMap.Publish(stringKey, material, material ? ResourceCacheState::Ready : ResourceCacheState::Failed);
 
     return material;
 }
 
-void ResourceManagerPrivate::LoadImageAsset(const char* file)
+void ResourceManagerPrivate::LoadImageAsset(const char* file, ResourceLoadPriority priority)
 {
     ResourceObjectFinder objectFinder(*this);
 
     std::string ext = objectFinder.GetFileExt(file);
-    if (!ImageResource::IsImageFormatSupported(objectFinder, ext.c_str()) ||
-        !ImageResource::ImageFileExists(objectFinder, file))
-    {
+    if (!ImageResource::IsImageFormatSupported(objectFinder, ext.c_str()))
         return;
-    }
 
     std::string stringKey(file);
-    // check if image already exists
-    TResourceImageMap::const_iterator entry = _imageMap.find(stringKey);
-    if (entry != _imageMap.end())
-        return;
+    // the image stays pending until it is decoded
+    ImageResource* image = nullptr;
+    if (_imageMap.Reserve(stringKey))
+    {
+        try
+        {
+            image = ImageResource::CreateImageResource(this, objectFinder, file);
+        }
+        catch (std::exception&)
+        {
+            // release waiting threads
+            _imageMap.Remove(stringKey);
+            throw;
+        }
+        if (!image)
+        {
+            _imageMap.Remove(stringKey);
+            return;
+        }
 
-    // create a new object and start async loading
-    ImageResource* image = ImageResource::CreateImageResource(this, objectFinder, file);
-    if (image)
+        _imageMap.Publish(stringKey, image, ResourceCacheState::Pending);
+    }
+    else
     {
-        _imageMap.insert(TResourceImageMap::value_type(stringKey, image));
-        _loadingThreadMap.insert(TResourceLoadingThreadMap::value_type(stringKey, std::async(&ResourceManagerPrivate::LoadImageFile, this, file, image)));
+        // raises the priority of a queued load or restarts a cancelled or failed one.
+        // Without an object yet the reserving thread starts loading, decoded images are done
+        if (_imageMap.Lookup(stringKey, &image) == ResourceCacheState::Ready || !image)
+            return;
     }
+
+    // the loader keeps its own copy of the file name. Missing files fail on the I/O thread
+    _pResourceLoader->Request(stringKey, priority, [this, stringKey](ResourceLoadData& data)
+    {
+        ResourceObjectFinder finder(*this);
+        return ImageResource::ReadImageFile(finder, stringKey.c_str(), data);
+    }, [this, image, stringKey](ResourceLoadData& data)
+    {
+        bool success = ImageResource::DecodeImageResource(image, data, _imageHostCopy.load(std::memory_order_relaxed));
+        _imageMap.SetState(stringKey, success ? ResourceCacheState::Ready : ResourceCacheState::Failed);
+        return success;
+    });
+}
+
+bool ResourceManagerPrivate::CancelImageAsset(const char* file)
+{
+    return _pResourceLoader->Cancel(std::string(file));
 }
 
 RenderTexture* ResourceManagerPrivate::GetTexture(const char* file)
 {
     std::string stringKey(file);
-    // check if image already exists
-    TResourceTextureMap::const_iterator entry = _textureMap.find(stringKey);
-    if (entry != _textureMap.end())
-        return entry->second;
+    // check if texture already exists
+    RenderTexture* texture = _textureMap.Find(stringKey);
+    if (texture)
+        return texture;
+
+    // another thread is creating it
+    if (!_textureMap.Reserve(stringKey))
+        return _textureMap.Wait(stringKey);
 
     // find matching imageResource object
     ImageResource* image = GetImageResource(file);
     if (image == nullptr)
+    {
+        _textureMap.Remove(stringKey);
         return nullptr;
+    }
 
     // Get image data
     ImageData imageData = image->getImageData();
@@ -337,70 +505,161 @@ RenderTexture* ResourceManagerPrivate::GetTexture(const char* file)
     imageInfo._componentSize = imageData.componentSize;
     imageInfo._usage = (static_cast<HalImageUsageFlags>(HalImageUsageFlagBits::TransferDst) | static_cast<HalImageUsageFlags>(HalImageUsageFlagBits::Sampled));
 
-    RenderTexture* texture = nullptr;
+    bool uploaded = false;
     try
     {
         texture = AllocateObject<RenderTexture>(*GetEngineAllocator(), *_pRenderDevice, imageInfo, file);
         if (texture)
         {
             texture->AddRef();
-            _textureMap.insert(TResourceTextureMap::value_type(stringKey, texture));
             // allocate memory
             texture->Bind();
-            // upload data
-            texture->Update(imageData.data);
+            // upload data. The image writes its levels straight into staging memory
+            uploaded = texture->UpdateStaging([image](void* pDst, uint64_t offset, uint64_t size)
+            {
+                return image->writeImageData(pDst, offset, size);
+            });
         }
     }
     catch (std::exception&)
     {
-        return texture;
+        uploaded = false;
     }
 
+    // other threads only see the texture once it is uploaded
+    if (!uploaded)
+    {
+        if (texture)
+            texture->Relase();
+        // release waiting threads
+        _textureMap.Remove(stringKey);
+        return nullptr;
+    }
+
+    _textureMap.Publish(stringKey, texture, ResourceCacheState::Ready);
+
     return texture;
 }
 
 void ResourceManagerPrivate::ReleaseTexture(RenderTexture* texture)
 {
     std::string stringKey(texture->GetFileName());
-    // check if image already exists
-    TResourceTextureMap::const_iterator entry = _textureMap.find(stringKey);
-    if (entry == _textureMap.end())
+    // check if texture exists
+    if (_textureMap.Find(stringKey) != texture)
         return;
 
     if (texture->GetRefCount() == 1)
     {
         // final release
-        _textureMap.erase(stringKey);
+        _textureMap.Remove(stringKey);
         texture->Relase();
     };
 }
 
-ImageResource* ResourceManagerPrivate::GetImageResource(const char* file)
+ResourceTextureRequestHandle ResourceManagerPrivate::LoadTextureAsync(const char* file, const ResourceTextureCallback& callback, ResourceLoadPriority priority)
 {
+    ResourceTextureRequestHandle request = std::make_shared<ResourceTextureRequest>(file, callback);
+
+    // make sure loading has been started
+    LoadImageAsset(file, priority);
+
+    // continuation runs once the loader finished and forwards the GPU part to the render thread
+    ResourceContinuationFunction continuation = [this, request](ResourceLoadState loadState)
+    {
+        if (request->IsCancelled() || loadState == ResourceLoadState::Cancelled)
+        {
+            request->SetState(ResourceRequestState::Cancelled);
+            return;
+        }
+
+        if (loadState != ResourceLoadState::Ready)
+        {
+            request->SetState(ResourceRequestState::Failed);
+            return;
+        }
+
+        request->SetState(ResourceRequestState::Uploading);
+        ScheduleRenderThreadTask([this, request]()
+        {
+            if (request->IsCancelled())
+            {
+                request->SetState(ResourceRequestState::Cancelled);
+                return;
+            }
+
+            request->Complete(GetTexture(request->GetFileName()));
+        });
+    };
+
     std::string stringKey(file);
+    if (!_pResourceLoader->AddContinuation(stringKey, continuation, _asyncJobCounter))
+    {
+        // nothing in flight. Either decoded earlier or an unsupported format
+        ImageResource* image = nullptr;
+        bool decoded = (_imageMap.Lookup(stringKey, &image) == ResourceCacheState::Ready);
+        continuation(decoded ? ResourceLoadState::Ready : ResourceLoadState::Failed);
+    }
 
-    // Make sure data is available
-    TResourceLoadingThreadMap::const_iterator threadEntry = _loadingThreadMap.find(stringKey);
-    if (threadEntry != _loadingThreadMap.end())
-        threadEntry->second.wait();
+    return request;
+}
 
-    // return image resource
-    TResourceImageMap::const_iterator imageEntry = _imageMap.find(stringKey);
-    if (imageEntry != _imageMap.end())
-        return imageEntry->second;
+void ResourceManagerPrivate::SetRenderThreadScheduler(const ResourceRenderThreadScheduler& scheduler)
+{
+    std::lock_guard<std::mutex> lock(_renderThreadMutex);
+    _renderThreadScheduler = scheduler;
+}
 
-    // not found
-    return nullptr;
+void ResourceManagerPrivate::ScheduleRenderThreadTask(const std::function<void()>& task)
+{
+    ResourceRenderThreadScheduler scheduler;
+    {
+        std::lock_guard<std::mutex> lock(_renderThreadMutex);
+        if (!_renderThreadScheduler)
+        {
+            _renderThreadTasks.push_back(task);
+            return;
+        }
+        scheduler = _renderThreadScheduler;
+    }
+
+    // call the hook outside of our lock
+    scheduler(task);
 }
 
-/**
-* Note this function is called in a thread
-*/
-void ResourceManagerPrivate::LoadImageFile(const char* file, ImageResource* image)
+uint32_t ResourceManagerPrivate::ProcessRenderThreadTasks(uint32_t maxTasks)
 {
-    ResourceObjectFinder objectFinder(*this);
-    ImageResource::LoadImageResource(objectFinder, image, file);
+    uint32_t executed = 0;
+    while (maxTasks == 0 || executed < maxTasks)
+    {
+        std::function<void()> task;
+        {
+            std::lock_guard<std::mutex> lock(_renderThreadMutex);
+            if (_renderThreadTasks.empty())
+                break;
+            task = _renderThreadTasks.front();
+            _renderThreadTasks.pop_front();
+        }
+
+        task();
+        executed++;
+    }
+
+    return executed;
 }
 
+ImageResource* ResourceManagerPrivate::GetImageResource(const char* file)
+{
+    std::string stringKey(file);
+
+    // Make sure data is available. Waiting raises the request to visible priority.
+    // Requests finished earlier are gone, the image state tells if they succeeded
+    _pResourceLoader->Wait(stringKey);
+
+    ImageResource* image = nullptr;
+    if (_imageMap.Lookup(stringKey, &image) != ResourceCacheState::Ready)
+        return nullptr;
+
+    return image;
+}
 
 }
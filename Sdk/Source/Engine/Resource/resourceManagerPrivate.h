@@ -18,12 +18,18 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SO
 
 #include "engineTypes.h"
 #include "Memory/allocatorGlobal.h"
+#include "resourceAsync.h"
+#include "resourceLoader.h"
+#include "resourceCache.h"
+#include "resourcePackage.h"
+#include "osMappedFile.h"
 
 #include <memory>
 #include <string>
 #include <vector>
-#include <map>
-#include <future>
+#include <deque>
+#include <mutex>
+#include <atomic>
 
 /** \addtogroup engine
 *  @{
@@ -43,6 +49,8 @@ class RenderTexture;
 class ResourceManagerPrivate;
 class MaterialResource;
 class ImageResource;
+class JobCounter;
+class ShaderCache;
 
 /**
 * A helper class to find resources
@@ -53,6 +61,7 @@ public:
 	std::string _projectContentPath;			///< Project path
 	std::string _appContentPath;				///< Application binary path
 	std::vector<std::string> _localSearchPath;	///< A string array for local search path
+	const ResourcePackage* _pPackage;			///< Mounted package searched before loose files (may be nullptr)
 
 	/**
 	* @brief Constructor
@@ -82,6 +91,40 @@ public:
 	*/
 	bool OpenFileBinary(const char* file, std::ifstream& fileStream);
 
+	/**
+	* @brief Map the file into memory
+	*
+	* @param[in] file			File name string
+	* @param[out] mappedFile	Receives the mapping
+	* @param[in] access		Expected access pattern
+	* @param[out] path			Receives the path of the mapped file (may be nullptr)
+	*
+	* @return true if successful
+	*/
+	bool OpenFileMapped(const char* file, OsMappedFile& mappedFile, OsMappedFileAccess access = OsMappedFileAccess::Sequential, std::string* path = nullptr);
+
+	/**
+	* @brief Get the file content. The mounted package is searched first without touching
+	* the file system, loose files are mapped if the package does not contain the file.
+	*
+	* @param[in] file		File name string
+	* @param[out] data		Receives the content
+	* @param[in] access		Expected access pattern of loose files
+	* @param[out] path		Receives the resolved path, package entries are prefixed with "pak:" (may be nullptr)
+	*
+	* @return true if successful
+	*/
+	bool OpenFile(const char* file, ResourceLoadData& data, OsMappedFileAccess access = OsMappedFileAccess::Sequential, std::string* path = nullptr);
+
+	/**
+	* @brief Check if a file exists in the mounted package or as loose file
+	*
+	* @param[in] file File name string
+	*
+	* @return true if found
+	*/
+	bool FileExists(const char* file);
+
 	/**
 	* @brief Extract filename from an input string
 	*
@@ -121,11 +164,10 @@ public:
 };
 
 
-typedef std::map<std::string, RenderMaterial*> TResourceMaterialMap;	///< Material objects map
-typedef std::map<std::string, RenderShader*> TResourceShaderMap;	///< Shader objects map
-typedef std::map<std::string, RenderTexture*> TResourceTextureMap;	///< Texture objects map
-typedef std::map<std::string, ImageResource*> TResourceImageMap;	///< Image objects map
-typedef std::map<std::string, std::future<void>> TResourceLoadingThreadMap;	///< laoding threads map
+typedef ResourceCache<RenderMaterial> TResourceMaterialMap;	///< Material objects map
+typedef ResourceCache<RenderShader> TResourceShaderMap;	///< Shader objects map
+typedef ResourceCache<RenderTexture> TResourceTextureMap;	///< Texture objects map
+typedef ResourceCache<ImageResource> TResourceImageMap;	///< Image objects map (pending until decoded)
 
 /**
 * Global Resource Manager
@@ -180,6 +222,30 @@ public:
 	*/
 	RenderDevice* GetRenderDevice() { return _pRenderDevice; }
 
+	/**
+	* @brief Mount a resource package. Thread safe, loads already in flight keep reading loose files.
+	*		 A mounted package stays open until the manager is destroyed.
+	*
+	* @param[in] path	Path to the package file
+	*
+	* @return false if the package is invalid or a package is already mounted
+	*/
+	bool MountPackage(const char* path);
+
+	/**
+	* @brief Get the mounted package
+	*
+	* @return ResourcePackage object or nullptr
+	*/
+	const ResourcePackage* GetPackage() const { return _pMountedPackage.load(std::memory_order_acquire); }
+
+	/**
+	* @brief Get the shader cache which owns all shaders
+	*
+	* @return ShaderCache object
+	*/
+	ShaderCache* GetShaderCache() { return _pShaderCache; }
+
 	/**
 	* @brief Find an already loaded shader resource
 	*
@@ -190,7 +256,8 @@ public:
 	RenderShader* FindRenderShaderResource(const char* fileName);
 
 	/**
-	* @brief Insert a new shader resource
+	* @brief Insert a new shader resource. Shaders are owned by the shader cache,
+	*		 several names may refer to the same shader.
 	*
 	* @param[in] fileName	Resource name (should include path)
 	* @param[in] shader		Pointer RenderShader object
@@ -209,13 +276,36 @@ public:
 	RenderMaterial* LoadMaterialAsset(const char* file);
 
 	/**
-	* @brief Load an image asset
+	* @brief Load an image asset. The image is read and decoded by the resource loader.
+	*
+	* @param[in] file		String to file
+	* @param[in] priority	Loader priority class
+	*/
+	void LoadImageAsset(const char* file, ResourceLoadPriority priority);
+
+	/**
+	* @brief Cancel loading an image asset if decoding did not start yet.
+	* A later LoadImageAsset call starts loading again.
 	*
 	* @param[in] file	String to file
 	*
-	* @return true if successful
+	* @return true if the image will not be decoded
 	*/
-	void LoadImageAsset(const char* file);
+	bool CancelImageAsset(const char* file);
+
+	/**
+	* @brief Get the resource loader
+	*
+	* @return ResourceLoader object
+	*/
+	ResourceLoader* GetResourceLoader() { return _pResourceLoader; }
+
+	/**
+	* @brief Keep a host copy of decoded images instead of referencing the file content
+	*
+	* @param[in] keep	true to decode into a host copy
+	*/
+	void SetImageHostCopy(bool keep) { _imageHostCopy.store(keep, std::memory_order_relaxed); }
 
 	/**
 	* @brief Get/create a texture object
@@ -236,16 +326,44 @@ public:
 	*/
 	void ReleaseTexture(RenderTexture* texture);
 
-private:
+	/**
+	* @brief Request a texture without blocking.
+	* The image is loaded and decoded by the resource loader. Texture creation and upload are
+	* handed to the render thread scheduler once the image data is available.
+	*
+	* @param[in] file		String to file
+	* @param[in] callback	Called on the render thread when the texture is ready (may be empty)
+	* @param[in] priority	Loader priority class
+	*
+	* @return Request handle
+	*/
+	ResourceTextureRequestHandle LoadTextureAsync(const char* file, const ResourceTextureCallback& callback, ResourceLoadPriority priority);
 
 	/**
-	* @brief Load an image async
+	* @brief Install a render thread scheduler hook.
+	* Without a hook render thread work is queued and executed by ProcessRenderThreadTasks.
 	*
-	* @param[in] file	String to file
-	* @param[in] image	Pointer to image resource
+	* @param[in] scheduler	Scheduler hook or empty function to restore the default queue
+	*/
+	void SetRenderThreadScheduler(const ResourceRenderThreadScheduler& scheduler);
+
+	/**
+	* @brief Execute queued render thread work. Must be called from the render thread.
 	*
+	* @param[in] maxTasks	Maximum tasks to execute (0 means all)
+	*
+	* @return Number of executed tasks
 	*/
-	void LoadImageFile(const char* file, ImageResource* image);
+	uint32_t ProcessRenderThreadTasks(uint32_t maxTasks);
+
+private:
+	/**
+	* @brief Hand a task to the render thread scheduler
+	*
+	* @param[in] task	Task to execute on the render thread
+	*/
+	void ScheduleRenderThreadTask(const std::function<void()>& task);
+
 
 	/**
 	* @brief Get an image resource
@@ -265,7 +383,17 @@ private:
 	TResourceShaderMap _shaderMap;	///< ShaderMaterial object map
 	TResourceImageMap _imageMap;	///< Image object map
 	TResourceTextureMap _textureMap; /// Texture objecty map
-	TResourceLoadingThreadMap _loadingThreadMap;	///< Loading threads
+	ResourceLoader* _pResourceLoader;	///< Reads and decodes images
+	JobCounter* _asyncJobCounter;	///< Counter of pending async request continuations
+	std::atomic<bool> _imageHostCopy;	///< Decode images into a host copy
+	ResourcePackage* _pPackage;	///< Resource package object
+	std::atomic<const ResourcePackage*> _pMountedPackage;	///< _pPackage once it is open, read by the loader threads
+	std::mutex _packageMutex;	///< Serializes mounting
+	ShaderCache* _pShaderCache;	///< Owns all shaders, deduplicated by content
+	std::string _shaderIndexPath;	///< Persistent shader index (empty if not persisted)
+	ResourceRenderThreadScheduler _renderThreadScheduler;	///< Optional render thread scheduler hook
+	std::mutex _renderThreadMutex;	///< Protects the render thread queue and hook
+	std::deque<std::function<void()>> _renderThreadTasks;	///< Default render thread queue
 };
 
 }
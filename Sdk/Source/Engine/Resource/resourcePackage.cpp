@@ -0,0 +1,385 @@
+/*
+Copyright (c) <2017> <Udo Lugauer>
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE
+*/
+
+/// @file resourcePackage.cpp
+///       Packed resource archive (.cavepak)
+
+#include "resourcePackage.h"
+#include "resourceLoader.h"
+
+#include "zlib.h"
+
+#include <algorithm>
+#include <fstream>
+#include <cstring>
+#include <cstdio>
+#include <limits>
+
+namespace cave
+{
+
+// FNV-1a 64 bit
+static const uint64_t g_hashOffsetBasis = 0xcbf29ce484222325ULL;
+static const uint64_t g_hashPrime = 0x100000001b3ULL;
+
+/**
+* @brief Normalize a path separator
+*/
+static inline char NormalizePathChar(char c)
+{
+	return (c == '\\') ? '/' : c;
+}
+
+/**
+* @brief Compare a stored path with a directory and a file name
+*
+* @return true if stored equals directory + file
+*/
+static bool PathEquals(const char* stored, const char* directory, const char* file)
+{
+	const char* parts[2] = { directory, file };
+	for (uint32_t i = 0; i < 2; i++)
+	{
+		for (const char* c = parts[i]; c && *c; c++, stored++)
+		{
+			if (*stored != NormalizePathChar(*c))
+				return false;
+		}
+	}
+
+	return *stored == '\0';
+}
+
+//-----------------------------------------------------------------------------
+// ResourcePackageHash class
+//-----------------------------------------------------------------------------
+ResourcePackageHash::ResourcePackageHash()
+	: _value(g_hashOffsetBasis)
+{
+}
+
+void ResourcePackageHash::Append(const char* str)
+{
+	for (const char* c = str; c && *c; c++)
+	{
+		_value ^= static_cast<uint8_t>(NormalizePathChar(*c));
+		_value *= g_hashPrime;
+	}
+}
+
+uint64_t ResourcePackageHash::Hash(const char* path)
+{
+	ResourcePackageHash hash;
+	hash.Append(path);
+	return hash.GetValue();
+}
+
+//-----------------------------------------------------------------------------
+// ResourcePackage class
+//-----------------------------------------------------------------------------
+ResourcePackage::ResourcePackage()
+	: _pHeader(nullptr)
+	, _pEntries(nullptr)
+	, _pStrings(nullptr)
+{
+}
+
+ResourcePackage::~ResourcePackage()
+{
+	Close();
+}
+
+bool ResourcePackage::Open(const char* path)
+{
+	Close();
+
+	// entries are accessed in any order
+	if (!_mappedFile.Open(path, OsMappedFileAccess::Random))
+		return false;
+
+	const uint8_t* data = _mappedFile.GetData();
+	uint64_t size = _mappedFile.GetSize();
+	if (size < sizeof(ResourcePackageHeader))
+	{
+		Close();
+		return false;
+	}
+
+	const ResourcePackageHeader* header = reinterpret_cast<const ResourcePackageHeader*>(data);
+	uint64_t tocSize = static_cast<uint64_t>(header->_entryCount) * sizeof(ResourcePackageEntry);
+
+	bool valid = header->_magic == ResourcePackageMagic
+		&& header->_version == ResourcePackageVersion
+		&& (header->_tocOffset % alignof(ResourcePackageEntry)) == 0
+		&& header->_tocOffset <= size && tocSize <= size - header->_tocOffset
+		&& header->_stringOffset <= size && header->_stringSize <= size - header->_stringOffset
+		&& header->_dataOffset <= size;
+
+	// paths must be zero terminated
+	if (valid && header->_entryCount > 0)
+		valid = header->_stringSize > 0 && data[header->_stringOffset + header->_stringSize - 1] == '\0';
+
+	if (!valid)
+	{
+		Close();
+		return false;
+	}
+
+	_pHeader = header;
+	_pEntries = reinterpret_cast<const ResourcePackageEntry*>(data + header->_tocOffset);
+	_pStrings = reinterpret_cast<const char*>(data + header->_stringOffset);
+
+	return true;
+}
+
+void ResourcePackage::Close()
+{
+	_mappedFile.Close();
+	_pHeader = nullptr;
+	_pEntries = nullptr;
+	_pStrings = nullptr;
+}
+
+const ResourcePackageEntry* ResourcePackage::Find(uint64_t hash, const char* path) const
+{
+	if (!_pHeader)
+		return nullptr;
+
+	const ResourcePackageEntry* end = _pEntries + _pHeader->_entryCount;
+	const ResourcePackageEntry* entry = std::lower_bound(_pEntries, end, hash,
+		[](const ResourcePackageEntry& e, uint64_t h) { return e._hash < h; });
+
+	for (; entry != end && entry->_hash == hash; entry++)
+	{
+		if (!path || PathEquals(GetPath(*entry), path, nullptr))
+			return entry;
+	}
+
+	return nullptr;
+}
+
+const ResourcePackageEntry* ResourcePackage::Find(const char* directory, const char* file) const
+{
+	if (!_pHeader)
+		return nullptr;
+
+	ResourcePackageHash hash;
+	hash.Append(directory);
+	hash.Append(file);
+
+	const ResourcePackageEntry* end = _pEntries + _pHeader->_entryCount;
+	const ResourcePackageEntry* entry = std::lower_bound(_pEntries, end, hash.GetValue(),
+		[](const ResourcePackageEntry& e, uint64_t h) { return e._hash < h; });
+
+	for (; entry != end && entry->_hash == hash.GetValue(); entry++)
+	{
+		if (PathEquals(GetPath(*entry), directory, file))
+			return entry;
+	}
+
+	return nullptr;
+}
+
+const char* ResourcePackage::GetPath(const ResourcePackageEntry& entry) const
+{
+	if (!_pHeader || entry._pathOffset >= _pHeader->_stringSize)
+		return "";
+
+	return _pStrings + entry._pathOffset;
+}
+
+bool ResourcePackage::Read(const ResourcePackageEntry& entry, ResourceLoadData& data) const
+{
+	if (!_pHeader)
+		return false;
+
+	uint64_t size = _mappedFile.GetSize();
+	if (entry._offset > size || entry._storedSize > size - entry._offset)
+		return false;
+
+	const uint8_t* stored = _mappedFile.GetData() + entry._offset;
+
+	if (entry._flags & static_cast<uint32_t>(ResourcePackageEntryFlags::Zlib))
+	{
+		std::vector<char>& buffer = data.GetBuffer();
+		buffer.resize(entry._size);
+
+		uLongf inflatedSize = static_cast<uLongf>(entry._size);
+		if (uncompress(reinterpret_cast<Bytef*>(buffer.data()), &inflatedSize, stored, static_cast<uLong>(entry._storedSize)) != Z_OK
+			|| inflatedSize != entry._size)
+		{
+			std::vector<char>().swap(buffer);
+			return false;
+		}
+	}
+	else
+	{
+		if (entry._storedSize != entry._size)
+			return false;
+
+		// the package stays mapped, hand out the content in place
+		data.SetView(stored, entry._size);
+	}
+
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// ResourcePackageWriter class
+//-----------------------------------------------------------------------------
+ResourcePackageWriter::ResourcePackageWriter()
+{
+}
+
+bool ResourcePackageWriter::Add(const char* path, const void* data, size_t size, bool compress)
+{
+	if (!path || size > (std::numeric_limits<uint32_t>::max)())
+		return false;
+
+	// paths are relative to the content root
+	std::string normalized(path);
+	std::replace(normalized.begin(), normalized.end(), '\\', '/');
+	while (normalized.compare(0, 2, "./") == 0)
+		normalized.erase(0, 2);
+	while (!normalized.empty() && normalized[0] == '/')
+		normalized.erase(0, 1);
+
+	if (normalized.empty())
+		return false;
+
+	PendingEntry entry;
+	entry._path = normalized;
+	entry._hash = ResourcePackageHash::Hash(normalized.c_str());
+	entry._size = static_cast<uint32_t>(size);
+	entry._flags = static_cast<uint32_t>(ResourcePackageEntryFlags::Stored);
+
+	// reject duplicates and (unlikely) hash collisions, lookups only see one of them
+	for (size_t i = 0; i < _entries.size(); i++)
+	{
+		if (_entries[i]._hash == entry._hash)
+			return false;
+	}
+
+	const uint8_t* bytes = static_cast<const uint8_t*>(data);
+	if (compress && size > 0)
+	{
+		uLongf compressedSize = compressBound(static_cast<uLong>(size));
+		entry._data.resize(compressedSize);
+		if (compress2(entry._data.data(), &compressedSize, bytes, static_cast<uLong>(size), Z_BEST_COMPRESSION) != Z_OK)
+			return false;
+
+		// keep it only if it pays off
+		if (compressedSize < size)
+		{
+			entry._data.resize(compressedSize);
+			entry._flags = static_cast<uint32_t>(ResourcePackageEntryFlags::Zlib);
+		}
+	}
+
+	if (entry._flags == static_cast<uint32_t>(ResourcePackageEntryFlags::Stored))
+		entry._data.assign(bytes, bytes + size);
+
+	_entries.push_back(std::move(entry));
+
+	return true;
+}
+
+bool ResourcePackageWriter::Write(const char* path)
+{
+	std::sort(_entries.begin(), _entries.end(),
+		[](const PendingEntry& a, const PendingEntry& b) { return a._hash < b._hash; });
+
+	ResourcePackageHeader header = {};
+	header._magic = ResourcePackageMagic;
+	header._version = ResourcePackageVersion;
+	header._entryCount = static_cast<uint32_t>(_entries.size());
+	header._tocOffset = sizeof(ResourcePackageHeader);
+
+	// path strings
+	std::vector<char> strings;
+	std::vector<ResourcePackageEntry> toc(_entries.size());
+	for (size_t i = 0; i < _entries.size(); i++)
+	{
+		toc[i]._pathOffset = static_cast<uint32_t>(strings.size());
+		strings.insert(strings.end(), _entries[i]._path.begin(), _entries[i]._path.end());
+		strings.push_back('\0');
+	}
+
+	header._stringOffset = header._tocOffset + toc.size() * sizeof(ResourcePackageEntry);
+	header._stringSize = strings.size();
+
+	// entry data
+	uint64_t offset = header._stringOffset + header._stringSize;
+	offset = (offset + ResourcePackageDataAlignment - 1) & ~(ResourcePackageDataAlignment - 1);
+	header._dataOffset = offset;
+
+	for (size_t i = 0; i < _entries.size(); i++)
+	{
+		toc[i]._hash = _entries[i]._hash;
+		toc[i]._offset = offset;
+		toc[i]._size = _entries[i]._size;
+		toc[i]._storedSize = static_cast<uint32_t>(_entries[i]._data.size());
+		toc[i]._flags = _entries[i]._flags;
+
+		offset += toc[i]._storedSize;
+		offset = (offset + ResourcePackageDataAlignment - 1) & ~(ResourcePackageDataAlignment - 1);
+	}
+
+	// write to a temporary file first so readers never see a partial package
+	std::string tmpPath(path);
+	tmpPath.append(".tmp");
+
+	{
+		std::ofstream out(tmpPath.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+		if (!out.is_open())
+			return false;
+
+		out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		if (!toc.empty())
+			out.write(reinterpret_cast<const char*>(toc.data()), toc.size() * sizeof(ResourcePackageEntry));
+		if (!strings.empty())
+			out.write(strings.data(), strings.size());
+
+		static const char padding[ResourcePackageDataAlignment] = {};
+		uint64_t written = header._stringOffset + header._stringSize;
+		for (size_t i = 0; i < _entries.size(); i++)
+		{
+			out.write(padding, static_cast<std::streamsize>(toc[i]._offset - written));
+			if (!_entries[i]._data.empty())
+				out.write(reinterpret_cast<const char*>(_entries[i]._data.data()), _entries[i]._data.size());
+			written = toc[i]._offset + toc[i]._storedSize;
+		}
+
+		if (!out.good())
+		{
+			out.close();
+			std::remove(tmpPath.c_str());
+			return false;
+		}
+	}
+
+#ifdef _WIN32
+	// rename does not replace existing files on windows
+	std::remove(path);
+#endif
+	if (std::rename(tmpPath.c_str(), path) != 0)
+	{
+		std::remove(tmpPath.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+}
@@ -0,0 +1,244 @@
+/*
+Copyright (c) <2017> <Udo Lugauer>
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE
+*/
+#pragma once
+
+/// @file resourcePackage.h
+///       Packed resource archive (.cavepak)
+
+#include "engineDefines.h"
+#include "Memory/allocatorBase.h"
+#include "osMappedFile.h"
+
+#include <string>
+#include <vector>
+#include <memory>
+
+/** \addtogroup engine
+*  @{
+*		This module contains all code related to resource handling
+*/
+
+namespace cave
+{
+
+/// forward declaration
+class ResourceLoadData;
+
+/// Package file identifier "CPAK"
+static const uint32_t ResourcePackageMagic = 0x4b415043;
+/// Package format version
+static const uint32_t ResourcePackageVersion = 1;
+/// Alignment of the entry data inside the package
+static const uint64_t ResourcePackageDataAlignment = 64;
+
+/**
+* @brief Entry flags
+*/
+enum class ResourcePackageEntryFlags : uint32_t
+{
+	Stored = 0,		///< Stored as is
+	Zlib = 1		///< Stored zlib compressed
+};
+
+/**
+* @brief Package file header. All values are little endian.
+*		 Layout: header, table of contents sorted by hash, path strings, entry data.
+*/
+struct ResourcePackageHeader
+{
+	uint32_t _magic;		///< ResourcePackageMagic
+	uint32_t _version;		///< ResourcePackageVersion
+	uint32_t _entryCount;	///< Number of entries in the table of contents
+	uint32_t _reserved;		///< Must be 0
+	uint64_t _tocOffset;	///< Offset of the table of contents
+	uint64_t _stringOffset;	///< Offset of the path strings
+	uint64_t _stringSize;	///< Size of the path strings in bytes
+	uint64_t _dataOffset;	///< Offset of the first entry data
+};
+
+/**
+* @brief Table of contents entry. The table is sorted by hash and used straight from the mapping.
+*/
+struct ResourcePackageEntry
+{
+	uint64_t _hash;			///< Hash of the normalized path
+	uint64_t _offset;		///< Offset of the stored data
+	uint32_t _size;			///< Size of the content in bytes
+	uint32_t _storedSize;	///< Size of the stored (maybe compressed) data in bytes
+	uint32_t _pathOffset;	///< Offset of the zero terminated path in the string block
+	uint32_t _flags;		///< ResourcePackageEntryFlags
+};
+
+/**
+* @brief Incremental hash of package paths. Path separators are normalized to '/'.
+*		 Feeding a search path and a file name yields the hash of the joined path without building a string.
+*/
+class CAVE_INTERFACE ResourcePackageHash
+{
+public:
+	/** @brief Constructor */
+	ResourcePackageHash();
+
+	/**
+	* @brief Add characters to the hash
+	*
+	* @param[in] str	Zero terminated string
+	*/
+	void Append(const char* str);
+
+	/** @brief Get the hash value */
+	uint64_t GetValue() const { return _value; }
+
+	/**
+	* @brief Hash a complete path
+	*
+	* @param[in] path	Zero terminated path
+	*
+	* @return hash value
+	*/
+	static uint64_t Hash(const char* path);
+
+private:
+	uint64_t _value;	///< Current hash value
+};
+
+/**
+* @brief Read only package. The file is mapped once, the table of contents is searched in place.
+*		 Stored entries are handed out as views into the mapping, compressed entries are inflated.
+*/
+class CAVE_INTERFACE ResourcePackage
+{
+public:
+	/** @brief Constructor */
+	ResourcePackage();
+
+	/** @brief Destructor */
+	~ResourcePackage();
+
+	/**
+	* @brief Map and validate a package file
+	*
+	* @param[in] path	Path to the package
+	*
+	* @return true on success
+	*/
+	bool Open(const char* path);
+
+	/** @brief Unmap the package */
+	void Close();
+
+	/** @brief Check if a package is mapped */
+	bool IsOpen() const { return _pHeader != nullptr; }
+
+	/** @brief Get number of entries */
+	uint32_t GetEntryCount() const { return _pHeader ? _pHeader->_entryCount : 0; }
+
+	/**
+	* @brief Find an entry
+	*
+	* @param[in] hash	Hash of the normalized path (see ResourcePackageHash)
+	* @param[in] path	Path used to reject hash collisions (may be nullptr)
+	*
+	* @return entry or nullptr
+	*/
+	const ResourcePackageEntry* Find(uint64_t hash, const char* path = nullptr) const;
+
+	/**
+	* @brief Find an entry stored under a search path
+	*
+	* @param[in] directory	Search path relative to the content root (e.g. "Images/")
+	* @param[in] file		File name
+	*
+	* @return entry or nullptr
+	*/
+	const ResourcePackageEntry* Find(const char* directory, const char* file) const;
+
+	/**
+	* @brief Get the content of an entry
+	*
+	* @param[in] entry	Entry returned by Find
+	* @param[out] data	Receives a view into the mapping or the inflated content
+	*
+	* @return false if the entry is damaged
+	*/
+	bool Read(const ResourcePackageEntry& entry, ResourceLoadData& data) const;
+
+	/**
+	* @brief Get the path of an entry
+	*
+	* @param[in] entry	Entry returned by Find
+	*
+	* @return zero terminated path
+	*/
+	const char* GetPath(const ResourcePackageEntry& entry) const;
+
+private:
+	ResourcePackage(const ResourcePackage&) = delete;
+	ResourcePackage& operator=(const ResourcePackage&) = delete;
+
+	OsMappedFile _mappedFile;				///< Package mapping
+	const ResourcePackageHeader* _pHeader;	///< Header inside the mapping
+	const ResourcePackageEntry* _pEntries;	///< Table of contents inside the mapping
+	const char* _pStrings;					///< Path strings inside the mapping
+};
+
+/**
+* @brief Creates package files
+*/
+class CAVE_INTERFACE ResourcePackageWriter
+{
+public:
+	/** @brief Constructor */
+	ResourcePackageWriter();
+
+	/**
+	* @brief Add an entry
+	*
+	* @param[in] path		Path relative to the content root (e.g. "Images/x.dds")
+	* @param[in] data		Content
+	* @param[in] size		Content size in bytes
+	* @param[in] compress	Store zlib compressed if that makes the entry smaller
+	*
+	* @return false if the path already exists or compression failed
+	*/
+	bool Add(const char* path, const void* data, size_t size, bool compress);
+
+	/**
+	* @brief Write the package
+	*
+	* @param[in] path	Output file
+	*
+	* @return true on success
+	*/
+	bool Write(const char* path);
+
+private:
+	/**
+	* @brief Entry waiting to be written
+	*/
+	struct PendingEntry
+	{
+		std::string _path;			///< Normalized path
+		uint64_t _hash;				///< Path hash
+		uint32_t _size;				///< Content size
+		uint32_t _flags;			///< ResourcePackageEntryFlags
+		std::vector<uint8_t> _data;	///< Stored data
+	};
+
+	std::vector<PendingEntry> _entries;	///< Entries to write
+};
+
+}
+
+/** @}*/
@@ -0,0 +1,231 @@
+/*
+Copyright (c) <2017> <Udo Lugauer>
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE
+*/
+
+/// @file shaderCache.cpp
+///       Content addressed shader cache
+
+#include "shaderCache.h"
+#include "Render/renderShader.h"
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+namespace cave
+{
+
+// first line of an index file. Version 2 keys the entries by resolved path
+static const char* g_indexHeader = "cave-shader-index 2";
+
+ShaderCache::ShaderCache(std::shared_ptr<AllocatorGlobal> allocator)
+	: _pAllocator(allocator)
+	, _shaders(allocator)
+	, _indexDirty(false)
+	, _shaderCount(0)
+	, _sharedCount(0)
+	, _indexHitCount(0)
+	, _indexMissCount(0)
+{
+}
+
+ShaderCache::~ShaderCache()
+{
+	_shaders.ForEach([this](const std::string&, RenderShader* shader)
+	{
+		if (shader)
+			DeallocateDelete(*_pAllocator, *shader);
+	});
+	_shaders.Clear();
+}
+
+bool ShaderCache::LoadIndex(const char* path)
+{
+	std::lock_guard<std::mutex> lock(_indexMutex);
+	_index.clear();
+	_indexDirty = false;
+
+	std::ifstream in(path);
+	if (!in.is_open())
+		return false;
+
+	std::string line;
+	if (!std::getline(in, line) || line != g_indexHeader)
+		return false;
+
+	// <content hash> <size> <modification time> <name>. The name is last, it may contain spaces
+	while (std::getline(in, line))
+	{
+		std::istringstream fields(line);
+		IndexEntry entry;
+		std::string name;
+		fields >> std::hex >> entry._contentHash >> std::dec >> entry._size >> entry._modificationTime;
+		fields.get();
+		std::getline(fields, name);
+		if (fields.fail() || name.empty())
+		{
+			_index.clear();
+			return false;
+		}
+
+		_index[name] = entry;
+	}
+
+	return true;
+}
+
+bool ShaderCache::SaveIndex(const char* path)
+{
+	std::lock_guard<std::mutex> lock(_indexMutex);
+	if (!_indexDirty)
+		return true;
+
+	// write to a temporary file first so a crash never leaves a partial index
+	std::string tmpPath(path);
+	tmpPath.append(".tmp");
+
+	{
+		std::ofstream out(tmpPath.c_str(), std::ios::out | std::ios::trunc);
+		if (!out.is_open())
+			return false;
+
+		out << g_indexHeader << "\n";
+		for (std::map<std::string, IndexEntry>::const_iterator it = _index.begin(); it != _index.end(); ++it)
+		{
+			out << std::hex << it->second._contentHash << std::dec << " " << it->second._size << " "
+				<< it->second._modificationTime << " " << it->first << "\n";
+		}
+
+		if (!out.good())
+		{
+			out.close();
+			std::remove(tmpPath.c_str());
+			return false;
+		}
+	}
+
+#ifdef _WIN32
+	// rename does not replace existing files on windows
+	std::remove(path);
+#endif
+	if (std::rename(tmpPath.c_str(), path) != 0)
+	{
+		std::remove(tmpPath.c_str());
+		return false;
+	}
+
+	_indexDirty = false;
+
+	return true;
+}
+
+bool ShaderCache::LookupIndex(const std::string& name, uint64_t size, uint64_t modificationTime, uint64_t& contentHash)
+{
+	if (modificationTime == 0)
+		return false;
+
+	std::lock_guard<std::mutex> lock(_indexMutex);
+	std::map<std::string, IndexEntry>::const_iterator it = _index.find(name);
+	if (it == _index.end() || it->second._size != size || it->second._modificationTime != modificationTime)
+	{
+		_indexMissCount++;
+		return false;
+	}
+
+	contentHash = it->second._contentHash;
+	_indexHitCount++;
+
+	return true;
+}
+
+void ShaderCache::UpdateIndex(const std::string& name, uint64_t size, uint64_t modificationTime, uint64_t contentHash)
+{
+	if (modificationTime == 0)
+		return;
+
+	std::lock_guard<std::mutex> lock(_indexMutex);
+	IndexEntry& entry = _index[name];
+	if (entry._contentHash == contentHash && entry._size == size && entry._modificationTime == modificationTime)
+		return;
+
+	entry._contentHash = contentHash;
+	entry._size = size;
+	entry._modificationTime = modificationTime;
+	_indexDirty = true;
+}
+
+RenderShader* ShaderCache::Find(uint64_t contentHash, const char* type, const char* language, const char* entry, uint64_t constantHash)
+{
+	RenderShader* shader = _shaders.Find(GetKey(contentHash, type, language, entry, constantHash));
+	if (shader)
+		_sharedCount++;
+
+	return shader;
+}
+
+RenderShader* ShaderCache::Insert(uint64_t contentHash, const char* type, const char* language, const char* entry, uint64_t constantHash, RenderShader* shader)
+{
+	std::string key = GetKey(contentHash, type, language, entry, constantHash);
+	if (_shaders.Insert(key, shader))
+	{
+		_shaderCount++;
+		return shader;
+	}
+
+	// lost the race against another loader
+	DeallocateDelete(*_pAllocator, *shader);
+	_sharedCount++;
+
+	return _shaders.Find(key);
+}
+
+ShaderCacheStats ShaderCache::GetStats() const
+{
+	ShaderCacheStats stats;
+	stats._shaderCount = _shaderCount.load(std::memory_order_relaxed);
+	stats._sharedCount = _sharedCount.load(std::memory_order_relaxed);
+	stats._indexHitCount = _indexHitCount.load(std::memory_order_relaxed);
+	stats._indexMissCount = _indexMissCount.load(std::memory_order_relaxed);
+
+	return stats;
+}
+
+uint64_t ShaderCache::HashContent(const uint8_t* data, size_t size)
+{
+	uint64_t hash = 14695981039346656037ULL;
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= data[i];
+		hash *= 1099511628211ULL;
+	}
+
+	return hash;
+}
+
+std::string ShaderCache::GetKey(uint64_t contentHash, const char* type, const char* language, const char* entry, uint64_t constantHash) const
+{
+	char hash[17];
+	std::snprintf(hash, sizeof(hash), "%016llx", static_cast<unsigned long long>(contentHash));
+
+	std::string key(hash);
+	key.append(":").append(type).append(":").append(language).append(":").append(entry);
+	if (constantHash)
+	{
+		std::snprintf(hash, sizeof(hash), "%016llx", static_cast<unsigned long long>(constantHash));
+		key.append(":").append(hash);
+	}
+
+	return key;
+}
+
+}
@@ -0,0 +1,180 @@
+/*
+Copyright (c) <2017> <Udo Lugauer>
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE
+*/
+#pragma once
+
+/// @file shaderCache.h
+///       Content addressed shader cache
+
+#include "engineDefines.h"
+#include "Memory/allocatorGlobal.h"
+#include "resourceCache.h"
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <map>
+#include <memory>
+
+/** \addtogroup engine
+*  @{
+*		This module contains all code related to resource handling
+*/
+
+namespace cave
+{
+
+/// forward declaration
+class RenderShader;
+
+/**
+* @brief Shader cache statistics
+*/
+struct ShaderCacheStats
+{
+	uint32_t _shaderCount;		///< Unique shaders
+	uint32_t _sharedCount;		///< Requests served by a shader loaded under another name
+	uint32_t _indexHitCount;	///< Content hashes taken from the index instead of reading the file
+	uint32_t _indexMissCount;	///< Files hashed because the index had no valid entry
+};
+
+/**
+* @brief Owns all render shaders and keys them by bytecode hash, stage, language and entry function.
+*		 Different file names with identical bytecode share one shader and one shader module.
+*		 A persistent index remembers the content hash of every file name together with its size and
+*		 modification time, so a warm start resolves names to already loaded shaders without reading the file.
+*/
+class CAVE_INTERFACE ShaderCache
+{
+public:
+	/**
+	* @brief Constructor
+	*
+	* @param[in] allocator	Engine allocator
+	*/
+	ShaderCache(std::shared_ptr<AllocatorGlobal> allocator);
+
+	/** @brief Destructor. Deletes all shaders */
+	~ShaderCache();
+
+	/**
+	* @brief Load the persistent index. A missing or damaged file leaves the index empty.
+	*
+	* @param[in] path	Index file
+	*
+	* @return true if the index was loaded
+	*/
+	bool LoadIndex(const char* path);
+
+	/**
+	* @brief Save the persistent index if it changed since it was loaded
+	*
+	* @param[in] path	Index file
+	*
+	* @return false if writing failed
+	*/
+	bool SaveIndex(const char* path);
+
+	/**
+	* @brief Get the content hash of a file from the index
+	*
+	* @param[in] name				Resolved file path
+	* @param[in] size				Current file size
+	* @param[in] modificationTime	Current modification time (0 if unknown, the index is not used then)
+	* @param[out] contentHash		Receives the content hash
+	*
+	* @return true if the index has a valid entry
+	*/
+	bool LookupIndex(const std::string& name, uint64_t size, uint64_t modificationTime, uint64_t& contentHash);
+
+	/**
+	* @brief Record the content hash of a file
+	*
+	* @param[in] name				Resolved file path
+	* @param[in] size				File size
+	* @param[in] modificationTime	Modification time (0 if unknown, nothing is recorded then)
+	* @param[in] contentHash		Content hash
+	*/
+	void UpdateIndex(const std::string& name, uint64_t size, uint64_t modificationTime, uint64_t contentHash);
+
+	/**
+	* @brief Find a shader by content
+	*
+	* @param[in] contentHash	Bytecode hash
+	* @param[in] type			Shader type (vertex, fragment)
+	* @param[in] language		Shader language
+	* @param[in] entry			Entry function
+	* @param[in] constantHash	Specialization constants hash (0 if there are none)
+	*
+	* @return shader or nullptr
+	*/
+	RenderShader* Find(uint64_t contentHash, const char* type, const char* language, const char* entry, uint64_t constantHash);
+
+	/**
+	* @brief Take over a new shader. If another thread inserted the same content first
+	*		 the new shader is deleted and the existing one returned.
+	*
+	* @param[in] contentHash	Bytecode hash
+	* @param[in] type			Shader type (vertex, fragment)
+	* @param[in] language		Shader language
+	* @param[in] entry			Entry function
+	* @param[in] constantHash	Specialization constants hash (0 if there are none)
+	* @param[in] shader			New shader
+	*
+	* @return shader to use
+	*/
+	RenderShader* Insert(uint64_t contentHash, const char* type, const char* language, const char* entry, uint64_t constantHash, RenderShader* shader);
+
+	/** @brief Get statistics */
+	ShaderCacheStats GetStats() const;
+
+	/**
+	* @brief Hash shader bytecode (64 bit FNV-1a)
+	*
+	* @param[in] data	Bytecode
+	* @param[in] size	Size in bytes
+	*
+	* @return hash value
+	*/
+	static uint64_t HashContent(const uint8_t* data, size_t size);
+
+private:
+	/**
+	* @brief Index entry
+	*/
+	struct IndexEntry
+	{
+		uint64_t _contentHash;		///< Content hash
+		uint64_t _size;				///< File size
+		uint64_t _modificationTime;	///< File modification time
+	};
+
+	std::string GetKey(uint64_t contentHash, const char* type, const char* language, const char* entry, uint64_t constantHash) const;
+
+	ShaderCache(const ShaderCache&) = delete;
+	ShaderCache& operator=(const ShaderCache&) = delete;
+
+	std::shared_ptr<AllocatorGlobal> _pAllocator;	///< Engine allocator
+	ResourceCache<RenderShader> _shaders;			///< Shaders by content key
+	std::mutex _indexMutex;							///< Protects the index
+	std::map<std::string, IndexEntry> _index;		///< Content hashes by resolved file path
+	bool _indexDirty;								///< Index changed since loaded
+	std::atomic<uint32_t> _shaderCount;				///< Statistics
+	std::atomic<uint32_t> _sharedCount;				///< Statistics
+	std::atomic<uint32_t> _indexHitCount;			///< Statistics
+	std::atomic<uint32_t> _indexMissCount;			///< Statistics
+};
+
+}
+
+/** @}*/
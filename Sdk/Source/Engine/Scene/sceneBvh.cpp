@@ -0,0 +1,993 @@
+/*
+Copyright (c) <2017> <Udo Lugauer>
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE
+*/
+
+/// @file sceneBvh.cpp
+///       Dynamic bounding volume hierarchy used for scene queries
+
+#include "sceneBvh.h"
+
+#include <cassert>
+#include <cstring>
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#define CAVE_BVH_SSE 1
+#include <emmintrin.h>
+#endif
+
+namespace cave
+{
+
+/// Number of bins used by the SAH build
+static const int32_t SceneBvhBinCount = 16;
+/// Depth after which the SAH build falls back to median splits
+static const int32_t SceneBvhMaxSahDepth = 48;
+/// Initial query stack size
+static const size_t SceneBvhStackSize = 256;
+
+//-----------------------------------------------------------------------------
+// Bounding primitives
+//-----------------------------------------------------------------------------
+
+float SceneAabb::SurfaceArea() const
+{
+	float dx = _max._x - _min._x;
+	float dy = _max._y - _min._y;
+	float dz = _max._z - _min._z;
+
+	return 2.0f * (dx * dy + dy * dz + dz * dx);
+}
+
+bool SceneAabb::Contains(const SceneAabb& other) const
+{
+	return _min._x <= other._min._x && _min._y <= other._min._y && _min._z <= other._min._z &&
+		   other._max._x <= _max._x && other._max._y <= _max._y && other._max._z <= _max._z;
+}
+
+bool SceneAabb::Overlaps(const SceneAabb& other) const
+{
+	return !(other._min._x > _max._x || other._min._y > _max._y || other._min._z > _max._z ||
+			 other._max._x < _min._x || other._max._y < _min._y || other._max._z < _min._z);
+}
+
+SceneAabb SceneAabb::Combine(const SceneAabb& a, const SceneAabb& b)
+{
+	SceneAabb result;
+	result._min = Vector3f((std::min)(a._min._x, b._min._x), (std::min)(a._min._y, b._min._y), (std::min)(a._min._z, b._min._z));
+	result._max = Vector3f((std::max)(a._max._x, b._max._x), (std::max)(a._max._y, b._max._y), (std::max)(a._max._z, b._max._z));
+
+	return result;
+}
+
+void SceneFrustum::SetFromMatrix(const Matrix4f& m)
+{
+	// rows of the matrix. Engine matrices are stored as _m[column][row]
+	float row[4][4];
+	for (uint32_t r = 0; r < 4; ++r)
+	{
+		for (uint32_t c = 0; c < 4; ++c)
+			row[r][c] = m._m[c][r];
+	}
+
+	float planes[6][4];
+	for (uint32_t c = 0; c < 4; ++c)
+	{
+		planes[0][c] = row[3][c] + row[0][c];	// left
+		planes[1][c] = row[3][c] - row[0][c];	// right
+		planes[2][c] = row[3][c] + row[1][c];	// bottom
+		planes[3][c] = row[3][c] - row[1][c];	// top
+		planes[4][c] = row[2][c];				// near (depth range 0..1)
+		planes[5][c] = row[3][c] - row[2][c];	// far
+	}
+
+	for (uint32_t i = 0; i < 6; ++i)
+	{
+		Vector3f n(planes[i][0], planes[i][1], planes[i][2]);
+		float length = Magnitude(n);
+		float invLength = (length > 0.0f) ? 1.0f / length : 0.0f;
+		_normal[i] = n * invLength;
+		_distance[i] = planes[i][3] * invLength;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Node tests
+//-----------------------------------------------------------------------------
+
+#ifdef CAVE_BVH_SSE
+
+static inline float HorizontalMax(__m128 v)
+{
+	__m128 m = _mm_max_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+	m = _mm_max_ps(m, _mm_shuffle_ps(m, m, _MM_SHUFFLE(1, 0, 3, 2)));
+	return _mm_cvtss_f32(m);
+}
+
+static inline float HorizontalMin(__m128 v)
+{
+	__m128 m = _mm_min_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+	m = _mm_min_ps(m, _mm_shuffle_ps(m, m, _MM_SHUFFLE(1, 0, 3, 2)));
+	return _mm_cvtss_f32(m);
+}
+
+#endif
+
+//-----------------------------------------------------------------------------
+// SceneBvh
+//-----------------------------------------------------------------------------
+
+SceneBvh::SceneBvh(std::shared_ptr<AllocatorBase> allocator, float fatMargin)
+	: _pAllocator(allocator)
+	, _nodes(nullptr)
+	, _nodeCapacity(16)
+	, _nodeCount(0)
+	, _freeList(0)
+	, _root(SceneBvhNullNode)
+	, _proxyCount(0)
+	, _fatMargin(fatMargin)
+{
+	_nodes = AllocateArray<SceneBvhNode>(*_pAllocator, _nodeCapacity);
+	memset(_nodes, 0, sizeof(SceneBvhNode) * _nodeCapacity);
+
+	// build free list
+	for (int32_t i = 0; i < _nodeCapacity; ++i)
+	{
+		_nodes[i]._parent = (i < _nodeCapacity - 1) ? i + 1 : SceneBvhNullNode;
+		_nodes[i]._height = -1;
+	}
+}
+
+SceneBvh::~SceneBvh()
+{
+	if (_nodes)
+		DeallocateArray<SceneBvhNode>(*_pAllocator, _nodes);
+}
+
+int32_t SceneBvh::AllocateNode()
+{
+	if (_freeList == SceneBvhNullNode)
+	{
+		assert(_nodeCount == _nodeCapacity);
+
+		// grow the node pool. Node indices stay valid
+		int32_t newCapacity = _nodeCapacity * 2;
+		SceneBvhNode* newNodes = AllocateArray<SceneBvhNode>(*_pAllocator, newCapacity);
+		memcpy(newNodes, _nodes, sizeof(SceneBvhNode) * _nodeCapacity);
+		memset(newNodes + _nodeCapacity, 0, sizeof(SceneBvhNode) * (newCapacity - _nodeCapacity));
+		DeallocateArray<SceneBvhNode>(*_pAllocator, _nodes);
+		_nodes = newNodes;
+
+		for (int32_t i = _nodeCapacity; i < newCapacity; ++i)
+		{
+			_nodes[i]._parent = (i < newCapacity - 1) ? i + 1 : SceneBvhNullNode;
+			_nodes[i]._height = -1;
+		}
+
+		_freeList = _nodeCapacity;
+		_nodeCapacity = newCapacity;
+	}
+
+	int32_t nodeId = _freeList;
+	SceneBvhNode& node = _nodes[nodeId];
+	_freeList = node._parent;
+	node._parent = SceneBvhNullNode;
+	node._child1 = SceneBvhNullNode;
+	node._child2 = SceneBvhNullNode;
+	node._height = 0;
+	node._userData = nullptr;
+	++_nodeCount;
+
+	return nodeId;
+}
+
+void SceneBvh::FreeNode(int32_t nodeId)
+{
+	assert(0 <= nodeId && nodeId < _nodeCapacity);
+	assert(0 < _nodeCount);
+
+	_nodes[nodeId]._parent = _freeList;
+	_nodes[nodeId]._height = -1;
+	_freeList = nodeId;
+	--_nodeCount;
+}
+
+void SceneBvh::SetNodeBounds(int32_t nodeId, const SceneAabb& bounds)
+{
+	SceneBvhNode& node = _nodes[nodeId];
+	node._min[0] = bounds._min._x; node._min[1] = bounds._min._y; node._min[2] = bounds._min._z; node._min[3] = 0.0f;
+	node._max[0] = bounds._max._x; node._max[1] = bounds._max._y; node._max[2] = bounds._max._z; node._max[3] = 0.0f;
+}
+
+SceneAabb SceneBvh::GetNodeBounds(int32_t nodeId) const
+{
+	const SceneBvhNode& node = _nodes[nodeId];
+	return SceneAabb(Vector3f(node._min[0], node._min[1], node._min[2]),
+					 Vector3f(node._max[0], node._max[1], node._max[2]));
+}
+
+int32_t SceneBvh::CreateProxy(const SceneAabb& bounds, void* userData)
+{
+	int32_t proxyId = AllocateNode();
+
+	Vector3f margin(_fatMargin);
+	SetNodeBounds(proxyId, SceneAabb(bounds._min - margin, bounds._max + margin));
+	_nodes[proxyId]._userData = userData;
+	_nodes[proxyId]._height = 0;
+
+	InsertLeaf(proxyId);
+	++_proxyCount;
+
+	return proxyId;
+}
+
+void SceneBvh::DestroyProxy(int32_t proxyId)
+{
+	assert(0 <= proxyId && proxyId < _nodeCapacity);
+	assert(_nodes[proxyId].IsLeaf());
+
+	RemoveLeaf(proxyId);
+	FreeNode(proxyId);
+	--_proxyCount;
+}
+
+bool SceneBvh::MoveProxy(int32_t proxyId, const SceneAabb& bounds)
+{
+	assert(0 <= proxyId && proxyId < _nodeCapacity);
+	assert(_nodes[proxyId].IsLeaf());
+
+	// still inside the fat bounds. Nothing to do
+	if (GetNodeBounds(proxyId).Contains(bounds))
+		return false;
+
+	RemoveLeaf(proxyId);
+
+	Vector3f margin(_fatMargin);
+	SetNodeBounds(proxyId, SceneAabb(bounds._min - margin, bounds._max + margin));
+
+	InsertLeaf(proxyId);
+
+	return true;
+}
+
+void SceneBvh::UpdateProxyBounds(int32_t proxyId, const SceneAabb& bounds)
+{
+	assert(0 <= proxyId && proxyId < _nodeCapacity);
+	assert(_nodes[proxyId].IsLeaf());
+
+	Vector3f margin(_fatMargin);
+	SetNodeBounds(proxyId, SceneAabb(bounds._min - margin, bounds._max + margin));
+}
+
+void* SceneBvh::GetUserData(int32_t proxyId) const
+{
+	assert(0 <= proxyId && proxyId < _nodeCapacity);
+	return _nodes[proxyId]._userData;
+}
+
+SceneAabb SceneBvh::GetFatBounds(int32_t proxyId) const
+{
+	assert(0 <= proxyId && proxyId < _nodeCapacity);
+	return GetNodeBounds(proxyId);
+}
+
+void SceneBvh::RefitNode(int32_t nodeId)
+{
+	SceneBvhNode& node = _nodes[nodeId];
+	const SceneBvhNode& child1 = _nodes[node._child1];
+	const SceneBvhNode& child2 = _nodes[node._child2];
+
+	for (uint32_t i = 0; i < 3; ++i)
+	{
+		node._min[i] = (std::min)(child1._min[i], child2._min[i]);
+		node._max[i] = (std::max)(child1._max[i], child2._max[i]);
+	}
+
+	node._height = 1 + (std::max)(child1._height, child2._height);
+}
+
+void SceneBvh::RotateNode(int32_t nodeId)
+{
+	// Tree rotations as described by Kopta et al. "Fast, Effective BVH Updates for Animated Scenes".
+	// A child is swapped with a grandchild on the other side if this lowers the area of the modified child.
+	SceneBvhNode& node = _nodes[nodeId];
+	int32_t b = node._child1;
+	int32_t c = node._child2;
+
+	int32_t bestRotation = 0;
+	float bestGain = 0.0f;
+
+	if (!_nodes[c].IsLeaf())
+	{
+		float area = GetNodeBounds(c).SurfaceArea();
+		SceneAabb boundsB = GetNodeBounds(b);
+		// B <-> F
+		float gain = area - SceneAabb::Combine(boundsB, GetNodeBounds(_nodes[c]._child2)).SurfaceArea();
+		if (gain > bestGain) { bestGain = gain; bestRotation = 1; }
+		// B <-> G
+		gain = area - SceneAabb::Combine(boundsB, GetNodeBounds(_nodes[c]._child1)).SurfaceArea();
+		if (gain > bestGain) { bestGain = gain; bestRotation = 2; }
+	}
+
+	if (!_nodes[b].IsLeaf())
+	{
+		float area = GetNodeBounds(b).SurfaceArea();
+		SceneAabb boundsC = GetNodeBounds(c);
+		// C <-> D
+		float gain = area - SceneAabb::Combine(boundsC, GetNodeBounds(_nodes[b]._child2)).SurfaceArea();
+		if (gain > bestGain) { bestGain = gain; bestRotation = 3; }
+		// C <-> E
+		gain = area - SceneAabb::Combine(boundsC, GetNodeBounds(_nodes[b]._child1)).SurfaceArea();
+		if (gain > bestGain) { bestGain = gain; bestRotation = 4; }
+	}
+
+	if (bestRotation == 0)
+		return;
+
+	// the swapped child (outer) moves down into "inner", the grandchild moves up to nodeId
+	int32_t outer = (bestRotation <= 2) ? b : c;
+	int32_t inner = (bestRotation <= 2) ? c : b;
+	int32_t* grandChild = (bestRotation == 1 || bestRotation == 3) ? &_nodes[inner]._child1 : &_nodes[inner]._child2;
+	int32_t moved = *grandChild;
+
+	*grandChild = outer;
+	_nodes[outer]._parent = inner;
+
+	if (node._child1 == outer)
+		node._child1 = moved;
+	else
+		node._child2 = moved;
+	_nodes[moved]._parent = nodeId;
+
+	RefitNode(inner);
+	RefitNode(nodeId);
+}
+
+void SceneBvh::InsertLeaf(int32_t leaf)
+{
+	if (_root == SceneBvhNullNode)
+	{
+		_root = leaf;
+		_nodes[_root]._parent = SceneBvhNullNode;
+		return;
+	}
+
+	// find the best sibling using the SAH cost of the combined node
+	// plus the area increase inherited by all ancestors
+	SceneAabb leafBounds = GetNodeBounds(leaf);
+	int32_t index = _root;
+	while (!_nodes[index].IsLeaf())
+	{
+		int32_t child1 = _nodes[index]._child1;
+		int32_t child2 = _nodes[index]._child2;
+
+		float area = GetNodeBounds(index).SurfaceArea();
+		float combinedArea = SceneAabb::Combine(GetNodeBounds(index), leafBounds).SurfaceArea();
+
+		// cost of creating a new parent for this node and the new leaf
+		float cost = 2.0f * combinedArea;
+		// minimum cost of pushing the leaf further down the tree
+		float inheritanceCost = 2.0f * (combinedArea - area);
+
+		float cost1 = SceneAabb::Combine(leafBounds, GetNodeBounds(child1)).SurfaceArea() + inheritanceCost;
+		if (!_nodes[child1].IsLeaf())
+			cost1 -= GetNodeBounds(child1).SurfaceArea();
+
+		float cost2 = SceneAabb::Combine(leafBounds, GetNodeBounds(child2)).SurfaceArea() + inheritanceCost;
+		if (!_nodes[child2].IsLeaf())
+			cost2 -= GetNodeBounds(child2).SurfaceArea();
+
+		if (cost < cost1 && cost < cost2)
+			break;
+
+		index = (cost1 < cost2) ? child1 : child2;
+	}
+
+	int32_t sibling = index;
+
+	// create a new parent. Note AllocateNode may grow the pool
+	int32_t oldParent = _nodes[sibling]._parent;
+	int32_t newParent = AllocateNode();
+	_nodes[newParent]._parent = oldParent;
+	_nodes[newParent]._child1 = sibling;
+	_nodes[newParent]._child2 = leaf;
+	_nodes[sibling]._parent = newParent;
+	_nodes[leaf]._parent = newParent;
+	RefitNode(newParent);
+
+	if (oldParent != SceneBvhNullNode)
+	{
+		if (_nodes[oldParent]._child1 == sibling)
+			_nodes[oldParent]._child1 = newParent;
+		else
+			_nodes[oldParent]._child2 = newParent;
+	}
+	else
+	{
+		_root = newParent;
+	}
+
+	// walk back up the tree fixing bounds and rotating
+	index = _nodes[leaf]._parent;
+	while (index != SceneBvhNullNode)
+	{
+		RefitNode(index);
+		RotateNode(index);
+		index = _nodes[index]._parent;
+	}
+}
+
+void SceneBvh::RemoveLeaf(int32_t leaf)
+{
+	if (leaf == _root)
+	{
+		_root = SceneBvhNullNode;
+		return;
+	}
+
+	int32_t parent = _nodes[leaf]._parent;
+	int32_t grandParent = _nodes[parent]._parent;
+	int32_t sibling = (_nodes[parent]._child1 == leaf) ? _nodes[parent]._child2 : _nodes[parent]._child1;
+
+	if (grandParent != SceneBvhNullNode)
+	{
+		// connect sibling to grand parent
+		if (_nodes[grandParent]._child1 == parent)
+			_nodes[grandParent]._child1 = sibling;
+		else
+			_nodes[grandParent]._child2 = sibling;
+		_nodes[sibling]._parent = grandParent;
+		FreeNode(parent);
+
+		int32_t index = grandParent;
+		while (index != SceneBvhNullNode)
+		{
+			RefitNode(index);
+			RotateNode(index);
+			index = _nodes[index]._parent;
+		}
+	}
+	else
+	{
+		_root = sibling;
+		_nodes[sibling]._parent = SceneBvhNullNode;
+		FreeNode(parent);
+	}
+}
+
+void SceneBvh::Refit()
+{
+	if (_root == SceneBvhNullNode)
+		return;
+
+	// gather internal nodes in pre order. Walking the list backwards visits children before parents
+	caveVector<int32_t> order(_pAllocator);
+	caveVector<int32_t> stack(_pAllocator);
+	order.Reserve(_nodeCount);
+	stack.Reserve(SceneBvhStackSize);
+	stack.Push(_root);
+
+	while (!stack.Empty())
+	{
+		int32_t nodeId = stack[stack.Size() - 1];
+		stack.Pop();
+
+		const SceneBvhNode& node = _nodes[nodeId];
+		if (node.IsLeaf())
+			continue;
+
+		order.Push(nodeId);
+		stack.Push(node._child1);
+		stack.Push(node._child2);
+	}
+
+	for (size_t i = order.Size(); i > 0; --i)
+	{
+		RefitNode(order[i - 1]);
+		RotateNode(order[i - 1]);
+	}
+}
+
+void SceneBvh::Build()
+{
+	if (_proxyCount == 0)
+		return;
+
+	// collect leaves and release all internal nodes
+	int32_t* leaves = AllocateArray<int32_t>(*_pAllocator, _proxyCount);
+	int32_t leafCount = 0;
+	for (int32_t i = 0; i < _nodeCapacity; ++i)
+	{
+		SceneBvhNode& node = _nodes[i];
+		if (node._height < 0)
+			continue;
+
+		if (node.IsLeaf())
+		{
+			node._parent = SceneBvhNullNode;
+			leaves[leafCount++] = i;
+		}
+		else
+		{
+			FreeNode(i);
+		}
+	}
+
+	assert(leafCount == static_cast<int32_t>(_proxyCount));
+
+	_root = BuildRange(leaves, leafCount, 0);
+	_nodes[_root]._parent = SceneBvhNullNode;
+
+	DeallocateArray<int32_t>(*_pAllocator, leaves);
+}
+
+int32_t SceneBvh::BuildRange(int32_t* leaves, int32_t count, int32_t depth)
+{
+	if (count == 1)
+		return leaves[0];
+
+	// centroid bounds
+	SceneAabb centroidBounds;
+	for (int32_t i = 0; i < count; ++i)
+	{
+		const SceneBvhNode& node = _nodes[leaves[i]];
+		Vector3f centroid((node._min[0] + node._max[0]) * 0.5f, (node._min[1] + node._max[1]) * 0.5f, (node._min[2] + node._max[2]) * 0.5f);
+		centroidBounds = SceneAabb::Combine(centroidBounds, SceneAabb(centroid, centroid));
+	}
+
+	Vector3f extent = centroidBounds._max - centroidBounds._min;
+	uint32_t axis = 0;
+	if (extent._y > extent._x)
+		axis = 1;
+	if (extent._z > ((axis == 0) ? extent._x : extent._y))
+		axis = 2;
+
+	float axisMin = (axis == 0) ? centroidBounds._min._x : ((axis == 1) ? centroidBounds._min._y : centroidBounds._min._z);
+	float axisExtent = (axis == 0) ? extent._x : ((axis == 1) ? extent._y : extent._z);
+
+	int32_t mid = count / 2;
+
+	if (axisExtent > 0.0f && depth < SceneBvhMaxSahDepth)
+	{
+		// binned SAH split
+		SceneAabb binBounds[SceneBvhBinCount];
+		int32_t binCount[SceneBvhBinCount] = {};
+		float binScale = SceneBvhBinCount / axisExtent;
+
+		for (int32_t i = 0; i < count; ++i)
+		{
+			const SceneBvhNode& node = _nodes[leaves[i]];
+			float centroid = (node._min[axis] + node._max[axis]) * 0.5f;
+			int32_t bin = (std::min)(static_cast<int32_t>((centroid - axisMin) * binScale), SceneBvhBinCount - 1);
+			binBounds[bin] = SceneAabb::Combine(binBounds[bin], GetNodeBounds(leaves[i]));
+			binCount[bin]++;
+		}
+
+		// sweep from the right to get the right side areas
+		float rightArea[SceneBvhBinCount];
+		SceneAabb accumBounds;
+		int32_t accumCount = 0;
+		for (int32_t i = SceneBvhBinCount - 1; i > 0; --i)
+		{
+			accumBounds = SceneAabb::Combine(accumBounds, binBounds[i]);
+			accumCount += binCount[i];
+			rightArea[i] = (accumCount > 0) ? accumBounds.SurfaceArea() * accumCount : 0.0f;
+		}
+
+		// sweep from the left and pick the cheapest split plane
+		float bestCost = (std::numeric_limits<float>::max)();
+		int32_t bestSplit = -1;
+		accumBounds = SceneAabb();
+		accumCount = 0;
+		for (int32_t i = 0; i < SceneBvhBinCount - 1; ++i)
+		{
+			accumBounds = SceneAabb::Combine(accumBounds, binBounds[i]);
+			accumCount += binCount[i];
+			if (accumCount == 0 || accumCount == count)
+				continue;
+
+			float cost = accumBounds.SurfaceArea() * accumCount + rightArea[i + 1];
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				bestSplit = i;
+			}
+		}
+
+		if (bestSplit >= 0)
+		{
+			// partition leaves in place
+			int32_t* first = leaves;
+			int32_t* last = leaves + count;
+			while (first < last)
+			{
+				const SceneBvhNode& node = _nodes[*first];
+				float centroid = (node._min[axis] + node._max[axis]) * 0.5f;
+				int32_t bin = (std::min)(static_cast<int32_t>((centroid - axisMin) * binScale), SceneBvhBinCount - 1);
+				if (bin <= bestSplit)
+					++first;
+				else
+					std::swap(*first, *(--last));
+			}
+
+			mid = static_cast<int32_t>(first - leaves);
+		}
+	}
+	else if (axisExtent > 0.0f)
+	{
+		// too deep for SAH. Use an object median split to bound the depth
+		const SceneBvhNode* nodes = _nodes;
+		std::nth_element(leaves, leaves + mid, leaves + count, [nodes, axis](int32_t a, int32_t b)
+		{
+			return (nodes[a]._min[axis] + nodes[a]._max[axis]) < (nodes[b]._min[axis] + nodes[b]._max[axis]);
+		});
+	}
+
+	assert(mid > 0 && mid < count);
+
+	int32_t child1 = BuildRange(leaves, mid, depth + 1);
+	int32_t child2 = BuildRange(leaves + mid, count - mid, depth + 1);
+
+	int32_t nodeId = AllocateNode();
+	_nodes[nodeId]._child1 = child1;
+	_nodes[nodeId]._child2 = child2;
+	_nodes[child1]._parent = nodeId;
+	_nodes[child2]._parent = nodeId;
+	RefitNode(nodeId);
+
+	return nodeId;
+}
+
+void SceneBvh::AppendSubtree(int32_t nodeId, caveVector<int32_t>& results, caveVector<int32_t>& stack) const
+{
+	size_t base = stack.Size();
+	stack.Push(nodeId);
+
+	while (stack.Size() > base)
+	{
+		int32_t index = stack[stack.Size() - 1];
+		stack.Pop();
+
+		const SceneBvhNode& node = _nodes[index];
+		if (node.IsLeaf())
+		{
+			results.Push(index);
+		}
+		else
+		{
+			stack.Push(node._child1);
+			stack.Push(node._child2);
+		}
+	}
+}
+
+void SceneBvh::QueryAabb(const SceneAabb& bounds, caveVector<int32_t>& results) const
+{
+	if (_root == SceneBvhNullNode)
+		return;
+
+	caveVector<int32_t> stack(_pAllocator);
+	stack.Reserve(SceneBvhStackSize);
+	stack.Push(_root);
+
+#ifdef CAVE_BVH_SSE
+	__m128 queryMin = _mm_set_ps(0.0f, bounds._min._z, bounds._min._y, bounds._min._x);
+	__m128 queryMax = _mm_set_ps(0.0f, bounds._max._z, bounds._max._y, bounds._max._x);
+#endif
+
+	while (!stack.Empty())
+	{
+		int32_t index = stack[stack.Size() - 1];
+		stack.Pop();
+
+		const SceneBvhNode& node = _nodes[index];
+#ifdef CAVE_BVH_SSE
+		__m128 nodeMin = _mm_loadu_ps(node._min);
+		__m128 nodeMax = _mm_loadu_ps(node._max);
+		__m128 separated = _mm_or_ps(_mm_cmpgt_ps(nodeMin, queryMax), _mm_cmplt_ps(nodeMax, queryMin));
+		if (_mm_movemask_ps(separated) & 0x7)
+			continue;
+#else
+		if (node._min[0] > bounds._max._x || node._min[1] > bounds._max._y || node._min[2] > bounds._max._z ||
+			node._max[0] < bounds._min._x || node._max[1] < bounds._min._y || node._max[2] < bounds._min._z)
+			continue;
+#endif
+
+		if (node.IsLeaf())
+		{
+			results.Push(index);
+		}
+		else
+		{
+			stack.Push(node._child1);
+			stack.Push(node._child2);
+		}
+	}
+}
+
+void SceneBvh::QuerySphere(const Vector3f& center, float radius, caveVector<int32_t>& results) const
+{
+	if (_root == SceneBvhNullNode)
+		return;
+
+	caveVector<int32_t> stack(_pAllocator);
+	stack.Reserve(SceneBvhStackSize);
+	stack.Push(_root);
+
+	float radiusSq = radius * radius;
+#ifdef CAVE_BVH_SSE
+	__m128 sphereCenter = _mm_set_ps(0.0f, center._z, center._y, center._x);
+#endif
+
+	while (!stack.Empty())
+	{
+		int32_t index = stack[stack.Size() - 1];
+		stack.Pop();
+
+		const SceneBvhNode& node = _nodes[index];
+		// distance from the sphere center to the closest point in the box
+#ifdef CAVE_BVH_SSE
+		__m128 closest = _mm_min_ps(_mm_max_ps(sphereCenter, _mm_loadu_ps(node._min)), _mm_loadu_ps(node._max));
+		__m128 delta = _mm_sub_ps(sphereCenter, closest);
+		delta = _mm_mul_ps(delta, delta);
+		delta = _mm_add_ps(delta, _mm_shuffle_ps(delta, delta, _MM_SHUFFLE(2, 3, 0, 1)));
+		delta = _mm_add_ps(delta, _mm_shuffle_ps(delta, delta, _MM_SHUFFLE(1, 0, 3, 2)));
+		if (_mm_cvtss_f32(delta) > radiusSq)
+			continue;
+#else
+		float dx = center._x - (std::min)((std::max)(center._x, node._min[0]), node._max[0]);
+		float dy = center._y - (std::min)((std::max)(center._y, node._min[1]), node._max[1]);
+		float dz = center._z - (std::min)((std::max)(center._z, node._min[2]), node._max[2]);
+		if (dx * dx + dy * dy + dz * dz > radiusSq)
+			continue;
+#endif
+
+		if (node.IsLeaf())
+		{
+			results.Push(index);
+		}
+		else
+		{
+			stack.Push(node._child1);
+			stack.Push(node._child2);
+		}
+	}
+}
+
+void SceneBvh::QueryFrustum(const SceneFrustum& frustum, caveVector<int32_t>& results) const
+{
+	if (_root == SceneBvhNullNode)
+		return;
+
+	caveVector<int32_t> stack(_pAllocator);
+	stack.Reserve(SceneBvhStackSize);
+	stack.Push(_root);
+
+#ifdef CAVE_BVH_SSE
+	// planes in SoA layout. Two groups of four, the last two planes always pass
+	__m128 planeX[2], planeY[2], planeZ[2], planeD[2];
+	planeX[0] = _mm_set_ps(frustum._normal[3]._x, frustum._normal[2]._x, frustum._normal[1]._x, frustum._normal[0]._x);
+	planeY[0] = _mm_set_ps(frustum._normal[3]._y, frustum._normal[2]._y, frustum._normal[1]._y, frustum._normal[0]._y);
+	planeZ[0] = _mm_set_ps(frustum._normal[3]._z, frustum._normal[2]._z, frustum._normal[1]._z, frustum._normal[0]._z);
+	planeD[0] = _mm_set_ps(frustum._distance[3], frustum._distance[2], frustum._distance[1], frustum._distance[0]);
+	planeX[1] = _mm_set_ps(0.0f, 0.0f, frustum._normal[5]._x, frustum._normal[4]._x);
+	planeY[1] = _mm_set_ps(0.0f, 0.0f, frustum._normal[5]._y, frustum._normal[4]._y);
+	planeZ[1] = _mm_set_ps(0.0f, 0.0f, frustum._normal[5]._z, frustum._normal[4]._z);
+	planeD[1] = _mm_set_ps(1.0f, 1.0f, frustum._distance[5], frustum._distance[4]);
+	__m128 zero = _mm_setzero_ps();
+#endif
+
+	while (!stack.Empty())
+	{
+		int32_t index = stack[stack.Size() - 1];
+		stack.Pop();
+
+		const SceneBvhNode& node = _nodes[index];
+		bool inside = true;
+
+#ifdef CAVE_BVH_SSE
+		__m128 minX = _mm_set1_ps(node._min[0]), maxX = _mm_set1_ps(node._max[0]);
+		__m128 minY = _mm_set1_ps(node._min[1]), maxY = _mm_set1_ps(node._max[1]);
+		__m128 minZ = _mm_set1_ps(node._min[2]), maxZ = _mm_set1_ps(node._max[2]);
+		bool outside = false;
+
+		for (uint32_t g = 0; g < 2 && !outside; ++g)
+		{
+			__m128 x0 = _mm_mul_ps(planeX[g], minX), x1 = _mm_mul_ps(planeX[g], maxX);
+			__m128 y0 = _mm_mul_ps(planeY[g], minY), y1 = _mm_mul_ps(planeY[g], maxY);
+			__m128 z0 = _mm_mul_ps(planeZ[g], minZ), z1 = _mm_mul_ps(planeZ[g], maxZ);
+
+			// distance of the corner furthest along the plane normal (p-vertex)
+			__m128 distMax = _mm_add_ps(_mm_add_ps(_mm_max_ps(x0, x1), _mm_max_ps(y0, y1)), _mm_add_ps(_mm_max_ps(z0, z1), planeD[g]));
+			if (_mm_movemask_ps(_mm_cmplt_ps(distMax, zero)))
+				outside = true;
+
+			// distance of the opposite corner (n-vertex)
+			__m128 distMin = _mm_add_ps(_mm_add_ps(_mm_min_ps(x0, x1), _mm_min_ps(y0, y1)), _mm_add_ps(_mm_min_ps(z0, z1), planeD[g]));
+			if (_mm_movemask_ps(_mm_cmplt_ps(distMin, zero)))
+				inside = false;
+		}
+
+		if (outside)
+			continue;
+#else
+		bool outside = false;
+		for (uint32_t i = 0; i < 6 && !outside; ++i)
+		{
+			const Vector3f& n = frustum._normal[i];
+			float distMax = (std::max)(n._x * node._min[0], n._x * node._max[0]) + (std::max)(n._y * node._min[1], n._y * node._max[1]) +
+							(std::max)(n._z * node._min[2], n._z * node._max[2]) + frustum._distance[i];
+			float distMin = (std::min)(n._x * node._min[0], n._x * node._max[0]) + (std::min)(n._y * node._min[1], n._y * node._max[1]) +
+							(std::min)(n._z * node._min[2], n._z * node._max[2]) + frustum._distance[i];
+			if (distMax < 0.0f)
+				outside = true;
+			if (distMin < 0.0f)
+				inside = false;
+		}
+
+		if (outside)
+			continue;
+#endif
+
+		if (node.IsLeaf())
+		{
+			results.Push(index);
+		}
+		else if (inside)
+		{
+			// fully inside. No need to test the subtree
+			AppendSubtree(index, results, stack);
+		}
+		else
+		{
+			stack.Push(node._child1);
+			stack.Push(node._child2);
+		}
+	}
+}
+
+void SceneBvh::QueryRay(const SceneRay& ray, float maxDistance, caveVector<int32_t>& results) const
+{
+	if (_root == SceneBvhNullNode)
+		return;
+
+	caveVector<int32_t> stack(_pAllocator);
+	stack.Reserve(SceneBvhStackSize);
+	stack.Push(_root);
+
+	// division by zero yields +-inf which the slab test handles
+	Vector3f invDir(1.0f / ray._direction._x, 1.0f / ray._direction._y, 1.0f / ray._direction._z);
+
+#ifdef CAVE_BVH_SSE
+	__m128 origin = _mm_set_ps(0.0f, ray._origin._z, ray._origin._y, ray._origin._x);
+	__m128 invDirection = _mm_set_ps(0.0f, invDir._z, invDir._y, invDir._x);
+	// w lane carries the ray segment range [0, maxDistance]
+	__m128 xyzMask = _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+	__m128 rangeMax = _mm_set_ps(maxDistance, 0.0f, 0.0f, 0.0f);
+#endif
+
+	while (!stack.Empty())
+	{
+		int32_t index = stack[stack.Size() - 1];
+		stack.Pop();
+
+		const SceneBvhNode& node = _nodes[index];
+#ifdef CAVE_BVH_SSE
+		__m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node._min), origin), invDirection);
+		__m128 t2 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node._max), origin), invDirection);
+		// w lanes of t1 and t2 are zero which clamps the entry distance to the ray start
+		float tEnter = HorizontalMax(_mm_min_ps(t1, t2));
+		float tExit = HorizontalMin(_mm_or_ps(_mm_and_ps(_mm_max_ps(t1, t2), xyzMask), rangeMax));
+		if (tEnter > tExit)
+			continue;
+#else
+		float tEnter = 0.0f;
+		float tExit = maxDistance;
+		const float origin[3] = { ray._origin._x, ray._origin._y, ray._origin._z };
+		const float inv[3] = { invDir._x, invDir._y, invDir._z };
+		for (uint32_t i = 0; i < 3; ++i)
+		{
+			float t1 = (node._min[i] - origin[i]) * inv[i];
+			float t2 = (node._max[i] - origin[i]) * inv[i];
+			tEnter = (std::max)(tEnter, (std::min)(t1, t2));
+			tExit = (std::min)(tExit, (std::max)(t1, t2));
+		}
+		if (tEnter > tExit)
+			continue;
+#endif
+
+		if (node.IsLeaf())
+		{
+			results.Push(index);
+		}
+		else
+		{
+			stack.Push(node._child1);
+			stack.Push(node._child2);
+		}
+	}
+}
+
+int32_t SceneBvh::GetHeight() const
+{
+	if (_root == SceneBvhNullNode)
+		return 0;
+
+	return _nodes[_root]._height;
+}
+
+float SceneBvh::GetAreaRatio() const
+{
+	if (_root == SceneBvhNullNode)
+		return 0.0f;
+
+	float rootArea = GetNodeBounds(_root).SurfaceArea();
+	if (rootArea <= 0.0f)
+		return 0.0f;
+
+	float totalArea = 0.0f;
+	for (int32_t i = 0; i < _nodeCapacity; ++i)
+	{
+		if (_nodes[i]._height > 0)
+			totalArea += GetNodeBounds(i).SurfaceArea();
+	}
+
+	return totalArea / rootArea;
+}
+
+bool SceneBvh::Validate() const
+{
+	if (_root == SceneBvhNullNode)
+		return _proxyCount == 0;
+
+	if (_nodes[_root]._parent != SceneBvhNullNode)
+		return false;
+
+	caveVector<int32_t> stack(_pAllocator);
+	stack.Reserve(SceneBvhStackSize);
+	stack.Push(_root);
+	uint32_t leafCount = 0;
+	int32_t nodeCount = 0;
+
+	while (!stack.Empty())
+	{
+		int32_t index = stack[stack.Size() - 1];
+		stack.Pop();
+		++nodeCount;
+
+		const SceneBvhNode& node = _nodes[index];
+		if (node.IsLeaf())
+		{
+			if (node._height != 0 || node._child2 != SceneBvhNullNode)
+				return false;
+			++leafCount;
+			continue;
+		}
+
+		const SceneBvhNode& child1 = _nodes[node._child1];
+		const SceneBvhNode& child2 = _nodes[node._child2];
+		if (child1._parent != index || child2._parent != index)
+			return false;
+		if (node._height != 1 + (std::max)(child1._height, child2._height))
+			return false;
+		if (!GetNodeBounds(index).Contains(GetNodeBounds(node._child1)) || !GetNodeBounds(index).Contains(GetNodeBounds(node._child2)))
+			return false;
+
+		stack.Push(node._child1);
+		stack.Push(node._child2);
+	}
+
+	return leafCount == _proxyCount && nodeCount == _nodeCount;
+}
+
+}
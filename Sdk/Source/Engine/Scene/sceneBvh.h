@@ -0,0 +1,305 @@
+/*
+Copyright (c) <2017> <Udo Lugauer>
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE
+*/
+#pragma once
+
+/// @file sceneBvh.h
+///       Dynamic bounding volume hierarchy used for scene queries
+
+#include "engineDefines.h"
+#include "Common/caveVector.h"
+#include "Memory/allocatorBase.h"
+#include "Math/vector3.h"
+#include "Math/matrix4.h"
+
+#include <memory>
+
+/** \addtogroup engine
+*  @{
+*		This module contains all code related to the engine
+*/
+
+namespace cave
+{
+
+/// Invalid proxy or node index
+static const int32_t SceneBvhNullNode = -1;
+
+/**
+* @brief Axis aligned bounding box
+*/
+struct CAVE_INTERFACE SceneAabb
+{
+	Vector3f _min;	///< Minimum corner
+	Vector3f _max;	///< Maximum corner
+
+	/** default constructor (creates an empty box) */
+	SceneAabb()
+		: _min((std::numeric_limits<float>::max)())
+		, _max(-(std::numeric_limits<float>::max)())
+	{}
+
+	/**
+	* @brief Constructor
+	*
+	* @param[in] minCorner	Minimum corner
+	* @param[in] maxCorner	Maximum corner
+	*/
+	SceneAabb(const Vector3f& minCorner, const Vector3f& maxCorner)
+		: _min(minCorner), _max(maxCorner)
+	{}
+
+	/**
+	* @brief Surface area of the box. Used as SAH cost metric.
+	*
+	* @return surface area
+	*/
+	float SurfaceArea() const;
+
+	/**
+	* @brief Check if this box fully contains another box
+	*
+	* @param[in] other	Box to test
+	*
+	* @return true if other is inside
+	*/
+	bool Contains(const SceneAabb& other) const;
+
+	/**
+	* @brief Check if two boxes overlap
+	*
+	* @param[in] other	Box to test
+	*
+	* @return true if they overlap
+	*/
+	bool Overlaps(const SceneAabb& other) const;
+
+	/**
+	* @brief Union of two boxes
+	*
+	* @param[in] a	First box
+	* @param[in] b	Second box
+	*
+	* @return box enclosing a and b
+	*/
+	static SceneAabb Combine(const SceneAabb& a, const SceneAabb& b);
+};
+
+/**
+* @brief Ray used for ray queries
+*/
+struct CAVE_INTERFACE SceneRay
+{
+	Vector3f _origin;		///< Ray origin
+	Vector3f _direction;	///< Ray direction (does not need to be normalized)
+};
+
+/**
+* @brief View frustum described by six inward facing planes.
+*		 A point p is inside if dot(normal, p) + distance >= 0 for all planes.
+*/
+struct CAVE_INTERFACE SceneFrustum
+{
+	Vector3f _normal[6];	///< Plane normals (left, right, bottom, top, near, far)
+	float _distance[6];		///< Plane distances
+
+	/**
+	* @brief Extract the frustum planes from a view projection matrix
+	*		 The matrix follows the engine layout (_m[column][row]) with a clip space depth of [0, 1].
+	*
+	* @param[in] viewProjection	Combined view projection matrix
+	*/
+	void SetFromMatrix(const Matrix4f& viewProjection);
+};
+
+/**
+* @brief Flattened node of the hierarchy. One cache line per node.
+*		 Bounds are stored as 4 floats so the node tests can load them into SIMD registers directly.
+*/
+struct SceneBvhNode
+{
+	float _min[4];			///< Fat bounds minimum (w unused)
+	float _max[4];			///< Fat bounds maximum (w unused)
+	int32_t _parent;		///< Parent node index or next free node if unused
+	int32_t _child1;		///< First child (SceneBvhNullNode if leaf)
+	int32_t _child2;		///< Second child (SceneBvhNullNode if leaf)
+	int32_t _height;		///< Leaf = 0, free node = -1
+	void* _userData;		///< User data of leaf nodes
+	uint8_t _padding[8];	///< Pad to 64 bytes
+
+	/** @brief Check if this node is a leaf */
+	bool IsLeaf() const { return _child1 == SceneBvhNullNode; }
+};
+
+/**
+* @brief Dynamic bounding volume hierarchy over scene object bounds.
+*		 Proxies are inserted incrementally using a SAH cost driven sibling search and
+*		 kept balanced with tree rotations. Moving objects use enlarged (fat) bounds so small
+*		 movements do not touch the tree at all. A full binned SAH rebuild is available for
+*		 bulk loads. Queries report proxies whose fat bounds pass the test.
+*/
+class CAVE_INTERFACE SceneBvh
+{
+public:
+	/**
+	* @brief Constructor
+	*
+	* @param[in] allocator	Engine allocator used for the node pool
+	* @param[in] fatMargin	Margin the proxy bounds are enlarged by
+	*/
+	SceneBvh(std::shared_ptr<AllocatorBase> allocator, float fatMargin = 0.1f);
+
+	/** @brief destructor */
+	~SceneBvh();
+
+	/**
+	* @brief Create a proxy for an object
+	*
+	* @param[in] bounds		Object bounds
+	* @param[in] userData	User data returned by GetUserData
+	*
+	* @return proxy id
+	*/
+	int32_t CreateProxy(const SceneAabb& bounds, void* userData);
+
+	/**
+	* @brief Destroy a proxy
+	*
+	* @param[in] proxyId	Proxy returned by CreateProxy
+	*/
+	void DestroyProxy(int32_t proxyId);
+
+	/**
+	* @brief Move a proxy. The proxy is only reinserted if the new bounds leave the fat bounds.
+	*
+	* @param[in] proxyId	Proxy returned by CreateProxy
+	* @param[in] bounds		New object bounds
+	*
+	* @return true if the proxy was reinserted
+	*/
+	bool MoveProxy(int32_t proxyId, const SceneAabb& bounds);
+
+	/**
+	* @brief Update the bounds of a proxy without restructuring the tree.
+	*		 Refit must be called after all updates before the next query.
+	*
+	* @param[in] proxyId	Proxy returned by CreateProxy
+	* @param[in] bounds		New object bounds
+	*/
+	void UpdateProxyBounds(int32_t proxyId, const SceneAabb& bounds);
+
+	/**
+	* @brief Refit all internal nodes bottom up and apply local tree rotations where they lower the SAH cost
+	*/
+	void Refit();
+
+	/**
+	* @brief Rebuild the whole hierarchy over the current proxies using a binned SAH build.
+	*		 Proxy ids stay valid.
+	*/
+	void Build();
+
+	/**
+	* @brief Get user data of a proxy
+	*
+	* @param[in] proxyId	Proxy returned by CreateProxy
+	*
+	* @return user data
+	*/
+	void* GetUserData(int32_t proxyId) const;
+
+	/**
+	* @brief Get fat bounds of a proxy
+	*
+	* @param[in] proxyId	Proxy returned by CreateProxy
+	*
+	* @return fat bounds
+	*/
+	SceneAabb GetFatBounds(int32_t proxyId) const;
+
+	/**
+	* @brief Query all proxies overlapping a box
+	*
+	* @param[in] bounds		Query box
+	* @param[out] results	Proxy ids are appended to this array
+	*/
+	void QueryAabb(const SceneAabb& bounds, caveVector<int32_t>& results) const;
+
+	/**
+	* @brief Query all proxies overlapping a sphere
+	*
+	* @param[in] center		Sphere center
+	* @param[in] radius		Sphere radius
+	* @param[out] results	Proxy ids are appended to this array
+	*/
+	void QuerySphere(const Vector3f& center, float radius, caveVector<int32_t>& results) const;
+
+	/**
+	* @brief Query all proxies intersecting a frustum
+	*
+	* @param[in] frustum	Query frustum
+	* @param[out] results	Proxy ids are appended to this array
+	*/
+	void QueryFrustum(const SceneFrustum& frustum, caveVector<int32_t>& results) const;
+
+	/**
+	* @brief Query all proxies hit by a ray segment
+	*
+	* @param[in] ray			Query ray
+	* @param[in] maxDistance	Maximum ray parameter t
+	* @param[out] results		Proxy ids are appended to this array
+	*/
+	void QueryRay(const SceneRay& ray, float maxDistance, caveVector<int32_t>& results) const;
+
+	/** @brief Get number of proxies */
+	uint32_t GetProxyCount() const { return _proxyCount; }
+
+	/** @brief Get height of the tree */
+	int32_t GetHeight() const;
+
+	/** @brief Ratio of the summed internal node area to the root area (SAH quality metric) */
+	float GetAreaRatio() const;
+
+	/**
+	* @brief Validate tree structure and bounds
+	*
+	* @return true if valid
+	*/
+	bool Validate() const;
+
+private:
+	int32_t AllocateNode();
+	void FreeNode(int32_t nodeId);
+	void InsertLeaf(int32_t leaf);
+	void RemoveLeaf(int32_t leaf);
+	void RefitNode(int32_t nodeId);
+	void RotateNode(int32_t nodeId);
+	int32_t BuildRange(int32_t* leaves, int32_t count, int32_t depth);
+	void SetNodeBounds(int32_t nodeId, const SceneAabb& bounds);
+	SceneAabb GetNodeBounds(int32_t nodeId) const;
+	void AppendSubtree(int32_t nodeId, caveVector<int32_t>& results, caveVector<int32_t>& stack) const;
+
+private:
+	std::shared_ptr<AllocatorBase> _pAllocator;	///< Allocator used for nodes
+	SceneBvhNode* _nodes;		///< Flattened node pool
+	int32_t _nodeCapacity;		///< Size of the node pool
+	int32_t _nodeCount;			///< Used nodes
+	int32_t _freeList;			///< Head of the free node list
+	int32_t _root;				///< Root node
+	uint32_t _proxyCount;		///< Number of proxies
+	float _fatMargin;			///< Fat bounds margin
+};
+
+}
+
+/** @}*/
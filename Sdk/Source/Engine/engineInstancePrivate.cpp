@@ -77,6 +77,7 @@ EngineInstancePrivate::EngineInstancePrivate(EngineCreateStruct& engineCreate)
 	: _pAllocator(nullptr)
 	, _pRenderInstance(nullptr)
 	, _pFrontend(nullptr)
+	, _pJobSystem(nullptr)
 	, _pEngineLog(nullptr)
 	, _ApplicationName(engineCreate.applicationName)
 	, _ProjectPath(engineCreate.projectPath)
@@ -89,6 +90,8 @@ EngineInstancePrivate::EngineInstancePrivate(EngineCreateStruct& engineCreate)
 		_ApplicationPath = GetAppPath();
 		// Create our logger. By default no logging
 		_pEngineLog = AllocateObject<EngineLog>(*_pAllocator, EngineLog::WARNING_LEVEL_NONE, EngineLog::MESSAGE_LEVEL_NONE, true);
+		// Create our job scheduler. One worker per additional core
+		_pJobSystem = AllocateObject<JobSystem>(*_pAllocator, _pAllocator);
 	}
 }
 
@@ -108,6 +111,13 @@ EngineInstancePrivate::~EngineInstancePrivate()
 		DeallocateDelete(*_pAllocator, *_pRenderInstance);
 		_pRenderInstance = nullptr;
 	}
+
+	// release last. Resources may still have jobs in flight
+	if (_pJobSystem)
+	{
+		DeallocateDelete(*_pAllocator, *_pJobSystem);
+		_pJobSystem = nullptr;
+	}
 }
 
 RenderInstance* EngineInstancePrivate::CreateRenderInstance(RenderInstanceTypes type)
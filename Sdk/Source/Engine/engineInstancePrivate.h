@@ -23,6 +23,7 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SO
 #include "frontend.h"
 #include "engineTypes.h"
 #include "engineLog.h"
+#include "Jobs/jobSystem.h"
 
 #include <string>
 #include <memory>
@@ -85,6 +86,13 @@ public:
 	*/
 	EngineLog* GetEngineLog() const { return _pEngineLog; }
 
+	/**
+	* @brief Get engine job system
+	*
+	* @return Pointer to job system
+	*/
+	JobSystem* GetJobSystem() const { return _pJobSystem; }
+
 	/**
 	* @brief GetAllocator
 	*
@@ -111,6 +119,7 @@ private:
 	std::shared_ptr<AllocatorGlobal>    _pAllocator;	///< Pointer to engine custom allocations
 	RenderInstance* _pRenderInstance;	///< Pointer to render instance
 	IFrontend* _pFrontend;	///< Interface pointer to widow frontend
+	JobSystem* _pJobSystem;	///< Engine wide work stealing job scheduler
 	EngineLog* _pEngineLog;	///< Our engine wide message logger
 	std::string _ApplicationName;	///< Optional specified at creation time
 	std::string _ProjectPath;	///< Path to project provided by the caller
@@ -0,0 +1,120 @@
+/*
+Copyright (c) <2017> <Udo Lugauer>
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), 
+to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, 
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE
+*/
+#pragma once
+
+
+/// @file osMappedFile.h
+///       cave OS memory mapped file interface.
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+/** \addtogroup os
+*  @{
+*
+*/
+
+
+namespace cave
+{
+
+/**
+* Expected access pattern of a mapped file. Passed on to the OS paging hints.
+*/
+enum class OsMappedFileAccess
+{
+	Sequential = 0,	///< File is read front to back once (read ahead aggressively)
+	Random = 1		///< File is accessed at random offsets (no read ahead)
+};
+
+/**
+* Read only memory mapped file.
+* The content is accessed in place without copying it into user space buffers.
+*/
+class OsMappedFile
+{
+	public:
+	/** @brief Constructor */
+	OsMappedFile();
+
+	/** @brief Destructor. Unmaps the file */
+	~OsMappedFile();
+
+	/**
+	* @brief Map a file
+	*
+	* @param[in] path	Path to the file
+	* @param[in] access	Expected access pattern
+	*
+	* @returns true on success. Empty files can't be mapped
+	*/
+	bool Open(const char* path, OsMappedFileAccess access = OsMappedFileAccess::Sequential);
+
+	/**
+	* @brief Unmap the file
+	*
+	* @returns none
+	*/
+	void Close();
+
+	/**
+	* @brief Fault in all pages of the mapping.
+	* Lets a loader thread pay for the disk reads so later consumers don't stall.
+	*
+	* @returns none
+	*/
+	void Prefault() const;
+
+	/**
+	* @brief Exchange the mapping with another object.
+	* The mapped address does not change, pointers into the content stay valid.
+	*
+	* @param[in,out] other	Mapping to swap with
+	*
+	* @returns none
+	*/
+	void Swap(OsMappedFile& other)
+	{
+		std::swap(_data, other._data);
+		std::swap(_size, other._size);
+		std::swap(_mapping, other._mapping);
+		std::swap(_modificationTime, other._modificationTime);
+	}
+
+	/** @brief Check if a file is mapped */
+	bool IsOpen() const { return _data != nullptr; }
+
+	/** @brief Get the mapped content */
+	const uint8_t* GetData() const { return static_cast<const uint8_t*>(_data); }
+
+	/** @brief Get the size of the mapped content in bytes */
+	size_t GetSize() const { return _size; }
+
+	/** @brief Get the last modification time of the file (OS specific units, only compare for equality) */
+	uint64_t GetModificationTime() const { return _modificationTime; }
+
+	private:
+	OsMappedFile(const OsMappedFile&) = delete;
+	OsMappedFile& operator=(const OsMappedFile&) = delete;
+
+	void* _data;		///< Mapped content
+	size_t _size;		///< Size of the content
+	void* _mapping;		///< OS mapping handle (unused on linux)
+	uint64_t _modificationTime;	///< Last modification time of the file
+};
+
+}
+
+/** @}*/
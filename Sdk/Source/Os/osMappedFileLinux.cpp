@@ -0,0 +1,106 @@
+/*
+Copyright (c) <2017> <Udo Lugauer>
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), 
+to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, 
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE
+*/
+
+/// @file osMappedFileLinux.cpp
+///       Cave OS linux memory mapped file.
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "osMappedFile.h"
+
+namespace cave
+{
+
+OsMappedFile::OsMappedFile()
+	: _data(nullptr)
+	, _size(0)
+	, _mapping(nullptr)
+	, _modificationTime(0)
+{
+}
+
+OsMappedFile::~OsMappedFile()
+{
+	Close();
+}
+
+// map a file
+bool OsMappedFile::Open(const char* path, OsMappedFileAccess access)
+{
+	Close();
+
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return false;
+
+	struct stat fileStat;
+	if (fstat(fd, &fileStat) != 0 || fileStat.st_size <= 0)
+	{
+		close(fd);
+		return false;
+	}
+
+	size_t size = static_cast<size_t>(fileStat.st_size);
+	void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	// the mapping keeps its own reference to the file
+	close(fd);
+	if (data == MAP_FAILED)
+		return false;
+
+	if (access == OsMappedFileAccess::Sequential)
+	{
+		madvise(data, size, MADV_SEQUENTIAL);
+		madvise(data, size, MADV_WILLNEED);
+	}
+	else
+	{
+		madvise(data, size, MADV_RANDOM);
+	}
+
+	_data = data;
+	_size = size;
+	_modificationTime = static_cast<uint64_t>(fileStat.st_mtim.tv_sec) * 1000000000ull + static_cast<uint64_t>(fileStat.st_mtim.tv_nsec);
+
+	return true;
+}
+
+// unmap the file
+void OsMappedFile::Close()
+{
+	if (_data)
+		munmap(_data, _size);
+
+	_data = nullptr;
+	_size = 0;
+	_modificationTime = 0;
+}
+
+// touch every page
+void OsMappedFile::Prefault() const
+{
+	if (!_data)
+		return;
+
+	size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+	const volatile uint8_t* bytes = static_cast<const volatile uint8_t*>(_data);
+	uint8_t sum = 0;
+	for (size_t offset = 0; offset < _size; offset += pageSize)
+		sum ^= bytes[offset];
+	(void)sum;
+}
+
+}
@@ -0,0 +1,121 @@
+/*
+Copyright (c) <2017> <Udo Lugauer>
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), 
+to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, 
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE
+*/
+
+/// @file osMappedFileWin.cpp
+///       Cave OS windows memory mapped file.
+
+/// Define WIN32_LEAN_AND_MEAN to exclude APIs such as Cryptography, DDE, RPC, Shell, and Windows Sockets. 
+#define WIN32_LEAN_AND_MEAN
+/// Exclude rarely-used stuff from Windows headers
+#define VC_EXTRALEAN
+#include <windows.h>
+#include <codecvt>
+#include <locale>
+#include <string>
+
+#include "osMappedFile.h"
+
+namespace cave
+{
+
+OsMappedFile::OsMappedFile()
+	: _data(nullptr)
+	, _size(0)
+	, _mapping(nullptr)
+	, _modificationTime(0)
+{
+}
+
+OsMappedFile::~OsMappedFile()
+{
+	Close();
+}
+
+// map a file
+bool OsMappedFile::Open(const char* path, OsMappedFileAccess access)
+{
+	Close();
+
+	// build name in utf8 fashion
+	std::wstring_convert<std::codecvt_utf8_utf16<wchar_t>> wcu8;
+	std::wstring fileName = wcu8.from_bytes(path);
+
+	// the hint selects the cache manager read ahead behaviour
+	DWORD flags = (access == OsMappedFileAccess::Sequential) ? FILE_FLAG_SEQUENTIAL_SCAN : FILE_FLAG_RANDOM_ACCESS;
+	HANDLE file = CreateFileW(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, flags, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart <= 0)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	FILETIME lastWrite = {};
+	GetFileTime(file, nullptr, nullptr, &lastWrite);
+
+	HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	// the mapping keeps its own reference to the file
+	CloseHandle(file);
+	if (!mapping)
+		return false;
+
+	void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!data)
+	{
+		CloseHandle(mapping);
+		return false;
+	}
+
+	_data = data;
+	_size = static_cast<size_t>(fileSize.QuadPart);
+	_mapping = mapping;
+	_modificationTime = (static_cast<uint64_t>(lastWrite.dwHighDateTime) << 32) | lastWrite.dwLowDateTime;
+
+	return true;
+}
+
+// unmap the file
+void OsMappedFile::Close()
+{
+	if (_data)
+		UnmapViewOfFile(_data);
+	if (_mapping)
+		CloseHandle(static_cast<HANDLE>(_mapping));
+
+	_data = nullptr;
+	_size = 0;
+	_mapping = nullptr;
+	_modificationTime = 0;
+}
+
+// touch every page
+void OsMappedFile::Prefault() const
+{
+	if (!_data)
+		return;
+
+	SYSTEM_INFO systemInfo;
+	GetSystemInfo(&systemInfo);
+	size_t pageSize = static_cast<size_t>(systemInfo.dwPageSize);
+	const volatile uint8_t* bytes = static_cast<const volatile uint8_t*>(_data);
+	uint8_t sum = 0;
+	for (size_t offset = 0; offset < _size; offset += pageSize)
+		sum ^= bytes[offset];
+	(void)sum;
+}
+
+}
@@ -97,7 +97,7 @@ bool CaveHtmlLog::LogInit(bool noLogFile, const char* filePrefix, const char* he
 			"<body>\n");
 		fprintf(logFile, "<h1>%s</h1>\n", header);
 
-		delete fileName;
+		delete[] fileName;
 	}
 
 	return true;
@@ -322,7 +322,7 @@ extern "C" bool ReadPng(const char* filename, image_t *pImage)
 	png_read_image(pngPtr, rowPtrs);
 
 	// clean up
-	delete (png_bytep)rowPtrs;
+	delete[] rowPtrs;
 	//And don't forget to clean up the read and info structs !
 	png_destroy_read_struct(&pngPtr, &infoPtr, (png_infopp)0);
 
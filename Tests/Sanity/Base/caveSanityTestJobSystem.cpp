@@ -0,0 +1,175 @@
+/*
+Copyright (c) <2017> <Udo Lugauer>
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE
+*/
+
+/// @file caveSanityTestJobSystem.cpp
+///       Job system tests
+
+#include "caveSanityTestJobSystem.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+using namespace cave;
+
+/// worker threads of the test job system
+static const uint32_t g_testWorkerCount = 3;
+
+CaveSanityTestJobSystem::CaveSanityTestJobSystem()
+{
+
+}
+
+CaveSanityTestJobSystem::~CaveSanityTestJobSystem()
+{
+
+}
+
+bool CaveSanityTestJobSystem::IsSupported(RenderDevice* )
+{
+	return true;
+}
+
+bool CaveSanityTestJobSystem::TestDependencyOrder(JobSystem& jobSystem)
+{
+	// three stages, every stage depends on the counter of the previous one
+	for (uint32_t round = 0; round < 100; ++round)
+	{
+		const int32_t stageSize = 64;
+		std::atomic<int32_t> finished(0);
+		std::atomic<bool> ordered(true);
+		JobCounter first;
+		JobCounter second;
+		JobCounter third;
+
+		for (int32_t i = 0; i < stageSize; ++i)
+		{
+			jobSystem.Submit([&finished]()
+			{
+				finished.fetch_add(1);
+			}, &first);
+		}
+
+		for (int32_t i = 0; i < stageSize; ++i)
+		{
+			jobSystem.Submit([&finished, &ordered]()
+			{
+				if (finished.fetch_add(1) < stageSize)
+					ordered.store(false);
+			}, &second, &first);
+		}
+
+		jobSystem.Submit([&finished, &ordered]()
+		{
+			if (finished.load() != 2 * stageSize)
+				ordered.store(false);
+		}, &third, &second);
+
+		jobSystem.Wait(third);
+		if (!ordered.load() || !first.IsComplete() || !second.IsComplete() || third.GetValue() != 0)
+			return false;
+	}
+
+	return true;
+}
+
+bool CaveSanityTestJobSystem::TestExternalCounter(JobSystem& jobSystem)
+{
+	// work outside the job system (e.g. file reads) holds the dependency
+	JobCounter io;
+	JobCounter done;
+	std::atomic<bool> ran(false);
+	std::atomic<bool> early(false);
+
+	io.Increment();
+	jobSystem.Submit([&io, &ran, &early]()
+	{
+		if (!io.IsComplete())
+			early.store(true);
+		ran.store(true);
+	}, &done, &io);
+
+	if (done.IsComplete())
+		return false;
+
+	std::thread ioThread([&io]()
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		io.Decrement();
+	});
+
+	jobSystem.Wait(done);
+	ioThread.join();
+
+	// a counter which is complete already does not hold jobs back
+	JobCounter immediate;
+	jobSystem.Submit([]() {}, &immediate, &io);
+	jobSystem.Wait(immediate);
+
+	return ran.load() && !early.load() && done.IsComplete();
+}
+
+bool CaveSanityTestJobSystem::TestParallelFor(JobSystem& jobSystem)
+{
+	std::vector<uint32_t> visits(10000, 0);
+	jobSystem.ParallelFor(0, visits.size(), [&visits](size_t index)
+	{
+		visits[index]++;
+	}, 64);
+
+	for (size_t i = 0; i < visits.size(); ++i)
+	{
+		if (visits[i] != 1)
+			return false;
+	}
+
+	return true;
+}
+
+bool CaveSanityTestJobSystem::Run(RenderDevice* device, RenderCommandPool*, userContextData*)
+{
+	JobSystem jobSystem(device->GetEngineAllocator(), g_testWorkerCount);
+
+	bool success = true;
+	if (!TestDependencyOrder(jobSystem))
+	{
+		std::cerr << "CaveSanityTestJobSystem: dependent job ran before its dependency completed\n";
+		success = false;
+	}
+
+	if (!TestExternalCounter(jobSystem))
+	{
+		std::cerr << "CaveSanityTestJobSystem: job waiting on an external counter failed\n";
+		success = false;
+	}
+
+	if (!TestParallelFor(jobSystem))
+	{
+		std::cerr << "CaveSanityTestJobSystem: parallel for missed or repeated an index\n";
+		success = false;
+	}
+
+	return success;
+}
+
+void CaveSanityTestJobSystem::Cleanup(RenderDevice*, userContextData*)
+{
+
+}
+
+bool CaveSanityTestJobSystem::RunPerformance(RenderDevice*, userContextData*)
+{
+	return true;
+}
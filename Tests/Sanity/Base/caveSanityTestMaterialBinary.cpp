@@ -0,0 +1,244 @@
+/*
+Copyright (c) <2017> <Udo Lugauer>
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE
+*/
+
+/// @file caveSanityTestMaterialBinary.cpp
+///       Compiled material format tests
+
+#include "caveSanityTestMaterialBinary.h"
+
+#include <cstddef>
+#include <cstring>
+#include <string>
+
+using namespace cave;
+
+/// material asset using every field of the format
+static const char* g_testMaterialAsset =
+	"{"
+	"  \"material\": { \"name\": \"testMaterial\", \"values\": { \"opacity\": 0.25, \"diffuse\": [0.5, 0.75, 1.0] } },"
+	"  \"program\": {"
+	"    \"name\": \"testProgram\", \"language\": \"glsl\","
+	"    \"vertex\": { \"source\": \"shaders/test.vert\", \"entry\": \"main\","
+	"      \"constants\": [ { \"id\": 0, \"value\": 3 }, { \"id\": 1, \"value\": true } ] },"
+	"    \"fragment\": { \"source\": \"shaders/test.frag\", \"entry\": \"main\","
+	"      \"constants\": [ { \"id\": 2, \"value\": -0.5 } ] }"
+	"  }"
+	"}";
+
+/**
+* @brief Write a 32 bit value into a compiled material
+*
+* @param[in,out] binary	Compiled material
+* @param[in] offset		Byte offset of the value
+* @param[in] value		New value
+*/
+static void PatchValue(std::vector<uint8_t>& binary, size_t offset, uint32_t value)
+{
+	std::memcpy(binary.data() + offset, &value, sizeof(value));
+}
+
+CaveSanityTestMaterialBinary::CaveSanityTestMaterialBinary()
+{
+
+}
+
+CaveSanityTestMaterialBinary::~CaveSanityTestMaterialBinary()
+{
+
+}
+
+bool CaveSanityTestMaterialBinary::IsSupported(RenderDevice* )
+{
+	return true;
+}
+
+bool CaveSanityTestMaterialBinary::TestRoundTrip(const std::vector<uint8_t>& binary)
+{
+	MaterialBinary material;
+	if (!MaterialBinary::IsBinary(binary.data(), binary.size()) || !material.Open(binary.data(), binary.size()))
+		return false;
+
+	if (std::strcmp(material.GetName(), "testMaterial") != 0 || std::strcmp(material.GetProgramName(), "testProgram") != 0
+		|| std::strcmp(material.GetLanguage(), "glsl") != 0)
+		return false;
+
+	RenderMaterialDataStruct materialData;
+	material.GetMaterialData(materialData);
+	if (materialData._opacity != 0.25f || materialData._diffuse._x != 0.5f || materialData._diffuse._y != 0.75f
+		|| materialData._diffuse._z != 1.0f || materialData._ambient._w != 1.0f)
+		return false;
+
+	if (material.GetStageCount() != 2)
+		return false;
+
+	const MaterialBinaryStage& vertex = material.GetStage(0);
+	const MaterialBinaryStage& fragment = material.GetStage(1);
+	if (vertex._type != static_cast<uint32_t>(MaterialBinaryStageType::Vertex)
+		|| fragment._type != static_cast<uint32_t>(MaterialBinaryStageType::Fragment)
+		|| std::strcmp(material.GetString(vertex._sourceOffset), "shaders/test.vert") != 0
+		|| std::strcmp(material.GetString(fragment._sourceOffset), "shaders/test.frag") != 0)
+		return false;
+
+	// equal strings are stored once
+	if (vertex._entryOffset != fragment._entryOffset || std::strcmp(material.GetString(vertex._entryOffset), "main") != 0)
+		return false;
+
+	if (vertex._constantCount != 2 || fragment._constantCount != 1)
+		return false;
+
+	const MaterialBinaryConstant* vertexConstants = material.GetStageConstants(0);
+	const MaterialBinaryConstant* fragmentConstants = material.GetStageConstants(1);
+	float fragmentValue = 0.0f;
+	std::memcpy(&fragmentValue, &fragmentConstants[0]._value, sizeof(fragmentValue));
+
+	return vertexConstants[0]._id == 0 && vertexConstants[0]._value == 3
+		&& vertexConstants[1]._id == 1 && vertexConstants[1]._value == 1
+		&& fragmentConstants[0]._id == 2 && fragmentValue == -0.5f;
+}
+
+bool CaveSanityTestMaterialBinary::TestTruncated(const std::vector<uint8_t>& binary)
+{
+	// every prefix of the file must be rejected
+	for (size_t size = 0; size < binary.size(); ++size)
+	{
+		std::vector<uint8_t> truncated(binary.begin(), binary.begin() + size);
+		MaterialBinary material;
+		if (material.Open(truncated.data(), truncated.size()))
+			return false;
+	}
+
+	// trailing bytes are damage as well
+	std::vector<uint8_t> extended(binary);
+	extended.push_back(0);
+	MaterialBinary material;
+	return !material.Open(extended.data(), extended.size());
+}
+
+bool CaveSanityTestMaterialBinary::TestCorrupted(const std::vector<uint8_t>& binary)
+{
+	const size_t stagesOffset = sizeof(MaterialBinaryHeader) + sizeof(RenderMaterialDataStruct);
+	const size_t stringSize = binary.size() - stagesOffset - 2 * sizeof(MaterialBinaryStage) - 3 * sizeof(MaterialBinaryConstant);
+
+	struct Corruption
+	{
+		size_t _offset;		///< Byte offset of the patched value
+		uint32_t _value;	///< Patched value
+	};
+
+	const Corruption corruptions[] =
+	{
+		{ offsetof(MaterialBinaryHeader, _magic), 0x12345678 },
+		{ offsetof(MaterialBinaryHeader, _version), MaterialBinaryVersion + 1 },
+		{ offsetof(MaterialBinaryHeader, _stageCount), 3 },
+		{ offsetof(MaterialBinaryHeader, _stageCount), 0xffffffff },
+		{ offsetof(MaterialBinaryHeader, _stringSize), 0 },
+		{ offsetof(MaterialBinaryHeader, _stringSize), static_cast<uint32_t>(stringSize + 4) },
+		{ offsetof(MaterialBinaryHeader, _nameOffset), static_cast<uint32_t>(stringSize) },
+		{ offsetof(MaterialBinaryHeader, _programOffset), 0xffffffff },
+		{ offsetof(MaterialBinaryHeader, _languageOffset), static_cast<uint32_t>(stringSize + 100) },
+		{ offsetof(MaterialBinaryHeader, _constantCount), 2 },
+		{ offsetof(MaterialBinaryHeader, _constantCount), 0x80000000 },
+		{ stagesOffset + offsetof(MaterialBinaryStage, _type), 7 },
+		{ stagesOffset + offsetof(MaterialBinaryStage, _sourceOffset), static_cast<uint32_t>(stringSize) },
+		{ stagesOffset + sizeof(MaterialBinaryStage) + offsetof(MaterialBinaryStage, _entryOffset), 0xffffffff },
+		{ stagesOffset + offsetof(MaterialBinaryStage, _constantCount), 3 },
+		// the last byte terminates the string table
+		{ binary.size() - sizeof(uint32_t), 0x41414141 },
+	};
+
+	for (const Corruption& corruption : corruptions)
+	{
+		std::vector<uint8_t> damaged(binary);
+		PatchValue(damaged, corruption._offset, corruption._value);
+
+		MaterialBinary material;
+		if (material.Open(damaged.data(), damaged.size()))
+			return false;
+	}
+
+	return true;
+}
+
+bool CaveSanityTestMaterialBinary::TestInvalidAsset()
+{
+	const char* assets[] =
+	{
+		"{ \"material\": ",
+		"[ 1, 2 ]",
+		"{ \"material\": { \"name\": 5 } }",
+		"{ \"program\": { \"vertex\": { \"source\": \"a.vert\", \"constants\": { \"id\": 0 } } } }",
+		"{ \"program\": { \"vertex\": { \"source\": \"a.vert\", \"constants\": [ { \"id\": 0 } ] } } }",
+		"{ \"program\": { \"vertex\": { \"source\": \"a.vert\", \"constants\": [ { \"id\": 0, \"value\": \"x\" } ] } } }",
+		"{ \"program\": { \"vertex\": { \"source\": \"a.vert\", \"constants\": [ { \"id\": 0, \"value\": 1 }, { \"id\": 0, \"value\": 2 } ] } } }",
+		"{ \"program\": { \"vertex\": { \"source\": \"a.vert\", \"constants\": [ { \"id\": 0, \"value\": 5000000000 } ] } } }",
+	};
+
+	for (const char* asset : assets)
+	{
+		std::vector<uint8_t> out;
+		std::string error;
+		if (MaterialBinaryWriter::Compile(asset, std::strlen(asset), out, &error) || error.empty())
+			return false;
+	}
+
+	return true;
+}
+
+bool CaveSanityTestMaterialBinary::Run(RenderDevice*, RenderCommandPool*, userContextData*)
+{
+	std::vector<uint8_t> binary;
+	std::string error;
+	if (!MaterialBinaryWriter::Compile(g_testMaterialAsset, std::strlen(g_testMaterialAsset), binary, &error))
+	{
+		std::cerr << "CaveSanityTestMaterialBinary: compile failed " << error << "\n";
+		return false;
+	}
+
+	bool success = true;
+	if (!TestRoundTrip(binary))
+	{
+		std::cerr << "CaveSanityTestMaterialBinary: compiled material does not match the asset\n";
+		success = false;
+	}
+
+	if (!TestTruncated(binary))
+	{
+		std::cerr << "CaveSanityTestMaterialBinary: truncated material accepted\n";
+		success = false;
+	}
+
+	if (!TestCorrupted(binary))
+	{
+		std::cerr << "CaveSanityTestMaterialBinary: corrupted material accepted\n";
+		success = false;
+	}
+
+	if (!TestInvalidAsset())
+	{
+		std::cerr << "CaveSanityTestMaterialBinary: invalid asset compiled\n";
+		success = false;
+	}
+
+	return success;
+}
+
+void CaveSanityTestMaterialBinary::Cleanup(RenderDevice*, userContextData*)
+{
+
+}
+
+bool CaveSanityTestMaterialBinary::RunPerformance(RenderDevice*, userContextData*)
+{
+	return true;
+}
@@ -0,0 +1,48 @@
+/*
+Copyright (c) <2017> <Udo Lugauer>
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE
+*/
+#pragma once
+
+/// @file caveSanityTestMaterialBinary.h
+///       Compiled material format tests
+
+#include "../caveSanityTestBase.h"
+#include "Resource/materialBinary.h"
+
+/**
+* @brief Material binary round trip and rejection of damaged files
+*/
+class CaveSanityTestMaterialBinary : public CaveSanityTestBase
+{
+public:
+	/** constructor */
+	CaveSanityTestMaterialBinary();
+	/** destructor */
+	~CaveSanityTestMaterialBinary();
+
+	bool IsSupported(cave::RenderDevice *device);
+
+	bool IsImageCompareSupported(cave::RenderDevice*) { return false; }
+
+	bool Run(cave::RenderDevice *device, cave::RenderCommandPool* commandPool, userContextData* pUserData);
+
+	void Cleanup(cave::RenderDevice *device, userContextData* pUserData);
+
+	bool RunPerformance(cave::RenderDevice *device, userContextData* pContextData);
+
+private:
+	bool TestRoundTrip(const std::vector<uint8_t>& binary);
+	bool TestTruncated(const std::vector<uint8_t>& binary);
+	bool TestCorrupted(const std::vector<uint8_t>& binary);
+	bool TestInvalidAsset();
+};
@@ -0,0 +1,286 @@
+/*
+Copyright (c) <2017> <Udo Lugauer>
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE
+*/
+
+/// @file caveSanityTestMemoryAllocator.cpp
+///       Device memory sub-allocator tests
+
+#include "caveSanityTestMemoryAllocator.h"
+
+#include <chrono>
+#include <random>
+#include <vector>
+
+using namespace cave;
+
+/// live allocation of the churn tests
+struct TestAllocation
+{
+	uint32_t _handle;
+	uint64_t _offset;
+	uint64_t _size;
+	AllocatorTlsfKind _kind;
+};
+
+/// brute force check of a new allocation against all live ones
+static bool CheckAllocation(const std::vector<TestAllocation>& allocations, const TestAllocation& allocation, uint64_t granularity)
+{
+	for (const TestAllocation& other : allocations)
+	{
+		if (allocation._offset < other._offset + other._size && other._offset < allocation._offset + allocation._size)
+			return false;
+
+		if (granularity > 1 && allocation._kind != other._kind)
+		{
+			const TestAllocation& first = (other._offset < allocation._offset) ? other : allocation;
+			const TestAllocation& second = (other._offset < allocation._offset) ? allocation : other;
+			if (((first._offset + first._size - 1) & ~(granularity - 1)) == (second._offset & ~(granularity - 1)))
+				return false;
+		}
+	}
+
+	return true;
+}
+
+/// one minus the largest free range relative to all free space
+static float Fragmentation(const AllocatorTlsf& allocator)
+{
+	uint64_t freeSize = allocator.GetSize() - allocator.GetUsedSize();
+	if (freeSize == 0)
+		return 0.0f;
+
+	return 1.0f - float(allocator.GetLargestFreeRange()) / float(freeSize);
+}
+
+CaveSanityTestMemoryAllocator::CaveSanityTestMemoryAllocator()
+	: _randomSeed(1234)
+{
+
+}
+
+CaveSanityTestMemoryAllocator::~CaveSanityTestMemoryAllocator()
+{
+
+}
+
+bool CaveSanityTestMemoryAllocator::IsSupported(RenderDevice* )
+{
+	return true;
+}
+
+bool CaveSanityTestMemoryAllocator::TestMiddleFree()
+{
+	// fill the range, a freed range in the middle must be reused
+	const uint64_t size = 1024 * 1024;
+	AllocatorTlsf allocator(size);
+	uint32_t handles[16];
+	uint64_t offsets[16];
+	for (uint32_t i = 0; i < 16; ++i)
+	{
+		handles[i] = allocator.Allocate(size / 16, 256, AllocatorTlsfKind::Linear, offsets[i]);
+		if (handles[i] == AllocatorTlsf::InvalidHandle)
+			return false;
+	}
+
+	uint64_t offset = 0;
+	if (allocator.Allocate(256, 256, AllocatorTlsfKind::Linear, offset) != AllocatorTlsf::InvalidHandle)
+		return false;
+
+	allocator.Free(handles[7]);
+	handles[7] = allocator.Allocate(size / 16, 256, AllocatorTlsfKind::Linear, offset);
+	if (handles[7] == AllocatorTlsf::InvalidHandle || offset != offsets[7])
+		return false;
+
+	// neighbours must merge into one range again
+	allocator.Free(handles[6]);
+	allocator.Free(handles[8]);
+	allocator.Free(handles[7]);
+	if (allocator.GetFreeRangeCount() != 1 || allocator.GetLargestFreeRange() != 3 * size / 16)
+		return false;
+
+	for (uint32_t i = 0; i < 16; ++i)
+	{
+		if (i < 6 || i > 8)
+			allocator.Free(handles[i]);
+	}
+
+	return allocator.IsEmpty() && allocator.GetFreeRangeCount() == 1 && allocator.GetLargestFreeRange() == size;
+}
+
+bool CaveSanityTestMemoryAllocator::TestGranularity()
+{
+	// a buffer and an optimal image must not share a page
+	const uint64_t granularity = 4096;
+	AllocatorTlsf allocator(1024 * 1024, granularity);
+	uint64_t bufferOffset = 0;
+	uint64_t imageOffset = 0;
+	uint64_t secondBufferOffset = 0;
+	allocator.Allocate(100, 16, AllocatorTlsfKind::Linear, bufferOffset);
+	allocator.Allocate(100, 16, AllocatorTlsfKind::Optimal, imageOffset);
+	allocator.Allocate(100, 16, AllocatorTlsfKind::Linear, secondBufferOffset);
+
+	return bufferOffset == 0 && imageOffset == granularity && secondBufferOffset == 2 * granularity;
+}
+
+bool CaveSanityTestMemoryAllocator::TestFallbackClasses()
+{
+	// the only free range is larger than the request but below the class searched with alignment padding
+	AllocatorTlsf allocator(16 * 1024);
+	uint64_t offsets[3];
+	uint32_t first = allocator.Allocate(4096, 256, AllocatorTlsfKind::Linear, offsets[0]);
+	uint32_t middle = allocator.Allocate(6144, 256, AllocatorTlsfKind::Linear, offsets[1]);
+	uint32_t last = allocator.Allocate(6144, 256, AllocatorTlsfKind::Linear, offsets[2]);
+	if (first == AllocatorTlsf::InvalidHandle || middle == AllocatorTlsf::InvalidHandle || last == AllocatorTlsf::InvalidHandle)
+		return false;
+
+	allocator.Free(middle);
+	uint64_t offset = 0;
+	middle = allocator.Allocate(4096, 4096, AllocatorTlsfKind::Linear, offset);
+
+	return middle != AllocatorTlsf::InvalidHandle && offset == offsets[1];
+}
+
+bool CaveSanityTestMemoryAllocator::TestRandomChurn(uint64_t granularity)
+{
+	const uint64_t size = 64 * 1024 * 1024;
+	AllocatorTlsf allocator(size, granularity);
+	std::vector<TestAllocation> allocations;
+	std::mt19937 generator(_randomSeed);
+	std::uniform_int_distribution<uint32_t> action(0, 99);
+	std::uniform_int_distribution<uint64_t> smallSize(1, 64 * 1024);
+	std::uniform_int_distribution<uint64_t> largeSize(64 * 1024, 4 * 1024 * 1024);
+	std::uniform_int_distribution<uint32_t> alignmentShift(0, 12);
+
+	for (uint32_t i = 0; i < 50000; ++i)
+	{
+		if (allocations.empty() || action(generator) < 55)
+		{
+			TestAllocation allocation;
+			allocation._size = (action(generator) < 10) ? largeSize(generator) : smallSize(generator);
+			allocation._kind = (action(generator) < 30) ? AllocatorTlsfKind::Optimal : AllocatorTlsfKind::Linear;
+			uint64_t alignment = 1ull << alignmentShift(generator);
+			allocation._handle = allocator.Allocate(allocation._size, alignment, allocation._kind, allocation._offset);
+			if (allocation._handle == AllocatorTlsf::InvalidHandle)
+				continue;
+
+			if ((allocation._offset & (alignment - 1)) || allocation._offset + allocation._size > size
+				|| !CheckAllocation(allocations, allocation, granularity))
+			{
+				std::cerr << "CaveSanityTestMemoryAllocator: invalid allocation\n";
+				return false;
+			}
+
+			allocations.push_back(allocation);
+		}
+		else
+		{
+			size_t index = generator() % allocations.size();
+			allocator.Free(allocations[index]._handle);
+			allocations[index] = allocations.back();
+			allocations.pop_back();
+		}
+	}
+
+	uint64_t usedSize = 0;
+	for (const TestAllocation& allocation : allocations)
+		usedSize += allocation._size;
+
+	if (usedSize != allocator.GetUsedSize() || allocations.size() != allocator.GetAllocationCount())
+		return false;
+
+	// after releasing everything the range must be in one piece again
+	for (const TestAllocation& allocation : allocations)
+		allocator.Free(allocation._handle);
+
+	return allocator.IsEmpty() && allocator.GetFreeRangeCount() == 1 && allocator.GetLargestFreeRange() == size;
+}
+
+bool CaveSanityTestMemoryAllocator::Run(RenderDevice*, RenderCommandPool*, userContextData*)
+{
+	bool success = true;
+	if (!TestMiddleFree())
+	{
+		std::cerr << "CaveSanityTestMemoryAllocator: freed range not reused or not merged\n";
+		success = false;
+	}
+
+	if (!TestGranularity())
+	{
+		std::cerr << "CaveSanityTestMemoryAllocator: linear and optimal resources share a page\n";
+		success = false;
+	}
+
+	if (!TestFallbackClasses())
+	{
+		std::cerr << "CaveSanityTestMemoryAllocator: fitting range below the search class not found\n";
+		success = false;
+	}
+
+	if (!TestRandomChurn(1) || !TestRandomChurn(1024))
+	{
+		std::cerr << "CaveSanityTestMemoryAllocator: random churn failed\n";
+		success = false;
+	}
+
+	return success;
+}
+
+void CaveSanityTestMemoryAllocator::Cleanup(RenderDevice*, userContextData*)
+{
+
+}
+
+bool CaveSanityTestMemoryAllocator::RunPerformance(RenderDevice*, userContextData*)
+{
+	typedef std::chrono::high_resolution_clock clock;
+	const uint32_t count = 1000000;
+
+	// steady state: about half the range in use, sizes typical for vertex and uniform buffers
+	AllocatorTlsf allocator(256 * 1024 * 1024, 1024);
+	std::vector<uint32_t> handles;
+	std::mt19937 generator(_randomSeed);
+	std::uniform_int_distribution<uint64_t> allocationSize(256, 256 * 1024);
+	uint32_t failed = 0;
+
+	clock::time_point start = clock::now();
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		if (handles.size() < 1000 || ((generator() & 1) && handles.size() < 1100))
+		{
+			uint64_t offset;
+			uint32_t handle = allocator.Allocate(allocationSize(generator), 256, AllocatorTlsfKind::Linear, offset);
+			if (handle != AllocatorTlsf::InvalidHandle)
+				handles.push_back(handle);
+			else
+				failed++;
+		}
+		else
+		{
+			size_t index = generator() % handles.size();
+			allocator.Free(handles[index]);
+			handles[index] = handles.back();
+			handles.pop_back();
+		}
+	}
+	double time = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+
+	std::cerr << "AllocatorTlsf " << count << " operations: " << time << "ms"
+			  << ", live " << allocator.GetAllocationCount() << ", failed " << failed
+			  << ", free ranges " << allocator.GetFreeRangeCount()
+			  << ", fragmentation " << Fragmentation(allocator) << "\n";
+
+	for (uint32_t handle : handles)
+		allocator.Free(handle);
+
+	return allocator.IsEmpty();
+}
@@ -0,0 +1,230 @@
+/*
+Copyright (c) <2017> <Udo Lugauer>
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE
+*/
+
+/// @file caveSanityTestResourceCache.cpp
+///       Concurrent resource cache tests
+
+#include "caveSanityTestResourceCache.h"
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace cave;
+
+/// threads racing for the same keys
+static const uint32_t g_testThreadCount = 4;
+/// enough keys to grow every shard several times
+static const uint32_t g_testKeyCount = 512;
+
+/// resource name of a test key
+static std::string TestKey(uint32_t index)
+{
+	return "resource" + std::to_string(index);
+}
+
+CaveSanityTestResourceCache::CaveSanityTestResourceCache()
+{
+
+}
+
+CaveSanityTestResourceCache::~CaveSanityTestResourceCache()
+{
+
+}
+
+bool CaveSanityTestResourceCache::IsSupported(RenderDevice* )
+{
+	return true;
+}
+
+bool CaveSanityTestResourceCache::TestReservePublish(std::shared_ptr<AllocatorBase> allocator)
+{
+	ResourceCache<uint32_t> cache(allocator);
+	std::vector<uint32_t> values(g_testKeyCount);
+	std::vector<std::atomic<uint32_t>> owners(g_testKeyCount);
+	std::atomic<bool> wrongValue(false);
+
+	for (uint32_t i = 0; i < g_testKeyCount; ++i)
+	{
+		values[i] = i;
+		owners[i].store(0);
+	}
+
+	// every thread claims every key, the losers wait for the winner
+	std::vector<std::thread> threads;
+	for (uint32_t t = 0; t < g_testThreadCount; ++t)
+	{
+		threads.push_back(std::thread([&cache, &values, &owners, &wrongValue, t]()
+		{
+			for (uint32_t n = 0; n < g_testKeyCount; ++n)
+			{
+				// threads walk the keys with different offsets
+				uint32_t i = (n + t * (g_testKeyCount / g_testThreadCount)) % g_testKeyCount;
+				std::string key = TestKey(i);
+				if (cache.Reserve(key))
+				{
+					owners[i].fetch_add(1);
+					cache.Publish(key, &values[i], ResourceCacheState::Ready);
+				}
+				else if (cache.Wait(key) != &values[i])
+				{
+					wrongValue.store(true);
+				}
+			}
+		}));
+	}
+
+	for (std::thread& thread : threads)
+		thread.join();
+
+	if (wrongValue.load())
+		return false;
+
+	for (uint32_t i = 0; i < g_testKeyCount; ++i)
+	{
+		if (owners[i].load() != 1 || cache.Find(TestKey(i)) != &values[i])
+			return false;
+	}
+
+	return true;
+}
+
+bool CaveSanityTestResourceCache::TestWaitResolution(std::shared_ptr<AllocatorBase> allocator)
+{
+	ResourceCache<uint32_t> cache(allocator);
+	uint32_t value = 7;
+	const char* keys[] = { "published", "failed", "removed" };
+	for (const char* key : keys)
+	{
+		if (!cache.Reserve(key))
+			return false;
+	}
+
+	// a pending key is not handed out twice
+	if (cache.Reserve("failed") || cache.Find("published") != nullptr)
+		return false;
+
+	std::atomic<uint32_t> published(0);
+	std::atomic<uint32_t> empty(0);
+	std::vector<std::thread> threads;
+	for (uint32_t t = 0; t < g_testThreadCount; ++t)
+	{
+		threads.push_back(std::thread([&cache, &value, &published, &empty, &keys]()
+		{
+			for (const char* key : keys)
+			{
+				uint32_t* result = cache.Wait(key);
+				if (result == &value)
+					published.fetch_add(1);
+				else if (!result)
+					empty.fetch_add(1);
+			}
+		}));
+	}
+
+	// give the waiters time to go to sleep
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	cache.Publish("published", &value, ResourceCacheState::Ready);
+	cache.Publish("failed", nullptr, ResourceCacheState::Failed);
+	cache.Remove("removed");
+
+	for (std::thread& thread : threads)
+		thread.join();
+
+	if (published.load() != g_testThreadCount || empty.load() != 2 * g_testThreadCount)
+		return false;
+
+	// removed keys can be reserved again, failed ones stay until removed
+	return cache.Reserve("removed") && !cache.Reserve("failed");
+}
+
+bool CaveSanityTestResourceCache::TestLookupWhileGrowing(std::shared_ptr<AllocatorBase> allocator)
+{
+	ResourceCache<uint32_t> cache(allocator);
+	std::vector<uint32_t> values(g_testKeyCount);
+	for (uint32_t i = 0; i < g_testKeyCount; ++i)
+		values[i] = i;
+
+	// readers look up the keys inserted so far while the writer grows the tables
+	std::atomic<uint32_t> inserted(0);
+	std::atomic<bool> missing(false);
+	std::vector<std::thread> readers;
+	for (uint32_t t = 0; t < g_testThreadCount; ++t)
+	{
+		readers.push_back(std::thread([&cache, &values, &inserted, &missing]()
+		{
+			uint32_t count = 0;
+			while (count < g_testKeyCount)
+			{
+				count = inserted.load(std::memory_order_acquire);
+				for (uint32_t i = 0; i < count; ++i)
+				{
+					if (cache.Find(TestKey(i)) != &values[i])
+						missing.store(true);
+				}
+			}
+		}));
+	}
+
+	for (uint32_t i = 0; i < g_testKeyCount; ++i)
+	{
+		if (!cache.Insert(TestKey(i), &values[i]))
+			return false;
+		inserted.store(i + 1, std::memory_order_release);
+	}
+
+	for (std::thread& thread : readers)
+		thread.join();
+
+	return !missing.load();
+}
+
+bool CaveSanityTestResourceCache::Run(RenderDevice* device, RenderCommandPool*, userContextData*)
+{
+	std::shared_ptr<AllocatorBase> allocator = device->GetEngineAllocator();
+
+	bool success = true;
+	if (!TestReservePublish(allocator))
+	{
+		std::cerr << "CaveSanityTestResourceCache: a key was reserved twice or waiters got a wrong value\n";
+		success = false;
+	}
+
+	if (!TestWaitResolution(allocator))
+	{
+		std::cerr << "CaveSanityTestResourceCache: waiters not released by publish, fail or remove\n";
+		success = false;
+	}
+
+	if (!TestLookupWhileGrowing(allocator))
+	{
+		std::cerr << "CaveSanityTestResourceCache: lookup missed an entry while the table grew\n";
+		success = false;
+	}
+
+	return success;
+}
+
+void CaveSanityTestResourceCache::Cleanup(RenderDevice*, userContextData*)
+{
+
+}
+
+bool CaveSanityTestResourceCache::RunPerformance(RenderDevice*, userContextData*)
+{
+	return true;
+}
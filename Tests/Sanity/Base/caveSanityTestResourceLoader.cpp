@@ -0,0 +1,313 @@
+/*
+Copyright (c) <2017> <Udo Lugauer>
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE
+*/
+
+/// @file caveSanityTestResourceLoader.cpp
+///       Resource loader tests
+
+#include "caveSanityTestResourceLoader.h"
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace cave;
+
+/// worker threads of the test job system
+static const uint32_t g_testWorkerCount = 2;
+
+/**
+* @brief Holds the only I/O thread of a loader until it is opened
+*/
+class TestGate
+{
+public:
+	TestGate() : _open(false), _entered(false) {}
+
+	/** @brief Called by the read function, blocks until Open */
+	void Pass()
+	{
+		_entered.store(true);
+		while (!_open.load())
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+
+	/** @brief Wait until the I/O thread is blocked */
+	void WaitEntered()
+	{
+		while (!_entered.load())
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+
+	void Open() { _open.store(true); }
+
+private:
+	std::atomic<bool> _open;
+	std::atomic<bool> _entered;
+};
+
+/**
+* @brief Counts how the tracked requests finished
+*/
+class TestTracker
+{
+public:
+	TestTracker() : _ready(0), _notReady(0) {}
+
+	/** @brief Track a request which has not finished yet */
+	bool Track(ResourceLoader& loader, const std::string& key)
+	{
+		return loader.AddContinuation(key, [this](ResourceLoadState state)
+		{
+			if (state == ResourceLoadState::Ready)
+				_ready.fetch_add(1);
+			else
+				_notReady.fetch_add(1);
+		}, &_counter);
+	}
+
+	/** @brief Wait until all tracked requests finished */
+	void Wait(JobSystem& jobSystem) { jobSystem.Wait(_counter); }
+
+	uint32_t GetReady() const { return _ready.load(); }
+	uint32_t GetNotReady() const { return _notReady.load(); }
+
+private:
+	JobCounter _counter;
+	std::atomic<uint32_t> _ready;
+	std::atomic<uint32_t> _notReady;
+};
+
+/// read function filling a small buffer
+static bool ReadTestData(ResourceLoadData& data)
+{
+	data.GetBuffer().assign(64, 'c');
+	return true;
+}
+
+/// occupies the only I/O thread of the loader until the gate opens
+static void BlockLoader(ResourceLoader& loader, const std::string& key, TestGate& gate, const ResourceDecodeFunction& decode)
+{
+	loader.Request(key, ResourceLoadPriority::Visible, [&gate](ResourceLoadData& data)
+	{
+		gate.Pass();
+		return ReadTestData(data);
+	}, decode);
+	gate.WaitEntered();
+}
+
+CaveSanityTestResourceLoader::CaveSanityTestResourceLoader()
+{
+
+}
+
+CaveSanityTestResourceLoader::~CaveSanityTestResourceLoader()
+{
+
+}
+
+bool CaveSanityTestResourceLoader::IsSupported(RenderDevice* )
+{
+	return true;
+}
+
+bool CaveSanityTestResourceLoader::TestPriorityOrder(std::shared_ptr<AllocatorBase> allocator, JobSystem& jobSystem)
+{
+	// one I/O thread and one decode slot make the order deterministic
+	ResourceLoader loader(allocator, &jobSystem, 1, 1);
+	TestGate gate;
+	TestTracker tracker;
+	std::mutex orderMutex;
+	std::vector<std::string> readOrder;
+
+	ResourceDecodeFunction decode = [](ResourceLoadData& data) { return data.GetSize() == 64; };
+	auto read = [&orderMutex, &readOrder](const std::string& key) -> ResourceReadFunction
+	{
+		return [&orderMutex, &readOrder, key](ResourceLoadData& data)
+		{
+			std::lock_guard<std::mutex> lock(orderMutex);
+			readOrder.push_back(key);
+			return ReadTestData(data);
+		};
+	};
+
+	BlockLoader(loader, "blocker", gate, decode);
+
+	if (!loader.Request("background", ResourceLoadPriority::Background, read("background"), decode)
+		|| !loader.Request("prefetch", ResourceLoadPriority::Prefetch, read("prefetch"), decode)
+		|| !loader.Request("visible", ResourceLoadPriority::Visible, read("visible"), decode)
+		|| !loader.Request("raised", ResourceLoadPriority::Background, read("raised"), decode))
+		return false;
+
+	// requesting a queued key merges and raises it above the other background load
+	if (loader.Request("raised", ResourceLoadPriority::Prefetch, read("raised"), decode))
+		return false;
+
+	const char* keys[] = { "blocker", "background", "prefetch", "visible", "raised" };
+	for (const char* key : keys)
+	{
+		if (!tracker.Track(loader, key))
+			return false;
+	}
+
+	gate.Open();
+	tracker.Wait(jobSystem);
+	if (tracker.GetReady() != 5)
+		return false;
+
+	const char* expected[] = { "visible", "prefetch", "raised", "background" };
+	if (readOrder.size() != 4)
+		return false;
+
+	for (size_t i = 0; i < readOrder.size(); ++i)
+	{
+		if (readOrder[i] != expected[i])
+			return false;
+	}
+
+	return true;
+}
+
+bool CaveSanityTestResourceLoader::TestCancelRequeue(std::shared_ptr<AllocatorBase> allocator, JobSystem& jobSystem)
+{
+	ResourceLoader loader(allocator, &jobSystem, 1, 1);
+	TestGate gate;
+	TestTracker tracker;
+	std::atomic<uint32_t> decodes(0);
+	ResourceDecodeFunction decode = [&decodes](ResourceLoadData&)
+	{
+		decodes.fetch_add(1);
+		return true;
+	};
+
+	BlockLoader(loader, "blocker", gate, decode);
+
+	loader.Request("single", ResourceLoadPriority::Visible, ReadTestData, decode);
+	loader.Request("stale0", ResourceLoadPriority::Background, ReadTestData, decode);
+	loader.Request("stale1", ResourceLoadPriority::Background, ReadTestData, decode);
+	loader.Request("kept", ResourceLoadPriority::Prefetch, ReadTestData, decode);
+	if (!tracker.Track(loader, "blocker") || !tracker.Track(loader, "kept"))
+		return false;
+
+	// the request being read is cancelled once its read finished
+	if (!loader.Cancel("single") || !loader.Cancel("blocker") || loader.CancelPriority(ResourceLoadPriority::Background) != 2)
+		return false;
+
+	// nobody references the cancelled queued requests anymore
+	if (loader.GetState("single") != ResourceLoadState::Unknown || loader.GetState("stale0") != ResourceLoadState::Unknown)
+		return false;
+
+	gate.Open();
+	tracker.Wait(jobSystem);
+
+	// only the kept request was decoded
+	if (tracker.GetReady() != 1 || tracker.GetNotReady() != 1 || decodes.load() != 1)
+		return false;
+
+	// cancelled and finished keys are loaded again
+	TestGate requeueGate;
+	TestTracker requeueTracker;
+	BlockLoader(loader, "requeueBlocker", requeueGate, decode);
+	if (!loader.Request("single", ResourceLoadPriority::Visible, ReadTestData, decode)
+		|| !loader.Request("kept", ResourceLoadPriority::Visible, ReadTestData, decode)
+		|| !requeueTracker.Track(loader, "single") || !requeueTracker.Track(loader, "kept"))
+		return false;
+
+	requeueGate.Open();
+	requeueTracker.Wait(jobSystem);
+	if (requeueTracker.GetReady() != 2)
+		return false;
+
+	ResourceLoaderStats stats;
+	loader.GetStats(stats);
+	return stats._cancelled == 4 && stats._completed == 4;
+}
+
+bool CaveSanityTestResourceLoader::TestContinuation(std::shared_ptr<AllocatorBase> allocator, JobSystem& jobSystem)
+{
+	ResourceLoader loader(allocator, &jobSystem, 1, 1);
+	TestGate gate;
+	JobCounter continuations;
+	std::atomic<uint32_t> readyCount(0);
+	std::atomic<bool> early(false);
+	std::atomic<bool> decoded(false);
+
+	BlockLoader(loader, "file", gate, [&decoded](ResourceLoadData&)
+	{
+		decoded.store(true);
+		return true;
+	});
+
+	// continuations run after the decode and see the final state
+	for (uint32_t i = 0; i < 4; ++i)
+	{
+		bool added = loader.AddContinuation("file", [&readyCount, &early, &decoded](ResourceLoadState state)
+		{
+			if (!decoded.load())
+				early.store(true);
+			if (state == ResourceLoadState::Ready)
+				readyCount.fetch_add(1);
+		}, &continuations);
+
+		if (!added)
+			return false;
+	}
+
+	if (continuations.IsComplete())
+		return false;
+
+	gate.Open();
+	jobSystem.Wait(continuations);
+
+	return readyCount.load() == 4 && !early.load();
+}
+
+bool CaveSanityTestResourceLoader::Run(RenderDevice* device, RenderCommandPool*, userContextData*)
+{
+	std::shared_ptr<AllocatorBase> allocator = device->GetEngineAllocator();
+	JobSystem jobSystem(allocator, g_testWorkerCount);
+
+	bool success = true;
+	if (!TestPriorityOrder(allocator, jobSystem))
+	{
+		std::cerr << "CaveSanityTestResourceLoader: requests not served in priority order\n";
+		success = false;
+	}
+
+	if (!TestCancelRequeue(allocator, jobSystem))
+	{
+		std::cerr << "CaveSanityTestResourceLoader: cancel or requeue failed\n";
+		success = false;
+	}
+
+	if (!TestContinuation(allocator, jobSystem))
+	{
+		std::cerr << "CaveSanityTestResourceLoader: continuation did not run after the request finished\n";
+		success = false;
+	}
+
+	return success;
+}
+
+void CaveSanityTestResourceLoader::Cleanup(RenderDevice*, userContextData*)
+{
+
+}
+
+bool CaveSanityTestResourceLoader::RunPerformance(RenderDevice*, userContextData*)
+{
+	return true;
+}
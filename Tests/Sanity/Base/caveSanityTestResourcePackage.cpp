@@ -0,0 +1,198 @@
+/*
+Copyright (c) <2017> <Udo Lugauer>
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE
+*/
+
+/// @file caveSanityTestResourcePackage.cpp
+///       Resource package tests
+
+#include "caveSanityTestResourcePackage.h"
+#include "Resource/resourceLoader.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+using namespace cave;
+
+/// package written by the test
+static const char* g_testPackage = "caveSanityTest.cavepak";
+/// damaged copy of the test package
+static const char* g_testDamagedPackage = "caveSanityTestDamaged.cavepak";
+
+/// compare the content of an entry
+static bool CheckEntry(const ResourcePackage& package, const ResourcePackageEntry* entry, const std::vector<char>& expected)
+{
+	if (!entry || entry->_size != expected.size())
+		return false;
+
+	ResourceLoadData data;
+	if (!package.Read(*entry, data) || data.GetSize() != expected.size())
+		return false;
+
+	return expected.empty() || memcmp(data.GetData(), expected.data(), expected.size()) == 0;
+}
+
+CaveSanityTestResourcePackage::CaveSanityTestResourcePackage()
+{
+
+}
+
+CaveSanityTestResourcePackage::~CaveSanityTestResourcePackage()
+{
+
+}
+
+bool CaveSanityTestResourcePackage::IsSupported(RenderDevice* )
+{
+	return true;
+}
+
+bool CaveSanityTestResourcePackage::WriteFile(const char* path, const std::vector<char>& content)
+{
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	if (!file)
+		return false;
+
+	file.write(content.data(), content.size());
+	return file.good();
+}
+
+bool CaveSanityTestResourcePackage::ReadFile(const char* path, std::vector<char>& content)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file)
+		return false;
+
+	content.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	return true;
+}
+
+bool CaveSanityTestResourcePackage::TestRoundTrip()
+{
+	// one entry compresses well, one doesn't and is stored as is
+	std::vector<char> shader(16 * 1024);
+	for (size_t i = 0; i < shader.size(); i++)
+		shader[i] = "void main() {}\n"[i % 15];
+
+	std::vector<char> image(1000);
+	uint32_t random = 1234;
+	for (size_t i = 0; i < image.size(); i++)
+	{
+		random = random * 1664525u + 1013904223u;
+		image[i] = static_cast<char>(random >> 24);
+	}
+
+	ResourcePackageWriter writer;
+	if (!writer.Add("Shaders/test.vert", shader.data(), shader.size(), true)
+		|| !writer.Add("Images\\test.raw", image.data(), image.size(), true))
+		return false;
+
+	// same path after normalization
+	if (writer.Add("./Shaders/test.vert", shader.data(), shader.size(), false))
+		return false;
+
+	if (!writer.Write(g_testPackage))
+		return false;
+
+	ResourcePackage package;
+	if (!package.Open(g_testPackage) || package.GetEntryCount() != 2)
+		return false;
+
+	const ResourcePackageEntry* shaderEntry = package.Find("Shaders/", "test.vert");
+	const ResourcePackageEntry* imageEntry = package.Find(ResourcePackageHash::Hash("Images/test.raw"), "Images/test.raw");
+	if (!shaderEntry || !imageEntry
+		|| shaderEntry->_flags != static_cast<uint32_t>(ResourcePackageEntryFlags::Zlib)
+		|| imageEntry->_flags != static_cast<uint32_t>(ResourcePackageEntryFlags::Stored)
+		|| strcmp(package.GetPath(*imageEntry), "Images/test.raw") != 0)
+		return false;
+
+	if (!CheckEntry(package, shaderEntry, shader) || !CheckEntry(package, imageEntry, image))
+		return false;
+
+	// a file name is not found under another search path
+	return package.Find("Images/", "test.vert") == nullptr;
+}
+
+bool CaveSanityTestResourcePackage::TestCorruptedHeader()
+{
+	std::vector<char> content;
+	if (!ReadFile(g_testPackage, content) || content.size() < sizeof(ResourcePackageHeader))
+		return false;
+
+	ResourcePackage package;
+	// wrong magic, wrong version, table of contents and strings outside the file, truncated header
+	for (uint32_t i = 0; i < 5; i++)
+	{
+		std::vector<char> damaged(content);
+		ResourcePackageHeader* header = reinterpret_cast<ResourcePackageHeader*>(damaged.data());
+		switch (i)
+		{
+		case 0:
+			header->_magic ^= 0xff;
+			break;
+		case 1:
+			header->_version = ResourcePackageVersion + 1;
+			break;
+		case 2:
+			header->_entryCount = 0x10000000;
+			break;
+		case 3:
+			header->_stringOffset = damaged.size() + 1;
+			break;
+		default:
+			damaged.resize(sizeof(ResourcePackageHeader) - 1);
+			break;
+		}
+
+		if (!WriteFile(g_testDamagedPackage, damaged))
+			return false;
+
+		if (package.Open(g_testDamagedPackage))
+		{
+			std::cerr << "CaveSanityTestResourcePackage: damaged package " << i << " accepted\n";
+			return false;
+		}
+	}
+
+	// the intact package must still open
+	return package.Open(g_testPackage);
+}
+
+bool CaveSanityTestResourcePackage::Run(RenderDevice*, RenderCommandPool*, userContextData*)
+{
+	bool success = true;
+	if (!TestRoundTrip())
+	{
+		std::cerr << "CaveSanityTestResourcePackage: package content differs after reading it back\n";
+		success = false;
+	}
+	else if (!TestCorruptedHeader())
+	{
+		std::cerr << "CaveSanityTestResourcePackage: corrupted header test failed\n";
+		success = false;
+	}
+
+	return success;
+}
+
+void CaveSanityTestResourcePackage::Cleanup(RenderDevice*, userContextData*)
+{
+	std::remove(g_testPackage);
+	std::remove(g_testDamagedPackage);
+}
+
+bool CaveSanityTestResourcePackage::RunPerformance(RenderDevice*, userContextData*)
+{
+	return true;
+}
@@ -0,0 +1,357 @@
+/*
+Copyright (c) <2017> <Udo Lugauer>
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE
+*/
+
+/// @file caveSanityTestSceneBvh.cpp
+///       Scene bounding volume hierarchy tests
+
+#include "caveSanityTestSceneBvh.h"
+
+#include "engineInstance.h"
+#include "engineError.h"
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+
+using namespace cave;
+
+/// brute force reference tests on the fat bounds of a proxy
+static bool BruteForceAabb(const SceneAabb& box, const SceneAabb& query)
+{
+	return box.Overlaps(query);
+}
+
+static bool BruteForceSphere(const SceneAabb& box, const Vector3f& center, float radius)
+{
+	float dx = center._x - (std::min)((std::max)(center._x, box._min._x), box._max._x);
+	float dy = center._y - (std::min)((std::max)(center._y, box._min._y), box._max._y);
+	float dz = center._z - (std::min)((std::max)(center._z, box._min._z), box._max._z);
+	return (dx * dx + dy * dy + dz * dz) <= radius * radius;
+}
+
+static bool BruteForceFrustum(const SceneAabb& box, const SceneFrustum& frustum)
+{
+	for (uint32_t i = 0; i < 6; ++i)
+	{
+		const Vector3f& n = frustum._normal[i];
+		Vector3f p(n._x >= 0.0f ? box._max._x : box._min._x, n._y >= 0.0f ? box._max._y : box._min._y, n._z >= 0.0f ? box._max._z : box._min._z);
+		if (DotProduct(n, p) + frustum._distance[i] < 0.0f)
+			return false;
+	}
+
+	return true;
+}
+
+static bool BruteForceRay(const SceneAabb& box, const SceneRay& ray, float maxDistance)
+{
+	float tEnter = 0.0f;
+	float tExit = maxDistance;
+	const float origin[3] = { ray._origin._x, ray._origin._y, ray._origin._z };
+	const float dir[3] = { ray._direction._x, ray._direction._y, ray._direction._z };
+	const float boxMin[3] = { box._min._x, box._min._y, box._min._z };
+	const float boxMax[3] = { box._max._x, box._max._y, box._max._z };
+	for (uint32_t i = 0; i < 3; ++i)
+	{
+		float t1 = (boxMin[i] - origin[i]) / dir[i];
+		float t2 = (boxMax[i] - origin[i]) / dir[i];
+		tEnter = (std::max)(tEnter, (std::min)(t1, t2));
+		tExit = (std::min)(tExit, (std::max)(t1, t2));
+	}
+
+	return tEnter <= tExit;
+}
+
+/// frustum looking down +z from the world origin
+static SceneFrustum CreateFrustum(float worldSize)
+{
+	Vector3f eye(worldSize * 0.5f, worldSize * 0.5f, -worldSize * 0.25f);
+	Vector3f at(worldSize * 0.5f, worldSize * 0.5f, worldSize);
+	Vector3f up(0.0f, 1.0f, 0.0f);
+	Matrix4f view = LookAtMatrixLH(eye, at, up);
+	Matrix4f projection = PerspectiveLH(1.0f, 1.0f, 1.0f, worldSize);
+
+	SceneFrustum frustum;
+	frustum.SetFromMatrix(Multiply(projection, view));
+
+	return frustum;
+}
+
+CaveSanityTestSceneBvh::CaveSanityTestSceneBvh()
+	: _randomSeed(1234)
+{
+
+}
+
+CaveSanityTestSceneBvh::~CaveSanityTestSceneBvh()
+{
+
+}
+
+bool CaveSanityTestSceneBvh::IsSupported(RenderDevice* )
+{
+	return true;
+}
+
+void CaveSanityTestSceneBvh::CreateBounds(uint32_t count, float worldSize, caveVector<SceneAabb>& bounds)
+{
+	std::mt19937 generator(_randomSeed);
+	std::uniform_real_distribution<float> position(0.0f, worldSize);
+	std::uniform_real_distribution<float> extent(0.1f, 2.0f);
+
+	bounds.Reserve(count);
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		Vector3f center(position(generator), position(generator), position(generator));
+		Vector3f halfSize(extent(generator), extent(generator), extent(generator));
+		bounds.Push(SceneAabb(center - halfSize, center + halfSize));
+	}
+}
+
+bool CaveSanityTestSceneBvh::CompareResults(caveVector<int32_t>& bvhResults, caveVector<int32_t>& bruteResults)
+{
+	if (bvhResults.Size() != bruteResults.Size())
+		return false;
+
+	std::sort(bvhResults.Begin(), bvhResults.End());
+	std::sort(bruteResults.Begin(), bruteResults.End());
+
+	for (size_t i = 0; i < bvhResults.Size(); ++i)
+	{
+		if (bvhResults[i] != bruteResults[i])
+			return false;
+	}
+
+	return true;
+}
+
+bool CaveSanityTestSceneBvh::Run(RenderDevice *device, RenderCommandPool*, userContextData*)
+{
+	const uint32_t objectCount = 10000;
+	const float worldSize = 500.0f;
+
+	std::shared_ptr<AllocatorBase> allocator = device->GetEngineAllocator();
+	caveVector<SceneAabb> bounds(allocator);
+	caveVector<int32_t> proxies(allocator);
+	CreateBounds(objectCount, worldSize, bounds);
+
+	SceneBvh bvh(allocator);
+	for (uint32_t i = 0; i < objectCount; ++i)
+		proxies.Push(bvh.CreateProxy(bounds[i], nullptr));
+
+	if (!bvh.Validate())
+	{
+		std::cerr << "CaveSanityTestSceneBvh: invalid tree after insertion\n";
+		return false;
+	}
+
+	// move some objects, destroy some and rebuild
+	std::mt19937 generator(_randomSeed + 1);
+	std::uniform_real_distribution<float> offset(-5.0f, 5.0f);
+	for (uint32_t i = 0; i < objectCount; i += 3)
+	{
+		Vector3f delta(offset(generator), offset(generator), offset(generator));
+		bvh.MoveProxy(proxies[i], SceneAabb(bounds[i]._min + delta, bounds[i]._max + delta));
+	}
+	for (uint32_t i = 1; i < objectCount; i += 7)
+	{
+		bvh.DestroyProxy(proxies[i]);
+		proxies[i] = SceneBvhNullNode;
+	}
+	for (uint32_t i = 2; i < objectCount; i += 5)
+	{
+		if (proxies[i] == SceneBvhNullNode)
+			continue;
+		Vector3f delta(offset(generator), offset(generator), offset(generator));
+		bvh.UpdateProxyBounds(proxies[i], SceneAabb(bounds[i]._min + delta, bounds[i]._max + delta));
+	}
+	bvh.Refit();
+
+	if (!bvh.Validate())
+	{
+		std::cerr << "CaveSanityTestSceneBvh: invalid tree after refit\n";
+		return false;
+	}
+
+	bool success = true;
+	caveVector<int32_t> bvhResults(allocator);
+	caveVector<int32_t> bruteResults(allocator);
+	SceneAabb queryBox(Vector3f(100.0f), Vector3f(180.0f));
+	Vector3f sphereCenter(250.0f, 250.0f, 250.0f);
+	float sphereRadius = 60.0f;
+	SceneFrustum frustum = CreateFrustum(worldSize);
+	SceneRay ray;
+	ray._origin = Vector3f(0.0f, 10.0f, 20.0f);
+	ray._direction = Normalize(Vector3f(1.0f, 0.9f, 0.7f));
+	float rayLength = worldSize;
+
+	for (uint32_t pass = 0; pass < 2 && success; ++pass)
+	{
+		bvhResults.Clear(); bruteResults.Clear();
+		bvh.QueryAabb(queryBox, bvhResults);
+		for (uint32_t i = 0; i < objectCount; ++i)
+		{
+			if (proxies[i] != SceneBvhNullNode && BruteForceAabb(bvh.GetFatBounds(proxies[i]), queryBox))
+				bruteResults.Push(proxies[i]);
+		}
+		success &= CompareResults(bvhResults, bruteResults);
+
+		bvhResults.Clear(); bruteResults.Clear();
+		bvh.QuerySphere(sphereCenter, sphereRadius, bvhResults);
+		for (uint32_t i = 0; i < objectCount; ++i)
+		{
+			if (proxies[i] != SceneBvhNullNode && BruteForceSphere(bvh.GetFatBounds(proxies[i]), sphereCenter, sphereRadius))
+				bruteResults.Push(proxies[i]);
+		}
+		success &= CompareResults(bvhResults, bruteResults);
+
+		bvhResults.Clear(); bruteResults.Clear();
+		bvh.QueryFrustum(frustum, bvhResults);
+		for (uint32_t i = 0; i < objectCount; ++i)
+		{
+			if (proxies[i] != SceneBvhNullNode && BruteForceFrustum(bvh.GetFatBounds(proxies[i]), frustum))
+				bruteResults.Push(proxies[i]);
+		}
+		success &= CompareResults(bvhResults, bruteResults);
+
+		bvhResults.Clear(); bruteResults.Clear();
+		bvh.QueryRay(ray, rayLength, bvhResults);
+		for (uint32_t i = 0; i < objectCount; ++i)
+		{
+			if (proxies[i] != SceneBvhNullNode && BruteForceRay(bvh.GetFatBounds(proxies[i]), ray, rayLength))
+				bruteResults.Push(proxies[i]);
+		}
+		success &= CompareResults(bvhResults, bruteResults);
+
+		// second pass runs on a full SAH rebuild
+		bvh.Build();
+		success &= bvh.Validate();
+	}
+
+	if (!success)
+		std::cerr << "CaveSanityTestSceneBvh: query results differ from brute force\n";
+
+	return success;
+}
+
+void CaveSanityTestSceneBvh::Cleanup(RenderDevice*, userContextData*)
+{
+
+}
+
+void CaveSanityTestSceneBvh::BenchmarkObjectCount(RenderDevice *device, uint32_t count)
+{
+	typedef std::chrono::high_resolution_clock clock;
+	const float worldSize = 2000.0f;
+	const uint32_t queryCount = 100;
+
+	std::shared_ptr<AllocatorBase> allocator = device->GetEngineAllocator();
+	caveVector<SceneAabb> bounds(allocator);
+	caveVector<int32_t> proxies(allocator);
+	caveVector<int32_t> results(allocator);
+	CreateBounds(count, worldSize, bounds);
+	proxies.Reserve(count);
+
+	SceneBvh bvh(allocator);
+
+	// incremental insert
+	clock::time_point start = clock::now();
+	for (uint32_t i = 0; i < count; ++i)
+		proxies.Push(bvh.CreateProxy(bounds[i], nullptr));
+	double insertTime = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+	float insertRatio = bvh.GetAreaRatio();
+
+	// full SAH build
+	start = clock::now();
+	bvh.Build();
+	double buildTime = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+	float buildRatio = bvh.GetAreaRatio();
+
+	// move every object a bit and refit
+	std::mt19937 generator(_randomSeed);
+	std::uniform_real_distribution<float> offset(-1.0f, 1.0f);
+	start = clock::now();
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		Vector3f delta(offset(generator), offset(generator), offset(generator));
+		bvh.UpdateProxyBounds(proxies[i], SceneAabb(bounds[i]._min + delta, bounds[i]._max + delta));
+	}
+	bvh.Refit();
+	double refitTime = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+
+	// queries
+	std::uniform_real_distribution<float> position(0.0f, worldSize);
+	SceneFrustum frustum = CreateFrustum(worldSize);
+	size_t bvhHits = 0;
+	start = clock::now();
+	for (uint32_t q = 0; q < queryCount; ++q)
+	{
+		Vector3f center(position(generator), position(generator), position(generator));
+		results.Clear();
+		bvh.QuerySphere(center, 50.0f, results);
+		bvhHits += results.Size();
+	}
+	double bvhSphereTime = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+
+	start = clock::now();
+	results.Clear();
+	bvh.QueryFrustum(frustum, results);
+	double bvhFrustumTime = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+	size_t frustumHits = results.Size();
+
+	// brute force reference
+	generator.seed(_randomSeed);
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		offset(generator); offset(generator); offset(generator);
+	}
+	size_t bruteHits = 0;
+	start = clock::now();
+	for (uint32_t q = 0; q < queryCount; ++q)
+	{
+		Vector3f center(position(generator), position(generator), position(generator));
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			if (BruteForceSphere(bvh.GetFatBounds(proxies[i]), center, 50.0f))
+				bruteHits++;
+		}
+	}
+	double bruteSphereTime = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+
+	start = clock::now();
+	size_t bruteFrustumHits = 0;
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		if (BruteForceFrustum(bvh.GetFatBounds(proxies[i]), frustum))
+			bruteFrustumHits++;
+	}
+	double bruteFrustumTime = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+
+	std::cerr << "SceneBvh " << count << " objects:"
+			  << " insert " << insertTime << "ms (area ratio " << insertRatio << ")"
+			  << ", SAH build " << buildTime << "ms (area ratio " << buildRatio << ")"
+			  << ", refit " << refitTime << "ms\n";
+	std::cerr << "    " << queryCount << " sphere queries: bvh " << bvhSphereTime << "ms, brute force " << bruteSphereTime << "ms"
+			  << " (hits " << bvhHits << "/" << bruteHits << ")\n";
+	std::cerr << "    frustum query: bvh " << bvhFrustumTime << "ms, brute force " << bruteFrustumTime << "ms"
+			  << " (hits " << frustumHits << "/" << bruteFrustumHits << ")\n";
+}
+
+bool CaveSanityTestSceneBvh::RunPerformance(RenderDevice *device, userContextData*)
+{
+	BenchmarkObjectCount(device, 10000);
+	BenchmarkObjectCount(device, 100000);
+	BenchmarkObjectCount(device, 1000000);
+
+	return true;
+}
@@ -0,0 +1,206 @@
+/*
+Copyright (c) <2017> <Udo Lugauer>
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE
+*/
+
+/// @file caveSanityTestShaderCache.cpp
+///       Shader cache index tests
+
+#include "caveSanityTestShaderCache.h"
+
+#include <cstdio>
+#include <fstream>
+
+using namespace cave;
+
+/// index written by the test
+static const char* g_testIndex = "caveSanityTest.shaderindex";
+/// index which must not be written
+static const char* g_testUnchangedIndex = "caveSanityTestUnchanged.shaderindex";
+
+/**
+* @brief Shader file recorded in the index
+*/
+struct TestIndexEntry
+{
+	const char* _name;				///< Resolved file path
+	uint64_t _size;					///< File size
+	uint64_t _modificationTime;		///< Modification time
+	uint64_t _contentHash;			///< Content hash
+};
+
+/// entries of the test index. Names may contain spaces
+static const TestIndexEntry g_testEntries[] =
+{
+	{ "shaders/test.vert.spv", 1024, 1500000000, 0x0123456789abcdefULL },
+	{ "shaders/test.frag.spv", 2048, 1500000001, 0xfedcba9876543210ULL },
+	{ "my shaders/with space.spv", 16, 1500000002, 0x1ULL },
+};
+
+CaveSanityTestShaderCache::CaveSanityTestShaderCache()
+{
+
+}
+
+CaveSanityTestShaderCache::~CaveSanityTestShaderCache()
+{
+
+}
+
+bool CaveSanityTestShaderCache::IsSupported(RenderDevice* )
+{
+	return true;
+}
+
+bool CaveSanityTestShaderCache::WriteFile(const char* path, const char* content)
+{
+	std::ofstream file(path, std::ios::trunc);
+	if (!file.is_open())
+		return false;
+
+	file << content;
+	return file.good();
+}
+
+bool CaveSanityTestShaderCache::TestSaveLoad(std::shared_ptr<AllocatorGlobal> allocator)
+{
+	{
+		ShaderCache cache(allocator);
+		for (const TestIndexEntry& entry : g_testEntries)
+			cache.UpdateIndex(entry._name, entry._size, entry._modificationTime, entry._contentHash);
+
+		// files without a modification time are never recorded
+		cache.UpdateIndex("shaders/unknown.spv", 8, 0, 0x2ULL);
+
+		if (!cache.SaveIndex(g_testIndex))
+			return false;
+	}
+
+	ShaderCache cache(allocator);
+	if (!cache.LoadIndex(g_testIndex))
+		return false;
+
+	for (const TestIndexEntry& entry : g_testEntries)
+	{
+		uint64_t contentHash = 0;
+		if (!cache.LookupIndex(entry._name, entry._size, entry._modificationTime, contentHash) || contentHash != entry._contentHash)
+			return false;
+	}
+
+	uint64_t contentHash = 0;
+	if (cache.LookupIndex("shaders/unknown.spv", 8, 1, contentHash))
+		return false;
+
+	// an unchanged index is not written again
+	std::remove(g_testUnchangedIndex);
+	if (!cache.SaveIndex(g_testUnchangedIndex) || std::ifstream(g_testUnchangedIndex).is_open())
+		return false;
+
+	ShaderCacheStats stats = cache.GetStats();
+	return stats._indexHitCount == 3 && stats._indexMissCount == 1;
+}
+
+bool CaveSanityTestShaderCache::TestStaleEntries(std::shared_ptr<AllocatorGlobal> allocator)
+{
+	ShaderCache cache(allocator);
+	if (!cache.LoadIndex(g_testIndex))
+		return false;
+
+	const TestIndexEntry& entry = g_testEntries[0];
+	uint64_t contentHash = 0;
+
+	// a changed file must be hashed again
+	if (cache.LookupIndex(entry._name, entry._size + 1, entry._modificationTime, contentHash)
+		|| cache.LookupIndex(entry._name, entry._size, entry._modificationTime + 1, contentHash)
+		|| cache.LookupIndex(entry._name, entry._size, 0, contentHash))
+		return false;
+
+	// the new content replaces the entry
+	cache.UpdateIndex(entry._name, entry._size + 1, entry._modificationTime + 1, 0x42ULL);
+	if (!cache.SaveIndex(g_testIndex))
+		return false;
+
+	ShaderCache reloaded(allocator);
+	if (!reloaded.LoadIndex(g_testIndex)
+		|| reloaded.LookupIndex(entry._name, entry._size, entry._modificationTime, contentHash)
+		|| !reloaded.LookupIndex(entry._name, entry._size + 1, entry._modificationTime + 1, contentHash)
+		|| contentHash != 0x42ULL)
+		return false;
+
+	ShaderCacheStats stats = cache.GetStats();
+	return stats._indexHitCount == 0 && stats._indexMissCount == 2;
+}
+
+bool CaveSanityTestShaderCache::TestDamagedIndex(std::shared_ptr<AllocatorGlobal> allocator)
+{
+	const char* indices[] =
+	{
+		// older version keyed by file name
+		"cave-shader-index 1\n123 16 1500000000 test.spv\n",
+		// size is not a number
+		"cave-shader-index 2\n123 16 1500000000 test.spv\n456 abc 1500000000 other.spv\n",
+		// name is missing
+		"cave-shader-index 2\n123 16 1500000000 test.spv\n456 16 1500000000\n",
+	};
+
+	for (const char* index : indices)
+	{
+		if (!WriteFile(g_testIndex, index))
+			return false;
+
+		// nothing of a damaged index is used
+		ShaderCache cache(allocator);
+		uint64_t contentHash = 0;
+		if (cache.LoadIndex(g_testIndex) || cache.LookupIndex("test.spv", 16, 1500000000, contentHash))
+			return false;
+	}
+
+	std::remove(g_testIndex);
+	ShaderCache cache(allocator);
+	return !cache.LoadIndex(g_testIndex);
+}
+
+bool CaveSanityTestShaderCache::Run(RenderDevice* device, RenderCommandPool*, userContextData*)
+{
+	std::shared_ptr<AllocatorGlobal> allocator = device->GetEngineAllocator();
+
+	bool success = true;
+	if (!TestSaveLoad(allocator))
+	{
+		std::cerr << "CaveSanityTestShaderCache: index entries lost between save and load\n";
+		success = false;
+	}
+	else if (!TestStaleEntries(allocator))
+	{
+		std::cerr << "CaveSanityTestShaderCache: stale index entry used\n";
+		success = false;
+	}
+
+	if (!TestDamagedIndex(allocator))
+	{
+		std::cerr << "CaveSanityTestShaderCache: damaged index accepted\n";
+		success = false;
+	}
+
+	return success;
+}
+
+void CaveSanityTestShaderCache::Cleanup(RenderDevice*, userContextData*)
+{
+	std::remove(g_testIndex);
+	std::remove(g_testUnchangedIndex);
+}
+
+bool CaveSanityTestShaderCache::RunPerformance(RenderDevice*, userContextData*)
+{
+	return true;
+}
@@ -29,6 +29,14 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SO
 #include "Base/caveSanityTestTexture2D.h"
 #include "Base/caveSanityTestFrameBuffer.h"
 #include "Base/caveSanityTestMsaa.h"
+#include "Base/caveSanityTestMemoryAllocator.h"
+#include "Base/caveSanityTestResourcePackage.h"
+#include "Base/caveSanityTestJobSystem.h"
+#include "Base/caveSanityTestResourceLoader.h"
+#include "Base/caveSanityTestResourceCache.h"
+#include "Base/caveSanityTestMaterialBinary.h"
+#include "Base/caveSanityTestShaderCache.h"
+#include "Base/caveSanityTestSceneBvh.h"
 
 #include <iostream>
 #include <sstream>
@@ -48,6 +56,7 @@ bool				g_CompareImage = false;	///< check gold images
 string_type			g_GoldDirName;			///< path to gold images
 
 bool				g_WriteLog = true;		///< by default write log file
+bool				g_RunPerformance = false;	///< run performance tests
 CaveHtmlLog			g_LogHMTL;				///< class looging the results in HTML
 
 
@@ -127,6 +136,7 @@ printHelpMessage()
 	MsgStr += " -o [outdir]\t\t- path to image output (directory must exist)\n";
 	MsgStr += " -g [comparedir]\t- directory which contains the gold images\n";
 	MsgStr += " -winSize x y\t\t- Set window size\n";
+	MsgStr += " -perf\t\t\t- run performance tests after the sanity tests\n";
 
 	std::cerr << MsgStr.c_str();
 }
@@ -187,6 +197,13 @@ bool getComdLineArguments(int argc, char** argv)
 			g_CompareImage = true;
 		}
 
+		// check if we should run performance tests
+		index = pArgStr.find("-perf");
+		if (index != string_type::npos)
+		{
+			g_RunPerformance = true;
+		}
+
 		// get window size
 		index = pArgStr.find("-winSize");
 		if (index != string_type::npos && argv[theIndex + 1] != NULL && argv[theIndex + 2] != NULL)
@@ -421,6 +438,16 @@ int main(int argc, char* argv[])
 	std::cerr << "Tests passed: " << testPassed << "\n";
 	std::cerr << "Tests failed: " << testFailed << "\n";
 
+	// run performance tests
+	if (g_RunPerformance)
+	{
+		for (uint32_t i = 0; i < sizeof(testList) / sizeof(testList[0]); i++)
+		{
+			if (testList[i].m_test->IsSupported(renderDevice))
+				testList[i].m_test->RunPerformance(renderDevice, &userData);
+		}
+	}
+
 	if (g_WriteLog)
 	{
 		g_LogHMTL.LogEndTable();
@@ -30,4 +30,14 @@ CAVE_SANITY_TEST_ITERATE(CaveSanityTestPushConstansts)
 CAVE_SANITY_TEST_ITERATE(CaveSanityTestTexture2D)
 CAVE_SANITY_TEST_ITERATE(CaveSanityTestFrameBuffer)
 CAVE_SANITY_TEST_ITERATE(CaveSanityTestMsaa)
+CAVE_SANITY_TEST_ITERATE(CaveSanityTestMemoryAllocator)
+CAVE_SANITY_TEST_ITERATE(CaveSanityTestResourcePackage)
+CAVE_SANITY_TEST_ITERATE(CaveSanityTestJobSystem)
+CAVE_SANITY_TEST_ITERATE(CaveSanityTestResourceLoader)
+CAVE_SANITY_TEST_ITERATE(CaveSanityTestResourceCache)
+CAVE_SANITY_TEST_ITERATE(CaveSanityTestMaterialBinary)
+CAVE_SANITY_TEST_ITERATE(CaveSanityTestShaderCache)
+
+// scene
+CAVE_SANITY_TEST_ITERATE(CaveSanityTestSceneBvh)
 
@@ -0,0 +1,347 @@
+/*
+Copyright (c) <2017> <Udo Lugauer>
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE
+*/
+
+/// @file caveCook.cpp
+///       Offline asset cooker. Turns a content tree into runtime ready files
+
+#include "cookDatabase.h"
+#include "cookFileSystem.h"
+#include "cookSteps.h"
+
+#include "Jobs/jobSystem.h"
+#include "Memory/allocatorGlobal.h"
+#include "Resource/resourcePackage.h"
+
+#include <iostream>
+#include <cstdlib>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <set>
+
+using namespace cave;
+
+typedef std::basic_string<char> string_type;
+
+/// Bump whenever a cook step changes its output. Everything is cooked again then
+static const uint32_t g_cookVersion = 3;
+/// Dependency database inside the output directory
+static const char* g_databaseName = "cook.db";
+
+// command line arguments
+string_type			g_ContentDir;			///< content tree to cook
+string_type			g_OutputDir;			///< cooked content tree
+string_type			g_PackagePath;			///< optional package written from the cooked tree
+uint32_t			g_JobCount = 0;			///< worker threads besides the main thread (0 uses one per core)
+bool				g_Force = false;		///< ignore the database and cook everything
+bool				g_Compress = false;		///< compress package entries
+
+/**
+* @brief State of one content file
+*/
+struct CookEntry
+{
+	std::string _path;				///< Content relative path
+	uint64_t _hash;					///< Content hash
+	bool _readable;					///< Content could be read
+	bool _dirty;					///< Needs to be cooked
+	bool _success;					///< Cook result
+	std::vector<std::pair<std::string, uint64_t>> _dependencies;	///< Dependencies found while cooking
+	std::string _error;				///< Cook error
+};
+
+static void
+printHelpMessage()
+{
+	string_type MsgStr = "Cave asset cooker.\n\n";
+	MsgStr += " caveCook [options] <contentDir> <outputDir>\n\n";
+	MsgStr += " -h\t\t\t- prints this help message\n";
+	MsgStr += " -j [count]\t\t- worker threads besides the main thread (default one per core)\n";
+	MsgStr += " -f\t\t\t- cook everything, ignore the dependency database\n";
+	MsgStr += " -p [package]\t\t- write a .cavepak package of the cooked content\n";
+	MsgStr += " -z\t\t\t- compress package entries\n";
+
+	std::cerr << MsgStr.c_str();
+}
+
+static bool
+getComdLineArguments(int argc, char** argv)
+{
+	std::vector<string_type> directories;
+	for (int theIndex = 1; theIndex < argc; ++theIndex)
+	{
+		string_type pArgStr = argv[theIndex];
+
+		if (pArgStr == "-h" || pArgStr == "-help")
+		{
+			printHelpMessage();
+			return false;
+		}
+		else if (pArgStr == "-j" && theIndex + 1 < argc)
+		{
+			g_JobCount = static_cast<uint32_t>(std::atoi(argv[++theIndex]));
+		}
+		else if (pArgStr == "-f")
+		{
+			g_Force = true;
+		}
+		else if (pArgStr == "-p" && theIndex + 1 < argc)
+		{
+			g_PackagePath = argv[++theIndex];
+		}
+		else if (pArgStr == "-z")
+		{
+			g_Compress = true;
+		}
+		else if (!pArgStr.empty() && pArgStr[0] != '-')
+		{
+			directories.push_back(pArgStr);
+		}
+		else
+		{
+			std::cerr << "Unknown argument " << pArgStr.c_str() << "\n";
+			printHelpMessage();
+			return false;
+		}
+	}
+
+	if (directories.size() != 2)
+	{
+		printHelpMessage();
+		return false;
+	}
+
+	g_ContentDir = directories[0];
+	g_OutputDir = directories[1];
+	if (g_ContentDir[g_ContentDir.length() - 1] != '/')
+		g_ContentDir += '/';
+	if (g_OutputDir[g_OutputDir.length() - 1] != '/')
+		g_OutputDir += '/';
+
+	return true;
+}
+
+/**
+* @brief Check if an input has to be cooked
+*
+* @param[in] entry		Content file
+* @param[in] database	Dependency database
+* @param[in] hashes		Current content hashes by path
+*
+* @return true if the recorded cook is out of date
+*/
+static bool
+isDirty(const CookEntry& entry, const CookDatabase& database, const std::map<std::string, uint64_t>& hashes)
+{
+	const CookRecord* record = database.Find(entry._path);
+	if (!record || record->_hash != entry._hash || record->_version != g_cookVersion)
+		return true;
+
+	if (!CookFileExists(g_OutputDir + entry._path))
+		return true;
+
+	// missing dependencies are recorded with hash 0
+	for (size_t i = 0; i < record->_dependencies.size(); i++)
+	{
+		std::map<std::string, uint64_t>::const_iterator it = hashes.find(record->_dependencies[i].first);
+		uint64_t hash = (it != hashes.end()) ? it->second : 0;
+		if (hash != record->_dependencies[i].second)
+			return true;
+	}
+
+	return false;
+}
+
+/**
+* @brief Write a package of all cooked outputs
+*
+* @param[in] entries	Content files
+*
+* @return true on success
+*/
+static bool
+writePackage(const std::vector<CookEntry>& entries)
+{
+	ResourcePackageWriter writer;
+	for (size_t i = 0; i < entries.size(); i++)
+	{
+		if (!entries[i]._success)
+			continue;
+
+		ResourceLoadData data;
+		if (!CookReadFile(g_OutputDir + entries[i]._path, data)
+			|| !writer.Add(entries[i]._path.c_str(), data.GetData(), data.GetSize(), g_Compress))
+		{
+			std::cerr << "Failed to add " << entries[i]._path.c_str() << " to the package\n";
+			return false;
+		}
+	}
+
+	return writer.Write(g_PackagePath.c_str());
+}
+
+int main(int argc, char** argv)
+{
+	if (!getComdLineArguments(argc, argv))
+		return EXIT_FAILURE;
+
+	CookContext context;
+	context._contentDir = g_ContentDir;
+	if (!CookListFiles(g_ContentDir, context._files))
+	{
+		std::cerr << "Can't read content directory " << g_ContentDir.c_str() << "\n";
+		return EXIT_FAILURE;
+	}
+
+	if (!CookCreateDirectories(g_OutputDir))
+	{
+		std::cerr << "Can't create output directory " << g_OutputDir.c_str() << "\n";
+		return EXIT_FAILURE;
+	}
+
+	CookDatabase database;
+	string_type databasePath = g_OutputDir + g_databaseName;
+	if (!g_Force && !database.Load(databasePath))
+		std::cerr << "Dependency database is damaged, cooking everything\n";
+
+	std::shared_ptr<AllocatorBase> allocator = std::make_shared<AllocatorGlobal>(0);
+	context._pAllocator = allocator;
+	JobSystem jobSystem(allocator, g_JobCount);
+
+	std::vector<CookEntry> entries(context._files.size());
+	for (size_t i = 0; i < entries.size(); i++)
+	{
+		entries[i]._path = context._files[i];
+		entries[i]._hash = 0;
+		entries[i]._readable = false;
+		entries[i]._dirty = false;
+		entries[i]._success = false;
+	}
+
+	// hash all inputs in parallel
+	jobSystem.ParallelFor(0, entries.size(), [&entries](size_t index)
+	{
+		CookEntry& entry = entries[index];
+		ResourceLoadData data;
+		entry._readable = CookReadFile(g_ContentDir + entry._path, data);
+		if (entry._readable)
+			entry._hash = CookHashContent(data.GetData(), data.GetSize());
+	}, 1);
+
+	std::map<std::string, uint64_t> hashes;
+	for (size_t i = 0; i < entries.size(); i++)
+	{
+		if (entries[i]._readable)
+			hashes[entries[i]._path] = entries[i]._hash;
+	}
+
+	size_t dirtyCount = 0;
+	for (size_t i = 0; i < entries.size(); i++)
+	{
+		entries[i]._dirty = g_Force || !entries[i]._readable || isDirty(entries[i], database, hashes);
+		if (entries[i]._dirty)
+			dirtyCount++;
+		else
+			entries[i]._success = true;
+	}
+
+	// cook the dirty inputs in parallel
+	jobSystem.ParallelFor(0, entries.size(), [&entries, &context, &hashes](size_t index)
+	{
+		CookEntry& entry = entries[index];
+		if (!entry._dirty)
+			return;
+
+		ResourceLoadData data;
+		if (!entry._readable || !CookReadFile(g_ContentDir + entry._path, data))
+		{
+			entry._error = "can't read file";
+			return;
+		}
+
+		CookResult result;
+		if (!CookItem(context, entry._path, data, result))
+		{
+			entry._error = result._error;
+			return;
+		}
+
+		if (!CookWriteFile(g_OutputDir + entry._path, result._output.data(), result._output.size()))
+		{
+			entry._error = "can't write output";
+			return;
+		}
+
+		for (size_t i = 0; i < result._dependencies.size(); i++)
+		{
+			std::map<std::string, uint64_t>::const_iterator it = hashes.find(result._dependencies[i]);
+			entry._dependencies.push_back(std::make_pair(result._dependencies[i], (it != hashes.end()) ? it->second : 0));
+		}
+		entry._success = true;
+	}, 1);
+
+	size_t failedCount = 0;
+	std::set<std::string> inputs;
+	for (size_t i = 0; i < entries.size(); i++)
+	{
+		const CookEntry& entry = entries[i];
+		inputs.insert(entry._path);
+		if (!entry._dirty)
+			continue;
+
+		if (entry._success)
+		{
+			CookRecord record;
+			record._hash = entry._hash;
+			record._version = g_cookVersion;
+			record._dependencies = entry._dependencies;
+			database.Set(entry._path, record);
+		}
+		else
+		{
+			// forget failed inputs so they are cooked again next time
+			std::cerr << "Failed to cook " << entry._path.c_str() << ": " << entry._error.c_str() << "\n";
+			database.Remove(entry._path);
+			failedCount++;
+		}
+	}
+
+	// remove outputs of deleted inputs
+	std::vector<std::string> recorded = database.GetPaths();
+	for (size_t i = 0; i < recorded.size(); i++)
+	{
+		if (inputs.find(recorded[i]) == inputs.end())
+		{
+			std::remove((g_OutputDir + recorded[i]).c_str());
+			database.Remove(recorded[i]);
+		}
+	}
+
+	if (!database.Save(databasePath))
+	{
+		std::cerr << "Can't write dependency database " << databasePath.c_str() << "\n";
+		return EXIT_FAILURE;
+	}
+
+	if (!g_PackagePath.empty() && !writePackage(entries))
+	{
+		std::cerr << "Can't write package " << g_PackagePath.c_str() << "\n";
+		return EXIT_FAILURE;
+	}
+
+	std::cout << "caveCook: " << (dirtyCount - failedCount) << " cooked, " << (entries.size() - dirtyCount)
+		<< " up to date, " << failedCount << " failed\n";
+
+	return (failedCount == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
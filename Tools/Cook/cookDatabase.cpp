@@ -0,0 +1,135 @@
+/*
+Copyright (c) <2017> <Udo Lugauer>
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE
+*/
+
+/// @file cookDatabase.cpp
+///       Dependency database of the asset cooker
+
+#include "cookDatabase.h"
+#include "cookFileSystem.h"
+
+#include <fstream>
+#include <sstream>
+
+namespace cave
+{
+
+// first line of a database file
+static const char* g_databaseHeader = "caveCook-db 1";
+
+bool CookDatabase::Load(const std::string& path)
+{
+	_records.clear();
+
+	std::ifstream in(path.c_str());
+	if (!in.is_open())
+		return true;
+
+	std::string line;
+	if (!std::getline(in, line) || line != g_databaseHeader)
+		return false;
+
+	// <hash> <version> <dependency count> <path>
+	// followed by one line per dependency: <hash> <path>. Paths are last, they may contain spaces
+	while (std::getline(in, line))
+	{
+		if (line.empty())
+			continue;
+
+		std::istringstream fields(line);
+		CookRecord record;
+		size_t dependencyCount = 0;
+		std::string inputPath;
+		fields >> std::hex >> record._hash >> std::dec >> record._version >> dependencyCount;
+		fields.get();
+		std::getline(fields, inputPath);
+		if (fields.fail() || inputPath.empty())
+		{
+			_records.clear();
+			return false;
+		}
+
+		for (size_t i = 0; i < dependencyCount; i++)
+		{
+			std::pair<std::string, uint64_t> dependency;
+			if (!std::getline(in, line))
+			{
+				_records.clear();
+				return false;
+			}
+
+			std::istringstream dependencyFields(line);
+			dependencyFields >> std::hex >> dependency.second;
+			dependencyFields.get();
+			std::getline(dependencyFields, dependency.first);
+			if (dependencyFields.fail() || dependency.first.empty())
+			{
+				_records.clear();
+				return false;
+			}
+
+			record._dependencies.push_back(dependency);
+		}
+
+		_records[inputPath] = record;
+	}
+
+	return true;
+}
+
+bool CookDatabase::Save(const std::string& path) const
+{
+	std::ostringstream out;
+	out << g_databaseHeader << "\n";
+
+	for (std::map<std::string, CookRecord>::const_iterator it = _records.begin(); it != _records.end(); ++it)
+	{
+		const CookRecord& record = it->second;
+		out << std::hex << record._hash << std::dec << " " << record._version << " "
+			<< record._dependencies.size() << " " << it->first << "\n";
+
+		for (size_t i = 0; i < record._dependencies.size(); i++)
+			out << std::hex << record._dependencies[i].second << std::dec << " " << record._dependencies[i].first << "\n";
+	}
+
+	std::string content = out.str();
+	return CookWriteFile(path, content.data(), content.size());
+}
+
+const CookRecord* CookDatabase::Find(const std::string& path) const
+{
+	std::map<std::string, CookRecord>::const_iterator it = _records.find(path);
+	return (it != _records.end()) ? &it->second : nullptr;
+}
+
+void CookDatabase::Set(const std::string& path, const CookRecord& record)
+{
+	_records[path] = record;
+}
+
+void CookDatabase::Remove(const std::string& path)
+{
+	_records.erase(path);
+}
+
+std::vector<std::string> CookDatabase::GetPaths() const
+{
+	std::vector<std::string> paths;
+	paths.reserve(_records.size());
+	for (std::map<std::string, CookRecord>::const_iterator it = _records.begin(); it != _records.end(); ++it)
+		paths.push_back(it->first);
+
+	return paths;
+}
+
+}
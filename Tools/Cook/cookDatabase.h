@@ -0,0 +1,97 @@
+/*
+Copyright (c) <2017> <Udo Lugauer>
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE
+*/
+#pragma once
+
+/// @file cookDatabase.h
+///       Dependency database of the asset cooker
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <map>
+#include <utility>
+
+namespace cave
+{
+
+/**
+* @brief What an output was cooked from
+*/
+struct CookRecord
+{
+	uint64_t _hash;		///< Content hash of the input
+	uint32_t _version;	///< Cooker version which produced the output
+	std::vector<std::pair<std::string, uint64_t>> _dependencies;	///< Other inputs and their content hashes
+
+	/** @brief Constructor */
+	CookRecord() : _hash(0), _version(0) {}
+};
+
+/**
+* @brief Persistent map from content path to cook record.
+*		 An input is cooked again if its hash, the cooker version or the hash of a dependency changed.
+*/
+class CookDatabase
+{
+public:
+	/**
+	* @brief Load the database. A missing file yields an empty database.
+	*
+	* @param[in] path	Database file
+	*
+	* @return false if the file exists but is damaged (the database is empty then)
+	*/
+	bool Load(const std::string& path);
+
+	/**
+	* @brief Save the database atomically
+	*
+	* @param[in] path	Database file
+	*
+	* @return true on success
+	*/
+	bool Save(const std::string& path) const;
+
+	/**
+	* @brief Find the record of an input
+	*
+	* @param[in] path	Content relative path
+	*
+	* @return record or nullptr
+	*/
+	const CookRecord* Find(const std::string& path) const;
+
+	/**
+	* @brief Add or replace the record of an input
+	*
+	* @param[in] path	Content relative path
+	* @param[in] record	Record
+	*/
+	void Set(const std::string& path, const CookRecord& record);
+
+	/**
+	* @brief Remove the record of an input
+	*
+	* @param[in] path	Content relative path
+	*/
+	void Remove(const std::string& path);
+
+	/** @brief Get all recorded paths */
+	std::vector<std::string> GetPaths() const;
+
+private:
+	std::map<std::string, CookRecord> _records;	///< Records by content path
+};
+
+}
@@ -0,0 +1,195 @@
+/*
+Copyright (c) <2017> <Udo Lugauer>
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE
+*/
+
+/// @file cookFileSystem.cpp
+///       File system helpers of the asset cooker
+
+#include "cookFileSystem.h"
+
+#include <fstream>
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <direct.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#endif
+
+namespace cave
+{
+
+/**
+* @brief Walk one directory level
+*/
+static bool ListDirectory(const std::string& root, const std::string& relative, std::vector<std::string>& files)
+{
+	std::string directory = root + "/" + relative;
+
+#ifdef _WIN32
+	WIN32_FIND_DATAA findData;
+	HANDLE find = FindFirstFileA((directory + "*").c_str(), &findData);
+	if (find == INVALID_HANDLE_VALUE)
+		return false;
+
+	do
+	{
+		std::string name(findData.cFileName);
+		if (name == "." || name == "..")
+			continue;
+
+		if (findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+			ListDirectory(root, relative + name + "/", files);
+		else
+			files.push_back(relative + name);
+	} while (FindNextFileA(find, &findData));
+
+	FindClose(find);
+#else
+	DIR* dir = opendir(directory.c_str());
+	if (!dir)
+		return false;
+
+	while (struct dirent* entry = readdir(dir))
+	{
+		std::string name(entry->d_name);
+		if (name == "." || name == "..")
+			continue;
+
+		struct stat fileStat;
+		if (stat((directory + name).c_str(), &fileStat) != 0)
+			continue;
+
+		if (S_ISDIR(fileStat.st_mode))
+			ListDirectory(root, relative + name + "/", files);
+		else if (S_ISREG(fileStat.st_mode))
+			files.push_back(relative + name);
+	}
+
+	closedir(dir);
+#endif
+
+	return true;
+}
+
+bool CookListFiles(const std::string& root, std::vector<std::string>& files)
+{
+	if (!ListDirectory(root, std::string(), files))
+		return false;
+
+	// stable order for reproducible packages and logs
+	std::sort(files.begin(), files.end());
+	return true;
+}
+
+bool CookCreateDirectories(const std::string& path)
+{
+	std::string current;
+	for (size_t i = 0; i <= path.size(); i++)
+	{
+		if (i == path.size() || path[i] == '/' || path[i] == '\\')
+		{
+			if (!current.empty())
+			{
+#ifdef _WIN32
+				_mkdir(current.c_str());
+#else
+				mkdir(current.c_str(), 0755);
+#endif
+			}
+		}
+
+		if (i < path.size())
+			current.push_back(path[i]);
+	}
+
+#ifdef _WIN32
+	DWORD attributes = GetFileAttributesA(path.c_str());
+	return attributes != INVALID_FILE_ATTRIBUTES && (attributes & FILE_ATTRIBUTE_DIRECTORY);
+#else
+	struct stat fileStat;
+	return stat(path.c_str(), &fileStat) == 0 && S_ISDIR(fileStat.st_mode);
+#endif
+}
+
+bool CookFileExists(const std::string& path)
+{
+	std::ifstream file(path.c_str(), std::ios::in | std::ios::binary);
+	return file.is_open();
+}
+
+bool CookWriteFile(const std::string& path, const void* data, size_t size)
+{
+	std::string directory = CookGetDirectory(path);
+	if (!directory.empty() && !CookCreateDirectories(directory))
+		return false;
+
+	std::string tmpPath(path);
+	tmpPath.append(".tmp");
+
+	{
+		std::ofstream out(tmpPath.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+		if (!out.is_open())
+			return false;
+
+		if (size > 0)
+			out.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+
+		if (!out.good())
+		{
+			out.close();
+			std::remove(tmpPath.c_str());
+			return false;
+		}
+	}
+
+#ifdef _WIN32
+	// rename does not replace existing files on windows
+	std::remove(path.c_str());
+#endif
+	if (std::rename(tmpPath.c_str(), path.c_str()) != 0)
+	{
+		std::remove(tmpPath.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+std::string CookGetDirectory(const std::string& path)
+{
+	size_t pos = path.find_last_of("/\\");
+	if (pos == std::string::npos)
+		return std::string();
+
+	return path.substr(0, pos + 1);
+}
+
+std::string CookGetExtension(const std::string& path)
+{
+	size_t pos = path.find_last_of('.');
+	size_t separator = path.find_last_of("/\\");
+	if (pos == std::string::npos || (separator != std::string::npos && pos < separator))
+		return std::string();
+
+	std::string ext = path.substr(pos + 1);
+	std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+	return ext;
+}
+
+}
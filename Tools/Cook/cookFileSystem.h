@@ -0,0 +1,83 @@
+/*
+Copyright (c) <2017> <Udo Lugauer>
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE
+*/
+#pragma once
+
+/// @file cookFileSystem.h
+///       File system helpers of the asset cooker
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace cave
+{
+
+/**
+* @brief Collect all files below a directory
+*
+* @param[in] root		Directory to walk
+* @param[out] files		Receives the paths relative to root, '/' separated
+*
+* @return false if root can't be read
+*/
+bool CookListFiles(const std::string& root, std::vector<std::string>& files);
+
+/**
+* @brief Create a directory and all missing parents
+*
+* @param[in] path	Directory path
+*
+* @return true if the directory exists afterwards
+*/
+bool CookCreateDirectories(const std::string& path);
+
+/**
+* @brief Check if a file exists
+*
+* @param[in] path	File path
+*
+* @return true if found
+*/
+bool CookFileExists(const std::string& path);
+
+/**
+* @brief Write a file. The content is written to a temporary file first and renamed into place.
+*
+* @param[in] path	File path. Missing directories are created
+* @param[in] data	Content
+* @param[in] size	Content size in bytes
+*
+* @return true on success
+*/
+bool CookWriteFile(const std::string& path, const void* data, size_t size);
+
+/**
+* @brief Get the directory part of a path
+*
+* @param[in] path	'/' separated path
+*
+* @return directory including the trailing '/' or an empty string
+*/
+std::string CookGetDirectory(const std::string& path);
+
+/**
+* @brief Get the lower case extension of a path
+*
+* @param[in] path	File path
+*
+* @return extension without '.'
+*/
+std::string CookGetExtension(const std::string& path);
+
+}
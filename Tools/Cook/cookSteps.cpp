@@ -0,0 +1,278 @@
+/*
+Copyright (c) <2017> <Udo Lugauer>
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE
+*/
+
+/// @file cookSteps.cpp
+///       Cook steps which turn content files into runtime ready files
+
+#include "cookSteps.h"
+#include "cookFileSystem.h"
+#include "Resource/imageResourceDds.h"
+#include "Resource/materialBinary.h"
+
+#include "json.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+
+using json = nlohmann::json;	///< convenience shortcut
+
+namespace cave
+{
+
+// default search locations of the material loader (see materialResource.cpp)
+static const char* g_materialLocation = "Materials/";
+static const char* g_shaderLocation = "Shader/";
+static const char* g_shaderLocationSpirv = "Shader/Spirv/";
+// shader stages of a material program
+static const char* g_shaderStages[] = { "vertex", "fragment" };
+// first word of a SPIR-V module
+static const uint32_t g_spirvMagic = 0x07230203;
+
+CookItemType CookGetItemType(const std::string& path)
+{
+	std::string extension = CookGetExtension(path);
+	if (extension == "asset")
+		return CookItemType::Material;
+	if (extension == "spv")
+		return CookItemType::Shader;
+	if (extension == "dds")
+		return CookItemType::Image;
+
+	return CookItemType::Copy;
+}
+
+uint64_t CookHashContent(const uint8_t* data, size_t size)
+{
+	uint64_t hash = 14695981039346656037ULL;
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= data[i];
+		hash *= 1099511628211ULL;
+	}
+
+	return hash;
+}
+
+bool CookReadFile(const std::string& path, ResourceLoadData& data)
+{
+	if (data.GetMappedFile().Open(path.c_str(), OsMappedFileAccess::Sequential))
+		return true;
+
+	// empty files can't be mapped
+	std::ifstream file(path.c_str(), std::ios::in | std::ios::binary);
+	if (!file.is_open())
+		return false;
+
+	std::vector<char>& buffer = data.GetBuffer();
+	buffer.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+
+	return !file.bad();
+}
+
+/**
+* @brief Resolve a shader source the way the runtime material loader searches for it
+*
+* @param[in] context		Cook context
+* @param[in] materialPath	Content relative path of the material
+* @param[in] source			Shader source as written in the material
+* @param[out] resolved		Content relative path of the shader
+* @param[out] result		Receives all probed paths as dependencies, so adding a shader which
+*							would now be found first makes the material dirty
+*
+* @return false if the shader can't be found
+*/
+static bool ResolveShader(const CookContext& context, const std::string& materialPath, const std::string& source
+	, std::string& resolved, CookResult& result)
+{
+	std::string sourceDir = CookGetDirectory(source);
+	std::string fileName = source.substr(sourceDir.length());
+
+	std::vector<std::string> searchPath;
+	std::string materialDir = CookGetDirectory(materialPath);
+	if (!materialDir.empty())
+		searchPath.push_back(materialDir);
+	searchPath.push_back(g_materialLocation);
+	searchPath.push_back(g_shaderLocation);
+	searchPath.push_back(g_shaderLocationSpirv);
+	if (!sourceDir.empty())
+		searchPath.push_back(sourceDir);
+
+	for (size_t i = 0; i < searchPath.size(); i++)
+	{
+		std::string candidate = searchPath[i] + fileName;
+		if (std::find(result._dependencies.begin(), result._dependencies.end(), candidate) == result._dependencies.end())
+			result._dependencies.push_back(candidate);
+
+		if (std::binary_search(context._files.begin(), context._files.end(), candidate))
+		{
+			resolved = candidate;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/**
+* @brief Validate a material, replace its shader sources with resolved content relative paths and compile it
+*/
+static bool CookMaterial(const CookContext& context, const std::string& path, ResourceLoadData& input, CookResult& result)
+{
+	const char* text = reinterpret_cast<const char*>(input.GetData());
+	json asset;
+	try
+	{
+		asset = json::parse(text, text + input.GetSize());
+	}
+	catch (const std::exception& e)
+	{
+		result._error = e.what();
+		return false;
+	}
+
+	if (!asset.is_object())
+	{
+		result._error = "material asset is not an object";
+		return false;
+	}
+
+	json::iterator itM = asset.find("material");
+	if (itM != asset.end())
+	{
+		if (!itM.value().is_object())
+		{
+			result._error = "\"material\" is not an object";
+			return false;
+		}
+
+		json::iterator itV = itM.value().find("values");
+		if (itV != itM.value().end())
+		{
+			json& values = itV.value();
+			if (values.count("opacity") > 0 && !values["opacity"].is_number())
+			{
+				result._error = "\"opacity\" is not a number";
+				return false;
+			}
+			if (values.count("diffuse") > 0 && (!values["diffuse"].is_array() || values["diffuse"].size() != 3))
+			{
+				result._error = "\"diffuse\" is not a 3 component array";
+				return false;
+			}
+		}
+	}
+
+	json::iterator itP = asset.find("program");
+	if (itP != asset.end())
+	{
+		if (!itP.value().is_object())
+		{
+			result._error = "\"program\" is not an object";
+			return false;
+		}
+
+		json& program = itP.value();
+		for (size_t i = 0; i < sizeof(g_shaderStages) / sizeof(g_shaderStages[0]); i++)
+		{
+			json::iterator itS = program.find(g_shaderStages[i]);
+			if (itS == program.end())
+				continue;
+
+			json& stage = itS.value();
+			if (!stage.is_object() || stage.count("source") == 0 || !stage["source"].is_string())
+			{
+				result._error = std::string("\"") + g_shaderStages[i] + "\" has no source";
+				return false;
+			}
+
+			// shader names become content relative paths, so the runtime finds them with the first probe
+			std::string source = stage["source"].get<std::string>();
+			std::string resolved;
+			if (!ResolveShader(context, path, source, resolved, result))
+			{
+				result._error = "shader not found: " + source;
+				return false;
+			}
+
+			stage["source"] = resolved;
+		}
+	}
+
+	std::string cooked = asset.dump();
+	return MaterialBinaryWriter::Compile(cooked.c_str(), cooked.size(), result._output, &result._error);
+}
+
+/**
+* @brief Validate a SPIR-V module
+*/
+static bool CookShader(ResourceLoadData& input, CookResult& result)
+{
+	uint32_t magic = 0;
+	if (input.GetSize() < sizeof(magic) || (input.GetSize() % sizeof(uint32_t)) != 0)
+	{
+		result._error = "invalid SPIR-V size";
+		return false;
+	}
+
+	std::copy(input.GetData(), input.GetData() + sizeof(magic), reinterpret_cast<uint8_t*>(&magic));
+	if (magic != g_spirvMagic)
+	{
+		result._error = "invalid SPIR-V magic";
+		return false;
+	}
+
+	result._output.assign(input.GetData(), input.GetData() + input.GetSize());
+
+	return true;
+}
+
+/**
+* @brief Validate a DDS image and write it in the layout the runtime uploads without preparation
+*/
+static bool CookImage(const CookContext& context, ResourceLoadData& input, CookResult& result)
+{
+	ImageResourceDds image(context._pAllocator);
+	if (!ImageResource::DecodeImageResource(&image, input, true))
+	{
+		result._error = "invalid or unsupported DDS file";
+		return false;
+	}
+
+	if (!image.writeDds(result._output))
+	{
+		result._error = "DDS format can't be normalized";
+		return false;
+	}
+
+	return true;
+}
+
+bool CookItem(const CookContext& context, const std::string& path, ResourceLoadData& input, CookResult& result)
+{
+	switch (CookGetItemType(path))
+	{
+	case CookItemType::Material:
+		return CookMaterial(context, path, input, result);
+	case CookItemType::Shader:
+		return CookShader(input, result);
+	case CookItemType::Image:
+		return CookImage(context, input, result);
+	default:
+		result._output.assign(input.GetData(), input.GetData() + input.GetSize());
+		return true;
+	}
+}
+
+}
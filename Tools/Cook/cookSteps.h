@@ -0,0 +1,102 @@
+/*
+Copyright (c) <2017> <Udo Lugauer>
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE
+*/
+#pragma once
+
+/// @file cookSteps.h
+///       Cook steps which turn content files into runtime ready files
+
+#include "Memory/allocatorBase.h"
+#include "Resource/resourceLoader.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <memory>
+
+namespace cave
+{
+
+/**
+* @brief How a content file is cooked
+*/
+enum class CookItemType
+{
+	Material = 0,	///< Material asset (.asset), compiled to the binary material format
+	Shader = 1,		///< SPIR-V shader (.spv)
+	Image = 2,		///< DDS image (.dds)
+	Copy = 3		///< Anything else is copied unchanged
+};
+
+/**
+* @brief Shared state of all cook steps. Read only while steps run.
+*/
+struct CookContext
+{
+	std::string _contentDir;					///< Content root including the trailing '/'
+	std::vector<std::string> _files;			///< Sorted content relative paths of all inputs
+	std::shared_ptr<AllocatorBase> _pAllocator;	///< Allocator for image data
+};
+
+/**
+* @brief Output of a cook step
+*/
+struct CookResult
+{
+	std::vector<uint8_t> _output;				///< Cooked file content
+	std::vector<std::string> _dependencies;		///< Other inputs the output depends on
+	std::string _error;							///< Error message if the step failed
+};
+
+/**
+* @brief Get the cook step of a file
+*
+* @param[in] path	Content relative path
+*
+* @return item type
+*/
+CookItemType CookGetItemType(const std::string& path);
+
+/**
+* @brief Hash file content (64 bit FNV-1a)
+*
+* @param[in] data	Content
+* @param[in] size	Content size in bytes
+*
+* @return hash value
+*/
+uint64_t CookHashContent(const uint8_t* data, size_t size);
+
+/**
+* @brief Map a file or read it if it can't be mapped (e.g. empty files)
+*
+* @param[in] path	File path
+* @param[out] data	Receives the content
+*
+* @return false if the file can't be read
+*/
+bool CookReadFile(const std::string& path, ResourceLoadData& data);
+
+/**
+* @brief Cook one content file. Safe to call from several threads.
+*
+* @param[in] context	Cook context
+* @param[in] path		Content relative path
+* @param[in] input		File content
+* @param[out] result	Receives the cooked content or an error
+*
+* @return true on success
+*/
+bool CookItem(const CookContext& context, const std::string& path, ResourceLoadData& input, CookResult& result);
+
+}